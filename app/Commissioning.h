@@ -67,4 +67,19 @@ Maintainer: Miguel Luis and Gregory Cristian
  */
 #define LORAWAN_APPSKEY                             { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C }
 
+/*!
+ * Multicast group address on the network (big endian)
+ */
+#define LORAWAN_MC_ADDRESS                          ( uint32_t )0x01ABCDEF
+
+/*!
+ * AES encryption/decryption cipher multicast network session key
+ */
+#define LORAWAN_MC_NWKSKEY                          { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C }
+
+/*!
+ * AES encryption/decryption cipher multicast application session key
+ */
+#define LORAWAN_MC_APPSKEY                          { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C }
+
 #endif // __LORA_COMMISSIONING_H__
@@ -0,0 +1,224 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Energy budget driven uplink scheduling. Adapts the uplink period,
+             the frame type and the batching depth to reach a target lifetime
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "board.h"
+#include "EnergyBudget.h"
+
+/*!
+ * Energy budget parameters
+ */
+static EnergyBudgetParams_t Params;
+
+/*!
+ * Time elapsed since the deployment. The hours are kept in the statistics
+ */
+static uint32_t ElapsedMs;
+static TimerTime_t LastUpdateTime;
+
+/*!
+ * Background charge at the beginning of the background current measurement
+ */
+static uint32_t BackgroundCharge;
+static TimerTime_t BackgroundTime;
+
+/*!
+ * Current uplink policy
+ */
+static EnergyBudgetPolicy_t Policy;
+
+/*!
+ * Energy budget statistics
+ */
+static EnergyBudgetStats_t Stats;
+
+/*!
+ * \brief   Updates the time elapsed since the beginning of the lifetime
+ */
+static void UpdateElapsedTime( void )
+{
+    ElapsedMs += TimerGetElapsedTime( LastUpdateTime );
+    LastUpdateTime = TimerGetCurrentTime( );
+
+    while( ElapsedMs >= 3600000 )
+    {
+        ElapsedMs -= 3600000;
+        Stats.ElapsedHours++;
+    }
+}
+
+/*!
+ * \brief   Averages a new transaction charge
+ */
+static uint32_t AverageCharge( uint32_t average, uint32_t charge )
+{
+    if( average == 0 )
+    {
+        return charge;
+    }
+    return average - ( average >> ENERGY_BUDGET_CHARGE_SHIFT ) + ( charge >> ENERGY_BUDGET_CHARGE_SHIFT );
+}
+
+/*!
+ * \brief   Computes the period between two uplinks drawing the given charge
+ *          which fits into the radio current allowance
+ *
+ * \param   [IN] charge Uplink charge [nAh]
+ *
+ * \retval  Uplink interval [ms]
+ */
+static uint32_t GetUplinkInterval( uint32_t charge )
+{
+    uint64_t interval;
+
+    if( Stats.Allowance <= 0 )
+    {
+        return UINT32_MAX;
+    }
+    // nAh / nA = h
+    interval = ( ( uint64_t )charge * 3600000 ) / ( uint32_t )Stats.Allowance;
+    return ( interval > UINT32_MAX ) ? UINT32_MAX : ( uint32_t )interval;
+}
+
+void EnergyBudgetInit( const EnergyBudgetParams_t *params )
+{
+    Params = *params;
+
+    memset1( ( uint8_t* )&Stats, 0, sizeof( Stats ) );
+
+    Policy.Period = Params.MinPeriod;
+    Policy.Depth = 1;
+    Policy.Confirmed = true;
+
+    BackgroundCharge = 0;
+    BackgroundTime = TimerGetCurrentTime( );
+
+    EnergyBudgetRestore( Params.Lifetime, 0 );
+}
+
+void EnergyBudgetRestore( uint32_t lifetime, uint32_t elapsedHours )
+{
+    EnergyBudgetSetLifetime( lifetime );
+    Stats.ElapsedHours = elapsedHours;
+    ElapsedMs = 0;
+    LastUpdateTime = TimerGetCurrentTime( );
+}
+
+void EnergyBudgetSetLifetime( uint32_t lifetime )
+{
+    Params.Lifetime = lifetime;
+    Stats.Lifetime = lifetime;
+}
+
+void EnergyBudgetOnTransaction( const LoRaMacEnergy_t *energy )
+{
+    TimerTime_t elapsed = TimerGetElapsedTime( BackgroundTime );
+
+    if( energy->BackgroundCharge < BackgroundCharge )
+    { // The MAC energy accounting has been reset
+        BackgroundCharge = energy->BackgroundCharge;
+        BackgroundTime = TimerGetCurrentTime( );
+    }
+    else if( elapsed >= ENERGY_BUDGET_BACKGROUND_WINDOW )
+    {
+        // nAh / ms = 3.6e6 nA
+        Stats.BackgroundCurrent = ( ( uint64_t )( energy->BackgroundCharge - BackgroundCharge ) * 3600000 ) / elapsed;
+        BackgroundCharge = energy->BackgroundCharge;
+        BackgroundTime = TimerGetCurrentTime( );
+    }
+
+    switch( energy->Transaction )
+    {
+        case ENERGY_TRANSACTION_UNCONFIRMED:
+            Stats.UnconfirmedCharge = AverageCharge( Stats.UnconfirmedCharge, energy->Charge );
+            break;
+        case ENERGY_TRANSACTION_CONFIRMED:
+            Stats.ConfirmedCharge = AverageCharge( Stats.ConfirmedCharge, energy->Charge );
+            break;
+        default:
+            break;
+    }
+}
+
+const EnergyBudgetPolicy_t* EnergyBudgetUpdate( uint16_t voltage )
+{
+    uint32_t charge = 0;
+    uint32_t interval = 0;
+    uint32_t depth = 0;
+    uint64_t allowance = 0;
+
+    UpdateElapsedTime( );
+
+    // State of charge linear between the empty and the full voltages
+    Stats.Voltage = voltage;
+    if( voltage >= Params.FullVoltage )
+    {
+        Stats.Remaining = Params.Capacity * 1000;
+    }
+    else if( voltage > Params.EmptyVoltage )
+    {
+        Stats.Remaining = ( ( uint64_t )Params.Capacity * 1000 * ( voltage - Params.EmptyVoltage ) ) /
+                          ( Params.FullVoltage - Params.EmptyVoltage );
+    }
+    else
+    {
+        Stats.Remaining = 0;
+    }
+
+    Stats.RemainingLifetime = ENERGY_BUDGET_MIN_HORIZON;
+    if( Params.Lifetime > ( Stats.ElapsedHours + ENERGY_BUDGET_MIN_HORIZON ) )
+    {
+        Stats.RemainingLifetime = Params.Lifetime - Stats.ElapsedHours;
+    }
+
+    // nAh / h = nA
+    allowance = ( ( uint64_t )Stats.Remaining * 1000 ) / Stats.RemainingLifetime;
+    if( allowance > INT32_MAX )
+    {
+        allowance = INT32_MAX;
+    }
+    Stats.Allowance = ( int32_t )allowance - ( int32_t )MIN( ( uint64_t )Params.SleepCurrent + Stats.BackgroundCurrent, INT32_MAX );
+
+    // Confirmed uplinks when one record per uplink at the shortest period
+    // fits into the budget. Unknown confirmed charge is assumed to be twice
+    // the unconfirmed one
+    charge = Stats.ConfirmedCharge;
+    if( charge == 0 )
+    {
+        charge = Stats.UnconfirmedCharge * 2;
+    }
+    if( ( charge == 0 ) || ( GetUplinkInterval( charge ) <= Params.MinPeriod ) )
+    {
+        Policy.Period = Params.MinPeriod;
+        Policy.Depth = 1;
+        Policy.Confirmed = true;
+        return &Policy;
+    }
+
+    // Unconfirmed uplinks. Batch more records before stretching the period
+    interval = GetUplinkInterval( Stats.UnconfirmedCharge );
+    depth = ( interval / Params.MinPeriod ) + ( ( ( interval % Params.MinPeriod ) != 0 ) ? 1 : 0 );
+    depth = MAX( MIN( depth, Params.MaxDepth ), 1 );
+
+    Policy.Period = ( interval / depth ) + ( ( ( interval % depth ) != 0 ) ? 1 : 0 );
+    Policy.Period = MAX( MIN( Policy.Period, Params.MaxPeriod ), Params.MinPeriod );
+    Policy.Depth = depth;
+    Policy.Confirmed = false;
+    return &Policy;
+}
+
+const EnergyBudgetStats_t* EnergyBudgetGetStats( void )
+{
+    return &Stats;
+}
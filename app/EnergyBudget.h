@@ -0,0 +1,179 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Energy budget driven uplink scheduling. Adapts the uplink period,
+             the frame type and the batching depth to reach a target lifetime
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __ENERGY_BUDGET_H__
+#define __ENERGY_BUDGET_H__
+
+#include "LoRaMac.h"
+
+/*!
+ * Minimum remaining lifetime used to spread the remaining charge, value in [h].
+ * Once the target lifetime is reached the budget is spread over this horizon
+ */
+#define ENERGY_BUDGET_MIN_HORIZON                   24
+
+/*!
+ * Minimum time over which the background current is measured [ms]
+ */
+#define ENERGY_BUDGET_BACKGROUND_WINDOW             3600000
+
+/*!
+ * Weight of a new transaction in the average transaction charge, 1 / 2^N
+ */
+#define ENERGY_BUDGET_CHARGE_SHIFT                  2
+
+/*!
+ * Energy budget parameters
+ */
+typedef struct sEnergyBudgetParams
+{
+    /*!
+     * Battery capacity [mAh]
+     */
+    uint32_t Capacity;
+    /*!
+     * Battery voltage when fully charged and when empty [mV]
+     */
+    uint16_t FullVoltage;
+    uint16_t EmptyVoltage;
+    /*!
+     * Average device current outside of the radio transactions [nA]
+     */
+    uint32_t SleepCurrent;
+    /*!
+     * Target lifetime [h]
+     */
+    uint32_t Lifetime;
+    /*!
+     * Uplink period bounds [ms]
+     */
+    uint32_t MinPeriod;
+    uint32_t MaxPeriod;
+    /*!
+     * Maximum number of records per uplink
+     */
+    uint8_t MaxDepth;
+}EnergyBudgetParams_t;
+
+/*!
+ * Uplink scheduling policy
+ */
+typedef struct sEnergyBudgetPolicy
+{
+    /*!
+     * Record sampling period [ms]
+     */
+    uint32_t Period;
+    /*!
+     * Number of records per uplink
+     */
+    uint8_t Depth;
+    /*!
+     * Confirmed uplinks fit into the budget
+     */
+    bool Confirmed;
+}EnergyBudgetPolicy_t;
+
+/*!
+ * Energy budget statistics
+ */
+typedef struct sEnergyBudgetStats
+{
+    /*!
+     * Last measured battery voltage [mV]
+     */
+    uint16_t Voltage;
+    /*!
+     * Estimated remaining charge [uAh]
+     */
+    uint32_t Remaining;
+    /*!
+     * Target lifetime and time elapsed since the deployment [h]
+     */
+    uint32_t Lifetime;
+    uint32_t ElapsedHours;
+    /*!
+     * Remaining time to reach the target lifetime [h]
+     */
+    uint32_t RemainingLifetime;
+    /*!
+     * Average current drawn by the radio outside of the transactions, class B
+     * and class C receptions [nA]
+     */
+    uint32_t BackgroundCurrent;
+    /*!
+     * Average current the transactions may draw to reach the target lifetime [nA]
+     */
+    int32_t Allowance;
+    /*!
+     * Average charge of an unconfirmed and of a confirmed transaction [nAh].
+     * 0 until a transaction of this type has been measured
+     */
+    uint32_t UnconfirmedCharge;
+    uint32_t ConfirmedCharge;
+}EnergyBudgetStats_t;
+
+/*!
+ * \brief   Initializes the energy budget. The lifetime starts now
+ *
+ * \param   [IN] params   Energy budget parameters
+ */
+void EnergyBudgetInit( const EnergyBudgetParams_t *params );
+
+/*!
+ * \brief   Resumes the lifetime after a reset
+ *
+ * \remark  The application stores Lifetime and ElapsedHours of the statistics
+ *          each time ElapsedHours changes. At most one hour is lost per reset
+ *
+ * \param   [IN] lifetime     Target lifetime [h]
+ * \param   [IN] elapsedHours Time elapsed since the deployment [h]
+ */
+void EnergyBudgetRestore( uint32_t lifetime, uint32_t elapsedHours );
+
+/*!
+ * \brief   Changes the target lifetime. The lifetime is counted from the
+ *          deployment, the time already elapsed is kept
+ *
+ * \param   [IN] lifetime Target lifetime [h]
+ */
+void EnergyBudgetSetLifetime( uint32_t lifetime );
+
+/*!
+ * \brief   Must be called once a transaction is completed. Updates the average
+ *          transaction charges and the background current
+ *
+ * \param   [IN] energy   Energy of the completed transaction
+ */
+void EnergyBudgetOnTransaction( const LoRaMacEnergy_t *energy );
+
+/*!
+ * \brief   Computes the uplink policy from the battery voltage. Must be called
+ *          at least once every TimerTime_t wrap around period
+ *
+ * \param   [IN] voltage  Battery voltage [mV]
+ *
+ * \retval  policy Pointer to the uplink policy
+ */
+const EnergyBudgetPolicy_t* EnergyBudgetUpdate( uint16_t voltage );
+
+/*!
+ * \brief   Gets the energy budget statistics
+ *
+ * \retval  stats Pointer to the energy budget statistics
+ */
+const EnergyBudgetStats_t* EnergyBudgetGetStats( void );
+
+#endif // __ENERGY_BUDGET_H__
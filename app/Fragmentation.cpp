@@ -0,0 +1,875 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Large messages fragmentation transport over LoRaMAC frames
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "board.h"
+#include "Fragmentation.h"
+
+/*!
+ * Size of the message size prefix
+ */
+#define FRAG_MSG_SIZE_PREFIX                        2
+
+/*!
+ * Message in transfer
+ */
+static uint8_t *FragTxBuffer;
+static uint16_t FragTxBufferSize;
+
+/*!
+ * Message transfer parameters
+ */
+static uint8_t FragTxPort;
+static uint8_t FragTxParityGroupSize;
+static uint8_t FragTxMessageId = 0;
+
+/*!
+ * Index of the next data fragment and of the next parity group to be sent
+ */
+static uint8_t FragTxNextFragment;
+static uint8_t FragTxNextParity;
+
+/*!
+ * Set while a fragment is handed over to the MAC layer
+ */
+static bool FragTxPending = false;
+
+/*!
+ * Set while an empty frame flushing the MAC commands is handed over to the
+ * MAC layer
+ */
+static bool FragTxFlushPending = false;
+
+/*!
+ * Transfer status
+ */
+static FragStatus_t FragTxStatus = FRAG_STATUS_IDLE;
+
+/*!
+ * Transfer statistics
+ */
+static FragTxStats_t FragTxStats;
+
+/*!
+ * Fragment buffer, header included
+ */
+static uint8_t FragTxFrame[FRAG_HEADER_SIZE + FRAG_MAX_FRAGMENT_SIZE];
+
+/*!
+ * \brief   Gets a byte of the data stream. The stream is the message prefixed
+ *          by its size and padded with zeros
+ *
+ * \param   [IN] index Byte index in the stream
+ *
+ * \retval  Stream byte
+ */
+static uint8_t FragTxGetStreamByte( uint16_t index )
+{
+    if( index == 0 )
+    {
+        return ( FragTxBufferSize >> 8 ) & 0xFF;
+    }
+    if( index == 1 )
+    {
+        return FragTxBufferSize & 0xFF;
+    }
+    index -= FRAG_MSG_SIZE_PREFIX;
+    if( index < FragTxBufferSize )
+    {
+        return FragTxBuffer[index];
+    }
+    return 0;
+}
+
+/*!
+ * \brief   Builds the data fragment
+ *
+ * \param   [IN] fragment Data fragment index
+ */
+static void FragTxBuildData( uint8_t fragment )
+{
+    uint16_t offset = fragment * FragTxStats.FragmentSize;
+
+    for( uint8_t i = 0; i < FragTxStats.FragmentSize; i++ )
+    {
+        FragTxFrame[FRAG_HEADER_SIZE + i] = FragTxGetStreamByte( offset + i );
+    }
+}
+
+/*!
+ * \brief   Builds the parity fragment of a group
+ *
+ * \param   [IN] group Parity group index
+ */
+static void FragTxBuildParity( uint8_t group )
+{
+    uint8_t first = group * FragTxParityGroupSize;
+    uint8_t last = MIN( first + FragTxParityGroupSize, FragTxStats.NbFragments );
+
+    memset1( FragTxFrame + FRAG_HEADER_SIZE, 0, FragTxStats.FragmentSize );
+    for( uint8_t fragment = first; fragment < last; fragment++ )
+    {
+        uint16_t offset = fragment * FragTxStats.FragmentSize;
+
+        for( uint8_t i = 0; i < FragTxStats.FragmentSize; i++ )
+        {
+            FragTxFrame[FRAG_HEADER_SIZE + i] ^= FragTxGetStreamByte( offset + i );
+        }
+    }
+}
+
+LoRaMacStatus_t FragTxStart( uint8_t *buffer, uint16_t size, uint8_t port, uint8_t parityGroupSize )
+{
+    LoRaMacTxPlan_t txPlan;
+    uint32_t nbFragments = 0;
+    uint32_t nbParity = 0;
+    uint16_t maxPayload = 0;
+    uint8_t fragmentSize = 0;
+
+    if( ( buffer == NULL ) || ( size == 0 ) || ( port == 0 ) || ( port >= 224 ) )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    if( FragTxStatus == FRAG_STATUS_RUNNING )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+    if( LoRaMacQueryTxPlan( FRAG_HEADER_SIZE, &txPlan ) != LORAMAC_STATUS_OK )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+
+    // Largest payload of the lowest allowed datarate, MAC commands excluded
+    maxPayload = FRAG_HEADER_SIZE + FRAG_MAX_FRAGMENT_SIZE;
+    for( uint8_t i = 0; i < ( LORAMAC_TX_MAX_DATARATE - LORAMAC_TX_MIN_DATARATE + 1 ); i++ )
+    {
+        if( txPlan.Entries[i].Allowed == true )
+        {
+            maxPayload = MIN( maxPayload, txPlan.Entries[i].MaxPossiblePayload + txPlan.FOptsLen );
+        }
+    }
+    if( maxPayload <= FRAG_HEADER_SIZE )
+    {
+        return LORAMAC_STATUS_LENGTH_ERROR;
+    }
+    fragmentSize = maxPayload - FRAG_HEADER_SIZE;
+
+    nbFragments = ( size + FRAG_MSG_SIZE_PREFIX + fragmentSize - 1 ) / fragmentSize;
+    if( parityGroupSize != 0 )
+    {
+        nbParity = ( nbFragments + parityGroupSize - 1 ) / parityGroupSize;
+    }
+    if( ( nbFragments + nbParity ) > FRAG_MAX_NB_FRAGMENTS )
+    {
+        return LORAMAC_STATUS_LENGTH_ERROR;
+    }
+
+    FragTxBuffer = buffer;
+    FragTxBufferSize = size;
+    FragTxPort = port;
+    FragTxParityGroupSize = parityGroupSize;
+    FragTxMessageId++;
+    FragTxNextFragment = 0;
+    FragTxNextParity = 0;
+    FragTxPending = false;
+    FragTxFlushPending = false;
+
+    FragTxStats.NbFragments = nbFragments;
+    FragTxStats.NbFragmentsSent = 0;
+    FragTxStats.FragmentSize = fragmentSize;
+    FragTxStats.TimeOnAir = 0;
+
+    FragTxStatus = FRAG_STATUS_RUNNING;
+    return LORAMAC_STATUS_OK;
+}
+
+void FragTxStop( void )
+{
+    if( FragTxStatus == FRAG_STATUS_RUNNING )
+    {
+        FragTxStatus = FRAG_STATUS_ERROR;
+    }
+}
+
+void FragTxProcess( void )
+{
+    McpsReq_t mcpsReq;
+    LoRaMacTxPlan_t txPlan;
+    LoRaMacTxInfo_t txInfo;
+    LoRaMacStatus_t status;
+    uint8_t index = 0;
+    bool parity = false;
+
+    if( ( FragTxStatus != FRAG_STATUS_RUNNING ) || ( FragTxPending == true ) || ( FragTxFlushPending == true ) )
+    {
+        return;
+    }
+
+    if( LoRaMacQueryTxPossible( FRAG_HEADER_SIZE + FragTxStats.FragmentSize, &txInfo ) == LORAMAC_STATUS_MAC_CMD_LENGTH_ERROR )
+    {
+        // Send empty frame in order to flush MAC commands
+        mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fBuffer = NULL;
+        mcpsReq.Req.Unconfirmed.fBufferSize = 0;
+        mcpsReq.Req.Unconfirmed.Datarate = DR_0;
+        if( LoRaMacQueryTxPlan( 0, &txPlan ) == LORAMAC_STATUS_OK )
+        {
+            mcpsReq.Req.Unconfirmed.Datarate = txPlan.CurrentDatarate;
+        }
+        if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
+        {
+            FragTxFlushPending = true;
+        }
+        return;
+    }
+
+    // The parity fragment of a group is sent right after its last data fragment
+    if( ( FragTxParityGroupSize != 0 ) &&
+        ( FragTxNextParity < ( ( FragTxNextFragment + FragTxParityGroupSize - 1 ) / FragTxParityGroupSize ) ) &&
+        ( ( ( FragTxNextFragment % FragTxParityGroupSize ) == 0 ) || ( FragTxNextFragment == FragTxStats.NbFragments ) ) )
+    {
+        parity = true;
+    }
+    else if( FragTxNextFragment >= FragTxStats.NbFragments )
+    {
+        FragTxStatus = FRAG_STATUS_DONE;
+        return;
+    }
+
+    if( parity == true )
+    {
+        index = FragTxStats.NbFragments + FragTxNextParity;
+        FragTxBuildParity( FragTxNextParity );
+    }
+    else
+    {
+        index = FragTxNextFragment;
+        FragTxBuildData( FragTxNextFragment );
+    }
+    FragTxFrame[0] = FragTxMessageId;
+    FragTxFrame[1] = index;
+    FragTxFrame[2] = FragTxStats.NbFragments;
+    FragTxFrame[3] = FragTxParityGroupSize;
+
+    mcpsReq.Type = MCPS_UNCONFIRMED;
+    mcpsReq.Req.Unconfirmed.fPort = FragTxPort;
+    mcpsReq.Req.Unconfirmed.fBuffer = FragTxFrame;
+    mcpsReq.Req.Unconfirmed.fBufferSize = FRAG_HEADER_SIZE + FragTxStats.FragmentSize;
+    mcpsReq.Req.Unconfirmed.Datarate = DR_0;
+    if( LoRaMacQueryTxPlan( FRAG_HEADER_SIZE + FragTxStats.FragmentSize, &txPlan ) == LORAMAC_STATUS_OK )
+    {
+        mcpsReq.Req.Unconfirmed.Datarate = txPlan.CurrentDatarate;
+    }
+
+    // The MAC layer delays the transmission as long as the duty cycle requires
+    status = LoRaMacMcpsRequest( &mcpsReq );
+    switch( status )
+    {
+        case LORAMAC_STATUS_OK:
+            FragTxPending = true;
+            if( parity == true )
+            {
+                FragTxNextParity++;
+            }
+            else
+            {
+                FragTxNextFragment++;
+            }
+            break;
+        case LORAMAC_STATUS_BUSY:
+            // Try again on next call
+            break;
+        default:
+            // The fragment does not fit anymore or the MAC layer is unable to send
+            FragTxStatus = FRAG_STATUS_ERROR;
+            break;
+    }
+}
+
+void FragTxOnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+    FragTxFlushPending = false;
+    if( FragTxPending == false )
+    {
+        return;
+    }
+    FragTxPending = false;
+    if( mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
+    {
+        FragTxStats.NbFragmentsSent++;
+        FragTxStats.TimeOnAir += mcpsConfirm->TxTimeOnAir;
+    }
+}
+
+FragStatus_t FragTxGetStatus( void )
+{
+    return FragTxStatus;
+}
+
+const FragTxStats_t* FragTxGetStats( void )
+{
+    return &FragTxStats;
+}
+
+/*!
+ * Size of a bitmap holding one bit per missing data fragment
+ */
+#define FRAG_RX_MISSING_BITMAP_SIZE                 ( FRAG_RX_MAX_NB_MISSING / 8 )
+
+/*!
+ * Received fragment waiting for FragRxProcess
+ */
+typedef struct sFragRxQueueItem
+{
+    uint8_t Size;
+    uint8_t Buffer[FRAG_RX_HEADER_SIZE + FRAG_RX_MAX_FRAGMENT_SIZE];
+}FragRxQueueItem_t;
+
+/*!
+ * Staging memory access functions and parameters
+ */
+static FragRxCallbacks_t *FragRxCallbacks = NULL;
+static uint32_t FragRxStagingSize;
+static uint8_t FragRxPort;
+
+/*!
+ * Reassembly status
+ */
+static FragStatus_t FragRxStatus = FRAG_STATUS_IDLE;
+
+/*!
+ * Set once the staged message has been released. The fragments of the
+ * released session are then ignored
+ */
+static bool FragRxIsReleased = false;
+
+/*!
+ * Reassembly statistics
+ */
+static FragRxStats_t FragRxStats;
+
+/*!
+ * Number of padding bytes of the last data fragment
+ */
+static uint8_t FragRxPadding;
+
+/*!
+ * Size of the staging area used by the session and size already erased
+ */
+static uint32_t FragRxStagingUsed;
+static uint32_t FragRxErased;
+
+/*!
+ * Bitmap of the data fragments written to the staging area
+ */
+static uint8_t FragRxReceived[FRAG_RX_BITMAP_SIZE];
+
+/*!
+ * Set once the first parity fragment has fixed the list of missing data
+ * fragments. Missing fragment m is the m-th data fragment not received then
+ */
+static bool FragRxIsDecoding;
+static uint16_t FragRxNbMissing;
+static uint16_t FragRxMissing[FRAG_RX_MAX_NB_MISSING];
+
+/*!
+ * Reduced parity equations over the missing fragments, kept upper triangular.
+ * When bit m of FragRxPivots is set, FragRxMatrix[m] involves missing
+ * fragment m and missing fragments above m only. Its payload is stored in the
+ * staging area after the data fragments
+ */
+static uint8_t FragRxMatrix[FRAG_RX_MAX_NB_MISSING][FRAG_RX_MISSING_BITMAP_SIZE];
+static uint8_t FragRxPivots[FRAG_RX_MISSING_BITMAP_SIZE];
+static uint16_t FragRxRank;
+
+/*!
+ * Equation being reduced and its payload
+ */
+static uint8_t FragRxEquation[FRAG_RX_MISSING_BITMAP_SIZE];
+static uint8_t FragRxEquationData[FRAG_RX_MAX_FRAGMENT_SIZE];
+
+/*!
+ * Parity line and staging read buffers
+ */
+static uint8_t FragRxLine[FRAG_RX_BITMAP_SIZE];
+static uint8_t FragRxReadBuffer[FRAG_RX_MAX_FRAGMENT_SIZE];
+
+/*!
+ * Single producer, single consumer queue. FragRxQueueIn is only written by
+ * FragRxOnMcpsIndication, FragRxQueueOut by FragRxProcess
+ */
+static FragRxQueueItem_t FragRxQueue[FRAG_RX_QUEUE_SIZE];
+static volatile uint8_t FragRxQueueIn = 0;
+static volatile uint8_t FragRxQueueOut = 0;
+
+/*!
+ * Fragment bitmaps handling. Fragment i is bit ( i % 8 ) of byte ( i / 8 )
+ */
+static bool FragRxBitGet( const uint8_t *bitmap, uint16_t index )
+{
+    return ( bitmap[index >> 3] & ( 1 << ( index & 0x07 ) ) ) != 0;
+}
+
+static void FragRxBitSet( uint8_t *bitmap, uint16_t index )
+{
+    bitmap[index >> 3] |= 1 << ( index & 0x07 );
+}
+
+/*!
+ * \brief   Pseudo random binary sequence generator ( x^23 + x^18 + 1 )
+ *
+ * \param   [IN] value Current state
+ *
+ * \retval  Next state
+ */
+static uint32_t FragRxPrbs23( uint32_t value )
+{
+    uint32_t b0 = value & 0x01;
+    uint32_t b1 = ( value & 0x20 ) >> 5;
+
+    return ( value >> 1 ) + ( ( b0 ^ b1 ) << 22 );
+}
+
+void FragRxGetParityLine( uint16_t row, uint16_t nbFragments, uint8_t *line )
+{
+    uint32_t x = 1 + ( 1001 * ( ( uint32_t )row + 1 ) );
+    uint16_t nbProtected = MAX( nbFragments / 2, 1 );
+
+    memset1( line, 0, ( nbFragments + 7 ) / 8 );
+    // Dense line, about 40 % of the data fragments are protected so that any
+    // set of missing fragments is covered by few parity fragments
+    for( uint16_t m = 0; m < nbProtected; m++ )
+    {
+        x = FragRxPrbs23( x );
+        FragRxBitSet( line, x % nbFragments );
+    }
+}
+
+/*!
+ * \brief   Erases the staging area up to the given offset, FRAG_RX_ERASE_SIZE
+ *          bytes at a time
+ *
+ * \retval  [true: success, false: failure]
+ */
+static bool FragRxEraseUpTo( uint32_t end )
+{
+    while( FragRxErased < end )
+    {
+        if( FragRxCallbacks->Erase( FragRxErased, FRAG_RX_ERASE_SIZE ) == false )
+        {
+            FragRxStatus = FRAG_STATUS_ERROR;
+            return false;
+        }
+        FragRxErased += FRAG_RX_ERASE_SIZE;
+    }
+    return true;
+}
+
+/*!
+ * \brief   Writes a fragment to the staging area. The area is erased first
+ *          when FragRxProcess has not reached it yet
+ *
+ * \retval  [true: success, false: failure]
+ */
+static bool FragRxWrite( uint32_t offset, const uint8_t *data )
+{
+    if( ( FragRxEraseUpTo( offset + FragRxStats.FragmentSize ) == false ) ||
+        ( FragRxCallbacks->Write( offset, data, FragRxStats.FragmentSize ) == false ) )
+    {
+        FragRxStatus = FRAG_STATUS_ERROR;
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief   Reads a fragment from the staging area and XORs it into a buffer
+ *
+ * \retval  [true: success, false: failure]
+ */
+static bool FragRxReadXor( uint32_t offset, uint8_t *target )
+{
+    if( FragRxCallbacks->Read( offset, FragRxReadBuffer, FragRxStats.FragmentSize ) == false )
+    {
+        FragRxStatus = FRAG_STATUS_ERROR;
+        return false;
+    }
+    for( uint8_t j = 0; j < FragRxStats.FragmentSize; j++ )
+    {
+        target[j] ^= FragRxReadBuffer[j];
+    }
+    return true;
+}
+
+/*!
+ * \brief   Staging area offsets of a data fragment and of the payload of the
+ *          reduced equation of missing fragment m
+ */
+static uint32_t FragRxDataOffset( uint16_t index )
+{
+    return ( uint32_t )index * FragRxStats.FragmentSize;
+}
+
+static uint32_t FragRxEquationOffset( uint16_t m )
+{
+    return ( ( uint32_t )FragRxStats.NbFragments + m ) * FragRxStats.FragmentSize;
+}
+
+/*!
+ * \brief   Starts a new reassembly session. The staging area is erased
+ *          incrementally by FragRxProcess and on demand by FragRxWrite
+ */
+static void FragRxSessionStart( uint8_t sessionId, uint16_t nbFragments, uint8_t fragmentSize, uint8_t padding )
+{
+    FragRxStats.SessionId = sessionId;
+    FragRxStats.NbFragments = nbFragments;
+    FragRxStats.FragmentSize = fragmentSize;
+    FragRxStats.NbReceived = 0;
+    FragRxStats.NbRecovered = 0;
+    FragRxStats.NbParityDropped = 0;
+    FragRxStats.Size = 0;
+    FragRxPadding = padding;
+    FragRxIsReleased = false;
+
+    memset1( FragRxReceived, 0, FRAG_RX_BITMAP_SIZE );
+    FragRxIsDecoding = false;
+    FragRxNbMissing = 0;
+    FragRxRank = 0;
+    memset1( FragRxPivots, 0, FRAG_RX_MISSING_BITMAP_SIZE );
+
+    FragRxErased = 0;
+    FragRxStagingUsed = ( ( uint32_t )nbFragments + FRAG_RX_MAX_NB_MISSING ) * fragmentSize;
+    FragRxStagingUsed = ( ( FragRxStagingUsed + FRAG_RX_ERASE_SIZE - 1 ) / FRAG_RX_ERASE_SIZE ) * FRAG_RX_ERASE_SIZE;
+
+    // The session is kept in error until a new session identifier is received
+    if( ( nbFragments == 0 ) || ( nbFragments > FRAG_RX_MAX_NB_FRAGMENTS ) ||
+        ( ( fragmentSize % FRAG_RX_FRAGMENT_SIZE_ALIGN ) != 0 ) || ( padding >= fragmentSize ) ||
+        ( FragRxStagingUsed > FragRxStagingSize ) )
+    {
+        FragRxStatus = FRAG_STATUS_ERROR;
+        return;
+    }
+    FragRxStatus = FRAG_STATUS_RUNNING;
+}
+
+/*!
+ * \brief   Completes the session once all the data fragments are staged
+ */
+static void FragRxCheckDone( void )
+{
+    if( ( FragRxStatus == FRAG_STATUS_RUNNING ) &&
+        ( ( FragRxStats.NbReceived + FragRxStats.NbRecovered ) == FragRxStats.NbFragments ) )
+    {
+        FragRxStats.Size = ( ( uint32_t )FragRxStats.NbFragments * FragRxStats.FragmentSize ) - FragRxPadding;
+        FragRxStatus = FRAG_STATUS_DONE;
+    }
+}
+
+/*!
+ * \brief   Reduces FragRxEquation and its payload with the stored equations.
+ *          An equation which remains independent is stored with its lowest
+ *          missing fragment as pivot
+ *
+ * \retval  [true: equation stored, false: no new information or failure]
+ */
+static bool FragRxAddEquation( void )
+{
+    for( uint16_t m = 0; m < FragRxNbMissing; m++ )
+    {
+        if( FragRxBitGet( FragRxEquation, m ) == false )
+        {
+            continue;
+        }
+        if( FragRxBitGet( FragRxPivots, m ) == false )
+        {
+            if( FragRxWrite( FragRxEquationOffset( m ), FragRxEquationData ) == false )
+            {
+                return false;
+            }
+            memcpy1( FragRxMatrix[m], FragRxEquation, FRAG_RX_MISSING_BITMAP_SIZE );
+            FragRxBitSet( FragRxPivots, m );
+            FragRxRank++;
+            return true;
+        }
+        // The stored equation only involves missing fragments from m
+        for( uint8_t j = 0; j < FRAG_RX_MISSING_BITMAP_SIZE; j++ )
+        {
+            FragRxEquation[j] ^= FragRxMatrix[m][j];
+        }
+        if( FragRxReadXor( FragRxEquationOffset( m ), FragRxEquationData ) == false )
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+/*!
+ * \brief   Back substitution. Called once the stored equations determine all
+ *          the missing fragments, solved from the highest one down
+ */
+static void FragRxSolve( void )
+{
+    for( int16_t m = FragRxNbMissing - 1; ( m >= 0 ) && ( FragRxStatus == FRAG_STATUS_RUNNING ); m-- )
+    {
+        uint16_t index = FragRxMissing[m];
+
+        // Fragments received after the first parity fragment are in place
+        if( FragRxBitGet( FragRxReceived, index ) == true )
+        {
+            continue;
+        }
+        if( FragRxCallbacks->Read( FragRxEquationOffset( m ), FragRxEquationData, FragRxStats.FragmentSize ) == false )
+        {
+            FragRxStatus = FRAG_STATUS_ERROR;
+            return;
+        }
+        for( uint16_t k = m + 1; k < FragRxNbMissing; k++ )
+        {
+            if( ( FragRxBitGet( FragRxMatrix[m], k ) == true ) &&
+                ( FragRxReadXor( FragRxDataOffset( FragRxMissing[k] ), FragRxEquationData ) == false ) )
+            {
+                return;
+            }
+        }
+        if( FragRxWrite( FragRxDataOffset( index ), FragRxEquationData ) == false )
+        {
+            return;
+        }
+        FragRxBitSet( FragRxReceived, index );
+        FragRxStats.NbRecovered++;
+    }
+    FragRxCheckDone( );
+}
+
+/*!
+ * \brief   Writes a data fragment to the staging area. After the first parity
+ *          fragment, a missing fragment received late is also an equation
+ *
+ * \param   [IN] index Data fragment index
+ * \param   [IN] data  Fragment payload
+ */
+static void FragRxStoreData( uint16_t index, const uint8_t *data )
+{
+    if( FragRxBitGet( FragRxReceived, index ) == true )
+    {
+        return;
+    }
+    if( FragRxWrite( FragRxDataOffset( index ), data ) == false )
+    {
+        return;
+    }
+    FragRxBitSet( FragRxReceived, index );
+    FragRxStats.NbReceived++;
+
+    if( FragRxIsDecoding == true )
+    {
+        for( uint16_t m = 0; m < FragRxNbMissing; m++ )
+        {
+            if( FragRxMissing[m] == index )
+            {
+                memset1( FragRxEquation, 0, FRAG_RX_MISSING_BITMAP_SIZE );
+                FragRxBitSet( FragRxEquation, m );
+                memcpy1( FragRxEquationData, data, FragRxStats.FragmentSize );
+                if( ( FragRxAddEquation( ) == true ) && ( FragRxRank == FragRxNbMissing ) )
+                {
+                    FragRxSolve( );
+                }
+                break;
+            }
+        }
+    }
+    FragRxCheckDone( );
+}
+
+/*!
+ * \brief   Adds a parity fragment. The received data fragments it protects are
+ *          read back from the staging area and removed from it, the remaining
+ *          equation over the missing fragments is reduced and stored
+ *
+ * \param   [IN] parityRow Parity fragment number
+ * \param   [IN] data      Fragment payload
+ */
+static void FragRxStoreParity( uint16_t parityRow, const uint8_t *data )
+{
+    uint16_t nbFragments = FragRxStats.NbFragments;
+    uint16_t m = 0;
+
+    if( FragRxIsDecoding == false )
+    {
+        for( uint16_t i = 0; i < nbFragments; i++ )
+        {
+            if( FragRxBitGet( FragRxReceived, i ) == false )
+            {
+                if( FragRxNbMissing == FRAG_RX_MAX_NB_MISSING )
+                {
+                    // Too many losses, the next parity fragment tries again
+                    FragRxNbMissing = 0;
+                    FragRxStats.NbParityDropped++;
+                    return;
+                }
+                FragRxMissing[FragRxNbMissing++] = i;
+            }
+        }
+        FragRxIsDecoding = true;
+    }
+
+    FragRxGetParityLine( parityRow, nbFragments, FragRxLine );
+    memset1( FragRxEquation, 0, FRAG_RX_MISSING_BITMAP_SIZE );
+    memcpy1( FragRxEquationData, data, FragRxStats.FragmentSize );
+    for( uint16_t i = 0; i < nbFragments; i++ )
+    {
+        if( FragRxBitGet( FragRxLine, i ) == false )
+        {
+            continue;
+        }
+        if( FragRxBitGet( FragRxReceived, i ) == true )
+        {
+            if( FragRxReadXor( FragRxDataOffset( i ), FragRxEquationData ) == false )
+            {
+                return;
+            }
+            continue;
+        }
+        // Not received, hence in the sorted missing list
+        while( FragRxMissing[m] < i )
+        {
+            m++;
+        }
+        FragRxBitSet( FragRxEquation, m );
+    }
+
+    if( FragRxAddEquation( ) == false )
+    {
+        FragRxStats.NbParityDropped++;
+        return;
+    }
+    if( FragRxRank == FragRxNbMissing )
+    {
+        FragRxSolve( );
+    }
+}
+
+/*!
+ * \brief   Processes a received fragment
+ */
+static void FragRxProcessFragment( const uint8_t *buffer, uint8_t size )
+{
+    uint8_t sessionId = buffer[0];
+    uint16_t index = ( ( uint16_t )buffer[1] << 8 ) | buffer[2];
+    uint16_t nbFragments = ( ( uint16_t )buffer[3] << 8 ) | buffer[4];
+    uint8_t padding = buffer[5];
+    uint8_t fragmentSize = size - FRAG_RX_HEADER_SIZE;
+
+    if( FragRxStatus == FRAG_STATUS_DONE )
+    {
+        // The staged message is kept until it is released
+        return;
+    }
+    if( ( FragRxIsReleased == true ) && ( sessionId == FragRxStats.SessionId ) )
+    {
+        // Late fragment of the released session
+        return;
+    }
+    if( ( FragRxStatus == FRAG_STATUS_IDLE ) || ( sessionId != FragRxStats.SessionId ) )
+    {
+        FragRxSessionStart( sessionId, nbFragments, fragmentSize, padding );
+    }
+    if( ( FragRxStatus != FRAG_STATUS_RUNNING ) ||
+        ( nbFragments != FragRxStats.NbFragments ) || ( fragmentSize != FragRxStats.FragmentSize ) )
+    {
+        return;
+    }
+
+    if( index < nbFragments )
+    {
+        FragRxStoreData( index, buffer + FRAG_RX_HEADER_SIZE );
+    }
+    else
+    {
+        FragRxStoreParity( index - nbFragments, buffer + FRAG_RX_HEADER_SIZE );
+    }
+}
+
+void FragRxInit( FragRxCallbacks_t *callbacks, uint32_t stagingSize, uint8_t port )
+{
+    FragRxCallbacks = callbacks;
+    FragRxStagingSize = stagingSize;
+    FragRxPort = port;
+    FragRxStatus = FRAG_STATUS_IDLE;
+    FragRxIsReleased = false;
+    FragRxQueueOut = FragRxQueueIn;
+}
+
+void FragRxOnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+    FragRxQueueItem_t *item = NULL;
+
+    if( ( FragRxCallbacks == NULL ) || ( mcpsIndication->Status != LORAMAC_EVENT_INFO_STATUS_OK ) ||
+        ( mcpsIndication->Multicast == 0 ) || ( mcpsIndication->RxData == false ) ||
+        ( mcpsIndication->Port != FragRxPort ) )
+    {
+        return;
+    }
+    if( ( mcpsIndication->BufferSize <= FRAG_RX_HEADER_SIZE ) ||
+        ( mcpsIndication->BufferSize > ( FRAG_RX_HEADER_SIZE + FRAG_RX_MAX_FRAGMENT_SIZE ) ) )
+    {
+        return;
+    }
+    if( ( uint8_t )( FragRxQueueIn - FragRxQueueOut ) >= FRAG_RX_QUEUE_SIZE )
+    {
+        // Queue full, the fragment is handled as lost
+        return;
+    }
+
+    item = &FragRxQueue[FragRxQueueIn % FRAG_RX_QUEUE_SIZE];
+    memcpy1( item->Buffer, mcpsIndication->Buffer, mcpsIndication->BufferSize );
+    item->Size = mcpsIndication->BufferSize;
+    FragRxQueueIn++;
+}
+
+void FragRxProcess( void )
+{
+    while( FragRxQueueOut != FragRxQueueIn )
+    {
+        FragRxQueueItem_t *item = &FragRxQueue[FragRxQueueOut % FRAG_RX_QUEUE_SIZE];
+
+        FragRxProcessFragment( item->Buffer, item->Size );
+        FragRxQueueOut++;
+    }
+
+    // Erase ahead of the fragments without blocking the main loop for long
+    if( ( FragRxStatus == FRAG_STATUS_RUNNING ) && ( FragRxErased < FragRxStagingUsed ) )
+    {
+        FragRxEraseUpTo( FragRxErased + FRAG_RX_ERASE_SIZE );
+    }
+}
+
+FragStatus_t FragRxGetStatus( void )
+{
+    return FragRxStatus;
+}
+
+void FragRxRelease( void )
+{
+    if( FragRxStatus == FRAG_STATUS_DONE )
+    {
+        FragRxIsReleased = true;
+        FragRxStatus = FRAG_STATUS_IDLE;
+    }
+}
+
+const FragRxStats_t* FragRxGetStats( void )
+{
+    return &FragRxStats;
+}
@@ -0,0 +1,328 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Large messages fragmentation transport over LoRaMAC frames
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __FRAGMENTATION_H__
+#define __FRAGMENTATION_H__
+
+#include "LoRaMac.h"
+
+/*!
+ * Fragment header size
+ *
+ * Byte 0: Message identifier
+ * Byte 1: Fragment index. Data fragments are numbered from 0 to NbFragments - 1,
+ *         parity fragment of group g has index NbFragments + g
+ * Byte 2: NbFragments, number of data fragments of the message
+ * Byte 3: Parity group size. 0 when the message carries no parity fragments
+ *
+ * The data fragments carry the message prefixed by its size on 2 bytes ( big
+ * endian ). The last data fragment is padded with zeros up to the fragment
+ * size. A parity fragment is the XOR of the data fragments of its group, it
+ * repairs a single lost data fragment per group. A group losing two data
+ * fragments, or a data fragment and its parity fragment, is not recovered.
+ */
+#define FRAG_HEADER_SIZE                            4
+
+/*!
+ * Maximum fragment payload size, header excluded. 242 bytes is the largest
+ * applicative payload of all datarates
+ */
+#define FRAG_MAX_FRAGMENT_SIZE                      ( 242 - FRAG_HEADER_SIZE )
+
+/*!
+ * Maximum number of data and parity fragments of a message
+ */
+#define FRAG_MAX_NB_FRAGMENTS                       255
+
+/*!
+ * Fragmentation session status
+ */
+typedef enum eFragStatus
+{
+    /*!
+     * No message in transfer
+     */
+    FRAG_STATUS_IDLE,
+    /*!
+     * Message transfer in progress
+     */
+    FRAG_STATUS_RUNNING,
+    /*!
+     * All fragments have been sent
+     */
+    FRAG_STATUS_DONE,
+    /*!
+     * The transfer has been aborted
+     */
+    FRAG_STATUS_ERROR,
+}FragStatus_t;
+
+/*!
+ * Fragmentation transmitter statistics
+ */
+typedef struct sFragTxStats
+{
+    /*!
+     * Number of data fragments of the message
+     */
+    uint8_t NbFragments;
+    /*!
+     * Number of data and parity fragments sent
+     */
+    uint8_t NbFragmentsSent;
+    /*!
+     * Size of a fragment payload, header excluded
+     */
+    uint8_t FragmentSize;
+    /*!
+     * Accumulated time on air of the message [ms]
+     */
+    uint32_t TimeOnAir;
+}FragTxStats_t;
+
+/*!
+ * \brief   Starts the transfer of a message. The fragment size is the largest
+ *          payload of the lowest datarate allowed by the enabled channels, so
+ *          that every fragment still fits when ADR or the network lowers the
+ *          datarate during the transfer
+ *
+ * \remark  When the pending MAC commands do not fit along with a fragment,
+ *          an empty frame carrying them is sent first
+ *
+ * \param   [IN] buffer          Message buffer. Must remain valid until the
+ *                               end of the transfer
+ * \param   [IN] size            Message size
+ * \param   [IN] port            Application port used by the fragments
+ * \param   [IN] parityGroupSize Number of data fragments protected by a
+ *                               parity fragment. 0 disables the parity
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID,
+ *          \ref LORAMAC_STATUS_LENGTH_ERROR.
+ */
+LoRaMacStatus_t FragTxStart( uint8_t *buffer, uint16_t size, uint8_t port, uint8_t parityGroupSize );
+
+/*!
+ * \brief   Aborts the current transfer
+ */
+void FragTxStop( void );
+
+/*!
+ * \brief   Sends the next fragment when the MAC layer is ready. Must be called
+ *          from the application main loop
+ */
+void FragTxProcess( void );
+
+/*!
+ * \brief   Must be called from the application MCPS-Confirm event function
+ *
+ * \param   [IN] mcpsConfirm Pointer to the confirm structure
+ */
+void FragTxOnMcpsConfirm( McpsConfirm_t *mcpsConfirm );
+
+/*!
+ * \brief   Gets the transfer status
+ *
+ * \retval  status Current transfer status
+ */
+FragStatus_t FragTxGetStatus( void );
+
+/*!
+ * \brief   Gets the transfer statistics
+ *
+ * \retval  stats Pointer to the current transfer statistics
+ */
+const FragTxStats_t* FragTxGetStats( void );
+
+/*!
+ * Downlink fragment header size
+ *
+ * Byte 0   : Session identifier. A fragment carrying a new identifier starts a
+ *            new session
+ * Byte 1..2: Fragment index ( big endian ). Data fragments are numbered from 0
+ *            to NbFragments - 1, parity fragment r has index NbFragments + r
+ * Byte 3..4: NbFragments, number of data fragments of the message ( big endian )
+ * Byte 5   : Number of padding bytes at the end of the last data fragment
+ *
+ * All the fragments of a session have the same size. Parity fragment r is the
+ * XOR of the data fragments selected by FragRxGetParityLine.
+ *
+ * The staging area holds the data fragments at their final location followed
+ * by up to FRAG_RX_MAX_NB_MISSING reduced parity fragments.
+ */
+#define FRAG_RX_HEADER_SIZE                         6
+
+/*!
+ * Maximum number of data fragments of a downlink message
+ */
+#define FRAG_RX_MAX_NB_FRAGMENTS                    1024
+
+/*!
+ * Maximum downlink fragment payload size, header excluded
+ */
+#define FRAG_RX_MAX_FRAGMENT_SIZE                   64
+
+/*!
+ * The downlink fragment payload size must be a multiple of this value so that
+ * the fragments can be programmed in flash at their final location
+ */
+#define FRAG_RX_FRAGMENT_SIZE_ALIGN                 4
+
+/*!
+ * Maximum number of data fragments missing when the first parity fragment is
+ * processed. Beyond this value the parity fragments are dropped and only the
+ * data fragments complete the message. Must be a multiple of 8
+ */
+#define FRAG_RX_MAX_NB_MISSING                      64
+
+/*!
+ * Size of the staging area erased by a FragRxProcess call. Must be a multiple
+ * of the staging memory erase size
+ */
+#define FRAG_RX_ERASE_SIZE                          1024
+
+/*!
+ * Number of received fragments waiting for FragRxProcess. Must be a power of 2
+ */
+#define FRAG_RX_QUEUE_SIZE                          2
+
+/*!
+ * Size of a bitmap holding one bit per data fragment
+ */
+#define FRAG_RX_BITMAP_SIZE                         ( FRAG_RX_MAX_NB_FRAGMENTS / 8 )
+
+/*!
+ * Staging memory access functions. offset is relative to the beginning of the
+ * staging area
+ */
+typedef struct sFragRxCallbacks
+{
+    /*!
+     * \brief   Erases a part of the staging area
+     *
+     * \retval  [true: success, false: failure]
+     */
+    bool ( *Erase )( uint32_t offset, uint32_t size );
+    /*!
+     * \brief   Writes an erased part of the staging area
+     *
+     * \retval  [true: success, false: failure]
+     */
+    bool ( *Write )( uint32_t offset, const uint8_t *buffer, uint32_t size );
+    /*!
+     * \brief   Reads the staging area
+     *
+     * \retval  [true: success, false: failure]
+     */
+    bool ( *Read )( uint32_t offset, uint8_t *buffer, uint32_t size );
+}FragRxCallbacks_t;
+
+/*!
+ * Fragmentation receiver statistics
+ */
+typedef struct sFragRxStats
+{
+    /*!
+     * Current session identifier
+     */
+    uint8_t SessionId;
+    /*!
+     * Number of data fragments of the message
+     */
+    uint16_t NbFragments;
+    /*!
+     * Size of a fragment payload, header excluded
+     */
+    uint8_t FragmentSize;
+    /*!
+     * Number of data fragments received
+     */
+    uint16_t NbReceived;
+    /*!
+     * Number of data fragments recovered from the parity fragments
+     */
+    uint16_t NbRecovered;
+    /*!
+     * Number of parity fragments dropped because they brought no new
+     * information or because too many data fragments were missing
+     */
+    uint16_t NbParityDropped;
+    /*!
+     * Size of the reassembled message
+     */
+    uint32_t Size;
+}FragRxStats_t;
+
+/*!
+ * \brief   Initializes the fragmentation receiver
+ *
+ * \param   [IN] callbacks   Staging memory access functions
+ * \param   [IN] stagingSize Size of the staging area. Must be a multiple of
+ *                           FRAG_RX_ERASE_SIZE
+ * \param   [IN] port        Application port of the downlink fragments
+ */
+void FragRxInit( FragRxCallbacks_t *callbacks, uint32_t stagingSize, uint8_t port );
+
+/*!
+ * \brief   Must be called from the application MCPS-Indication event function.
+ *          The multicast fragments received on the session port are queued
+ *          for FragRxProcess
+ *
+ * \param   [IN] mcpsIndication Pointer to the indication structure
+ */
+void FragRxOnMcpsIndication( McpsIndication_t *mcpsIndication );
+
+/*!
+ * \brief   Reassembles the queued fragments and erases the next
+ *          FRAG_RX_ERASE_SIZE bytes of the staging area used by the session.
+ *          Must be called from the application main loop
+ */
+void FragRxProcess( void );
+
+/*!
+ * \brief   Gets the reassembly status
+ *
+ * \retval  status FRAG_STATUS_RUNNING while data fragments are missing,
+ *                 FRAG_STATUS_DONE once the message is staged
+ */
+FragStatus_t FragRxGetStatus( void );
+
+/*!
+ * \brief   Releases the staged message. Until then the fragments of the
+ *          other sessions are ignored so that the message is never erased
+ *          before the application consumed it
+ */
+void FragRxRelease( void );
+
+/*!
+ * \brief   Gets the reassembly statistics
+ *
+ * \retval  stats Pointer to the current session statistics
+ */
+const FragRxStats_t* FragRxGetStats( void );
+
+/*!
+ * \brief   Computes the data fragments protected by a parity fragment. The
+ *          sender uses the same function to build the parity fragments
+ *
+ * \param   [IN]  row         Parity fragment number
+ * \param   [IN]  nbFragments Number of data fragments of the message
+ * \param   [OUT] line        Bitmap of the protected fragments, fragment i is
+ *                            bit ( i % 8 ) of byte ( i / 8 )
+ */
+void FragRxGetParityLine( uint16_t row, uint16_t nbFragments, uint8_t *line );
+
+#endif // __FRAGMENTATION_H__
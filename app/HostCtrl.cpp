@@ -0,0 +1,916 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Binary host control protocol. Exposes the MCPS, MLME and MIB
+             services as COBS framed messages on the console UART
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "board.h"
+#include "HostCtrl.h"
+
+/*!
+ * Frame CRC size
+ */
+#define HOSTCTRL_CRC_SIZE                           2
+
+/*!
+ * Maximum COBS encoded frame size, delimiters excluded
+ */
+#define HOSTCTRL_FRAME_SIZE                         ( HOSTCTRL_MAX_MESSAGE_SIZE + HOSTCTRL_CRC_SIZE + ( ( HOSTCTRL_MAX_MESSAGE_SIZE + HOSTCTRL_CRC_SIZE ) / 254 ) + 1 )
+
+/*!
+ * Message header size
+ */
+#define HOSTCTRL_HEADER_SIZE                        2
+
+/*!
+ * Number of MLME services. The confirm of each service carries the sequence
+ * number of its last request
+ */
+#define HOSTCTRL_NB_MLME                            ( MLME_BEACON + 1 )
+
+/*!
+ * Messages ring buffer. Each message is stored as its size ( 2 bytes )
+ * followed by its bytes. Single producer, single consumer
+ */
+typedef struct sHostCtrlRing
+{
+    uint8_t *Buffer;
+    uint16_t Size;
+    volatile uint16_t Head;
+    volatile uint16_t Tail;
+}HostCtrlRing_t;
+
+/*!
+ * Function queueing bytes on the console UART
+ */
+static uint16_t ( *HostCtrlWrite )( const uint8_t *buffer, uint16_t size ) = NULL;
+
+/*!
+ * Frame being sent and its part already queued on the UART
+ */
+static uint8_t TxFrame[HOSTCTRL_FRAME_SIZE + 2];
+static uint16_t TxFrameSize = 0;
+static uint16_t TxFrameSent = 0;
+
+/*!
+ * Set once a valid frame has been received
+ */
+static bool HostCtrlActive = false;
+
+/*!
+ * Received frame
+ */
+static uint8_t RxFrame[HOSTCTRL_FRAME_SIZE];
+static uint16_t RxFrameSize = 0;
+static bool RxInFrame = false;
+static bool RxOverflow = false;
+
+/*!
+ * Pending requests, filled and executed from the main loop
+ */
+static uint8_t RequestBuffer[HOSTCTRL_REQUEST_BUFFER_SIZE];
+static HostCtrlRing_t RequestRing = { RequestBuffer, HOSTCTRL_REQUEST_BUFFER_SIZE, 0, 0 };
+
+/*!
+ * Request being executed. Kept until the MAC layer is ready to accept it
+ */
+static uint8_t Request[HOSTCTRL_MAX_MESSAGE_SIZE];
+static uint16_t RequestSize = 0;
+
+/*!
+ * Pending confirms and indications, filled from the MAC layer interrupts
+ */
+static uint8_t EventBuffer[HOSTCTRL_EVENT_BUFFER_SIZE];
+static HostCtrlRing_t EventRing = { EventBuffer, HOSTCTRL_EVENT_BUFFER_SIZE, 0, 0 };
+
+/*!
+ * Status of the requests refused on reception, sent by HostCtrlProcess
+ */
+static uint8_t ReplyBuffer[HOSTCTRL_REPLY_BUFFER_SIZE];
+static HostCtrlRing_t ReplyRing = { ReplyBuffer, HOSTCTRL_REPLY_BUFFER_SIZE, 0, 0 };
+
+/*!
+ * Set while the MAC layer transmits for a MCPS, join or continuous wave
+ * request. The next transmitting request waits for its confirm
+ */
+static volatile bool MacBusy = false;
+
+/*!
+ * Sequence number of the pending MCPS request and of the last request of
+ * each MLME service
+ */
+static uint8_t McpsSeq = 0;
+static uint8_t MlmeSeq[HOSTCTRL_NB_MLME];
+
+/*!
+ * Indications counter
+ */
+static uint8_t IndicationSeq = 0;
+
+/*!
+ * Join request keys. The MAC layer keeps pointers on them
+ */
+static uint8_t HostCtrlDevEui[8];
+static uint8_t HostCtrlAppEui[8];
+static uint8_t HostCtrlAppKey[16];
+
+/*!
+ * \brief Computes the CRC-16 CCITT of a buffer
+ */
+static uint16_t HostCtrlCrc( uint16_t crc, const uint8_t *buffer, uint16_t size )
+{
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        crc ^= ( uint16_t )buffer[i] << 8;
+        for( uint8_t j = 0; j < 8; j++ )
+        {
+            crc = ( ( crc & 0x8000 ) != 0 ) ? ( ( crc << 1 ) ^ 0x1021 ) : ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+/*!
+ * \brief Little endian fields helpers
+ */
+static uint8_t* HostCtrlPut16( uint8_t *buffer, uint16_t value )
+{
+    *buffer++ = value & 0xFF;
+    *buffer++ = ( value >> 8 ) & 0xFF;
+    return buffer;
+}
+
+static uint8_t* HostCtrlPut32( uint8_t *buffer, uint32_t value )
+{
+    buffer = HostCtrlPut16( buffer, value & 0xFFFF );
+    return HostCtrlPut16( buffer, value >> 16 );
+}
+
+static uint16_t HostCtrlGet16( const uint8_t *buffer )
+{
+    return ( uint16_t )buffer[0] | ( ( uint16_t )buffer[1] << 8 );
+}
+
+static uint32_t HostCtrlGet32( const uint8_t *buffer )
+{
+    return ( uint32_t )HostCtrlGet16( buffer ) | ( ( uint32_t )HostCtrlGet16( buffer + 2 ) << 16 );
+}
+
+/*!
+ * \brief Appends a message to a ring buffer
+ *
+ * \retval [true: message stored, false: ring buffer full]
+ */
+static bool HostCtrlRingPut( HostCtrlRing_t *ring, const uint8_t *message, uint16_t size )
+{
+    uint16_t head = ring->Head;
+    uint16_t used = ( head + ring->Size - ring->Tail ) % ring->Size;
+    uint8_t header[2];
+
+    if( ( ring->Size - used - 1 ) < ( size + 2 ) )
+    {
+        return false;
+    }
+    HostCtrlPut16( header, size );
+    for( uint16_t i = 0; i < ( size + 2 ); i++ )
+    {
+        ring->Buffer[head] = ( i < 2 ) ? header[i] : message[i - 2];
+        head = ( head + 1 ) % ring->Size;
+    }
+    // Commits the message
+    __DMB( );
+    ring->Head = head;
+    return true;
+}
+
+/*!
+ * \brief Removes the oldest message of a ring buffer
+ *
+ * \retval size Message size, 0 when the ring buffer is empty
+ */
+static uint16_t HostCtrlRingGet( HostCtrlRing_t *ring, uint8_t *message )
+{
+    uint16_t tail = ring->Tail;
+    uint8_t header[2];
+    uint16_t size;
+
+    if( tail == ring->Head )
+    {
+        return 0;
+    }
+    __DMB( );
+    header[0] = ring->Buffer[tail];
+    header[1] = ring->Buffer[( tail + 1 ) % ring->Size];
+    size = HostCtrlGet16( header );
+    tail = ( tail + 2 ) % ring->Size;
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        message[i] = ring->Buffer[tail];
+        tail = ( tail + 1 ) % ring->Size;
+    }
+    // Releases the message
+    __DMB( );
+    ring->Tail = tail;
+    return size;
+}
+
+/*!
+ * \brief Queues the rest of the frame being sent on the UART
+ *
+ * \retval [true: no frame pending, false: the UART queue is full]
+ */
+static bool HostCtrlFlush( void )
+{
+    if( TxFrameSent < TxFrameSize )
+    {
+        TxFrameSent += HostCtrlWrite( TxFrame + TxFrameSent, TxFrameSize - TxFrameSent );
+    }
+    return TxFrameSent == TxFrameSize;
+}
+
+/*!
+ * \brief Frames and sends a message. Must be called from the main loop only,
+ *        once HostCtrlFlush has reported no frame pending
+ */
+static void HostCtrlSend( const uint8_t *message, uint16_t size )
+{
+    uint8_t *frame = TxFrame;
+    uint16_t crc = HostCtrlCrc( 0, message, size );
+    uint16_t codeIndex = 1;
+    uint16_t length = 2;
+    uint8_t code = 1;
+    uint8_t c;
+
+    frame[0] = HOSTCTRL_FRAME_DELIMITER;
+    for( uint16_t i = 0; i < ( size + HOSTCTRL_CRC_SIZE ); i++ )
+    {
+        if( i < size )
+        {
+            c = message[i];
+        }
+        else
+        {
+            c = ( i == size ) ? ( crc & 0xFF ) : ( crc >> 8 );
+        }
+
+        if( c == 0 )
+        {
+            frame[codeIndex] = code;
+            codeIndex = length++;
+            code = 1;
+        }
+        else
+        {
+            frame[length++] = c;
+            code++;
+            if( code == 0xFF )
+            {
+                frame[codeIndex] = code;
+                codeIndex = length++;
+                code = 1;
+            }
+        }
+    }
+    frame[codeIndex] = code;
+    frame[length++] = HOSTCTRL_FRAME_DELIMITER;
+
+    TxFrameSize = length;
+    TxFrameSent = 0;
+    HostCtrlFlush( );
+}
+
+/*!
+ * \brief Sends the status of a request
+ */
+static void HostCtrlSendStatus( uint8_t seq, LoRaMacStatus_t status, const uint8_t *value, uint8_t size )
+{
+    uint8_t message[HOSTCTRL_HEADER_SIZE + 1 + 16];
+
+    message[0] = HOSTCTRL_STATUS;
+    message[1] = seq;
+    message[2] = status;
+    memcpy1( message + 3, value, size );
+    HostCtrlSend( message, 3 + size );
+}
+
+/*!
+ * \brief Queues the status of a request refused on reception. Dropped when
+ *        the ring buffer is full, the host times the request out
+ */
+static void HostCtrlQueueStatus( uint8_t seq, LoRaMacStatus_t status )
+{
+    uint8_t message[HOSTCTRL_HEADER_SIZE + 1];
+
+    message[0] = HOSTCTRL_STATUS;
+    message[1] = seq;
+    message[2] = status;
+    HostCtrlRingPut( &ReplyRing, message, sizeof( message ) );
+}
+
+/*!
+ * \brief Decodes a received frame in place
+ *
+ * \retval size Message size, 0 for an invalid frame
+ */
+static uint16_t HostCtrlDecode( uint8_t *frame, uint16_t size )
+{
+    uint16_t in = 0;
+    uint16_t out = 0;
+    uint8_t code;
+
+    while( in < size )
+    {
+        code = frame[in++];
+        if( ( in + code - 1 ) > size )
+        {
+            return 0;
+        }
+        for( uint8_t i = 1; i < code; i++ )
+        {
+            frame[out++] = frame[in++];
+        }
+        if( ( code != 0xFF ) && ( in < size ) )
+        {
+            frame[out++] = 0;
+        }
+    }
+    if( ( out < ( HOSTCTRL_HEADER_SIZE + HOSTCTRL_CRC_SIZE ) ) ||
+        ( HostCtrlCrc( 0, frame, out - HOSTCTRL_CRC_SIZE ) != HostCtrlGet16( frame + out - HOSTCTRL_CRC_SIZE ) ) )
+    {
+        return 0;
+    }
+    return out - HOSTCTRL_CRC_SIZE;
+}
+
+/*!
+ * \brief Gets a scalar MIB attribute
+ */
+static LoRaMacStatus_t HostCtrlMibGet( Mib_t type, uint8_t *value, uint8_t *size )
+{
+    MibRequestConfirm_t mibReq;
+    LoRaMacStatus_t status;
+    uint32_t scalar;
+
+    switch( type )
+    {
+        case MIB_NWK_SKEY:
+        case MIB_APP_SKEY:
+        case MIB_CHANNELS:
+        case MIB_CHANNELS_MASK:
+        case MIB_CHANNELS_DEFAULT_MASK:
+        case MIB_ENERGY:
+        case MIB_ENERGY_TABLE:
+            // The keys are write only, the tables are not exposed
+            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+        default:
+            break;
+    }
+
+    mibReq.Type = type;
+    status = LoRaMacMibGetRequestConfirm( &mibReq );
+    if( status != LORAMAC_STATUS_OK )
+    {
+        return status;
+    }
+
+    switch( type )
+    {
+        case MIB_DEVICE_CLASS:              scalar = mibReq.Param.Class; break;
+        case MIB_NETWORK_JOINED:            scalar = mibReq.Param.IsNetworkJoined; break;
+        case MIB_ADR:                       scalar = mibReq.Param.AdrEnable; break;
+        case MIB_NET_ID:                    scalar = mibReq.Param.NetID; break;
+        case MIB_DEV_ADDR:                  scalar = mibReq.Param.DevAddr; break;
+        case MIB_PUBLIC_NETWORK:            scalar = mibReq.Param.EnablePublicNetwork; break;
+        case MIB_REPEATER_SUPPORT:          scalar = mibReq.Param.EnableRepeaterSupport; break;
+        case MIB_CHANNELS_NB_REP:           scalar = mibReq.Param.ChannelNbRep; break;
+        case MIB_MAX_RX_WINDOW_DURATION:    scalar = mibReq.Param.MaxRxWindow; break;
+        case MIB_RECEIVE_DELAY_1:           scalar = mibReq.Param.ReceiveDelay1; break;
+        case MIB_RECEIVE_DELAY_2:           scalar = mibReq.Param.ReceiveDelay2; break;
+        case MIB_JOIN_ACCEPT_DELAY_1:       scalar = mibReq.Param.JoinAcceptDelay1; break;
+        case MIB_JOIN_ACCEPT_DELAY_2:       scalar = mibReq.Param.JoinAcceptDelay2; break;
+        case MIB_CHANNELS_DEFAULT_DATARATE: scalar = mibReq.Param.ChannelsDefaultDatarate; break;
+        case MIB_CHANNELS_DATARATE:         scalar = mibReq.Param.ChannelsDatarate; break;
+        case MIB_CHANNELS_DEFAULT_TX_POWER: scalar = mibReq.Param.ChannelsDefaultTxPower; break;
+        case MIB_CHANNELS_TX_POWER:         scalar = mibReq.Param.ChannelsTxPower; break;
+        case MIB_UPLINK_COUNTER:            scalar = mibReq.Param.UpLinkCounter; break;
+        case MIB_DOWNLINK_COUNTER:          scalar = mibReq.Param.DownLinkCounter; break;
+        case MIB_MULTICAST_CHANNEL:         scalar = mibReq.Param.NbMulticastChannels; break;
+        case MIB_SYSTEM_MAX_RX_ERROR:       scalar = mibReq.Param.SystemMaxRxError; break;
+        case MIB_MIN_RX_SYMBOLS:            scalar = mibReq.Param.MinRxSymbols; break;
+        case MIB_REGION:                    scalar = mibReq.Param.Region; break;
+        case MIB_LINK_ADR:                  scalar = mibReq.Param.LinkAdrEnable; break;
+        case MIB_DEV_NONCE:                 scalar = mibReq.Param.DevNonce; break;
+        case MIB_RX2_CHANNEL:
+        case MIB_RX2_DEFAULT_CHANNEL:
+        {
+            Rx2ChannelParams_t *rx2 = ( type == MIB_RX2_CHANNEL ) ? &mibReq.Param.Rx2Channel : &mibReq.Param.Rx2DefaultChannel;
+
+            HostCtrlPut32( value, rx2->Frequency );
+            value[4] = rx2->Datarate;
+            *size = 5;
+            return LORAMAC_STATUS_OK;
+        }
+        default:
+            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+    HostCtrlPut32( value, scalar );
+    *size = 4;
+    return LORAMAC_STATUS_OK;
+}
+
+/*!
+ * \brief Sets a scalar MIB attribute or a key
+ */
+static LoRaMacStatus_t HostCtrlMibSet( Mib_t type, const uint8_t *value, uint16_t size )
+{
+    MibRequestConfirm_t mibReq;
+    uint32_t scalar;
+
+    mibReq.Type = type;
+    switch( type )
+    {
+        case MIB_NWK_SKEY:
+        case MIB_APP_SKEY:
+            if( size != 16 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            // Copied by the MAC layer
+            if( type == MIB_NWK_SKEY )
+            {
+                mibReq.Param.NwkSKey = ( uint8_t* )value;
+            }
+            else
+            {
+                mibReq.Param.AppSKey = ( uint8_t* )value;
+            }
+            return LoRaMacMibSetRequestConfirm( &mibReq );
+        case MIB_RX2_CHANNEL:
+        case MIB_RX2_DEFAULT_CHANNEL:
+            if( size != 5 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            if( type == MIB_RX2_CHANNEL )
+            {
+                mibReq.Param.Rx2Channel.Frequency = HostCtrlGet32( value );
+                mibReq.Param.Rx2Channel.Datarate = value[4];
+            }
+            else
+            {
+                mibReq.Param.Rx2DefaultChannel.Frequency = HostCtrlGet32( value );
+                mibReq.Param.Rx2DefaultChannel.Datarate = value[4];
+            }
+            return LoRaMacMibSetRequestConfirm( &mibReq );
+        default:
+            break;
+    }
+
+    if( size != 4 )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    scalar = HostCtrlGet32( value );
+
+    switch( type )
+    {
+        case MIB_DEVICE_CLASS:              mibReq.Param.Class = ( DeviceClass_t )scalar; break;
+        case MIB_NETWORK_JOINED:            mibReq.Param.IsNetworkJoined = ( scalar != 0 ); break;
+        case MIB_ADR:                       mibReq.Param.AdrEnable = ( scalar != 0 ); break;
+        case MIB_NET_ID:                    mibReq.Param.NetID = scalar; break;
+        case MIB_DEV_ADDR:                  mibReq.Param.DevAddr = scalar; break;
+        case MIB_PUBLIC_NETWORK:            mibReq.Param.EnablePublicNetwork = ( scalar != 0 ); break;
+        case MIB_REPEATER_SUPPORT:          mibReq.Param.EnableRepeaterSupport = ( scalar != 0 ); break;
+        case MIB_CHANNELS_NB_REP:           mibReq.Param.ChannelNbRep = scalar; break;
+        case MIB_MAX_RX_WINDOW_DURATION:    mibReq.Param.MaxRxWindow = scalar; break;
+        case MIB_RECEIVE_DELAY_1:           mibReq.Param.ReceiveDelay1 = scalar; break;
+        case MIB_RECEIVE_DELAY_2:           mibReq.Param.ReceiveDelay2 = scalar; break;
+        case MIB_JOIN_ACCEPT_DELAY_1:       mibReq.Param.JoinAcceptDelay1 = scalar; break;
+        case MIB_JOIN_ACCEPT_DELAY_2:       mibReq.Param.JoinAcceptDelay2 = scalar; break;
+        case MIB_CHANNELS_DEFAULT_DATARATE: mibReq.Param.ChannelsDefaultDatarate = ( int8_t )scalar; break;
+        case MIB_CHANNELS_DATARATE:         mibReq.Param.ChannelsDatarate = ( int8_t )scalar; break;
+        case MIB_CHANNELS_DEFAULT_TX_POWER: mibReq.Param.ChannelsDefaultTxPower = ( int8_t )scalar; break;
+        case MIB_CHANNELS_TX_POWER:         mibReq.Param.ChannelsTxPower = ( int8_t )scalar; break;
+        case MIB_UPLINK_COUNTER:            mibReq.Param.UpLinkCounter = scalar; break;
+        case MIB_DOWNLINK_COUNTER:          mibReq.Param.DownLinkCounter = scalar; break;
+        case MIB_SYSTEM_MAX_RX_ERROR:       mibReq.Param.SystemMaxRxError = scalar; break;
+        case MIB_MIN_RX_SYMBOLS:            mibReq.Param.MinRxSymbols = scalar; break;
+        case MIB_REGION:                    mibReq.Param.Region = ( LoRaMacRegion_t )scalar; break;
+        case MIB_LINK_ADR:                  mibReq.Param.LinkAdrEnable = ( scalar != 0 ); break;
+        case MIB_DEV_NONCE:                 mibReq.Param.DevNonce = scalar; break;
+        default:
+            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+    return LoRaMacMibSetRequestConfirm( &mibReq );
+}
+
+/*!
+ * \brief Executes a MCPS request
+ */
+static LoRaMacStatus_t HostCtrlMcpsRequest( const uint8_t *body, uint16_t size )
+{
+    McpsReq_t mcpsReq;
+    uint8_t *data = ( uint8_t* )body + 4;
+    uint16_t dataSize;
+
+    if( size < 4 )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    dataSize = size - 4;
+
+    mcpsReq.Type = ( Mcps_t )body[0];
+    switch( mcpsReq.Type )
+    {
+        case MCPS_UNCONFIRMED:
+            mcpsReq.Req.Unconfirmed.fPort = body[1];
+            mcpsReq.Req.Unconfirmed.fBuffer = ( dataSize != 0 ) ? data : NULL;
+            mcpsReq.Req.Unconfirmed.fBufferSize = dataSize;
+            mcpsReq.Req.Unconfirmed.Datarate = body[2];
+            break;
+        case MCPS_CONFIRMED:
+            mcpsReq.Req.Confirmed.fPort = body[1];
+            mcpsReq.Req.Confirmed.fBuffer = ( dataSize != 0 ) ? data : NULL;
+            mcpsReq.Req.Confirmed.fBufferSize = dataSize;
+            mcpsReq.Req.Confirmed.Datarate = body[2];
+            mcpsReq.Req.Confirmed.NbTrials = body[3];
+            break;
+        case MCPS_PROPRIETARY:
+            mcpsReq.Req.Proprietary.fBuffer = ( dataSize != 0 ) ? data : NULL;
+            mcpsReq.Req.Proprietary.fBufferSize = dataSize;
+            mcpsReq.Req.Proprietary.Datarate = body[2];
+            break;
+        default:
+            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+    return LoRaMacMcpsRequest( &mcpsReq );
+}
+
+/*!
+ * \brief Executes a MLME request
+ */
+static LoRaMacStatus_t HostCtrlMlmeRequest( const uint8_t *body, uint16_t size )
+{
+    MlmeReq_t mlmeReq;
+
+    if( size < 1 )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+
+    mlmeReq.Type = ( Mlme_t )body[0];
+    switch( mlmeReq.Type )
+    {
+        case MLME_JOIN:
+            if( size != 34 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            memcpy1( HostCtrlDevEui, body + 1, 8 );
+            memcpy1( HostCtrlAppEui, body + 9, 8 );
+            memcpy1( HostCtrlAppKey, body + 17, 16 );
+            mlmeReq.Req.Join.DevEui = HostCtrlDevEui;
+            mlmeReq.Req.Join.AppEui = HostCtrlAppEui;
+            mlmeReq.Req.Join.AppKey = HostCtrlAppKey;
+            mlmeReq.Req.Join.NbTrials = body[33];
+            break;
+        case MLME_TXCW:
+            if( size != 3 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            mlmeReq.Req.TxCw.Timeout = HostCtrlGet16( body + 1 );
+            break;
+        case MLME_PING_SLOT_INFO:
+            if( size != 2 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            mlmeReq.Req.PingSlotInfo.Periodicity = body[1];
+            break;
+        case MLME_LINK_CHECK:
+        case MLME_BEACON_ACQUISITION:
+            break;
+        default:
+            return LORAMAC_STATUS_SERVICE_UNKNOWN;
+    }
+    return LoRaMacMlmeRequest( &mlmeReq );
+}
+
+/*!
+ * \brief Indicates if a request makes the MAC layer transmit until its confirm
+ */
+static bool HostCtrlIsTransmitting( const uint8_t *message, uint16_t size )
+{
+    if( message[0] == HOSTCTRL_MCPS_REQ )
+    {
+        return true;
+    }
+    if( ( message[0] == HOSTCTRL_MLME_REQ ) && ( size > HOSTCTRL_HEADER_SIZE ) )
+    {
+        // The link check is sent with the next uplink, the beacon acquisition
+        // and the ping slot info confirms do not block the uplinks
+        return ( message[2] == MLME_JOIN ) || ( message[2] == MLME_TXCW ) || ( message[2] == MLME_TXCW_1 );
+    }
+    return false;
+}
+
+/*!
+ * \brief Executes a request
+ *
+ * \retval [true: request executed, false: the MAC layer is busy]
+ */
+static bool HostCtrlExecute( const uint8_t *message, uint16_t size )
+{
+    const uint8_t *body = message + HOSTCTRL_HEADER_SIZE;
+    uint16_t bodySize = size - HOSTCTRL_HEADER_SIZE;
+    uint8_t value[5];
+    uint8_t valueSize = 0;
+    LoRaMacStatus_t status;
+    bool transmitting = HostCtrlIsTransmitting( message, size );
+
+    if( ( transmitting == true ) && ( MacBusy == true ) )
+    {
+        return false;
+    }
+
+    switch( message[0] )
+    {
+        case HOSTCTRL_MCPS_REQ:
+            McpsSeq = message[1];
+            status = HostCtrlMcpsRequest( body, bodySize );
+            break;
+        case HOSTCTRL_MLME_REQ:
+            if( ( bodySize != 0 ) && ( body[0] < HOSTCTRL_NB_MLME ) )
+            {
+                MlmeSeq[body[0]] = message[1];
+            }
+            status = HostCtrlMlmeRequest( body, bodySize );
+            break;
+        case HOSTCTRL_MIB_GET:
+            status = ( bodySize == 1 ) ? HostCtrlMibGet( ( Mib_t )body[0], value, &valueSize ) : LORAMAC_STATUS_PARAMETER_INVALID;
+            break;
+        case HOSTCTRL_MIB_SET:
+            status = ( bodySize != 0 ) ? HostCtrlMibSet( ( Mib_t )body[0], body + 1, bodySize - 1 ) : LORAMAC_STATUS_PARAMETER_INVALID;
+            break;
+        default:
+            status = LORAMAC_STATUS_SERVICE_UNKNOWN;
+            break;
+    }
+
+    if( ( transmitting == true ) && ( status == LORAMAC_STATUS_OK ) )
+    {
+        MacBusy = true;
+    }
+    HostCtrlSendStatus( message[1], status, value, ( status == LORAMAC_STATUS_OK ) ? valueSize : 0 );
+    return true;
+}
+
+/*!
+ * \brief Processes a received message
+ */
+static void HostCtrlOnMessage( const uint8_t *message, uint16_t size )
+{
+    HostCtrlActive = true;
+
+    switch( message[0] )
+    {
+        case HOSTCTRL_MCPS_REQ:
+        case HOSTCTRL_MLME_REQ:
+        case HOSTCTRL_MIB_GET:
+        case HOSTCTRL_MIB_SET:
+            if( HostCtrlRingPut( &RequestRing, message, size ) == false )
+            {
+                HostCtrlQueueStatus( message[1], LORAMAC_STATUS_BUSY );
+            }
+            break;
+        default:
+            HostCtrlQueueStatus( message[1], LORAMAC_STATUS_SERVICE_UNKNOWN );
+            break;
+    }
+}
+
+void HostCtrlInit( uint16_t ( *write )( const uint8_t *buffer, uint16_t size ) )
+{
+    HostCtrlWrite = write;
+    HostCtrlStop( );
+}
+
+bool HostCtrlOnChar( uint8_t c )
+{
+    uint16_t size;
+
+    if( RxInFrame == false )
+    {
+        if( c != HOSTCTRL_FRAME_DELIMITER )
+        {
+            // Console key
+            return false;
+        }
+        RxInFrame = true;
+        RxFrameSize = 0;
+        RxOverflow = false;
+        return true;
+    }
+
+    if( c != HOSTCTRL_FRAME_DELIMITER )
+    {
+        if( RxFrameSize < sizeof( RxFrame ) )
+        {
+            RxFrame[RxFrameSize++] = c;
+        }
+        else
+        {
+            RxOverflow = true;
+        }
+        return true;
+    }
+
+    if( RxFrameSize == 0 )
+    {
+        // Repeated delimiter, still waiting for the frame
+        return true;
+    }
+    RxInFrame = false;
+
+    size = ( RxOverflow == false ) ? HostCtrlDecode( RxFrame, RxFrameSize ) : 0;
+    if( size != 0 )
+    {
+        HostCtrlOnMessage( RxFrame, size );
+    }
+    // Invalid frames are dropped, the host times the request out
+    return true;
+}
+
+void HostCtrlProcess( void )
+{
+    uint8_t message[HOSTCTRL_MAX_MESSAGE_SIZE];
+    uint16_t size;
+
+    // Refusals and confirms first, the confirms may release the next request
+    while( true )
+    {
+        if( HostCtrlFlush( ) == false )
+        {
+            return;
+        }
+        size = HostCtrlRingGet( &ReplyRing, message );
+        if( size == 0 )
+        {
+            size = HostCtrlRingGet( &EventRing, message );
+        }
+        if( size == 0 )
+        {
+            break;
+        }
+        HostCtrlSend( message, size );
+    }
+
+    // A request sends its status
+    while( HostCtrlFlush( ) == true )
+    {
+        if( RequestSize == 0 )
+        {
+            RequestSize = HostCtrlRingGet( &RequestRing, Request );
+            if( RequestSize == 0 )
+            {
+                break;
+            }
+        }
+        if( HostCtrlExecute( Request, RequestSize ) == false )
+        {
+            break;
+        }
+        RequestSize = 0;
+    }
+}
+
+bool HostCtrlIsActive( void )
+{
+    return HostCtrlActive;
+}
+
+void HostCtrlStop( void )
+{
+    HostCtrlActive = false;
+    RxInFrame = false;
+    RequestSize = 0;
+    RequestRing.Head = RequestRing.Tail;
+    ReplyRing.Tail = ReplyRing.Head;
+    MacBusy = false;
+}
+
+void HostCtrlOnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+    uint8_t message[HOSTCTRL_HEADER_SIZE + 18];
+    uint8_t *p = message;
+
+    if( HostCtrlActive == false )
+    {
+        return;
+    }
+
+    *p++ = HOSTCTRL_MCPS_CONFIRM;
+    *p++ = McpsSeq;
+    *p++ = mcpsConfirm->McpsRequest;
+    *p++ = mcpsConfirm->Status;
+    *p++ = mcpsConfirm->Datarate;
+    *p++ = mcpsConfirm->TxPower;
+    *p++ = mcpsConfirm->AckReceived;
+    *p++ = mcpsConfirm->NbRetries;
+    p = HostCtrlPut32( p, mcpsConfirm->TxTimeOnAir );
+    p = HostCtrlPut32( p, mcpsConfirm->UpLinkCounter );
+    p = HostCtrlPut32( p, mcpsConfirm->UpLinkFrequency );
+    HostCtrlRingPut( &EventRing, message, p - message );
+
+    MacBusy = false;
+}
+
+void HostCtrlOnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+    uint8_t message[HOSTCTRL_MAX_MESSAGE_SIZE];
+    uint8_t *p = message;
+    uint16_t size = 0;
+
+    if( HostCtrlActive == false )
+    {
+        return;
+    }
+
+    *p++ = HOSTCTRL_MCPS_INDICATION;
+    *p++ = IndicationSeq++;
+    *p++ = mcpsIndication->McpsIndication;
+    *p++ = mcpsIndication->Status;
+    *p++ = mcpsIndication->Multicast;
+    *p++ = mcpsIndication->Port;
+    *p++ = mcpsIndication->RxDatarate;
+    *p++ = mcpsIndication->FramePending;
+    *p++ = mcpsIndication->AckReceived;
+    *p++ = mcpsIndication->RxSlot;
+    p = HostCtrlPut16( p, mcpsIndication->Rssi );
+    *p++ = mcpsIndication->Snr;
+    p = HostCtrlPut32( p, mcpsIndication->DownLinkCounter );
+    if( mcpsIndication->RxData == true )
+    {
+        size = MIN( mcpsIndication->BufferSize, sizeof( message ) - ( p - message ) );
+        memcpy1( p, mcpsIndication->Buffer, size );
+    }
+    HostCtrlRingPut( &EventRing, message, ( p - message ) + size );
+}
+
+void HostCtrlOnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+    uint8_t message[HOSTCTRL_HEADER_SIZE + 9];
+    uint8_t *p = message;
+
+    if( HostCtrlActive == false )
+    {
+        return;
+    }
+
+    *p++ = HOSTCTRL_MLME_CONFIRM;
+    *p++ = ( mlmeConfirm->MlmeRequest < HOSTCTRL_NB_MLME ) ? MlmeSeq[mlmeConfirm->MlmeRequest] : 0;
+    *p++ = mlmeConfirm->MlmeRequest;
+    *p++ = mlmeConfirm->Status;
+    p = HostCtrlPut32( p, mlmeConfirm->TxTimeOnAir );
+    *p++ = mlmeConfirm->DemodMargin;
+    *p++ = mlmeConfirm->NbGateways;
+    *p++ = mlmeConfirm->NbRetries;
+    HostCtrlRingPut( &EventRing, message, p - message );
+
+    if( ( mlmeConfirm->MlmeRequest == MLME_JOIN ) || ( mlmeConfirm->MlmeRequest == MLME_TXCW ) ||
+        ( mlmeConfirm->MlmeRequest == MLME_TXCW_1 ) )
+    {
+        MacBusy = false;
+    }
+}
+
+void HostCtrlOnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+    uint8_t message[HOSTCTRL_HEADER_SIZE + 9];
+    uint8_t *p = message;
+
+    if( HostCtrlActive == false )
+    {
+        return;
+    }
+
+    *p++ = HOSTCTRL_MLME_INDICATION;
+    *p++ = IndicationSeq++;
+    *p++ = mlmeIndication->MlmeIndication;
+    *p++ = mlmeIndication->Status;
+    p = HostCtrlPut32( p, mlmeIndication->BeaconTime );
+    p = HostCtrlPut16( p, mlmeIndication->Rssi );
+    *p++ = mlmeIndication->Snr;
+    HostCtrlRingPut( &EventRing, message, p - message );
+}
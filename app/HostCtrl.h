@@ -0,0 +1,154 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Binary host control protocol. Exposes the MCPS, MLME and MIB
+             services as COBS framed messages on the console UART
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __HOST_CTRL_H__
+#define __HOST_CTRL_H__
+
+#include "LoRaMac.h"
+
+/*!
+ * Frame format
+ *
+ * 0x00, COBS( Message, CRC ), 0x00
+ *
+ * The CRC is the CRC-16 CCITT of the message ( little endian ). The console
+ * text never holds 0x00, the chars received outside of a frame are console
+ * keys.
+ *
+ * Message      : Type ( 1 byte ), Sequence number ( 1 byte ), Body
+ *
+ * The requests are executed in order. A MCPS or MLME request waits for the
+ * confirm of the previous one, the host may send the next requests without
+ * waiting for the responses. Each request gets a HOSTCTRL_STATUS message and
+ * the MCPS and MLME requests accepted by the MAC layer get a confirm carrying
+ * the request sequence number. The indications carry a device counter.
+ * Multi-bytes fields are little endian.
+ */
+#define HOSTCTRL_FRAME_DELIMITER                    0x00
+
+/*!
+ * Maximum message size, CRC excluded
+ */
+#define HOSTCTRL_MAX_MESSAGE_SIZE                   260
+
+/*!
+ * Size of the pending requests and of the pending events buffers. Each
+ * message takes its size plus 2 bytes
+ */
+#define HOSTCTRL_REQUEST_BUFFER_SIZE                384
+#define HOSTCTRL_EVENT_BUFFER_SIZE                  384
+
+/*!
+ * Size of the buffer of the requests refused on reception, 5 bytes each
+ */
+#define HOSTCTRL_REPLY_BUFFER_SIZE                  32
+
+/*!
+ * Message types
+ */
+typedef enum eHostCtrlMessage
+{
+    /*!
+     * McpsType, Port, Datarate, NbTrials, Data
+     */
+    HOSTCTRL_MCPS_REQ                               = 0x01,
+    /*!
+     * MlmeType, then
+     * MLME_JOIN             : DevEui ( 8 ), AppEui ( 8 ), AppKey ( 16 ), NbTrials
+     * MLME_TXCW             : Timeout ( 2 )
+     * MLME_PING_SLOT_INFO   : Periodicity
+     */
+    HOSTCTRL_MLME_REQ                               = 0x02,
+    /*!
+     * MibType
+     */
+    HOSTCTRL_MIB_GET                                = 0x03,
+    /*!
+     * MibType, Value. Scalars on 4 bytes, keys on 16 bytes, Rx2 channel as
+     * Frequency ( 4 ), Datarate
+     */
+    HOSTCTRL_MIB_SET                                = 0x04,
+    /*!
+     * Status ( LoRaMacStatus_t ), Value of a HOSTCTRL_MIB_GET
+     */
+    HOSTCTRL_STATUS                                 = 0x80,
+    /*!
+     * McpsType, Status, Datarate, TxPower, AckReceived, NbRetries,
+     * TxTimeOnAir ( 4 ), UpLinkCounter ( 4 ), UpLinkFrequency ( 4 )
+     */
+    HOSTCTRL_MCPS_CONFIRM                           = 0x81,
+    /*!
+     * McpsType, Status, Multicast, Port, RxDatarate, FramePending,
+     * AckReceived, RxSlot, Rssi ( 2 ), Snr, DownLinkCounter ( 4 ), Data
+     */
+    HOSTCTRL_MCPS_INDICATION                        = 0x82,
+    /*!
+     * MlmeType, Status, TxTimeOnAir ( 4 ), DemodMargin, NbGateways, NbRetries
+     */
+    HOSTCTRL_MLME_CONFIRM                           = 0x83,
+    /*!
+     * MlmeType, Status, BeaconTime ( 4 ), Rssi ( 2 ), Snr
+     */
+    HOSTCTRL_MLME_INDICATION                        = 0x84,
+}HostCtrlMessage_t;
+
+/*!
+ * \brief   Initializes the host control
+ *
+ * \param   [IN] write Function queueing bytes on the console UART without
+ *                     waiting. Returns the number of bytes queued. Called
+ *                     from HostCtrlProcess only
+ */
+void HostCtrlInit( uint16_t ( *write )( const uint8_t *buffer, uint16_t size ) );
+
+/*!
+ * \brief   Processes a char received on the console UART
+ *
+ * \param   [IN] c Received char
+ *
+ * \retval  [true: the char belongs to a frame, false: console key]
+ */
+bool HostCtrlOnChar( uint8_t c );
+
+/*!
+ * \brief   Executes the pending requests and sends the pending events. Must
+ *          be called from the application main loop. A frame not fully
+ *          queued on the UART is resumed on the next call
+ */
+void HostCtrlProcess( void );
+
+/*!
+ * \brief   Indicates if a host took control of the node. The application
+ *          must then stop its own requests and its display updates
+ *
+ * \retval  [true: host control active, false: standalone application]
+ */
+bool HostCtrlIsActive( void );
+
+/*!
+ * \brief   Gives the control back to the application. The pending requests
+ *          are dropped
+ */
+void HostCtrlStop( void );
+
+/*!
+ * \brief   Must be called from the application MAC primitives
+ */
+void HostCtrlOnMcpsConfirm( McpsConfirm_t *mcpsConfirm );
+void HostCtrlOnMcpsIndication( McpsIndication_t *mcpsIndication );
+void HostCtrlOnMlmeConfirm( MlmeConfirm_t *mlmeConfirm );
+void HostCtrlOnMlmeIndication( MlmeIndication_t *mlmeIndication );
+
+#endif // __HOST_CTRL_H__
@@ -0,0 +1,175 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: On target microbenchmarks of the LoRaMAC crypto and radio time
+             on air computations. The results are printed to the log as
+             comma separated values
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "board.h"
+#include "LoRaMac.h"
+#include "LoRaMacCrypto.h"
+#include "MicroBench.h"
+
+#if( PROFILE_ON == 1 ) && ( LOG_ON == 1 )
+
+/*!
+ * Largest benchmarked payload, maximum LoRaWAN application payload
+ */
+#define MICROBENCH_MAX_SIZE                         242
+
+/*!
+ * Benchmarked operations
+ */
+typedef enum eMicroBenchOp
+{
+    MICROBENCH_COMPUTE_MIC,
+    MICROBENCH_PAYLOAD_ENCRYPT,
+    MICROBENCH_PAYLOAD_DECRYPT,
+    MICROBENCH_JOIN_COMPUTE_MIC,
+    MICROBENCH_TIME_ON_AIR,
+    MICROBENCH_NB_OPS,
+}MicroBenchOp_t;
+
+/*!
+ * Operations names, printed in the results
+ */
+static const char *MicroBenchNames[MICROBENCH_NB_OPS] =
+{
+    "LoRaMacComputeMic",
+    "LoRaMacPayloadEncrypt",
+    "LoRaMacPayloadDecrypt",
+    "LoRaMacJoinComputeMic",
+    "TimeOnAir",
+};
+
+/*!
+ * Benchmarked payload sizes
+ */
+static const uint8_t MicroBenchSizes[] = { 1, 16, 32, 64, 128, MICROBENCH_MAX_SIZE };
+
+#define MICROBENCH_NB_SIZES                         ( sizeof( MicroBenchSizes ) / sizeof( MicroBenchSizes[0] ) )
+
+/*!
+ * Dummy key and device address
+ */
+static const uint8_t MicroBenchKey[16] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+
+#define MICROBENCH_ADDRESS                          0x26011234
+
+/*!
+ * Input and output buffers
+ */
+static uint8_t MicroBenchInput[MICROBENCH_MAX_SIZE];
+static uint8_t MicroBenchOutput[MICROBENCH_MAX_SIZE];
+
+/*!
+ * Next measurement, operation major. MICROBENCH_NB_OPS * MICROBENCH_NB_SIZES
+ * when idle
+ */
+static uint8_t MicroBenchStep = MICROBENCH_NB_OPS * MICROBENCH_NB_SIZES;
+
+/*!
+ * Frame counter used by the encryption operations. Changed for each call so
+ * that the keystream computed ahead of time is never used
+ */
+static uint32_t MicroBenchCounter = 0;
+
+/*!
+ * Crypto context of the benchmark. The MAC layer context is used by the radio
+ * and timer interrupts, a run never touches it
+ */
+static LoRaMacCryptoCtx_t MicroBenchCryptoCtx;
+
+/*!
+ * \brief Calls an operation once
+ *
+ * \param [IN] op   Operation
+ * \param [IN] size Payload size
+ */
+static void MicroBenchRun( MicroBenchOp_t op, uint8_t size )
+{
+    uint32_t mic;
+
+    switch( op )
+    {
+        case MICROBENCH_COMPUTE_MIC:
+            LoRaMacComputeMicCtx( &MicroBenchCryptoCtx, MicroBenchInput, size, MicroBenchKey, MICROBENCH_ADDRESS, UP_LINK, MicroBenchCounter++, &mic );
+            break;
+        case MICROBENCH_PAYLOAD_ENCRYPT:
+            LoRaMacPayloadEncryptCtx( &MicroBenchCryptoCtx, MicroBenchInput, size, MicroBenchKey, MICROBENCH_ADDRESS, UP_LINK, MicroBenchCounter++, MicroBenchOutput );
+            break;
+        case MICROBENCH_PAYLOAD_DECRYPT:
+            LoRaMacPayloadDecryptCtx( &MicroBenchCryptoCtx, MicroBenchInput, size, MicroBenchKey, MICROBENCH_ADDRESS, DOWN_LINK, MicroBenchCounter++, MicroBenchOutput );
+            break;
+        case MICROBENCH_JOIN_COMPUTE_MIC:
+            LoRaMacJoinComputeMicCtx( &MicroBenchCryptoCtx, MicroBenchInput, size, MicroBenchKey, &mic );
+            break;
+        case MICROBENCH_TIME_ON_AIR:
+            Radio.TimeOnAir( MODEM_LORA, size );
+            break;
+        default:
+            break;
+    }
+}
+
+void MicroBenchStart( void )
+{
+    for( uint8_t i = 0; i < MICROBENCH_MAX_SIZE; i++ )
+    {
+        MicroBenchInput[i] = i;
+    }
+    MicroBenchStep = 0;
+    LOG_INFO( APP, "bench,operation,size,cycles,ns\n" );
+}
+
+bool MicroBenchIsRunning( void )
+{
+    return MicroBenchStep < ( MICROBENCH_NB_OPS * MICROBENCH_NB_SIZES );
+}
+
+bool MicroBenchProcess( void )
+{
+    MicroBenchOp_t op;
+    uint8_t size;
+    uint32_t start;
+    uint32_t cycles;
+    uint32_t ns;
+
+    if( ( MicroBenchIsRunning( ) == false ) || ( LogIsEmpty( ) == false ) )
+    {
+        return false;
+    }
+
+    op = ( MicroBenchOp_t )( MicroBenchStep / MICROBENCH_NB_SIZES );
+    size = MicroBenchSizes[MicroBenchStep % MICROBENCH_NB_SIZES];
+    MicroBenchStep++;
+
+    // Warms up the caches and the flash prefetch buffer
+    MicroBenchRun( op, size );
+
+    start = ProfileGetCycles( );
+    for( uint8_t i = 0; i < MICROBENCH_ITERATIONS; i++ )
+    {
+        MicroBenchRun( op, size );
+    }
+    cycles = ProfileGetElapsed( start ) / MICROBENCH_ITERATIONS;
+    ns = ( uint32_t )( ( ( uint64_t )cycles * 1000000000 ) / SystemCoreClock );
+
+    LOG_INFO( APP, "bench,%s,%u,%u,%u\n", ( uint32_t )( uintptr_t )MicroBenchNames[op], size, cycles, ns );
+
+    return MicroBenchIsRunning( ) == false;
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: On target microbenchmarks of the LoRaMAC crypto and radio time
+             on air computations. The results are printed to the log as
+             comma separated values
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __MICRO_BENCH_H__
+#define __MICRO_BENCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Number of calls measured per operation and payload size
+ */
+#define MICROBENCH_ITERATIONS                       8
+
+/*!
+ * \brief Starts a benchmark run. The crypto operations use a context of
+ *        their own, the run may overlap MAC layer transactions
+ */
+void MicroBenchStart( void );
+
+/*!
+ * \brief Measures the next operation and payload size. Must be called from the
+ *        main loop. Waits for the log to be drained between measurements
+ *
+ *        Output: bench,<operation>,<payload size>,<cycles/op>,<ns/op>
+ *
+ * \retval [true: the run has just completed, false: otherwise]
+ */
+bool MicroBenchProcess( void );
+
+/*!
+ * \brief Indicates if a run is in progress
+ *
+ * \retval [true: running, false: idle]
+ */
+bool MicroBenchIsRunning( void );
+
+#endif // __MICRO_BENCH_H__
@@ -0,0 +1,440 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Wear-levelled non-volatile memory log. Keeps the last version of
+             a data block as a checkpoint followed by delta records
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "board.h"
+#include "NvmLog.h"
+
+/*!
+ * Page header magic number
+ */
+#define NVM_LOG_MAGIC                               0x4C4D564E
+
+/*!
+ * Record types. Erased memory reads as 0x00 or 0xFF depending on the device
+ */
+#define NVM_LOG_RECORD_CHECKPOINT                   0xC3
+#define NVM_LOG_RECORD_DELTA                        0xD4
+
+/*!
+ * Size of the chunks used to read and write the records
+ */
+#define NVM_LOG_CHUNK_SIZE                          16
+
+/*!
+ * Rounds a size up to the programming granularity
+ */
+#define NVM_LOG_ALIGN_UP( size )                    ( ( ( size ) + NVM_LOG_ALIGN - 1 ) & ~( NVM_LOG_ALIGN - 1 ) )
+
+/*!
+ * Log area access functions
+ */
+static NvmLogCallbacks_t *Callbacks = NULL;
+
+/*!
+ * Log geometry
+ */
+static uint32_t PageSize = 0;
+static uint8_t NbPages = 0;
+
+/*!
+ * Data block image and size
+ */
+static uint8_t *Image = NULL;
+static uint16_t ImageSize = 0;
+
+/*!
+ * Indicates if the log holds a valid checkpoint
+ */
+static bool IsValid = false;
+
+/*!
+ * Current page and write position in the page
+ */
+static uint8_t Page = 0;
+static uint32_t WriteOffset = 0;
+
+/*!
+ * Indicates if no more record can be appended to the current page
+ */
+static bool IsPageFull = true;
+
+/*!
+ * Log statistics
+ */
+static NvmLogStats_t Stats;
+
+/*!
+ * CRC-16 CCITT
+ */
+static uint16_t NvmLogCrc( uint16_t crc, const uint8_t *buffer, uint16_t size )
+{
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        crc ^= ( uint16_t )buffer[i] << 8;
+        for( uint8_t j = 0; j < 8; j++ )
+        {
+            crc = ( ( crc & 0x8000 ) != 0 ) ? ( ( crc << 1 ) ^ 0x1021 ) : ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+/*!
+ * Checks if a buffer reads as erased memory
+ */
+static bool NvmLogIsErased( const uint8_t *buffer, uint8_t size )
+{
+    if( ( buffer[0] != 0x00 ) && ( buffer[0] != 0xFF ) )
+    {
+        return false;
+    }
+    for( uint8_t i = 1; i < size; i++ )
+    {
+        if( buffer[i] != buffer[0] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * Checks the CRC of a record
+ */
+static bool NvmLogCheckRecord( uint32_t address, const uint8_t *header, uint16_t length, uint16_t crc )
+{
+    uint8_t chunk[NVM_LOG_CHUNK_SIZE];
+    uint16_t computed = NvmLogCrc( 0, header, NVM_LOG_RECORD_HEADER_SIZE - 2 );
+
+    for( uint16_t pos = 0; pos < length; pos += NVM_LOG_CHUNK_SIZE )
+    {
+        uint16_t n = MIN( NVM_LOG_CHUNK_SIZE, length - pos );
+
+        if( Callbacks->Read( address + NVM_LOG_RECORD_HEADER_SIZE + pos, chunk, n ) == false )
+        {
+            return false;
+        }
+        computed = NvmLogCrc( computed, chunk, n );
+    }
+    return computed == crc;
+}
+
+/*!
+ * Appends a record to the current page
+ */
+static bool NvmLogAppend( uint8_t type, uint16_t offset, const uint8_t *data, uint16_t length )
+{
+    uint32_t address = ( Page * PageSize ) + WriteOffset;
+    uint32_t recordSize = NVM_LOG_RECORD_HEADER_SIZE + NVM_LOG_ALIGN_UP( length );
+    // Word buffers, the flash driver may require aligned sources
+    uint32_t header[NVM_LOG_RECORD_HEADER_SIZE / 4];
+    uint32_t chunk[NVM_LOG_CHUNK_SIZE / 4];
+    uint8_t *headerBytes = ( uint8_t* )header;
+    uint16_t crc = 0;
+
+    if( ( IsPageFull == true ) || ( ( WriteOffset + recordSize ) > PageSize ) )
+    {
+        return false;
+    }
+
+    headerBytes[0] = type;
+    headerBytes[1] = 0;
+    headerBytes[2] = length & 0xFF;
+    headerBytes[3] = ( length >> 8 ) & 0xFF;
+    headerBytes[4] = offset & 0xFF;
+    headerBytes[5] = ( offset >> 8 ) & 0xFF;
+    crc = NvmLogCrc( NvmLogCrc( 0, headerBytes, NVM_LOG_RECORD_HEADER_SIZE - 2 ), data, length );
+    headerBytes[6] = crc & 0xFF;
+    headerBytes[7] = ( crc >> 8 ) & 0xFF;
+
+    // The header is written first. An interrupted record never looks erased
+    // and ends the page at the next recovery
+    IsPageFull = true;
+    if( Callbacks->Write( address, headerBytes, NVM_LOG_RECORD_HEADER_SIZE ) == false )
+    {
+        return false;
+    }
+    address += NVM_LOG_RECORD_HEADER_SIZE;
+    for( uint16_t pos = 0; pos < length; pos += NVM_LOG_CHUNK_SIZE )
+    {
+        uint16_t n = MIN( NVM_LOG_CHUNK_SIZE, length - pos );
+
+        memset1( ( uint8_t* )chunk, 0xFF, NVM_LOG_CHUNK_SIZE );
+        memcpy1( ( uint8_t* )chunk, data + pos, n );
+        if( Callbacks->Write( address + pos, ( uint8_t* )chunk, NVM_LOG_ALIGN_UP( n ) ) == false )
+        {
+            return false;
+        }
+    }
+    WriteOffset += recordSize;
+    IsPageFull = false;
+    return true;
+}
+
+/*!
+ * Erases the next page and writes a checkpoint of the data block
+ */
+static bool NvmLogNewPage( const uint8_t *data )
+{
+    uint8_t page = ( Page + 1 ) % NbPages;
+    uint32_t header[NVM_LOG_PAGE_HEADER_SIZE / 4];
+    uint8_t *headerBytes = ( uint8_t* )header;
+    uint32_t sequence = Stats.Sequence + 1;
+
+    IsPageFull = true;
+    if( Callbacks->Erase( page * PageSize, PageSize ) == false )
+    {
+        return false;
+    }
+
+    headerBytes[0] = NVM_LOG_MAGIC & 0xFF;
+    headerBytes[1] = ( NVM_LOG_MAGIC >> 8 ) & 0xFF;
+    headerBytes[2] = ( NVM_LOG_MAGIC >> 16 ) & 0xFF;
+    headerBytes[3] = ( NVM_LOG_MAGIC >> 24 ) & 0xFF;
+    headerBytes[4] = sequence & 0xFF;
+    headerBytes[5] = ( sequence >> 8 ) & 0xFF;
+    headerBytes[6] = ( sequence >> 16 ) & 0xFF;
+    headerBytes[7] = ( sequence >> 24 ) & 0xFF;
+    // The magic number is written last. It validates the sequence number
+    if( ( Callbacks->Write( ( page * PageSize ) + 4, headerBytes + 4, 4 ) == false ) ||
+        ( Callbacks->Write( page * PageSize, headerBytes, 4 ) == false ) )
+    {
+        return false;
+    }
+
+    Page = page;
+    Stats.Sequence = sequence;
+    WriteOffset = NVM_LOG_PAGE_HEADER_SIZE;
+    IsPageFull = false;
+
+    if( NvmLogAppend( NVM_LOG_RECORD_CHECKPOINT, 0, data, ImageSize ) == false )
+    {
+        return false;
+    }
+    Stats.NbCheckpoints++;
+    return true;
+}
+
+/*!
+ * Replays a page into the image. The image is only modified once the
+ * checkpoint of the page is known to be valid
+ */
+static bool NvmLogReplay( uint8_t page )
+{
+    uint32_t offset = NVM_LOG_PAGE_HEADER_SIZE;
+    uint32_t address = 0;
+    uint8_t header[NVM_LOG_RECORD_HEADER_SIZE];
+    uint16_t length = 0;
+    uint16_t recordOffset = 0;
+    uint16_t crc = 0;
+    bool isFirst = true;
+    bool isValid = false;
+
+    Stats.NbReplayed = 0;
+    IsPageFull = true;
+
+    while( ( offset + NVM_LOG_RECORD_HEADER_SIZE ) <= PageSize )
+    {
+        address = ( page * PageSize ) + offset;
+        if( Callbacks->Read( address, header, NVM_LOG_RECORD_HEADER_SIZE ) == false )
+        {
+            break;
+        }
+        if( NvmLogIsErased( header, NVM_LOG_RECORD_HEADER_SIZE ) == true )
+        {
+            IsPageFull = false;
+            break;
+        }
+
+        length = ( uint16_t )header[2] | ( ( uint16_t )header[3] << 8 );
+        recordOffset = ( uint16_t )header[4] | ( ( uint16_t )header[5] << 8 );
+        crc = ( uint16_t )header[6] | ( ( uint16_t )header[7] << 8 );
+
+        if( isFirst == true )
+        {
+            isValid = ( header[0] == NVM_LOG_RECORD_CHECKPOINT ) && ( recordOffset == 0 ) && ( length == ImageSize );
+        }
+        else
+        {
+            isValid = ( header[0] == NVM_LOG_RECORD_DELTA ) && ( length > 0 ) && ( ( ( uint32_t )recordOffset + length ) <= ImageSize );
+        }
+        isValid = isValid && ( ( offset + NVM_LOG_RECORD_HEADER_SIZE + NVM_LOG_ALIGN_UP( length ) ) <= PageSize );
+        if( ( isValid == false ) ||
+            ( NvmLogCheckRecord( address, header, length, crc ) == false ) ||
+            ( Callbacks->Read( address + NVM_LOG_RECORD_HEADER_SIZE, Image + recordOffset, length ) == false ) )
+        {
+            break;
+        }
+
+        if( isFirst == false )
+        {
+            Stats.NbReplayed++;
+        }
+        isFirst = false;
+        offset += NVM_LOG_RECORD_HEADER_SIZE + NVM_LOG_ALIGN_UP( length );
+    }
+
+    if( isFirst == true )
+    { // No valid checkpoint
+        return false;
+    }
+    WriteOffset = offset;
+    return true;
+}
+
+bool NvmLogInit( NvmLogCallbacks_t *callbacks, uint32_t pageSize, uint8_t nbPages, uint8_t *image, uint16_t size )
+{
+    uint8_t header[NVM_LOG_PAGE_HEADER_SIZE];
+    uint32_t sequences[NVM_LOG_MAX_NB_PAGES];
+    bool isUsed[NVM_LOG_MAX_NB_PAGES];
+    uint32_t maxSequence = 0;
+    uint8_t candidate = 0;
+    bool found = false;
+
+    Callbacks = callbacks;
+    PageSize = pageSize;
+    NbPages = nbPages;
+    Image = image;
+    ImageSize = size;
+    IsValid = false;
+    IsPageFull = true;
+    Page = nbPages - 1;
+    WriteOffset = 0;
+    memset1( ( uint8_t* )&Stats, 0, sizeof( Stats ) );
+
+    if( ( callbacks == NULL ) || ( image == NULL ) || ( nbPages < 2 ) || ( nbPages > NVM_LOG_MAX_NB_PAGES ) ||
+        ( ( uint32_t )( NVM_LOG_PAGE_HEADER_SIZE + NVM_LOG_RECORD_HEADER_SIZE + NVM_LOG_ALIGN_UP( size ) ) > pageSize ) )
+    {
+        NbPages = 0;
+        return false;
+    }
+
+    for( uint8_t i = 0; i < nbPages; i++ )
+    {
+        isUsed[i] = false;
+        if( Callbacks->Read( i * PageSize, header, NVM_LOG_PAGE_HEADER_SIZE ) == true )
+        {
+            isUsed[i] = ( ( ( uint32_t )header[0] | ( ( uint32_t )header[1] << 8 ) |
+                            ( ( uint32_t )header[2] << 16 ) | ( ( uint32_t )header[3] << 24 ) ) == NVM_LOG_MAGIC );
+            sequences[i] = ( uint32_t )header[4] | ( ( uint32_t )header[5] << 8 ) |
+                           ( ( uint32_t )header[6] << 16 ) | ( ( uint32_t )header[7] << 24 );
+        }
+        if( ( isUsed[i] == true ) && ( sequences[i] > maxSequence ) )
+        {
+            maxSequence = sequences[i];
+        }
+    }
+    // New pages always get the highest sequence number
+    Stats.Sequence = maxSequence;
+
+    // Replay the most recent page. Fall back to the previous one when its
+    // checkpoint has been interrupted
+    for( uint8_t n = 0; n < nbPages; n++ )
+    {
+        found = false;
+        for( uint8_t i = 0; i < nbPages; i++ )
+        {
+            if( ( isUsed[i] == true ) && ( ( found == false ) || ( sequences[i] > sequences[candidate] ) ) )
+            {
+                candidate = i;
+                found = true;
+            }
+        }
+        if( found == false )
+        {
+            break;
+        }
+        isUsed[candidate] = false;
+        if( NvmLogReplay( candidate ) == true )
+        {
+            Page = candidate;
+            IsValid = true;
+            Stats.PageFree = PageSize - WriteOffset;
+            return true;
+        }
+    }
+    IsPageFull = true;
+    return false;
+}
+
+bool NvmLogUpdate( const uint8_t *data )
+{
+    uint16_t first = 0;
+    uint16_t last = 0;
+    bool isDelta = false;
+
+    if( ( NbPages == 0 ) || ( data == NULL ) )
+    {
+        return false;
+    }
+
+    if( IsValid == true )
+    {
+        while( ( first < ImageSize ) && ( data[first] == Image[first] ) )
+        {
+            first++;
+        }
+        if( first == ImageSize )
+        { // Nothing changed
+            return true;
+        }
+        last = ImageSize - 1;
+        while( data[last] == Image[last] )
+        {
+            last--;
+        }
+        isDelta = NvmLogAppend( NVM_LOG_RECORD_DELTA, first, data + first, last - first + 1 );
+    }
+
+    if( isDelta == true )
+    {
+        Stats.NbDeltas++;
+    }
+    else
+    {
+        if( NvmLogNewPage( data ) == false )
+        {
+            return false;
+        }
+        IsValid = true;
+    }
+    memcpy1( Image, data, ImageSize );
+    Stats.PageFree = PageSize - WriteOffset;
+    return true;
+}
+
+bool NvmLogErase( void )
+{
+    if( NbPages == 0 )
+    {
+        return false;
+    }
+    IsValid = false;
+    IsPageFull = true;
+    Stats.PageFree = 0;
+    for( uint8_t i = 0; i < NbPages; i++ )
+    {
+        if( Callbacks->Erase( i * PageSize, PageSize ) == false )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const NvmLogStats_t* NvmLogGetStats( void )
+{
+    return &Stats;
+}
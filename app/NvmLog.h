@@ -0,0 +1,140 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Wear-levelled non-volatile memory log. Keeps the last version of
+             a data block as a checkpoint followed by delta records
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __NVM_LOG_H__
+#define __NVM_LOG_H__
+
+#include <stdint.h>
+
+/*!
+ * Log page layout
+ *
+ * Page header  : Magic ( 4 bytes ), Sequence number ( 4 bytes )
+ * Records      : Type ( 1 byte ), RFU ( 1 byte ), Length ( 2 bytes ),
+ *                Offset ( 2 bytes ), Crc ( 2 bytes ), Data ( Length bytes )
+ *                padded to NVM_LOG_ALIGN
+ *
+ * The first record of a page is a checkpoint holding the whole data block.
+ * The following records are deltas replacing Length bytes at Offset. When a
+ * page is full, the next page is erased and starts with a new checkpoint. The
+ * page with the highest sequence number and a valid checkpoint holds the
+ * current data block.
+ */
+#define NVM_LOG_PAGE_HEADER_SIZE                    8
+#define NVM_LOG_RECORD_HEADER_SIZE                  8
+
+/*!
+ * Flash programming granularity. Records are padded to this size
+ */
+#define NVM_LOG_ALIGN                               4
+
+/*!
+ * Maximum number of log pages
+ */
+#define NVM_LOG_MAX_NB_PAGES                        8
+
+/*!
+ * Non-volatile memory access functions. offset is relative to the beginning
+ * of the log area
+ */
+typedef struct sNvmLogCallbacks
+{
+    /*!
+     * \brief   Erases a part of the log area
+     *
+     * \retval  [true: success, false: failure]
+     */
+    bool ( *Erase )( uint32_t offset, uint32_t size );
+    /*!
+     * \brief   Writes an erased part of the log area
+     *
+     * \retval  [true: success, false: failure]
+     */
+    bool ( *Write )( uint32_t offset, const uint8_t *buffer, uint32_t size );
+    /*!
+     * \brief   Reads the log area
+     *
+     * \retval  [true: success, false: failure]
+     */
+    bool ( *Read )( uint32_t offset, uint8_t *buffer, uint32_t size );
+}NvmLogCallbacks_t;
+
+/*!
+ * Log statistics
+ */
+typedef struct sNvmLogStats
+{
+    /*!
+     * Number of checkpoints written
+     */
+    uint32_t NbCheckpoints;
+    /*!
+     * Number of delta records written
+     */
+    uint32_t NbDeltas;
+    /*!
+     * Number of delta records applied by the recovery
+     */
+    uint16_t NbReplayed;
+    /*!
+     * Sequence number of the current page
+     */
+    uint32_t Sequence;
+    /*!
+     * Free bytes in the current page
+     */
+    uint32_t PageFree;
+}NvmLogStats_t;
+
+/*!
+ * \brief   Initializes the log and recovers the last data block
+ *
+ * \remark  The recovery reads the page headers and replays a single page
+ *
+ * \param   [IN] callbacks Log area access functions
+ * \param   [IN] pageSize  Log page size. Must be a multiple of the erase size
+ * \param   [IN] nbPages   Number of log pages [2:NVM_LOG_MAX_NB_PAGES]
+ * \param   [IN] image     Data block image. Receives the recovered data block
+ * \param   [IN] size      Data block size. A checkpoint must fit in a page
+ *
+ * \retval  [true: data block recovered, false: no valid data block]
+ */
+bool NvmLogInit( NvmLogCallbacks_t *callbacks, uint32_t pageSize, uint8_t nbPages, uint8_t *image, uint16_t size );
+
+/*!
+ * \brief   Stores a new version of the data block. Only the range of bytes
+ *          which differ from the image is written
+ *
+ * \param   [IN] data      New data block. The image is updated on success
+ *
+ * \retval  [true: success, false: failure]
+ */
+bool NvmLogUpdate( const uint8_t *data );
+
+/*!
+ * \brief   Erases the whole log. The data block is lost
+ *
+ * \retval  [true: success, false: failure]
+ */
+bool NvmLogErase( void );
+
+/*!
+ * \brief   Gets the log statistics
+ *
+ * \retval  stats Pointer to the log statistics
+ */
+const NvmLogStats_t* NvmLogGetStats( void );
+
+#endif // __NVM_LOG_H__
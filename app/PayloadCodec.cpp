@@ -0,0 +1,364 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Compact application payload encoding. Delta, zig-zag varint and
+             bit-packing of typed sensor fields
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stddef.h>
+#include "PayloadCodec.h"
+
+/*!
+ * Writes the nbBits LSB of value into the buffer, LSB first
+ */
+static bool WriteBits( uint8_t *buffer, uint8_t maxSize, uint16_t *bitIndex, uint32_t value, uint8_t nbBits )
+{
+    if( ( *bitIndex + nbBits ) > ( maxSize * 8 ) )
+    {
+        return false;
+    }
+    for( uint8_t i = 0; i < nbBits; i++ )
+    {
+        if( ( ( value >> i ) & 0x01 ) != 0 )
+        {
+            buffer[*bitIndex >> 3] |= 1 << ( *bitIndex & 0x07 );
+        }
+        else
+        {
+            buffer[*bitIndex >> 3] &= ~( 1 << ( *bitIndex & 0x07 ) );
+        }
+        ( *bitIndex )++;
+    }
+    return true;
+}
+
+/*!
+ * Reads nbBits from the buffer, LSB first
+ */
+static bool ReadBits( const uint8_t *buffer, uint8_t size, uint16_t *bitIndex, uint32_t *value, uint8_t nbBits )
+{
+    if( ( *bitIndex + nbBits ) > ( size * 8 ) )
+    {
+        return false;
+    }
+    *value = 0;
+    for( uint8_t i = 0; i < nbBits; i++ )
+    {
+        if( ( ( buffer[*bitIndex >> 3] >> ( *bitIndex & 0x07 ) ) & 0x01 ) != 0 )
+        {
+            *value |= ( uint32_t )1 << i;
+        }
+        ( *bitIndex )++;
+    }
+    return true;
+}
+
+/*!
+ * Writes a zig-zag varint. 7 bits groups, bit 7 set when more groups follow
+ */
+static bool WriteVarint( uint8_t *buffer, uint8_t maxSize, uint16_t *bitIndex, int32_t value )
+{
+    uint32_t zigzag = ( ( uint32_t )value << 1 ) ^ ( uint32_t )( value >> 31 );
+
+    do
+    {
+        uint8_t group = zigzag & 0x7F;
+
+        zigzag >>= 7;
+        if( zigzag != 0 )
+        {
+            group |= 0x80;
+        }
+        if( WriteBits( buffer, maxSize, bitIndex, group, 8 ) == false )
+        {
+            return false;
+        }
+    }while( zigzag != 0 );
+    return true;
+}
+
+/*!
+ * Reads a zig-zag varint
+ */
+static bool ReadVarint( const uint8_t *buffer, uint8_t size, uint16_t *bitIndex, int32_t *value )
+{
+    uint32_t zigzag = 0;
+    uint32_t group = 0;
+
+    for( uint8_t shift = 0; shift < 35; shift += 7 )
+    {
+        if( ReadBits( buffer, size, bitIndex, &group, 8 ) == false )
+        {
+            return false;
+        }
+        zigzag |= ( group & 0x7F ) << shift;
+        if( ( group & 0x80 ) == 0 )
+        {
+            *value = ( int32_t )( ( zigzag >> 1 ) ^ ( 0 - ( zigzag & 0x01 ) ) );
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * Minimum number of bits taken by a record
+ */
+static uint16_t GetMinRecordBits( const PayloadCodecField_t *fields, uint8_t nbFields )
+{
+    uint16_t nbBits = 0;
+
+    for( uint8_t i = 0; i < nbFields; i++ )
+    {
+        nbBits += ( fields[i].Encoding == PAYLOAD_CODEC_BITS ) ? fields[i].NbBits : 8;
+    }
+    return nbBits;
+}
+
+void PayloadCodecInit( PayloadCodec_t *codec, const PayloadCodecField_t *fields, uint8_t nbFields )
+{
+    codec->Fields = fields;
+    codec->NbFields = ( nbFields > PAYLOAD_CODEC_MAX_FIELDS ) ? PAYLOAD_CODEC_MAX_FIELDS : nbFields;
+    codec->Buffer = NULL;
+    codec->MaxSize = 0;
+    codec->BitIndex = 0;
+    codec->NbRecords = 0;
+    PayloadCodecReset( codec );
+}
+
+void PayloadCodecReset( PayloadCodec_t *codec )
+{
+    codec->HasReference = false;
+    codec->ReferenceCounter = 0;
+    codec->HasPending = false;
+}
+
+void PayloadCodecBeginFrame( PayloadCodec_t *codec, uint32_t upLinkCounter, uint8_t *buffer, uint8_t maxSize )
+{
+    uint32_t distance = upLinkCounter - codec->ReferenceCounter;
+
+    if( ( distance == 0 ) || ( distance > PAYLOAD_CODEC_MAX_DISTANCE ) )
+    { // The reference is too old to be still known by the decoder
+        codec->HasReference = false;
+    }
+
+    codec->Buffer = buffer;
+    codec->MaxSize = maxSize;
+    codec->BitIndex = 0;
+    codec->NbRecords = 0;
+    codec->HasPending = false;
+
+    if( codec->HasReference == true )
+    {
+        WriteBits( buffer, maxSize, &codec->BitIndex, PAYLOAD_CODEC_HDR_DELTA | distance, 8 );
+    }
+    else
+    {
+        WriteBits( buffer, maxSize, &codec->BitIndex, 0, 8 );
+    }
+}
+
+bool PayloadCodecAppend( PayloadCodec_t *codec, const int32_t *values )
+{
+    uint16_t bitIndex = codec->BitIndex;
+    const int32_t *previous = NULL;
+    bool fits = true;
+
+    if( codec->NbRecords > 0 )
+    {
+        previous = codec->Pending;
+    }
+    else if( codec->HasReference == true )
+    {
+        previous = codec->Reference;
+    }
+
+    for( uint8_t i = 0; ( i < codec->NbFields ) && ( fits == true ); i++ )
+    {
+        switch( codec->Fields[i].Encoding )
+        {
+            case PAYLOAD_CODEC_BITS:
+                fits = WriteBits( codec->Buffer, codec->MaxSize, &bitIndex, ( uint32_t )values[i], codec->Fields[i].NbBits );
+                break;
+            case PAYLOAD_CODEC_DELTA:
+                if( previous != NULL )
+                {
+                    fits = WriteVarint( codec->Buffer, codec->MaxSize, &bitIndex, ( int32_t )( ( uint32_t )values[i] - ( uint32_t )previous[i] ) );
+                    break;
+                }
+                // Absolute value when no reference is available
+            case PAYLOAD_CODEC_VARINT:
+            default:
+                fits = WriteVarint( codec->Buffer, codec->MaxSize, &bitIndex, values[i] );
+                break;
+        }
+    }
+    if( fits == false )
+    {
+        return false;
+    }
+
+    codec->BitIndex = bitIndex;
+    codec->NbRecords++;
+    for( uint8_t i = 0; i < codec->NbFields; i++ )
+    {
+        codec->Pending[i] = values[i];
+    }
+    return true;
+}
+
+uint8_t PayloadCodecEndFrame( PayloadCodec_t *codec )
+{
+    codec->HasPending = ( codec->NbRecords > 0 );
+    return ( codec->BitIndex + 7 ) >> 3;
+}
+
+void PayloadCodecConfirm( PayloadCodec_t *codec, uint32_t upLinkCounter )
+{
+    if( codec->HasPending == false )
+    {
+        return;
+    }
+    for( uint8_t i = 0; i < codec->NbFields; i++ )
+    {
+        codec->Reference[i] = codec->Pending[i];
+    }
+    codec->ReferenceCounter = upLinkCounter;
+    codec->HasReference = true;
+    codec->HasPending = false;
+}
+
+void PayloadCodecCancel( PayloadCodec_t *codec )
+{
+    codec->HasPending = false;
+}
+
+void PayloadCodecDecoderInit( PayloadCodecDecoder_t *decoder, const PayloadCodecField_t *fields, uint8_t nbFields )
+{
+    decoder->Fields = fields;
+    decoder->NbFields = ( nbFields > PAYLOAD_CODEC_MAX_FIELDS ) ? PAYLOAD_CODEC_MAX_FIELDS : nbFields;
+    decoder->HasReference = false;
+    decoder->ReferenceCounter = 0;
+    decoder->NbHistory = 0;
+    decoder->NextHistory = 0;
+}
+
+uint8_t PayloadCodecDecode( PayloadCodecDecoder_t *decoder, uint32_t upLinkCounter, const uint8_t *buffer, uint8_t size, int32_t *values, uint8_t maxRecords )
+{
+    uint16_t bitIndex = 0;
+    uint16_t minRecordBits = GetMinRecordBits( decoder->Fields, decoder->NbFields );
+    uint32_t header = 0;
+    uint32_t raw = 0;
+    int32_t delta = 0;
+    const int32_t *previous = NULL;
+    int32_t *record = values;
+    uint8_t nbRecords = 0;
+    uint32_t referenceCounter = 0;
+    uint8_t slot = 0;
+    bool knownCounter = false;
+
+    // The padding of the last byte must not be taken for a record
+    if( ( minRecordBits < 8 ) || ( ReadBits( buffer, size, &bitIndex, &header, 8 ) == false ) )
+    {
+        return 0;
+    }
+
+    if( ( header & PAYLOAD_CODEC_HDR_DELTA ) != 0 )
+    {
+        referenceCounter = upLinkCounter - ( header & PAYLOAD_CODEC_HDR_DISTANCE_MASK );
+        if( ( decoder->HasReference == true ) && ( decoder->ReferenceCounter == referenceCounter ) )
+        {
+            previous = decoder->Reference;
+        }
+        for( uint8_t i = 0; ( i < decoder->NbHistory ) && ( previous == NULL ); i++ )
+        {
+            if( decoder->Counters[i] == referenceCounter )
+            {
+                // The network acknowledged this frame, keep it as long as
+                // the encoder refers to it
+                for( uint8_t j = 0; j < decoder->NbFields; j++ )
+                {
+                    decoder->Reference[j] = decoder->History[i][j];
+                }
+                decoder->ReferenceCounter = referenceCounter;
+                decoder->HasReference = true;
+                previous = decoder->Reference;
+            }
+        }
+        if( previous == NULL )
+        { // Unknown reference
+            return 0;
+        }
+    }
+
+    while( ( ( bitIndex + minRecordBits ) <= ( size * 8 ) ) && ( nbRecords < maxRecords ) )
+    {
+        for( uint8_t i = 0; i < decoder->NbFields; i++ )
+        {
+            switch( decoder->Fields[i].Encoding )
+            {
+                case PAYLOAD_CODEC_BITS:
+                    if( ReadBits( buffer, size, &bitIndex, &raw, decoder->Fields[i].NbBits ) == false )
+                    {
+                        return 0;
+                    }
+                    record[i] = ( int32_t )raw;
+                    break;
+                case PAYLOAD_CODEC_DELTA:
+                    if( ReadVarint( buffer, size, &bitIndex, &delta ) == false )
+                    {
+                        return 0;
+                    }
+                    record[i] = ( previous != NULL ) ? ( int32_t )( ( uint32_t )previous[i] + ( uint32_t )delta ) : delta;
+                    break;
+                case PAYLOAD_CODEC_VARINT:
+                default:
+                    if( ReadVarint( buffer, size, &bitIndex, &record[i] ) == false )
+                    {
+                        return 0;
+                    }
+                    break;
+            }
+        }
+        previous = record;
+        record += decoder->NbFields;
+        nbRecords++;
+    }
+
+    if( nbRecords > 0 )
+    {
+        // Keep the last record as reference for the next frames. A frame
+        // received again replaces its previous entry
+        slot = decoder->NextHistory;
+        for( uint8_t i = 0; i < decoder->NbHistory; i++ )
+        {
+            if( decoder->Counters[i] == upLinkCounter )
+            {
+                slot = i;
+                knownCounter = true;
+            }
+        }
+        if( knownCounter == false )
+        {
+            decoder->NextHistory = ( slot + 1 ) % PAYLOAD_CODEC_HISTORY;
+            if( decoder->NbHistory < PAYLOAD_CODEC_HISTORY )
+            {
+                decoder->NbHistory++;
+            }
+        }
+        decoder->Counters[slot] = upLinkCounter;
+        for( uint8_t i = 0; i < decoder->NbFields; i++ )
+        {
+            decoder->History[slot][i] = previous[i];
+        }
+    }
+    return nbRecords;
+}
@@ -0,0 +1,234 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Compact application payload encoding. Delta, zig-zag varint and
+             bit-packing of typed sensor fields
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __PAYLOAD_CODEC_H__
+#define __PAYLOAD_CODEC_H__
+
+#include <stdint.h>
+
+/*!
+ * Maximum number of fields of a record
+ */
+#define PAYLOAD_CODEC_MAX_FIELDS                    8
+
+/*!
+ * Number of recently decoded frames kept by the decoder, in addition to the
+ * reference frame
+ */
+#define PAYLOAD_CODEC_HISTORY                       4
+
+/*!
+ * Frame header. Bit 7 is set when the first record is delta encoded, bits
+ * 6..0 hold the distance between the uplink counter of the frame and the
+ * uplink counter of the reference frame
+ */
+#define PAYLOAD_CODEC_HDR_DELTA                     0x80
+#define PAYLOAD_CODEC_HDR_DISTANCE_MASK             0x7F
+
+/*!
+ * Maximum distance between a frame and its reference frame. Beyond, the frame
+ * is absolute encoded
+ */
+#define PAYLOAD_CODEC_MAX_DISTANCE                  PAYLOAD_CODEC_HDR_DISTANCE_MASK
+
+/*!
+ * Field encodings
+ */
+typedef enum ePayloadCodecEncoding
+{
+    /*!
+     * Unsigned value packed on NbBits
+     */
+    PAYLOAD_CODEC_BITS,
+    /*!
+     * Zig-zag varint of the value
+     */
+    PAYLOAD_CODEC_VARINT,
+    /*!
+     * Zig-zag varint of the difference to the previous record. The first
+     * record of a frame refers to the last record acknowledged by the
+     * network. Without acknowledged record the value is absolute encoded
+     */
+    PAYLOAD_CODEC_DELTA,
+}PayloadCodecEncoding_t;
+
+/*!
+ * Field description
+ */
+typedef struct sPayloadCodecField
+{
+    /*!
+     * Field encoding
+     */
+    PayloadCodecEncoding_t Encoding;
+    /*!
+     * Field size in bits [1:32]. PAYLOAD_CODEC_BITS only
+     */
+    uint8_t NbBits;
+}PayloadCodecField_t;
+
+/*!
+ * Encoder context
+ */
+typedef struct sPayloadCodec
+{
+    /*!
+     * Record description
+     */
+    const PayloadCodecField_t *Fields;
+    uint8_t NbFields;
+    /*!
+     * Last record acknowledged by the network and the uplink counter of its
+     * frame
+     */
+    bool HasReference;
+    uint32_t ReferenceCounter;
+    int32_t Reference[PAYLOAD_CODEC_MAX_FIELDS];
+    /*!
+     * Last record of the frame in flight
+     */
+    bool HasPending;
+    int32_t Pending[PAYLOAD_CODEC_MAX_FIELDS];
+    /*!
+     * Frame being built
+     */
+    uint8_t *Buffer;
+    uint8_t MaxSize;
+    uint16_t BitIndex;
+    uint8_t NbRecords;
+}PayloadCodec_t;
+
+/*!
+ * Decoder context
+ */
+typedef struct sPayloadCodecDecoder
+{
+    /*!
+     * Record description
+     */
+    const PayloadCodecField_t *Fields;
+    uint8_t NbFields;
+    /*!
+     * Last record of the most recently referenced frame and its uplink
+     * counter. The encoder reference only moves forward, older frames are
+     * no longer needed
+     */
+    bool HasReference;
+    uint32_t ReferenceCounter;
+    int32_t Reference[PAYLOAD_CODEC_MAX_FIELDS];
+    /*!
+     * Last record of the most recently decoded frames and their uplink
+     * counters. One of them becomes the reference once acknowledged
+     */
+    uint8_t NbHistory;
+    uint8_t NextHistory;
+    uint32_t Counters[PAYLOAD_CODEC_HISTORY];
+    int32_t History[PAYLOAD_CODEC_HISTORY][PAYLOAD_CODEC_MAX_FIELDS];
+}PayloadCodecDecoder_t;
+
+/*!
+ * \brief   Initializes the encoder
+ *
+ * \remark  A record must take at least 8 bits so that the padding of the
+ *          last byte is not decoded as a record
+ *
+ * \param   [IN] codec    Encoder context
+ * \param   [IN] fields   Record description
+ * \param   [IN] nbFields Number of fields of a record
+ */
+void PayloadCodecInit( PayloadCodec_t *codec, const PayloadCodecField_t *fields, uint8_t nbFields );
+
+/*!
+ * \brief   Drops the reference record. The next frame is absolute encoded
+ *
+ * \param   [IN] codec    Encoder context
+ */
+void PayloadCodecReset( PayloadCodec_t *codec );
+
+/*!
+ * \brief   Starts a new frame. The frame is delta encoded when the reference
+ *          record is at most PAYLOAD_CODEC_MAX_DISTANCE frames old
+ *
+ * \param   [IN] codec         Encoder context
+ * \param   [IN] upLinkCounter Uplink counter the frame will be sent with
+ * \param   [IN] buffer        Frame buffer
+ * \param   [IN] maxSize       Frame buffer size
+ */
+void PayloadCodecBeginFrame( PayloadCodec_t *codec, uint32_t upLinkCounter, uint8_t *buffer, uint8_t maxSize );
+
+/*!
+ * \brief   Appends a record to the frame
+ *
+ * \param   [IN] codec    Encoder context
+ * \param   [IN] values   Record field values
+ *
+ * \retval  [true: record added, false: the record does not fit]
+ */
+bool PayloadCodecAppend( PayloadCodec_t *codec, const int32_t *values );
+
+/*!
+ * \brief   Terminates the frame
+ *
+ * \param   [IN] codec    Encoder context
+ *
+ * \retval  Frame size in bytes
+ */
+uint8_t PayloadCodecEndFrame( PayloadCodec_t *codec );
+
+/*!
+ * \brief   Must be called when the network acknowledged the last frame. The
+ *          last record of the frame becomes the reference record
+ *
+ * \remark  Unconfirmed frames never become reference. When the application
+ *          only sends unconfirmed frames, all frames are absolute encoded
+ *
+ * \param   [IN] codec         Encoder context
+ * \param   [IN] upLinkCounter Uplink counter of the acknowledged frame
+ */
+void PayloadCodecConfirm( PayloadCodec_t *codec, uint32_t upLinkCounter );
+
+/*!
+ * \brief   Must be called when the last frame has not been sent
+ *
+ * \param   [IN] codec    Encoder context
+ */
+void PayloadCodecCancel( PayloadCodec_t *codec );
+
+/*!
+ * \brief   Initializes the decoder. Must be called again when the device
+ *          joins, the uplink counter restarts
+ *
+ * \param   [IN] decoder  Decoder context
+ * \param   [IN] fields   Record description
+ * \param   [IN] nbFields Number of fields of a record
+ */
+void PayloadCodecDecoderInit( PayloadCodecDecoder_t *decoder, const PayloadCodecField_t *fields, uint8_t nbFields );
+
+/*!
+ * \brief   Decodes a frame. A frame received twice is decoded again
+ *
+ * \param   [IN]  decoder       Decoder context
+ * \param   [IN]  upLinkCounter Uplink counter of the frame
+ * \param   [IN]  buffer        Frame buffer
+ * \param   [IN]  size          Frame size
+ * \param   [OUT] values        Decoded records, NbFields values per record
+ * \param   [IN]  maxRecords    Maximum number of records values can hold
+ *
+ * \retval  Number of decoded records. 0 when the reference record is unknown
+ *          or the frame is malformed
+ */
+uint8_t PayloadCodecDecode( PayloadCodecDecoder_t *decoder, uint32_t upLinkCounter, const uint8_t *buffer, uint8_t size, int32_t *values, uint8_t maxRecords );
+
+#endif // __PAYLOAD_CODEC_H__
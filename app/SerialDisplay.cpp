@@ -18,419 +18,769 @@ Maintainer: Miguel Luis and Gregory Cristian
 
 VT100 vt( USBTX, USBRX );
 
-void SerialPrintCheckBox( bool activated, uint8_t color )
+/*!
+ * Displayed values comparison enable/disable
+ *
+ * \remark When enabled, an update only redraws the fields whose value
+ *         changed. When disabled, every update redraws its fields. In both
+ *         cases the display functions only store the values and
+ *         SerialDisplayProcess sends the fields as the UART drains
+ */
+#ifndef SERIAL_DISPLAY_DIFF_ON
+#define SERIAL_DISPLAY_DIFF_ON                      1
+#endif
+
+/*!
+ * Layout columns width, without the borders
+ */
+#define DISPLAY_FIRST_COL_WIDTH                     12
+#define DISPLAY_SECOND_COL_WIDTH                    65
+#define DISPLAY_SINGLE_COL_WIDTH                    78
+
+/*!
+ * Application data fields: 16 bytes per line
+ */
+#define DISPLAY_DATA_NB_LINES                       4
+#define DISPLAY_DATA_LINE_SIZE                      16
+#define DISPLAY_DATA_MAX_SIZE                       ( DISPLAY_DATA_NB_LINES * DISPLAY_DATA_LINE_SIZE )
+
+/*!
+ * First screen line of the uplink and downlink data fields
+ */
+#define DISPLAY_UP_DATA_LINE                        28
+#define DISPLAY_DOWN_DATA_LINE                      37
+
+/*!
+ * Maximum output size of a layout line and of a field. Cursor move,
+ * attributes, charset switches and chars
+ */
+#define DISPLAY_LINE_MAX_OUTPUT                     128
+#define DISPLAY_FIELD_MAX_OUTPUT                    96
+
+/*!
+ * Layout line. Box drawing chars and texts
+ */
+typedef struct sDisplayLayoutLine
+{
+    /*!
+     * Left border, column separator and right border. The column separator
+     * is 0 for a single column line, the left border for a text line
+     */
+    char Left;
+    char Middle;
+    char Right;
+    /*!
+     * Box drawing char filling the columns without text
+     */
+    char Fill;
+    const char *FirstCol;
+    const char *SecondCol;
+}DisplayLayoutLine_t;
+
+/*!
+ * Screen layout, the fields are drawn over it
+ */
+static const DisplayLayoutLine_t DisplayLayout[] =
+{
+    // "+-----------------------------------------------------------------------------+" );
+    { 'l', 0, 'k', 'q', NULL, NULL },
+    // "¦                      LoRaWAN Demonstration Application                      ¦" );
+    { 'x', 0, 'x', 0, "                      LoRaWAN Demonstration Application                       ", NULL },
+    // "+------------+----------------------------------------------------------------¦" );
+    { 't', 'w', 'u', 'q', NULL, NULL },
+    // "¦ Activation ¦ [ ]Over The Air                                                ¦" );
+    { 'x', 'x', 'x', 0, " Activation ", " [ ]Over The Air                                                 " },
+    // "¦            ¦ DevEui    [__ __ __ __ __ __ __ __]                            ¦" );
+    { 'x', 'x', 'x', 0, "            ", " DevEui    [__ __ __ __ __ __ __ __]                             " },
+    // "¦            ¦ AppEui    [__ __ __ __ __ __ __ __]                            ¦" );
+    { 'x', 'x', 'x', 0, "            ", " AppEui    [__ __ __ __ __ __ __ __]                             " },
+    // "¦            ¦ AppKey  [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]      ¦" );
+    { 'x', 'x', 'x', 0, "            ", " AppKey    [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " },
+    // "¦            +----------------------------------------------------------------¦" );
+    { 'x', 't', 'u', 'q', "            ", NULL },
+    // "¦            ¦ [x]Personalisation                                             ¦" );
+    { 'x', 'x', 'x', 0, "            ", " [ ]Personalisation                                              " },
+    // "¦            ¦ NwkId     [___]                                                ¦" );
+    { 'x', 'x', 'x', 0, "            ", " NwkId     [___]                                                 " },
+    // "¦            ¦ DevAddr   [__ __ __ __]                                        ¦" );
+    { 'x', 'x', 'x', 0, "            ", " DevAddr   [__ __ __ __]                                         " },
+    // "¦            ¦ NwkSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]    ¦" );
+    { 'x', 'x', 'x', 0, "            ", " NwkSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " },
+    // "¦            ¦ AppSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]    ¦" );
+    { 'x', 'x', 'x', 0, "            ", " AppSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " },
+    // "+------------+----------------------------------------------------------------¦" );
+    { 't', 'n', 'u', 'q', NULL, NULL },
+    // "¦ MAC params ¦ [ ]Confirmed / [ ]Unconfirmed                                  ¦" );
+    { 'x', 'x', 'x', 0, " MAC params ", " [ ]Confirmed / [ ]Unconfirmed                                   " },
+    // "¦            ¦ ADR       [   ]                                                ¦" );
+    { 'x', 'x', 'x', 0, "            ", " ADR       [   ]                                                 " },
+    // "¦            ¦ Duty cycle[   ]                                                ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Duty cycle[   ]                                                 " },
+    // "+------------+----------------------------------------------------------------¦" );
+    { 't', 'n', 'u', 'q', NULL, NULL },
+    // "¦ Network    ¦ [ ]Public  / [ ]Private                                        ¦" );
+    { 'x', 'x', 'x', 0, " Network    ", " [ ]Public  / [ ]Private                                         " },
+    // "¦            ¦ [ ]Joining / [ ]Joined                                         ¦" );
+    { 'x', 'x', 'x', 0, "            ", " [ ]Joining / [ ]Joined                                          " },
+    // "+------------+----------------------------------------------------------------¦" );
+    { 't', 'n', 'u', 'q', NULL, NULL },
+    // "¦ LED status ¦ [ ]LED1(Tx) / [ ]LED2(Rx) / [ ]LED3(App)                       ¦" );
+    { 'x', 'x', 'x', 0, " LED status ", " [ ]LED1(Tx) / [ ]LED2(Rx) / [ ]LED3(App)                        " },
+    // "+------------+----------------------------------------------------------------¦" );
+    { 't', 'n', 'u', 'q', NULL, NULL },
+    // "¦ Uplink     ¦ Acked              [ ]                                         ¦" );
+    { 'x', 'x', 'x', 0, " Uplink     ", " Acked              [ ]                                          " },
+    // "¦            ¦ Datarate        [    ]                                         ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Datarate        [    ]                                          " },
+    // "¦            ¦ Counter   [          ]                                         ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Counter   [          ]                                          " },
+    // "¦            ¦ Port             [   ]                                         ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Port             [   ]                                          " },
+    // "¦            ¦ Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " },
+    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " },
+    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " },
+    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " },
+    // "+------------+----------------------------------------------------------------¦" );
+    { 't', 'n', 'u', 'q', NULL, NULL },
+    // "¦ Downlink   ¦ RSSI           [     ] dBm                                     ¦" );
+    { 'x', 'x', 'x', 0, " Downlink   ", " RSSI           [     ] dBm                                      " },
+    // "¦ [ ]Data    ¦ SNR      [     ] dB                                            ¦" );
+    { 'x', 'x', 'x', 0, " [ ]Data    ", " SNR            [     ] dB                                       " },
+    // "¦            ¦ Counter  [          ]                                          ¦" );
+    // "¦            ¦ Counter   [          ]                                         ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Counter   [          ]                                          " },
+    // "¦            ¦ Port             [   ]                                         ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Port             [   ]                                          " },
+    // "¦            ¦ Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", " Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " },
+    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " },
+    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " },
+    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
+    { 'x', 'x', 'x', 0, "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " },
+    // "+------------+----------------------------------------------------------------+" );
+    { 'm', 'v', 'j', 'q', NULL, NULL },
+    { 0, 0, 0, 0, "To refresh screen please hit 'r' key.", NULL },
+};
+
+#define DISPLAY_LAYOUT_NB_LINES                     ( sizeof( DisplayLayout ) / sizeof( DisplayLayout[0] ) )
+
+/*!
+ * Displayed fields. A data field takes one field per line
+ */
+typedef enum eDisplayField
+{
+    DISPLAY_ACTIVATION,
+    DISPLAY_DEV_EUI,
+    DISPLAY_APP_EUI,
+    DISPLAY_APP_KEY,
+    DISPLAY_NWK_ID,
+    DISPLAY_DEV_ADDR,
+    DISPLAY_NWK_SKEY,
+    DISPLAY_APP_SKEY,
+    DISPLAY_FRAME_TYPE,
+    DISPLAY_ADR,
+    DISPLAY_DUTY_CYCLE,
+    DISPLAY_PUBLIC_NETWORK,
+    DISPLAY_JOINED,
+    DISPLAY_LED1,
+    DISPLAY_LED2,
+    DISPLAY_LED3,
+    DISPLAY_UP_ACKED,
+    DISPLAY_UP_DATARATE,
+    DISPLAY_UP_COUNTER,
+    DISPLAY_UP_PORT,
+    DISPLAY_UP_DATA,
+    DISPLAY_DOWN_RX_DATA = DISPLAY_UP_DATA + DISPLAY_DATA_NB_LINES,
+    DISPLAY_DOWN_RSSI,
+    DISPLAY_DOWN_SNR,
+    DISPLAY_DOWN_COUNTER,
+    DISPLAY_DOWN_PORT,
+    DISPLAY_DOWN_DATA,
+    DISPLAY_BATCH = DISPLAY_DOWN_DATA + DISPLAY_DATA_NB_LINES,
+    DISPLAY_ENERGY,
+    DISPLAY_BUDGET,
+    DISPLAY_NB_FIELDS,
+}DisplayField_t;
+
+/*!
+ * Displayed values
+ */
+typedef struct sDisplayValues
+{
+    bool Otaa;
+    uint8_t DevEui[8];
+    uint8_t AppEui[8];
+    uint8_t AppKey[16];
+    uint8_t NwkId;
+    uint32_t DevAddr;
+    uint8_t NwkSKey[16];
+    uint8_t AppSKey[16];
+    bool Confirmed;
+    bool Adr;
+    bool DutyCycle;
+    bool PublicNetwork;
+    bool Joined;
+    uint8_t Led[3];
+    bool UpAcked;
+    uint8_t UpDatarate;
+    uint16_t UpCounter;
+    uint8_t UpPort;
+    uint8_t UpData[DISPLAY_DATA_MAX_SIZE];
+    uint8_t UpDataSize;
+    bool DownRxData;
+    int16_t DownRssi;
+    int8_t DownSnr;
+    uint16_t DownCounter;
+    /*!
+     * -1 when the downlink has no data
+     */
+    int16_t DownPort;
+    uint8_t DownData[DISPLAY_DATA_MAX_SIZE];
+    uint8_t DownDataSize;
+    /*!
+     * Records, airtime saved per byte
+     */
+    uint32_t Batch[2];
+    /*!
+     * Tx time, Rx time, charge, total charge
+     */
+    uint32_t Energy[4];
+    /*!
+     * Voltage, remaining charge, lifetime, period, depth
+     */
+    uint32_t Budget[5];
+}DisplayValues_t;
+
+static DisplayValues_t DisplayValues;
+
+/*!
+ * Fields to draw, fields set at least once
+ */
+static uint8_t DisplayDirty[( DISPLAY_NB_FIELDS + 7 ) / 8];
+static uint8_t DisplayValid[( DISPLAY_NB_FIELDS + 7 ) / 8];
+static uint8_t DisplayNbDirty = 0;
+
+/*!
+ * Next layout step: 0 clears the terminal, then the layout lines from 1.
+ * DISPLAY_LAYOUT_NB_LINES + 1 once the layout is drawn
+ */
+static uint8_t DisplayLayoutStep = DISPLAY_LAYOUT_NB_LINES + 1;
+
+/*!
+ * \brief Marks a field to be drawn by SerialDisplayProcess
+ */
+static void DisplayMarkDirty( uint8_t field )
+{
+    DisplayValid[field >> 3] |= 1 << ( field & 0x07 );
+    if( ( DisplayDirty[field >> 3] & ( 1 << ( field & 0x07 ) ) ) == 0 )
+    {
+        DisplayDirty[field >> 3] |= 1 << ( field & 0x07 );
+        DisplayNbDirty++;
+    }
+}
+
+/*!
+ * \brief Stores the value of a field. Marks the field when the value changed
+ *
+ * \param [IN] field    Field
+ * \param [IN] value    Displayed value
+ * \param [IN] newValue New value
+ * \param [IN] size     Value size
+ */
+static void DisplaySet( DisplayField_t field, void *value, const void *newValue, uint8_t size )
+{
+    if( ( SERIAL_DISPLAY_DIFF_ON == 1 ) && ( memcmp( value, newValue, size ) == 0 ) )
+    {
+        return;
+    }
+    memcpy1( ( uint8_t* )value, ( const uint8_t* )newValue, size );
+    DisplayMarkDirty( field );
+}
+
+/*!
+ * \brief Stores the value of a data field. Marks the lines which changed
+ *
+ * \param [IN] field    First line field
+ * \param [IN] data     Displayed data
+ * \param [IN] dataSize Displayed data size
+ * \param [IN] buffer   New data
+ * \param [IN] size     New data size
+ */
+static void DisplaySetData( uint8_t field, uint8_t *data, uint8_t *dataSize, const uint8_t *buffer, uint8_t size )
+{
+    size = MIN( size, DISPLAY_DATA_MAX_SIZE );
+
+    for( uint8_t line = 0; line < DISPLAY_DATA_NB_LINES; line++ )
+    {
+        bool changed = false;
+
+        for( uint8_t i = line * DISPLAY_DATA_LINE_SIZE; ( i < ( ( line + 1 ) * DISPLAY_DATA_LINE_SIZE ) ) && ( changed == false ); i++ )
+        {
+            // A byte is shown as its value below the size, as "__" above
+            changed = ( ( i < *dataSize ) != ( i < size ) ) || ( ( i < size ) && ( data[i] != buffer[i] ) );
+        }
+        if( ( changed == true ) || ( SERIAL_DISPLAY_DIFF_ON == 0 ) )
+        {
+            DisplayMarkDirty( field + line );
+        }
+    }
+    memcpy1( data, buffer, size );
+    *dataSize = size;
+}
+
+/*!
+ * \brief Sends box drawing chars
+ */
+static void DisplayPutBox( char c, uint8_t count )
+{
+    vt.printf( "\x1B(0" );
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        vt.putc( c );
+    }
+    vt.printf( "\x1B(B" );
+}
+
+/*!
+ * \brief Sends a layout column, its text or the fill box drawing char
+ */
+static void DisplayPutColumn( const char *text, char fill, uint8_t width )
+{
+    if( text != NULL )
+    {
+        vt.printf( "%s", text );
+    }
+    else
+    {
+        DisplayPutBox( fill, width );
+    }
+}
+
+/*!
+ * \brief Sends a layout line
+ *
+ * \param [IN] line Screen line [1:DISPLAY_LAYOUT_NB_LINES]
+ */
+static void DisplayDrawLayoutLine( uint8_t line )
 {
+    const DisplayLayoutLine_t *layout = &DisplayLayout[line - 1];
+
+    vt.SetCursorPos( line, 1 );
+    if( layout->Left == 0 )
+    {
+        vt.printf( "%s", layout->FirstCol );
+        return;
+    }
+    DisplayPutBox( layout->Left, 1 );
+    if( layout->Middle == 0 )
+    {
+        DisplayPutColumn( layout->FirstCol, layout->Fill, DISPLAY_SINGLE_COL_WIDTH );
+    }
+    else
+    {
+        DisplayPutColumn( layout->FirstCol, layout->Fill, DISPLAY_FIRST_COL_WIDTH );
+        DisplayPutBox( layout->Middle, 1 );
+        DisplayPutColumn( layout->SecondCol, layout->Fill, DISPLAY_SECOND_COL_WIDTH );
+    }
+    DisplayPutBox( layout->Right, 1 );
+}
+
+/*!
+ * \brief Clears the terminal
+ */
+static void DisplayClear( void )
+{
+    vt.SetAttribute( VT100::ATTR_OFF );
+    vt.printf( "\x1B(B" );
+    vt.ClearScreen( 2 );
+    vt.SetCursorMode( false );
+}
+
+/*!
+ * \brief Sends a check box, filled with the color when activated
+ */
+static void DisplayDrawCheckBox( uint8_t line, uint8_t col, bool activated, uint8_t color )
+{
+    vt.SetCursorPos( line, col );
     if( activated == true )
     {
         vt.SetAttribute( VT100::ATTR_OFF, color, color );
+        vt.putc( ' ' );
+        vt.SetAttribute( VT100::ATTR_OFF );
     }
     else
     {
-        vt.SetAttribute( VT100::ATTR_OFF );
+        vt.putc( ' ' );
+    }
+}
+
+/*!
+ * \brief Sends an EUI or a key, the closing bracket replaces the last space
+ */
+static void DisplayDrawBytes( uint8_t line, const uint8_t *bytes, uint8_t size )
+{
+    vt.SetCursorPos( line, 27 );
+    for( uint8_t i = 0; i < size; i++ )
+    {
+        vt.printf( ( i < ( size - 1 ) ) ? "%02X " : "%02X]", bytes[i] );
+    }
+}
+
+/*!
+ * \brief Sends a line of a data field. The bytes above the size are shown as
+ *        "__", the closing bracket ends the last line
+ *
+ * \param [IN] firstLine Screen line of the data field
+ * \param [IN] line      Data line [0:DISPLAY_DATA_NB_LINES[
+ */
+static void DisplayDrawData( uint8_t firstLine, uint8_t line, const uint8_t *data, uint8_t size )
+{
+    vt.SetCursorPos( firstLine + line, 27 );
+    for( uint8_t i = line * DISPLAY_DATA_LINE_SIZE; i < ( ( line + 1 ) * DISPLAY_DATA_LINE_SIZE ); i++ )
+    {
+        if( i < size )
+        {
+            vt.printf( "%02X", data[i] );
+        }
+        else
+        {
+            vt.printf( "__" );
+        }
+        vt.putc( ( i == ( DISPLAY_DATA_MAX_SIZE - 1 ) ) ? ']' : ' ' );
+    }
+}
+
+/*!
+ * \brief Sends a field
+ */
+static void DisplayDrawField( uint8_t field )
+{
+    DisplayValues_t *v = &DisplayValues;
+
+    if( ( field >= DISPLAY_UP_DATA ) && ( field < ( DISPLAY_UP_DATA + DISPLAY_DATA_NB_LINES ) ) )
+    {
+        DisplayDrawData( DISPLAY_UP_DATA_LINE, field - DISPLAY_UP_DATA, v->UpData, v->UpDataSize );
+        return;
+    }
+    if( ( field >= DISPLAY_DOWN_DATA ) && ( field < ( DISPLAY_DOWN_DATA + DISPLAY_DATA_NB_LINES ) ) )
+    {
+        DisplayDrawData( DISPLAY_DOWN_DATA_LINE, field - DISPLAY_DOWN_DATA, v->DownData, v->DownDataSize );
+        return;
+    }
+
+    switch( field )
+    {
+        case DISPLAY_ACTIVATION:
+            DisplayDrawCheckBox( 4, 17, v->Otaa, VT100::WHITE );
+            DisplayDrawCheckBox( 9, 17, !v->Otaa, VT100::WHITE );
+            break;
+        case DISPLAY_DEV_EUI:
+            DisplayDrawBytes( 5, v->DevEui, sizeof( v->DevEui ) );
+            break;
+        case DISPLAY_APP_EUI:
+            DisplayDrawBytes( 6, v->AppEui, sizeof( v->AppEui ) );
+            break;
+        case DISPLAY_APP_KEY:
+            DisplayDrawBytes( 7, v->AppKey, sizeof( v->AppKey ) );
+            break;
+        case DISPLAY_NWK_ID:
+            vt.SetCursorPos( 10, 27 );
+            vt.printf( "%03d", v->NwkId );
+            break;
+        case DISPLAY_DEV_ADDR:
+            vt.SetCursorPos( 11, 27 );
+            vt.printf( "%02X %02X %02X %02X", ( v->DevAddr >> 24 ) & 0xFF, ( v->DevAddr >> 16 ) & 0xFF, ( v->DevAddr >> 8 ) & 0xFF, v->DevAddr & 0xFF );
+            break;
+        case DISPLAY_NWK_SKEY:
+            DisplayDrawBytes( 12, v->NwkSKey, sizeof( v->NwkSKey ) );
+            break;
+        case DISPLAY_APP_SKEY:
+            DisplayDrawBytes( 13, v->AppSKey, sizeof( v->AppSKey ) );
+            break;
+        case DISPLAY_FRAME_TYPE:
+            DisplayDrawCheckBox( 15, 17, v->Confirmed, VT100::WHITE );
+            DisplayDrawCheckBox( 15, 32, !v->Confirmed, VT100::WHITE );
+            break;
+        case DISPLAY_ADR:
+            vt.SetCursorPos( 16, 27 );
+            vt.printf( ( v->Adr == true ) ? " ON" : "OFF" );
+            break;
+        case DISPLAY_DUTY_CYCLE:
+            vt.SetCursorPos( 17, 27 );
+            vt.printf( ( v->DutyCycle == true ) ? " ON" : "OFF" );
+            break;
+        case DISPLAY_PUBLIC_NETWORK:
+            DisplayDrawCheckBox( 19, 17, v->PublicNetwork, VT100::WHITE );
+            DisplayDrawCheckBox( 19, 30, !v->PublicNetwork, VT100::WHITE );
+            break;
+        case DISPLAY_JOINED:
+            DisplayDrawCheckBox( 20, 17, !v->Joined, VT100::RED );
+            DisplayDrawCheckBox( 20, 30, v->Joined, VT100::GREEN );
+            break;
+        case DISPLAY_LED1:
+            DisplayDrawCheckBox( 22, 17, v->Led[0], VT100::RED );
+            break;
+        case DISPLAY_LED2:
+            DisplayDrawCheckBox( 22, 31, v->Led[1], VT100::GREEN );
+            break;
+        case DISPLAY_LED3:
+            DisplayDrawCheckBox( 22, 45, v->Led[2], VT100::BLUE );
+            break;
+        case DISPLAY_UP_ACKED:
+            DisplayDrawCheckBox( 24, 36, v->UpAcked, VT100::GREEN );
+            break;
+        case DISPLAY_UP_DATARATE:
+            vt.SetCursorPos( 25, 33 );
+            vt.printf( "DR%d", v->UpDatarate );
+            break;
+        case DISPLAY_UP_COUNTER:
+            vt.SetCursorPos( 26, 27 );
+            vt.printf( "%10d", v->UpCounter );
+            break;
+        case DISPLAY_UP_PORT:
+            vt.SetCursorPos( 27, 34 );
+            vt.printf( "%3d", v->UpPort );
+            break;
+        case DISPLAY_DOWN_RX_DATA:
+            DisplayDrawCheckBox( 34, 4, v->DownRxData, VT100::GREEN );
+            break;
+        case DISPLAY_DOWN_RSSI:
+            vt.SetCursorPos( 33, 32 );
+            vt.printf( "%5d", v->DownRssi );
+            break;
+        case DISPLAY_DOWN_SNR:
+            vt.SetCursorPos( 34, 32 );
+            vt.printf( "%5d", v->DownSnr );
+            break;
+        case DISPLAY_DOWN_COUNTER:
+            vt.SetCursorPos( 35, 27 );
+            vt.printf( "%10d", v->DownCounter );
+            break;
+        case DISPLAY_DOWN_PORT:
+            vt.SetCursorPos( 36, 34 );
+            if( v->DownPort < 0 )
+            {
+                vt.printf( "   " );
+            }
+            else
+            {
+                vt.printf( "%3d", v->DownPort );
+            }
+            break;
+        case DISPLAY_BATCH:
+            vt.SetCursorPos( 43, 1 );
+            vt.printf( "Batch: %2lu records pending, airtime saved %6lu us/byte", v->Batch[0], v->Batch[1] );
+            break;
+        case DISPLAY_ENERGY:
+            vt.SetCursorPos( 44, 1 );
+            vt.printf( "Energy: Tx %7lu us, Rx %7lu us, %6lu nAh, total %9lu nAh", v->Energy[0], v->Energy[1], v->Energy[2], v->Energy[3] );
+            break;
+        case DISPLAY_BUDGET:
+            vt.SetCursorPos( 45, 1 );
+            vt.printf( "Budget: %4lu mV, %5lu mAh, %5lu days left, period %7lu ms, %2lu records", v->Budget[0], v->Budget[1], v->Budget[2], v->Budget[3], v->Budget[4] );
+            break;
+        default:
+            break;
     }
-    vt.printf( " " );
-    vt.SetAttribute( VT100::ATTR_OFF );
 }
 
 void SerialDisplayUpdateActivationMode( bool otaa )
 {
-    vt.SetCursorPos( 4, 17 );
-    SerialPrintCheckBox( otaa, VT100::WHITE );
-    vt.SetCursorPos( 9, 17 );
-    SerialPrintCheckBox( !otaa, VT100::WHITE );
+    DisplaySet( DISPLAY_ACTIVATION, &DisplayValues.Otaa, &otaa, sizeof( otaa ) );
 }
 
 void SerialDisplayUpdateEui( uint8_t line, uint8_t *eui )
 {
-    vt.SetCursorPos( line, 27 );
-    for( uint8_t i = 0; i < 8; i++ )
+    if( line == 5 )
+    {
+        DisplaySet( DISPLAY_DEV_EUI, DisplayValues.DevEui, eui, sizeof( DisplayValues.DevEui ) );
+    }
+    else if( line == 6 )
     {
-        vt.printf( "%02X ", eui[i] );
+        DisplaySet( DISPLAY_APP_EUI, DisplayValues.AppEui, eui, sizeof( DisplayValues.AppEui ) );
     }
-    vt.SetCursorPos( line, 50 );
-    vt.printf( "]" );
 }
 
 void SerialDisplayUpdateKey( uint8_t line, uint8_t *key )
 {
-    vt.SetCursorPos( line, 27 );
-    for( uint8_t i = 0; i < 16; i++ )
+    switch( line )
     {
-        vt.printf( "%02X ", key[i] );
+        case 7:
+            DisplaySet( DISPLAY_APP_KEY, DisplayValues.AppKey, key, sizeof( DisplayValues.AppKey ) );
+            break;
+        case 12:
+            DisplaySet( DISPLAY_NWK_SKEY, DisplayValues.NwkSKey, key, sizeof( DisplayValues.NwkSKey ) );
+            break;
+        case 13:
+            DisplaySet( DISPLAY_APP_SKEY, DisplayValues.AppSKey, key, sizeof( DisplayValues.AppSKey ) );
+            break;
+        default:
+            break;
     }
-    vt.SetCursorPos( line, 74 );
-    vt.printf( "]" );
 }
 
 void SerialDisplayUpdateNwkId( uint8_t id )
 {
-    vt.SetCursorPos( 10, 27 );
-    vt.printf( "%03d", id );
+    DisplaySet( DISPLAY_NWK_ID, &DisplayValues.NwkId, &id, sizeof( id ) );
 }
 
 void SerialDisplayUpdateDevAddr( uint32_t addr )
 {
-    vt.SetCursorPos( 11, 27 );
-    vt.printf( "%02X %02X %02X %02X", ( addr >> 24 ) & 0xFF, ( addr >> 16 ) & 0xFF, ( addr >> 8 ) & 0xFF, addr & 0xFF );
+    DisplaySet( DISPLAY_DEV_ADDR, &DisplayValues.DevAddr, &addr, sizeof( addr ) );
 }
 
 void SerialDisplayUpdateFrameType( bool confirmed )
 {
-    vt.SetCursorPos( 15, 17 );
-    SerialPrintCheckBox( confirmed, VT100::WHITE );
-    vt.SetCursorPos( 15, 32 );
-    SerialPrintCheckBox( !confirmed, VT100::WHITE );
+    DisplaySet( DISPLAY_FRAME_TYPE, &DisplayValues.Confirmed, &confirmed, sizeof( confirmed ) );
 }
 
 void SerialDisplayUpdateAdr( bool adr )
 {
-    vt.SetCursorPos( 16, 27 );
-    if( adr == true )
-    {
-        vt.printf( " ON" );
-    }
-    else
-    {
-        vt.printf( "OFF" );
-    }
+    DisplaySet( DISPLAY_ADR, &DisplayValues.Adr, &adr, sizeof( adr ) );
 }
 
 void SerialDisplayUpdateDutyCycle( bool dutyCycle )
 {
-    vt.SetCursorPos( 17, 27 );
-    if( dutyCycle == true )
-    {
-        vt.printf( " ON" );
-    }
-    else
-    {
-        vt.printf( "OFF" );
-    }
+    DisplaySet( DISPLAY_DUTY_CYCLE, &DisplayValues.DutyCycle, &dutyCycle, sizeof( dutyCycle ) );
 }
 
 void SerialDisplayUpdatePublicNetwork( bool network )
 {
-    vt.SetCursorPos( 19, 17 );
-    SerialPrintCheckBox( network, VT100::WHITE );
-    vt.SetCursorPos( 19, 30 );
-    SerialPrintCheckBox( !network, VT100::WHITE );
+    DisplaySet( DISPLAY_PUBLIC_NETWORK, &DisplayValues.PublicNetwork, &network, sizeof( network ) );
 }
 
 void SerialDisplayUpdateNetworkIsJoined( bool state )
 {
-    vt.SetCursorPos( 20, 17 );
-    SerialPrintCheckBox( !state, VT100::RED );
-    vt.SetCursorPos( 20, 30 );
-    SerialPrintCheckBox( state, VT100::GREEN );
+    DisplaySet( DISPLAY_JOINED, &DisplayValues.Joined, &state, sizeof( state ) );
 }
 
 void SerialDisplayUpdateLedState( uint8_t id, uint8_t state )
 {
-    switch( id )
+    if( ( id >= 1 ) && ( id <= 3 ) )
     {
-        case 1:
-            vt.SetCursorPos( 22, 17 );
-            SerialPrintCheckBox( state, VT100::RED );
-            break;
-        case 2:
-            vt.SetCursorPos( 22, 31 );
-            SerialPrintCheckBox( state, VT100::GREEN );
-            break;
-        case 3:
-            vt.SetCursorPos( 22, 45 );
-            SerialPrintCheckBox( state, VT100::BLUE );
-            break;
+        DisplaySet( ( DisplayField_t )( DISPLAY_LED1 + id - 1 ), &DisplayValues.Led[id - 1], &state, sizeof( state ) );
     }
 }
 
 void SerialDisplayUpdateData( uint8_t line, uint8_t *buffer, uint8_t size )
 {
-    if( size != 0 )
+    if( line == DISPLAY_UP_DATA_LINE )
     {
-        vt.SetCursorPos( line, 27 );
-        for( uint8_t i = 0; i < size; i++ )
-        {
-            vt.printf( "%02X ", buffer[i] );
-            if( ( ( i + 1 ) % 16 ) == 0 )
-            {
-                line++;
-                vt.SetCursorPos( line, 27 );
-            }
-        }
-        for( uint8_t i = size; i < 64; i++ )
-        {
-            vt.printf( "__ " );
-            if( ( ( i + 1 ) % 16 ) == 0 )
-            {
-                line++;
-                vt.SetCursorPos( line, 27 );
-            }
-        }
-        vt.SetCursorPos( line - 1, 74 );
-        vt.printf( "]" );
+        DisplaySetData( DISPLAY_UP_DATA, DisplayValues.UpData, &DisplayValues.UpDataSize, buffer, size );
     }
-    else
+    else if( line == DISPLAY_DOWN_DATA_LINE )
     {
-        vt.SetCursorPos( line, 27 );
-        for( uint8_t i = 0; i < 64; i++ )
-        {
-            vt.printf( "__ " );
-            if( ( ( i + 1 ) % 16 ) == 0 )
-            {
-                line++;
-                vt.SetCursorPos( line, 27 );
-            }
-        }
-        vt.SetCursorPos( line - 1, 74 );
-        vt.printf( "]" );
+        DisplaySetData( DISPLAY_DOWN_DATA, DisplayValues.DownData, &DisplayValues.DownDataSize, buffer, size );
     }
 }
 
 void SerialDisplayUpdateUplinkAcked( bool state )
 {
-    vt.SetCursorPos( 24, 36 );
-    SerialPrintCheckBox( state, VT100::GREEN );
+    DisplaySet( DISPLAY_UP_ACKED, &DisplayValues.UpAcked, &state, sizeof( state ) );
 }
 
 void SerialDisplayUpdateUplink( bool acked, uint8_t datarate, uint16_t counter, uint8_t port, uint8_t *buffer, uint8_t bufferSize )
 {
-    // Acked
     SerialDisplayUpdateUplinkAcked( acked );
-    // Datarate
-    vt.SetCursorPos( 25, 33 );
-    vt.printf( "DR%d", datarate );
-    // Counter
-    vt.SetCursorPos( 26, 27 );
-    vt.printf( "%10d", counter );
-    // Port
-    vt.SetCursorPos( 27, 34 );
-    vt.printf( "%3d", port );
-    // Data
-    SerialDisplayUpdateData( 28, buffer, bufferSize );
-    // Help message
-    vt.SetCursorPos( 42, 1 );
-    vt.printf( "To refresh screen please hit 'r' key." );
+    DisplaySet( DISPLAY_UP_DATARATE, &DisplayValues.UpDatarate, &datarate, sizeof( datarate ) );
+    DisplaySet( DISPLAY_UP_COUNTER, &DisplayValues.UpCounter, &counter, sizeof( counter ) );
+    DisplaySet( DISPLAY_UP_PORT, &DisplayValues.UpPort, &port, sizeof( port ) );
+    SerialDisplayUpdateData( DISPLAY_UP_DATA_LINE, buffer, bufferSize );
 }
 
 void SerialDisplayUpdateDonwlinkRxData( bool state )
 {
-    vt.SetCursorPos( 34, 4 );
-    SerialPrintCheckBox( state, VT100::GREEN );
+    DisplaySet( DISPLAY_DOWN_RX_DATA, &DisplayValues.DownRxData, &state, sizeof( state ) );
 }
 
 void SerialDisplayUpdateDownlink( bool rxData, int16_t rssi, int8_t snr, uint16_t counter, uint8_t port, uint8_t *buffer, uint8_t bufferSize )
 {
-    // Rx data
+    int16_t downPort = ( rxData == true ) ? port : -1;
+
     SerialDisplayUpdateDonwlinkRxData( rxData );
-    // RSSI
-    vt.SetCursorPos( 33, 32 );
-    vt.printf( "%5d", rssi );
-    // SNR
-    vt.SetCursorPos( 34, 32 );
-    vt.printf( "%5d", snr );
-    // Counter
-    vt.SetCursorPos( 35, 27 );
-    vt.printf( "%10d", counter );
-    if( rxData == true )
-    {
-        // Port
-        vt.SetCursorPos( 36, 34 );
-        vt.printf( "%3d", port );
-        // Data
-        SerialDisplayUpdateData( 37, buffer, bufferSize );
-    }
-    else
-    {
-        // Port
-        vt.SetCursorPos( 36, 34 );
-        vt.printf( "   " );
-        // Data
-        SerialDisplayUpdateData( 37, NULL, 0 );
-    }
+    DisplaySet( DISPLAY_DOWN_RSSI, &DisplayValues.DownRssi, &rssi, sizeof( rssi ) );
+    DisplaySet( DISPLAY_DOWN_SNR, &DisplayValues.DownSnr, &snr, sizeof( snr ) );
+    DisplaySet( DISPLAY_DOWN_COUNTER, &DisplayValues.DownCounter, &counter, sizeof( counter ) );
+    DisplaySet( DISPLAY_DOWN_PORT, &DisplayValues.DownPort, &downPort, sizeof( downPort ) );
+    SerialDisplayUpdateData( DISPLAY_DOWN_DATA_LINE, ( rxData == true ) ? buffer : NULL, ( rxData == true ) ? bufferSize : 0 );
 }
 
-void SerialDisplayDrawFirstLine( void )
+void SerialDisplayUpdateBatch( uint8_t nbRecords, uint32_t airTimeSavedPerByte )
 {
-    vt.PutBoxDrawingChar( 'l' );
-    for( int8_t i = 0; i <= 77; i++ )
-    {
-        vt.PutBoxDrawingChar( 'q' );
-    }
-    vt.PutBoxDrawingChar( 'k' );
-    vt.printf( "\r\n" );
-}
+    uint32_t batch[2] = { nbRecords, airTimeSavedPerByte };
 
-void SerialDisplayDrawTitle( const char* title )
-{
-    vt.PutBoxDrawingChar( 'x' );
-    vt.printf( "%s", title );
-    vt.PutBoxDrawingChar( 'x' );
-    vt.printf( "\r\n" );
+    DisplaySet( DISPLAY_BATCH, DisplayValues.Batch, batch, sizeof( batch ) );
 }
-void SerialDisplayDrawTopSeparator( void )
+
+void SerialDisplayUpdateEnergy( uint32_t txTime, uint32_t rxTime, uint32_t charge, uint32_t totalCharge )
 {
-    vt.PutBoxDrawingChar( 't' );
-    for( int8_t i = 0; i <= 11; i++ )
-    {
-        vt.PutBoxDrawingChar( 'q' );
-    }
-    vt.PutBoxDrawingChar( 'w' );
-    for( int8_t i = 0; i <= 64; i++ )
-    {
-        vt.PutBoxDrawingChar( 'q' );
-    }
-    vt.PutBoxDrawingChar( 'u' );
-    vt.printf( "\r\n" );
+    uint32_t energy[4] = { txTime, rxTime, charge, totalCharge };
+
+    DisplaySet( DISPLAY_ENERGY, DisplayValues.Energy, energy, sizeof( energy ) );
 }
 
-void SerialDisplayDrawColSeparator( void )
+void SerialDisplayUpdateBudget( uint16_t voltage, uint32_t remaining, uint32_t lifetime, uint32_t period, uint8_t depth )
 {
-    vt.PutBoxDrawingChar( 'x' );
-    for( int8_t i = 0; i <= 11; i++ )
-    {
-        vt.PutBoxDrawingChar( ' ' );
-    }
-    vt.PutBoxDrawingChar( 't' );
-    for( int8_t i = 0; i <= 64; i++ )
-    {
-        vt.PutBoxDrawingChar( 'q' );
-    }
-    vt.PutBoxDrawingChar( 'u' );
-    vt.printf( "\r\n" );
+    uint32_t budget[5] = { voltage, remaining, lifetime, period, depth };
+
+    DisplaySet( DISPLAY_BUDGET, DisplayValues.Budget, budget, sizeof( budget ) );
 }
 
-void SerialDisplayDrawSeparator( void )
+void SerialDisplayInit( void )
 {
-    vt.PutBoxDrawingChar( 't' );
-    for( int8_t i = 0; i <= 11; i++ )
-    {
-        vt.PutBoxDrawingChar( 'q' );
-    }
-    vt.PutBoxDrawingChar( 'n' );
-    for( int8_t i = 0; i <= 64; i++ )
+    // The layout is drawn again, then the fields already set
+    DisplayLayoutStep = 0;
+    for( uint8_t field = 0; field < DISPLAY_NB_FIELDS; field++ )
     {
-        vt.PutBoxDrawingChar( 'q' );
+        if( ( DisplayValid[field >> 3] & ( 1 << ( field & 0x07 ) ) ) != 0 )
+        {
+            DisplayMarkDirty( field );
+        }
     }
-    vt.PutBoxDrawingChar( 'u' );
-    vt.printf( "\r\n" );
 }
 
-void SerialDisplayDrawLine( const char* firstCol, const char* secondCol )
+void SerialDisplayProcess( void )
 {
-    vt.PutBoxDrawingChar( 'x' );
-    vt.printf( "%s", firstCol );
-    vt.PutBoxDrawingChar( 'x' );
-    vt.printf( "%s", secondCol );
-    vt.PutBoxDrawingChar( 'x' );
-    vt.printf( "\r\n" );
-}
+    uint8_t field;
 
-void SerialDisplayDrawBottomLine( void )
-{
-    vt.PutBoxDrawingChar( 'm' );
-    for( int8_t i = 0; i <= 11; i++ )
+    // Resumes once the UART has sent the queued chars
+    while( DisplayLayoutStep <= DISPLAY_LAYOUT_NB_LINES )
     {
-        vt.PutBoxDrawingChar( 'q' );
+        if( vt.GetTxFree( ) < DISPLAY_LINE_MAX_OUTPUT )
+        {
+            return;
+        }
+        if( DisplayLayoutStep == 0 )
+        {
+            DisplayClear( );
+        }
+        else
+        {
+            DisplayDrawLayoutLine( DisplayLayoutStep );
+        }
+        DisplayLayoutStep++;
     }
-    vt.PutBoxDrawingChar( 'v' );
-    for( int8_t i = 0; i <= 64; i++ )
+
+    for( field = 0; ( field < DISPLAY_NB_FIELDS ) && ( DisplayNbDirty != 0 ); field++ )
     {
-        vt.PutBoxDrawingChar( 'q' );
+        if( ( DisplayDirty[field >> 3] & ( 1 << ( field & 0x07 ) ) ) == 0 )
+        {
+            continue;
+        }
+        if( vt.GetTxFree( ) < DISPLAY_FIELD_MAX_OUTPUT )
+        {
+            return;
+        }
+        DisplayDirty[field >> 3] &= ~( 1 << ( field & 0x07 ) );
+        DisplayNbDirty--;
+        DisplayDrawField( field );
     }
-    vt.PutBoxDrawingChar( 'j' );
-    vt.printf( "\r\n" );
-}
-
-void SerialDisplayInit( void )
-{
-    vt.ClearScreen( 2 );
-    vt.SetCursorMode( false );
-    vt.SetCursorPos( 0, 0 );
-    
-    // "+-----------------------------------------------------------------------------+" );
-    SerialDisplayDrawFirstLine( );
-    // "¦                      LoRaWAN Demonstration Application                      ¦" );
-    SerialDisplayDrawTitle( "                      LoRaWAN Demonstration Application                       " );
-    // "+------------+----------------------------------------------------------------¦" );
-    SerialDisplayDrawTopSeparator( );
-    // "¦ Activation ¦ [ ]Over The Air                                                ¦" );
-    SerialDisplayDrawLine( " Activation ", " [ ]Over The Air                                                 " );
-    // "¦            ¦ DevEui    [__ __ __ __ __ __ __ __]                            ¦" );
-    SerialDisplayDrawLine( "            ", " DevEui    [__ __ __ __ __ __ __ __]                             " );
-    // "¦            ¦ AppEui    [__ __ __ __ __ __ __ __]                            ¦" );
-    SerialDisplayDrawLine( "            ", " AppEui    [__ __ __ __ __ __ __ __]                             " );
-    // "¦            ¦ AppKey  [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]      ¦" );
-    SerialDisplayDrawLine( "            ", " AppKey    [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " );
-    // "¦            +----------------------------------------------------------------¦" );
-    SerialDisplayDrawColSeparator( );
-    // "¦            ¦ [x]Personalisation                                             ¦" );
-    SerialDisplayDrawLine( "            ", " [ ]Personalisation                                              " );
-    // "¦            ¦ NwkId     [___]                                                ¦" );
-    SerialDisplayDrawLine( "            ", " NwkId     [___]                                                 " );
-    // "¦            ¦ DevAddr   [__ __ __ __]                                        ¦" );
-    SerialDisplayDrawLine( "            ", " DevAddr   [__ __ __ __]                                         " );
-    // "¦            ¦ NwkSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]    ¦" );
-    SerialDisplayDrawLine( "            ", " NwkSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " );
-    // "¦            ¦ AppSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]    ¦" );
-    SerialDisplayDrawLine( "            ", " AppSKey   [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __]     " );
-    // "+------------+----------------------------------------------------------------¦" );
-    SerialDisplayDrawSeparator( );
-    // "¦ MAC params ¦ [ ]Confirmed / [ ]Unconfirmed                                  ¦" );
-    SerialDisplayDrawLine( " MAC params ", " [ ]Confirmed / [ ]Unconfirmed                                   " );
-    // "¦            ¦ ADR       [   ]                                                ¦" );
-    SerialDisplayDrawLine( "            ", " ADR       [   ]                                                 " );
-    // "¦            ¦ Duty cycle[   ]                                                ¦" );
-    SerialDisplayDrawLine( "            ", " Duty cycle[   ]                                                 " );
-    // "+------------+----------------------------------------------------------------¦" );
-    SerialDisplayDrawSeparator( );
-    // "¦ Network    ¦ [ ]Public  / [ ]Private                                        ¦" );
-    SerialDisplayDrawLine( " Network    ", " [ ]Public  / [ ]Private                                         " );
-    // "¦            ¦ [ ]Joining / [ ]Joined                                         ¦" );
-    SerialDisplayDrawLine( "            ", " [ ]Joining / [ ]Joined                                          " );
-    // "+------------+----------------------------------------------------------------¦" );
-    SerialDisplayDrawSeparator( );
-    // "¦ LED status ¦ [ ]LED1(Tx) / [ ]LED2(Rx) / [ ]LED3(App)                       ¦" );
-    SerialDisplayDrawLine( " LED status ", " [ ]LED1(Tx) / [ ]LED2(Rx) / [ ]LED3(App)                        " );
-    // "+------------+----------------------------------------------------------------¦" );
-    SerialDisplayDrawSeparator( );
-    // "¦ Uplink     ¦ Acked              [ ]                                         ¦" );
-    SerialDisplayDrawLine( " Uplink     ", " Acked              [ ]                                          " );
-    // "¦            ¦ Datarate        [    ]                                         ¦" );
-    SerialDisplayDrawLine( "            ", " Datarate        [    ]                                          " );
-    // "¦            ¦ Counter   [          ]                                         ¦" );
-    SerialDisplayDrawLine( "            ", " Counter   [          ]                                          " );
-    // "¦            ¦ Port             [   ]                                         ¦" );
-    SerialDisplayDrawLine( "            ", " Port             [   ]                                          " );
-    // "¦            ¦ Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", " Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "+------------+----------------------------------------------------------------¦" );
-    SerialDisplayDrawSeparator( );
-    // "¦ Downlink   ¦ RSSI           [     ] dBm                                     ¦" );
-    SerialDisplayDrawLine( " Downlink   ", " RSSI           [     ] dBm                                      " );
-    // "¦ [ ]Data    ¦ SNR      [     ] dB                                            ¦" );
-    SerialDisplayDrawLine( " [ ]Data    ", " SNR            [     ] dB                                       " );
-    // "¦            ¦ Counter  [          ]                                          ¦" );
-    // "¦            ¦ Counter   [          ]                                         ¦" );
-    SerialDisplayDrawLine( "            ", " Counter   [          ]                                          " );
-    // "¦            ¦ Port             [   ]                                         ¦" );
-    SerialDisplayDrawLine( "            ", " Port             [   ]                                          " );
-    // "¦            ¦ Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", " Data      [__ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "¦            ¦            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __     ¦" );
-    SerialDisplayDrawLine( "            ", "            __ __ __ __ __ __ __ __ __ __ __ __ __ __ __ __      " );
-    // "+------------+----------------------------------------------------------------+" );
-    SerialDisplayDrawBottomLine( );
-    vt.printf( "To refresh screen please hit 'r' key.\r\n" );
 }
 
 bool SerialDisplayReadable( void )
@@ -442,3 +792,8 @@ uint8_t SerialDisplayGetChar( void )
 {
     return vt.GetChar( );
 }
+
+uint16_t SerialDisplayWrite( const uint8_t *buffer, uint16_t size )
+{
+    return vt.Write( buffer, size );
+}
@@ -16,6 +16,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 #define __SERIAL_DISPLAY_H__
 
 void SerialDisplayInit( void );
+void SerialDisplayProcess( void );
 void SerialDisplayUpdateUplink( bool acked, uint8_t datarate, uint16_t counter, uint8_t port, uint8_t *buffer, uint8_t bufferSize );
 void SerialDisplayUpdateDownlink( bool rxData, int16_t rssi, int8_t snr, uint16_t counter, uint8_t port, uint8_t *buffer, uint8_t bufferSize );
 void SerialDisplayPrintCheckBox( bool activated );
@@ -33,7 +34,11 @@ void SerialDisplayUpdateData( uint8_t *buffer );
 void SerialDisplayUpdateNetworkIsJoined( bool state );
 void SerialDisplayUpdateUplinkAcked( bool state );
 void SerialDisplayUpdateDonwlinkRxData( bool state );
+void SerialDisplayUpdateBatch( uint8_t nbRecords, uint32_t airTimeSavedPerByte );
+void SerialDisplayUpdateEnergy( uint32_t txTime, uint32_t rxTime, uint32_t charge, uint32_t totalCharge );
+void SerialDisplayUpdateBudget( uint16_t voltage, uint32_t remaining, uint32_t lifetime, uint32_t period, uint8_t depth );
 bool SerialDisplayReadable( void );
 uint8_t SerialDisplayGetChar( void );
+uint16_t SerialDisplayWrite( const uint8_t *buffer, uint16_t size );
 
 #endif // __SERIAL_DISPLAY_H__
@@ -19,6 +19,12 @@ Maintainer: Miguel Luis and Gregory Cristian
 #include "LoRaMac.h"
 #include "Commissioning.h"
 #include "SerialDisplay.h"
+#include "PayloadCodec.h"
+#include "Fragmentation.h"
+#include "NvmLog.h"
+#include "EnergyBudget.h"
+#include "HostCtrl.h"
+#include "MicroBench.h"
 
 /*!
  * Defines the application data transmission duty cycle. 5s, value in [ms].
@@ -48,6 +54,185 @@ Maintainer: Miguel Luis and Gregory Cristian
  */
 #define LORAWAN_ADR_ON                              1
 
+/*!
+ * Device side ADR, the datarate and the TX power follow the link margin
+ * measured on the downlinks and the link check answers
+ *
+ * \remark Requires LORAWAN_ADR_ON. The network ADR takes over once it sends a
+ *         LinkADRReq
+ */
+#define LORAWAN_LINK_ADR_ON                         0
+
+/*!
+ * Application records batching enable/disable
+ *
+ * \remark When enabled, a record is sampled on each application duty cycle
+ *         and the records are sent together once the frame is full or the
+ *         oldest record reaches APP_BATCH_MAX_LATENCY
+ */
+#define APP_BATCH_ON                                1
+
+/*!
+ * Maximum time a record may wait in the batch before being sent, value in [ms].
+ *
+ * \remark With APP_BUDGET_ON the budget sets the number of records per uplink
+ *         and their period. The latency bound becomes
+ *         MAX( APP_BATCH_MAX_LATENCY, Depth * Period )
+ */
+#define APP_BATCH_MAX_LATENCY                       60000
+
+/*!
+ * Size of a single application record
+ */
+#define APP_BATCH_RECORD_SIZE                       6
+
+/*!
+ * Maximum number of records kept in the batch ring buffer
+ */
+#define APP_BATCH_MAX_RECORDS                       16
+
+/*!
+ * Application records compact encoding enable/disable
+ *
+ * \remark When enabled, the batched records are delta encoded with respect to
+ *         the last record acknowledged by the network
+ */
+#define APP_PAYLOAD_CODEC_ON                        1
+
+/*!
+ * Large message fragmentation enable/disable
+ *
+ * \remark When enabled, pressing 'F' on the serial console sends a
+ *         APP_FRAG_MSG_SIZE bytes message split over several uplinks
+ */
+#define APP_FRAG_ON                                 1
+
+/*!
+ * Application port used by the message fragments
+ */
+#define APP_FRAG_PORT                               16
+
+/*!
+ * Size of the fragmented message
+ */
+#define APP_FRAG_MSG_SIZE                           512
+
+/*!
+ * Number of data fragments protected by a parity fragment
+ */
+#define APP_FRAG_PARITY_GROUP_SIZE                  4
+
+/*!
+ * Multicast fragmented download enable/disable
+ *
+ * \remark The reassembled message is staged in the last
+ *         APP_FRAG_RX_STAGING_SIZE bytes of the MCU flash
+ */
+#define APP_FRAG_RX_ON                              1
+
+/*!
+ * Application port of the multicast fragments
+ */
+#define APP_FRAG_RX_PORT                            201
+
+/*!
+ * Size of the flash staging area
+ */
+#define APP_FRAG_RX_STAGING_SIZE                    0x10000
+
+/*!
+ * Session persistence enable/disable
+ *
+ * \remark The MAC session is stored in a flash log located below the staging
+ *         area. After a reset the node resumes the session without joining
+ */
+#define APP_NVM_ON                                  1
+
+/*!
+ * Flash log page size and number of pages
+ */
+#define APP_NVM_PAGE_SIZE                           2048
+#define APP_NVM_NB_PAGES                            4
+
+/*!
+ * Class B enable/disable
+ *
+ * \remark The 'B' key starts the beacon acquisition. The node switches to
+ *         class B once the beacon is locked
+ */
+#define APP_CLASS_B_ON                              1
+
+/*!
+ * Energy budget driven scheduling enable/disable
+ *
+ * \remark When enabled, the uplink period, the frame type and the batching
+ *         depth are adapted to the battery voltage and to the measured
+ *         transaction charge in order to reach APP_BUDGET_LIFETIME
+ *
+ * \remark Requires the battery measurement, see BATTERY_MEASURE_ON. The time
+ *         elapsed since the deployment is kept across resets when APP_NVM_ON
+ *         is enabled
+ */
+#define APP_BUDGET_ON                               BATTERY_MEASURE_ON
+
+/*!
+ * Battery capacity, value in [mAh]
+ */
+#define APP_BUDGET_CAPACITY                         2400
+
+/*!
+ * Average device current outside of the radio transactions, value in [nA]
+ */
+#define APP_BUDGET_SLEEP_CURRENT                    5000
+
+/*!
+ * Default target lifetime, 5 years, value in [h]
+ */
+#define APP_BUDGET_LIFETIME                         43800
+
+/*!
+ * Longest uplink period, value in [ms]
+ */
+#define APP_BUDGET_MAX_PERIOD                       3600000
+
+/*!
+ * Application port of the target lifetime downlink. The payload holds the
+ * new target lifetime in days on 2 bytes ( big endian ), counted from the
+ * deployment
+ */
+#define APP_BUDGET_PORT                             3
+
+/*!
+ * Event trace and log output enable/disable
+ *
+ * \remark The trace records, the log messages and the MAC inputs capture are
+ *         drained on a dedicated UART in the main loop. tools/trace_decode.py,
+ *         tools/log_decode.py and tools/capture_decode.py render them on the
+ *         host
+ */
+#define APP_TRACE_ON                                1
+
+/*!
+ * Event trace UART pins and baudrate
+ */
+#define APP_TRACE_TX                                PC_10
+#define APP_TRACE_RX                                PC_11
+#define APP_TRACE_BAUDRATE                          115200
+
+/*!
+ * Maximum number of trace records drained per main loop iteration
+ */
+#define APP_TRACE_DRAIN_SIZE                        8
+
+/*!
+ * Binary host control enable/disable
+ *
+ * \remark Once a host frame is received, the application stops its own uplinks
+ *         and the display updates. The 'R' key gives the control back to the
+ *         application. tools/hostctrl.py implements the host side
+ */
+#define APP_HOST_CTRL_ON                            1
+
 #if defined( USE_BAND_868 )
 
 #include "LoRaMacTest.h"
@@ -232,6 +417,300 @@ struct sLoRaMacDownlinkStatus
 }LoRaMacDownlinkStatus;
 volatile bool DownlinkStatusUpdated = false;
 
+/*!
+ * Copy of the last downlink payload shown by the serial display. The MAC
+ * frees the indicated buffer when the indication callback returns
+ */
+static uint8_t DownlinkData[LORAWAN_APP_DATA_MAX_SIZE];
+
+#if( APP_BATCH_ON == 1 )
+
+/*!
+ * Application record
+ */
+typedef struct sBatchRecord
+{
+    TimerTime_t Time;
+    uint8_t Data[APP_BATCH_RECORD_SIZE];
+}BatchRecord_t;
+
+/*!
+ * Strucure containing the application records batch
+ */
+struct sBatch
+{
+    BatchRecord_t Records[APP_BATCH_MAX_RECORDS];
+    uint8_t Head;
+    uint8_t Count;
+    uint8_t NbRecordsInFrame;
+    TimerTime_t FrameAirTimeSaved;
+    uint32_t AirTimeSaved;
+    uint32_t DeliveredBytes;
+}Batch;
+volatile bool BatchStatusUpdated = false;
+
+#if( APP_PAYLOAD_CODEC_ON == 1 )
+
+/*!
+ * Number of fields of an application record
+ */
+#define APP_RECORD_NB_FIELDS                        4
+
+/*!
+ * Application record fields encoding. LED state, downlink counter, RSSI, SNR
+ */
+static const PayloadCodecField_t AppRecordFields[APP_RECORD_NB_FIELDS] =
+{
+    { PAYLOAD_CODEC_BITS, 1 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+};
+
+/*!
+ * Application records encoder
+ */
+static PayloadCodec_t AppCodec;
+
+#endif
+
+#endif
+
+#if( APP_FRAG_ON == 1 )
+
+/*!
+ * Fragmented message buffer
+ */
+static uint8_t AppFragMsg[APP_FRAG_MSG_SIZE];
+
+/*!
+ * \brief   Starts the transfer of the fragmented message
+ */
+static void FragStartMessage( void )
+{
+    // Test pattern, the receiver checks the message integrity
+    for( uint16_t i = 0; i < APP_FRAG_MSG_SIZE; i++ )
+    {
+        AppFragMsg[i] = i & 0xFF;
+    }
+    FragTxStart( AppFragMsg, APP_FRAG_MSG_SIZE, APP_FRAG_PORT, APP_FRAG_PARITY_GROUP_SIZE );
+}
+
+#endif
+
+#if( APP_FRAG_RX_ON == 1 )
+
+/*!
+ * Multicast channel of the fragmented downloads
+ */
+static MulticastParams_t AppMcChannel = { LORAWAN_MC_ADDRESS, LORAWAN_MC_NWKSKEY, LORAWAN_MC_APPSKEY, 0 };
+
+/*!
+ * Staging area start address
+ */
+static uint32_t AppStagingAddress;
+
+/*!
+ * \brief   Flash staging area access functions. offset is relative to the
+ *          staging area start address
+ */
+static bool AppStagingErase( uint32_t offset, uint32_t size )
+{
+    return BoardFlashErase( AppStagingAddress + offset, size );
+}
+
+static bool AppStagingWrite( uint32_t offset, const uint8_t *buffer, uint32_t size )
+{
+    return BoardFlashWrite( AppStagingAddress + offset, buffer, size );
+}
+
+static bool AppStagingRead( uint32_t offset, uint8_t *buffer, uint32_t size )
+{
+    return BoardFlashRead( AppStagingAddress + offset, buffer, size );
+}
+
+/*!
+ * Flash staging area access functions
+ */
+static FragRxCallbacks_t AppStagingCallbacks = { AppStagingErase, AppStagingWrite, AppStagingRead };
+
+#endif
+
+#if( APP_NVM_ON == 1 )
+
+/*!
+ * Flash log start address
+ */
+static uint32_t AppNvmAddress;
+
+/*!
+ * Non-volatile application state. The MAC session comes first, its counters
+ * change on every transaction
+ */
+typedef struct sAppNvmImage
+{
+    /*!
+     * MAC session, valid when IsJoined is set
+     */
+    LoRaMacSession_t Session;
+#if( APP_BUDGET_ON == 1 )
+    /*!
+     * Energy budget target lifetime and time elapsed since the deployment [h]
+     */
+    uint32_t BudgetLifetime;
+    uint32_t BudgetElapsedHours;
+#endif
+    /*!
+     * DevNonce of the next join request
+     */
+    uint16_t DevNonce;
+    /*!
+     * Set when the node was joined
+     */
+    uint8_t IsJoined;
+}AppNvmImage_t;
+
+/*!
+ * Last stored application state
+ */
+static AppNvmImage_t AppNvm;
+
+/*!
+ * Indicates if the MAC session has changed and must be stored
+ */
+static volatile bool AppNvmUpdate = false;
+
+/*!
+ * \brief   Flash log access functions. offset is relative to the log start
+ *          address
+ */
+static bool AppNvmErase( uint32_t offset, uint32_t size )
+{
+    return BoardFlashErase( AppNvmAddress + offset, size );
+}
+
+static bool AppNvmWrite( uint32_t offset, const uint8_t *buffer, uint32_t size )
+{
+    return BoardFlashWrite( AppNvmAddress + offset, buffer, size );
+}
+
+static bool AppNvmRead( uint32_t offset, uint8_t *buffer, uint32_t size )
+{
+    return BoardFlashRead( AppNvmAddress + offset, buffer, size );
+}
+
+/*!
+ * Flash log access functions
+ */
+static NvmLogCallbacks_t AppNvmCallbacks = { AppNvmErase, AppNvmWrite, AppNvmRead };
+
+/*!
+ * \brief   Stores the MAC session and the join state. Only the bytes which
+ *          changed since the last call are written
+ *
+ * \param   [IN] isJoining Set right before a join request. The DevNonce the
+ *                         request is about to use is stored as used
+ */
+static void AppNvmStore( bool isJoining )
+{
+    AppNvmImage_t image;
+    MibRequestConfirm_t mibReq;
+
+    // Clear the structure padding so that it never shows up as a change
+    memset1( ( uint8_t* )&image, 0, sizeof( image ) );
+    image.IsJoined = ( LoRaMacSessionGet( &image.Session ) == LORAMAC_STATUS_OK ) ? 1 : 0;
+
+    mibReq.Type = MIB_DEV_NONCE;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    image.DevNonce = mibReq.Param.DevNonce + ( ( isJoining == true ) ? 1 : 0 );
+#if( APP_BUDGET_ON == 1 )
+    image.BudgetLifetime = EnergyBudgetGetStats( )->Lifetime;
+    image.BudgetElapsedHours = EnergyBudgetGetStats( )->ElapsedHours;
+#endif
+
+    NvmLogUpdate( ( uint8_t* )&image );
+}
+
+#endif
+
+#if( APP_BUDGET_ON == 1 )
+
+/*!
+ * Energy budget parameters
+ */
+static const EnergyBudgetParams_t AppBudgetParams =
+{
+    APP_BUDGET_CAPACITY,
+    BATTERY_MAX_LEVEL,
+    BATTERY_SHUTDOWN_LEVEL,
+    APP_BUDGET_SLEEP_CURRENT,
+    APP_BUDGET_LIFETIME,
+    APP_TX_DUTYCYCLE,
+    APP_BUDGET_MAX_PERIOD,
+    APP_BATCH_MAX_RECORDS,
+};
+
+/*!
+ * Current uplink policy
+ */
+static const EnergyBudgetPolicy_t *AppBudgetPolicy;
+volatile bool BudgetStatusUpdated = false;
+
+#endif
+
+#if( APP_TRACE_ON == 1 ) && ( ( TRACE_ON == 1 ) || ( LOG_ON == 1 ) || ( CAPTURE_ON == 1 ) )
+
+/*!
+ * Event trace UART
+ */
+static RawSerial AppTraceSerial( APP_TRACE_TX, APP_TRACE_RX, APP_TRACE_BAUDRATE );
+
+#if( CAPTURE_ON == 1 )
+/*!
+ * Capture drain buffer, holds the largest record
+ */
+static uint8_t AppCaptureBuffer[CAPTURE_FRAME_SIZE( CAPTURE_MAX_DATA_SIZE )];
+#endif
+
+/*!
+ * \brief   Sends the pending trace records, log messages and captured MAC
+ *          inputs
+ */
+static void AppTraceProcess( void )
+{
+    uint8_t buffer[APP_TRACE_DRAIN_SIZE * TRACE_FRAME_SIZE];
+    uint16_t size = 0;
+
+#if( TRACE_ON == 1 )
+    size = TraceDrain( buffer, sizeof( buffer ) );
+#endif
+#if( LOG_ON == 1 )
+    size += LogDrain( buffer + size, sizeof( buffer ) - size );
+#endif
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        AppTraceSerial.putc( buffer[i] );
+    }
+#if( CAPTURE_ON == 1 )
+    size = CaptureDrain( AppCaptureBuffer, sizeof( AppCaptureBuffer ) );
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        AppTraceSerial.putc( AppCaptureBuffer[i] );
+    }
+#endif
+}
+
+#endif
+
+#if( PROFILE_ON == 1 ) && ( LOG_ON == 1 )
+
+/*!
+ * Next profiled region to print. PROFILE_NB_REGIONS when idle
+ */
+static uint8_t AppProfileDump = PROFILE_NB_REGIONS;
+
+#endif
+
 void SerialDisplayRefresh( void )
 {
     MibRequestConfirm_t mibReq;
@@ -266,21 +745,299 @@ void SerialDisplayRefresh( void )
 
 void SerialRxProcess( void )
 {
-    if( SerialDisplayReadable( ) == true )
+    uint8_t c;
+
+    while( SerialDisplayReadable( ) == true )
     {
-        switch( SerialDisplayGetChar( ) )
+        c = SerialDisplayGetChar( );
+#if( APP_HOST_CTRL_ON == 1 )
+        if( HostCtrlOnChar( c ) == true )
+        {
+            // Host control frame
+            continue;
+        }
+#endif
+        switch( c )
         {
             case 'R':
             case 'r':
+#if( APP_HOST_CTRL_ON == 1 )
+                if( HostCtrlIsActive( ) == true )
+                {
+                    // Resume the application uplinks
+                    HostCtrlStop( );
+                    DeviceState = DEVICE_STATE_CYCLE;
+                }
+#endif
                 // Refresh Serial screen
                 SerialDisplayRefresh( );
                 break;
+#if( APP_FRAG_ON == 1 )
+            case 'F':
+            case 'f':
+                // Send the fragmented message
+                if( ComplianceTest.Running == false )
+                {
+                    FragStartMessage( );
+                }
+                break;
+#endif
+#if( PROFILE_ON == 1 ) && ( LOG_ON == 1 )
+            case 'P':
+            case 'p':
+                // Print the profiler statistics to the log
+                AppProfileDump = 0;
+                break;
+            case 'M':
+            case 'm':
+                // The benchmark shares the crypto contexts with the MAC
+                if( ( NextTx == true ) && ( MicroBenchIsRunning( ) == false ) )
+                {
+                    MicroBenchStart( );
+                }
+                break;
+#endif
+#if( APP_CLASS_B_ON == 1 ) && defined( USE_BAND_868 )
+            case 'B':
+            case 'b':
+            {
+                MlmeReq_t mlmeReq;
+
+                // Start the beacon acquisition
+                mlmeReq.Type = MLME_BEACON_ACQUISITION;
+                LoRaMacMlmeRequest( &mlmeReq );
+                break;
+            }
+#endif
             default:
                 break;
         }
     }
 }
 
+#if( APP_BATCH_ON == 1 )
+
+/*!
+ * \brief   Indicates if the application records are batched
+ *
+ * \retval  [true: records are batched, false: one frame per record]
+ */
+static bool BatchIsActive( void )
+{
+    return ( ComplianceTest.Running == false ) && ( AppPort == LORAWAN_APP_PORT );
+}
+
+/*!
+ * \brief   Samples a new record into the batch ring buffer. When the buffer
+ *          is full, the oldest record is dropped
+ */
+static void BatchPushRecord( void )
+{
+    BatchRecord_t *record;
+
+    if( Batch.Count == APP_BATCH_MAX_RECORDS )
+    {
+        Batch.Head = ( Batch.Head + 1 ) % APP_BATCH_MAX_RECORDS;
+        Batch.Count--;
+    }
+    record = &Batch.Records[( Batch.Head + Batch.Count ) % APP_BATCH_MAX_RECORDS];
+    Batch.Count++;
+
+    record->Time = TimerGetCurrentTime( );
+    record->Data[0] = AppLedStateOn;
+    record->Data[1] = LoRaMacDownlinkStatus.DownlinkCounter >> 8;
+    record->Data[2] = LoRaMacDownlinkStatus.DownlinkCounter;
+    record->Data[3] = LoRaMacDownlinkStatus.Rssi >> 8;
+    record->Data[4] = LoRaMacDownlinkStatus.Rssi;
+    record->Data[5] = LoRaMacDownlinkStatus.Snr;
+
+    BatchStatusUpdated = true;
+}
+
+/*!
+ * \brief   Computes the maximum applicative payload of the next frame
+ *
+ * \retval  Maximum payload for the datarate the MAC will use
+ */
+static uint8_t BatchGetMaxPayload( void )
+{
+    LoRaMacTxPlan_t txPlan;
+
+    if( LoRaMacQueryTxPlan( 0, &txPlan ) != LORAMAC_STATUS_OK )
+    {
+        return APP_BATCH_RECORD_SIZE;
+    }
+    return MIN( txPlan.Entries[txPlan.CurrentDatarate - LORAMAC_TX_MIN_DATARATE].MaxPossiblePayload, LORAWAN_APP_DATA_MAX_SIZE );
+}
+
+#if( APP_PAYLOAD_CODEC_ON == 1 )
+
+/*!
+ * \brief   Encodes the oldest records which fit into the buffer
+ *
+ * \param   [IN]  codec   Encoder context
+ * \param   [IN]  buffer  Frame buffer
+ * \param   [IN]  maxSize Frame buffer size
+ * \param   [OUT] size    Encoded frame size
+ *
+ * \retval  Number of encoded records
+ */
+static uint8_t BatchEncode( PayloadCodec_t *codec, uint8_t *buffer, uint8_t maxSize, uint8_t *size )
+{
+    MibRequestConfirm_t mibReq;
+    int32_t values[APP_RECORD_NB_FIELDS];
+    uint8_t *data;
+    uint8_t nbRecords = 0;
+
+    // The frame refers to the reference frame by the uplink counter distance
+    mibReq.Type = MIB_UPLINK_COUNTER;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    PayloadCodecBeginFrame( codec, mibReq.Param.UpLinkCounter, buffer, maxSize );
+    for( nbRecords = 0; nbRecords < Batch.Count; nbRecords++ )
+    {
+        data = Batch.Records[( Batch.Head + nbRecords ) % APP_BATCH_MAX_RECORDS].Data;
+        values[0] = data[0];
+        values[1] = ( uint16_t )( ( data[1] << 8 ) | data[2] );
+        values[2] = ( int16_t )( ( data[3] << 8 ) | data[4] );
+        values[3] = ( int8_t )data[5];
+        if( PayloadCodecAppend( codec, values ) == false )
+        {
+            break;
+        }
+    }
+    *size = PayloadCodecEndFrame( codec );
+    return nbRecords;
+}
+
+#else
+
+/*!
+ * \brief   Computes the number of records which fit into the next frame
+ *
+ * \retval  Maximum number of records for the datarate the MAC will use
+ */
+static uint8_t BatchGetMaxRecords( void )
+{
+    return MAX( BatchGetMaxPayload( ) / APP_BATCH_RECORD_SIZE, 1 );
+}
+
+#endif
+
+/*!
+ * \brief   Checks if the frame is full. The encoded records fill the maximum
+ *          payload or do not all fit
+ *
+ * \retval  [true: the frame is full, false: there is room for more records]
+ */
+static bool BatchIsFrameFull( void )
+{
+#if( APP_PAYLOAD_CODEC_ON == 1 )
+    PayloadCodec_t codec = AppCodec;
+    uint8_t buffer[LORAWAN_APP_DATA_MAX_SIZE];
+    uint8_t maxSize = BatchGetMaxPayload( );
+    uint8_t size = 0;
+
+    // Dry run on a copy of the encoder, the records are encoded again once
+    // the frame is sent
+    return ( BatchEncode( &codec, buffer, maxSize, &size ) < Batch.Count ) || ( size >= maxSize );
+#else
+    return Batch.Count >= BatchGetMaxRecords( );
+#endif
+}
+
+/*!
+ * \brief   Checks if the batch has to be sent
+ *
+ * \retval  [true: the frame is full or the latency deadline expired, false: keep batching]
+ */
+static bool BatchFlushRequired( void )
+{
+    if( Batch.Count == 0 )
+    {
+        return false;
+    }
+    if( BatchIsFrameFull( ) == true )
+    {
+        return true;
+    }
+#if( APP_BUDGET_ON == 1 )
+    // The budget sets the number of records per uplink, the latency grows
+    // with it
+    if( Batch.Count >= AppBudgetPolicy->Depth )
+    {
+        return true;
+    }
+    if( TimerGetElapsedTime( Batch.Records[Batch.Head].Time ) >= MAX( APP_BATCH_MAX_LATENCY, AppBudgetPolicy->Depth * AppBudgetPolicy->Period ) )
+    {
+        return true;
+    }
+#else
+    if( TimerGetElapsedTime( Batch.Records[Batch.Head].Time ) >= APP_BATCH_MAX_LATENCY )
+    {
+        return true;
+    }
+#endif
+    return false;
+}
+
+/*!
+ * \brief   Copies the oldest records into the application data buffer and
+ *          computes the airtime saved compared to one frame per record
+ */
+static void BatchPrepareFrame( void )
+{
+    LoRaMacTxPlan_t txPlan;
+    TimerTime_t recordsAirTime = 0;
+    TimerTime_t frameAirTime = 0;
+#if( APP_PAYLOAD_CODEC_ON == 0 )
+    uint8_t index = 0;
+#endif
+
+    Batch.FrameAirTimeSaved = 0;
+
+#if( APP_PAYLOAD_CODEC_ON == 1 )
+    Batch.NbRecordsInFrame = BatchEncode( &AppCodec, AppData, BatchGetMaxPayload( ), &AppDataSize );
+#else
+    Batch.NbRecordsInFrame = MIN( Batch.Count, BatchGetMaxRecords( ) );
+    for( uint8_t i = 0; i < Batch.NbRecordsInFrame; i++ )
+    {
+        index = ( Batch.Head + i ) % APP_BATCH_MAX_RECORDS;
+        memcpy1( AppData + ( i * APP_BATCH_RECORD_SIZE ), Batch.Records[index].Data, APP_BATCH_RECORD_SIZE );
+    }
+    AppDataSize = Batch.NbRecordsInFrame * APP_BATCH_RECORD_SIZE;
+#endif
+
+    if( LoRaMacQueryTxPlan( APP_BATCH_RECORD_SIZE, &txPlan ) == LORAMAC_STATUS_OK )
+    {
+        recordsAirTime = txPlan.Entries[txPlan.CurrentDatarate - LORAMAC_TX_MIN_DATARATE].TimeOnAir * Batch.NbRecordsInFrame;
+        if( LoRaMacQueryTxPlan( AppDataSize, &txPlan ) == LORAMAC_STATUS_OK )
+        {
+            frameAirTime = txPlan.Entries[txPlan.CurrentDatarate - LORAMAC_TX_MIN_DATARATE].TimeOnAir;
+            if( recordsAirTime > frameAirTime )
+            {
+                Batch.FrameAirTimeSaved = recordsAirTime - frameAirTime;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief   Removes the records handed over to the MAC layer from the batch
+ */
+static void BatchCommit( void )
+{
+    Batch.Head = ( Batch.Head + Batch.NbRecordsInFrame ) % APP_BATCH_MAX_RECORDS;
+    Batch.Count -= Batch.NbRecordsInFrame;
+    Batch.DeliveredBytes += Batch.NbRecordsInFrame * APP_BATCH_RECORD_SIZE;
+    Batch.AirTimeSaved += Batch.FrameAirTimeSaved;
+    Batch.NbRecordsInFrame = 0;
+    Batch.FrameAirTimeSaved = 0;
+
+    BatchStatusUpdated = true;
+}
+
+#endif
+
 /*!
  * \brief   Prepares the payload of the frame
  */
@@ -290,6 +1047,13 @@ static void PrepareTxFrame( uint8_t port )
     {
     case 15:
         {
+#if( APP_BATCH_ON == 1 )
+            if( BatchIsActive( ) == true )
+            {
+                BatchPrepareFrame( );
+                break;
+            }
+#endif
             AppData[0] = AppLedStateOn;
             if( IsTxConfirmed == true )
             {
@@ -349,6 +1113,13 @@ static bool SendFrame( void )
         mcpsReq.Req.Unconfirmed.fBufferSize = 0;
         mcpsReq.Req.Unconfirmed.Datarate = LORAWAN_DEFAULT_DATARATE;
 
+#if( APP_BATCH_ON == 1 )
+        // The records stay in the batch
+        Batch.NbRecordsInFrame = 0;
+#if( APP_PAYLOAD_CODEC_ON == 1 )
+        PayloadCodecCancel( &AppCodec );
+#endif
+#endif
         LoRaMacUplinkStatus.Acked = false;
         LoRaMacUplinkStatus.Port = 0;
         LoRaMacUplinkStatus.Buffer = NULL;
@@ -384,8 +1155,17 @@ static bool SendFrame( void )
 
     if( LoRaMacMcpsRequest( &mcpsReq ) == LORAMAC_STATUS_OK )
     {
+#if( APP_BATCH_ON == 1 )
+        BatchCommit( );
+#endif
         return false;
     }
+#if( APP_BATCH_ON == 1 )
+    Batch.NbRecordsInFrame = 0;
+#if( APP_PAYLOAD_CODEC_ON == 1 )
+    PayloadCodecCancel( &AppCodec );
+#endif
+#endif
     return true;
 }
 
@@ -446,6 +1226,9 @@ static void OnLed2TimerEvent( void )
  */
 static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
 {
+#if( APP_HOST_CTRL_ON == 1 )
+    HostCtrlOnMcpsConfirm( mcpsConfirm );
+#endif
     if( mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
     {
         switch( mcpsConfirm->McpsRequest )
@@ -463,6 +1246,13 @@ static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
                 // Check AckReceived
                 // Check NbTrials
                 LoRaMacUplinkStatus.Acked = mcpsConfirm->AckReceived;
+#if( APP_BATCH_ON == 1 ) && ( APP_PAYLOAD_CODEC_ON == 1 )
+                if( mcpsConfirm->AckReceived == true )
+                {
+                    // The network holds the last record of the frame
+                    PayloadCodecConfirm( &AppCodec, mcpsConfirm->UpLinkCounter );
+                }
+#endif
                 break;
             }
             case MCPS_PROPRIETARY:
@@ -482,6 +1272,23 @@ static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
 
         UplinkStatusUpdated = true;
     }
+#if( APP_FRAG_ON == 1 )
+    FragTxOnMcpsConfirm( mcpsConfirm );
+#endif
+#if( APP_NVM_ON == 1 )
+    // The uplink counter has been incremented
+    AppNvmUpdate = true;
+#endif
+#if( APP_BUDGET_ON == 1 )
+    {
+        MibRequestConfirm_t mibReq;
+
+        // The energy of the transaction is available before its confirm
+        mibReq.Type = MIB_ENERGY;
+        LoRaMacMibGetRequestConfirm( &mibReq );
+        EnergyBudgetOnTransaction( mibReq.Param.Energy );
+    }
+#endif
     NextTx = true;
 }
 
@@ -493,10 +1300,17 @@ static void McpsConfirm( McpsConfirm_t *mcpsConfirm )
  */
 static void McpsIndication( McpsIndication_t *mcpsIndication )
 {
+#if( APP_HOST_CTRL_ON == 1 )
+    HostCtrlOnMcpsIndication( mcpsIndication );
+#endif
     if( mcpsIndication->Status != LORAMAC_EVENT_INFO_STATUS_OK )
     {
         return;
     }
+#if( APP_NVM_ON == 1 )
+    // The downlink counter has been updated
+    AppNvmUpdate = true;
+#endif
 
     switch( mcpsIndication->McpsIndication )
     {
@@ -514,6 +1328,9 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
         }
         case MCPS_MULTICAST:
         {
+#if( APP_FRAG_RX_ON == 1 )
+            FragRxOnMcpsIndication( mcpsIndication );
+#endif
             break;
         }
         default:
@@ -544,8 +1361,9 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
     LoRaMacDownlinkStatus.DownlinkCounter++;
     LoRaMacDownlinkStatus.RxData = mcpsIndication->RxData;
     LoRaMacDownlinkStatus.Port = mcpsIndication->Port;
-    LoRaMacDownlinkStatus.Buffer = mcpsIndication->Buffer;
-    LoRaMacDownlinkStatus.BufferSize = mcpsIndication->BufferSize;
+    LoRaMacDownlinkStatus.BufferSize = MIN( mcpsIndication->BufferSize, sizeof( DownlinkData ) );
+    memcpy1( DownlinkData, mcpsIndication->Buffer, LoRaMacDownlinkStatus.BufferSize );
+    LoRaMacDownlinkStatus.Buffer = DownlinkData;
 
     if( ComplianceTest.Running == true )
     {
@@ -564,6 +1382,17 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
                 Led3StateChanged = true;
             }
             break;
+#if( APP_BUDGET_ON == 1 )
+        case APP_BUDGET_PORT:
+            if( mcpsIndication->BufferSize == 2 )
+            {
+                EnergyBudgetSetLifetime( ( ( mcpsIndication->Buffer[0] << 8 ) | mcpsIndication->Buffer[1] ) * 24 );
+#if( APP_NVM_ON == 1 )
+                AppNvmUpdate = true;
+#endif
+            }
+            break;
+#endif
         case 224:
             if( ComplianceTest.Running == false )
             {
@@ -589,6 +1418,11 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
                     mibReq.Param.AdrEnable = true;
                     LoRaMacMibSetRequestConfirm( &mibReq );
 
+                    // The test house drives the datarate
+                    mibReq.Type = MIB_LINK_ADR;
+                    mibReq.Param.LinkAdrEnable = false;
+                    LoRaMacMibSetRequestConfirm( &mibReq );
+
 #if defined( USE_BAND_868 )
                     LoRaMacTestSetDutyCycleOn( false );
 #endif
@@ -610,6 +1444,10 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
                     mibReq.Type = MIB_ADR;
                     mibReq.Param.AdrEnable = LORAWAN_ADR_ON;
                     LoRaMacMibSetRequestConfirm( &mibReq );
+
+                    mibReq.Type = MIB_LINK_ADR;
+                    mibReq.Param.LinkAdrEnable = LORAWAN_LINK_ADR_ON;
+                    LoRaMacMibSetRequestConfirm( &mibReq );
 #if defined( USE_BAND_868 )
                     LoRaMacTestSetDutyCycleOn( LORAWAN_DUTYCYCLE_ON );
 #endif
@@ -656,6 +1494,10 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
                         mibReq.Type = MIB_ADR;
                         mibReq.Param.AdrEnable = LORAWAN_ADR_ON;
                         LoRaMacMibSetRequestConfirm( &mibReq );
+
+                        mibReq.Type = MIB_LINK_ADR;
+                        mibReq.Param.LinkAdrEnable = LORAWAN_LINK_ADR_ON;
+                        LoRaMacMibSetRequestConfirm( &mibReq );
 #if defined( USE_BAND_868 )
                         LoRaMacTestSetDutyCycleOn( LORAWAN_DUTYCYCLE_ON );
 #endif
@@ -667,6 +1509,9 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
                         mlmeReq.Req.Join.AppKey = AppKey;
                         mlmeReq.Req.Join.NbTrials = 3;
 
+#if( APP_NVM_ON == 1 )
+                        AppNvmStore( true );
+#endif
                         LoRaMacMlmeRequest( &mlmeReq );
                         DeviceState = DEVICE_STATE_SLEEP;
                     }
@@ -717,6 +1562,9 @@ static void McpsIndication( McpsIndication_t *mcpsIndication )
  */
 static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
 {
+#if( APP_HOST_CTRL_ON == 1 )
+    HostCtrlOnMlmeConfirm( mlmeConfirm );
+#endif
     switch( mlmeConfirm->MlmeRequest )
     {
         case MLME_JOIN:
@@ -725,6 +1573,14 @@ static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
             {
                 // Status is OK, node has joined the network
                 IsNetworkJoinedStatusUpdate = true;
+#if( APP_BATCH_ON == 1 ) && ( APP_PAYLOAD_CODEC_ON == 1 )
+                // The uplink counter restarts, drop the reference record
+                PayloadCodecReset( &AppCodec );
+#endif
+#if( APP_NVM_ON == 1 )
+                // New session keys and counters
+                AppNvmUpdate = true;
+#endif
                 DeviceState = DEVICE_STATE_SEND;
             }
             else
@@ -756,6 +1612,42 @@ static void MlmeConfirm( MlmeConfirm_t *mlmeConfirm )
     UplinkStatusUpdated = true;
 }
 
+/*!
+ * \brief   MLME-Indication event function
+ *
+ * \param   [IN] mlmeIndication - Pointer to the indication structure,
+ *               containing indication attributes.
+ */
+static void MlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+    MibRequestConfirm_t mibReq;
+
+#if( APP_HOST_CTRL_ON == 1 )
+    HostCtrlOnMlmeIndication( mlmeIndication );
+#endif
+    switch( mlmeIndication->MlmeIndication )
+    {
+        case MLME_BEACON:
+        {
+            if( mlmeIndication->Status == LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED )
+            {
+                mibReq.Type = MIB_DEVICE_CLASS;
+                LoRaMacMibGetRequestConfirm( &mibReq );
+                if( mibReq.Param.Class != CLASS_B )
+                {
+                    // Switch to class B once the beacon is locked
+                    mibReq.Param.Class = CLASS_B;
+                    LoRaMacMibSetRequestConfirm( &mibReq );
+                }
+            }
+            // On BEACON_LOST the MAC layer reverted to class A
+            break;
+        }
+        default:
+            break;
+    }
+}
+
 /**
  * Main application entry point.
  */
@@ -781,9 +1673,21 @@ int main( void )
 
     DeviceState = DEVICE_STATE_INIT;
 
+#if( APP_HOST_CTRL_ON == 1 )
+    HostCtrlInit( SerialDisplayWrite );
+#endif
+
     while( 1 )
     {
         SerialRxProcess( );
+#if( APP_HOST_CTRL_ON == 1 )
+        HostCtrlProcess( );
+        if( HostCtrlIsActive( ) == false )
+#endif
+        {
+            // The screen updates would corrupt the host frames
+            SerialDisplayProcess( );
+        }
         if( IsNetworkJoinedStatusUpdate == true )
         {
             IsNetworkJoinedStatusUpdate = false;
@@ -810,6 +1714,10 @@ int main( void )
         {
             UplinkStatusUpdated = false;
             SerialDisplayUpdateUplink( LoRaMacUplinkStatus.Acked, LoRaMacUplinkStatus.Datarate, LoRaMacUplinkStatus.UplinkCounter, LoRaMacUplinkStatus.Port, LoRaMacUplinkStatus.Buffer, LoRaMacUplinkStatus.BufferSize );
+
+            mibReq.Type = MIB_ENERGY;
+            LoRaMacMibGetRequestConfirm( &mibReq );
+            SerialDisplayUpdateEnergy( mibReq.Param.Energy->TxTime, mibReq.Param.Energy->RxTime, mibReq.Param.Energy->Charge, mibReq.Param.Energy->TotalCharge );
         }
         if( DownlinkStatusUpdated == true )
         {
@@ -817,6 +1725,71 @@ int main( void )
             SerialDisplayUpdateLedState( 2, Led2State );
             SerialDisplayUpdateDownlink( LoRaMacDownlinkStatus.RxData, LoRaMacDownlinkStatus.Rssi, LoRaMacDownlinkStatus.Snr, LoRaMacDownlinkStatus.DownlinkCounter, LoRaMacDownlinkStatus.Port, LoRaMacDownlinkStatus.Buffer, LoRaMacDownlinkStatus.BufferSize );
         }
+#if( APP_BATCH_ON == 1 )
+        if( BatchStatusUpdated == true )
+        {
+            BatchStatusUpdated = false;
+            SerialDisplayUpdateBatch( Batch.Count, ( Batch.DeliveredBytes != 0 ) ? ( uint32_t )( ( ( uint64_t )Batch.AirTimeSaved * 1000 ) / Batch.DeliveredBytes ) : 0 );
+        }
+#endif
+#if( APP_FRAG_ON == 1 )
+        if( NextTx == true )
+        {
+            FragTxProcess( );
+        }
+#endif
+#if( APP_FRAG_RX_ON == 1 )
+        FragRxProcess( );
+        if( FragRxGetStatus( ) == FRAG_STATUS_DONE )
+        {
+            const FragRxStats_t *stats = FragRxGetStats( );
+
+            // The demo has no use for the staged message. An application
+            // consumes it before releasing the staging area
+            LOG_INFO( APP, "Download %u: %u bytes, %u fragments recovered\n", stats->SessionId, stats->Size, stats->NbRecovered );
+            FragRxRelease( );
+        }
+#endif
+#if( APP_NVM_ON == 1 )
+        if( AppNvmUpdate == true )
+        {
+            AppNvmUpdate = false;
+            AppNvmStore( false );
+        }
+#endif
+#if( APP_TRACE_ON == 1 ) && ( ( TRACE_ON == 1 ) || ( LOG_ON == 1 ) || ( CAPTURE_ON == 1 ) )
+        AppTraceProcess( );
+#endif
+#if( PROFILE_ON == 1 ) && ( LOG_ON == 1 )
+        if( MicroBenchProcess( ) == true )
+        {
+            // Followed by the MAC internal paths measured by the profiler
+            AppProfileDump = 0;
+        }
+        // One region at a time, the log ring holds the statistics of one region
+        if( ( AppProfileDump < PROFILE_NB_REGIONS ) && ( LogIsEmpty( ) == true ) )
+        {
+            ProfileDump( ( ProfileRegion_t )AppProfileDump++ );
+        }
+#endif
+#if( APP_BUDGET_ON == 1 )
+        if( BudgetStatusUpdated == true )
+        {
+            const EnergyBudgetStats_t *stats = EnergyBudgetGetStats( );
+
+            BudgetStatusUpdated = false;
+            SerialDisplayUpdateBudget( stats->Voltage, stats->Remaining / 1000, stats->RemainingLifetime / 24, AppBudgetPolicy->Period, AppBudgetPolicy->Depth );
+        }
+#endif
+#if( APP_HOST_CTRL_ON == 1 )
+        if( ( HostCtrlIsActive( ) == true ) && ( DeviceState != DEVICE_STATE_INIT ) )
+        {
+            // The host drives the MAC layer
+            TimerStop( &TxNextPacketTimer );
+            DeviceState = DEVICE_STATE_SLEEP;
+            continue;
+        }
+#endif
         
         switch( DeviceState )
         {
@@ -825,6 +1798,7 @@ int main( void )
                 LoRaMacPrimitives.MacMcpsConfirm = McpsConfirm;
                 LoRaMacPrimitives.MacMcpsIndication = McpsIndication;
                 LoRaMacPrimitives.MacMlmeConfirm = MlmeConfirm;
+                LoRaMacPrimitives.MacMlmeIndication = MlmeIndication;
                 LoRaMacCallbacks.GetBatteryLevel = BoardGetBatteryLevel;
                 LoRaMacInitialization( &LoRaMacPrimitives, &LoRaMacCallbacks );
 
@@ -840,10 +1814,20 @@ int main( void )
                 mibReq.Param.AdrEnable = LORAWAN_ADR_ON;
                 LoRaMacMibSetRequestConfirm( &mibReq );
 
+                mibReq.Type = MIB_LINK_ADR;
+                mibReq.Param.LinkAdrEnable = LORAWAN_LINK_ADR_ON;
+                LoRaMacMibSetRequestConfirm( &mibReq );
+
                 mibReq.Type = MIB_PUBLIC_NETWORK;
                 mibReq.Param.EnablePublicNetwork = LORAWAN_PUBLIC_NETWORK;
                 LoRaMacMibSetRequestConfirm( &mibReq );
 
+#if( APP_FRAG_RX_ON == 1 )
+                AppStagingAddress = BoardFlashGetEnd( ) - APP_FRAG_RX_STAGING_SIZE;
+                FragRxInit( &AppStagingCallbacks, APP_FRAG_RX_STAGING_SIZE, APP_FRAG_RX_PORT );
+                LoRaMacMulticastChannelLink( &AppMcChannel );
+#endif
+
 #if defined( USE_BAND_868 )
                 LoRaMacTestSetDutyCycleOn( LORAWAN_DUTYCYCLE_ON );
                 SerialDisplayUpdateDutyCycle( LORAWAN_DUTYCYCLE_ON );
@@ -873,7 +1857,43 @@ int main( void )
 
                 LoRaMacDownlinkStatus.DownlinkCounter = 0;
 
+#if( APP_BATCH_ON == 1 ) && ( APP_PAYLOAD_CODEC_ON == 1 )
+                PayloadCodecInit( &AppCodec, AppRecordFields, APP_RECORD_NB_FIELDS );
+#endif
+#if( APP_BUDGET_ON == 1 )
+                EnergyBudgetInit( &AppBudgetParams );
+                AppBudgetPolicy = EnergyBudgetUpdate( BoardGetBatteryVoltage( ) );
+#endif
+
                 DeviceState = DEVICE_STATE_JOIN;
+
+#if( APP_NVM_ON == 1 )
+                AppNvmAddress = BoardFlashGetEnd( ) - ( APP_NVM_PAGE_SIZE * APP_NVM_NB_PAGES );
+#if( APP_FRAG_RX_ON == 1 )
+                AppNvmAddress -= APP_FRAG_RX_STAGING_SIZE;
+#endif
+                if( NvmLogInit( &AppNvmCallbacks, APP_NVM_PAGE_SIZE, APP_NVM_NB_PAGES, ( uint8_t* )&AppNvm, sizeof( AppNvm ) ) == true )
+                {
+                    mibReq.Type = MIB_DEV_NONCE;
+                    mibReq.Param.DevNonce = AppNvm.DevNonce;
+                    LoRaMacMibSetRequestConfirm( &mibReq );
+#if( APP_BUDGET_ON == 1 )
+                    // The lifetime goes on from the last stored hour
+                    EnergyBudgetRestore( AppNvm.BudgetLifetime, AppNvm.BudgetElapsedHours );
+                    AppBudgetPolicy = EnergyBudgetUpdate( BoardGetBatteryVoltage( ) );
+#endif
+
+                    if( ( AppNvm.IsJoined != 0 ) && ( LoRaMacSessionRestore( &AppNvm.Session ) == LORAMAC_STATUS_OK ) )
+                    {
+                        // Resume the stored session. The uplink counter skipped
+                        // LORAMAC_SESSION_FCNT_GAP frames, the new value is
+                        // stored before the next reset may reuse it
+                        IsNetworkJoinedStatusUpdate = true;
+                        AppNvmUpdate = true;
+                        DeviceState = DEVICE_STATE_SEND;
+                    }
+                }
+#endif
                 break;
             }
             case DEVICE_STATE_JOIN:
@@ -889,6 +1909,9 @@ int main( void )
 
                 if( NextTx == true )
                 {
+#if( APP_NVM_ON == 1 )
+                    AppNvmStore( true );
+#endif
                     LoRaMacMlmeRequest( &mlmeReq );
                 }
                 DeviceState = DEVICE_STATE_SLEEP;
@@ -920,7 +1943,33 @@ int main( void )
             }
             case DEVICE_STATE_SEND:
             {
+#if( APP_BUDGET_ON == 1 )
+                AppBudgetPolicy = EnergyBudgetUpdate( BoardGetBatteryVoltage( ) );
+                BudgetStatusUpdated = true;
+#if( APP_NVM_ON == 1 )
+                if( EnergyBudgetGetStats( )->ElapsedHours != AppNvm.BudgetElapsedHours )
+                {
+                    AppNvmUpdate = true;
+                }
+#endif
+                if( ComplianceTest.Running == false )
+                {
+                    IsTxConfirmed = LORAWAN_CONFIRMED_MSG_ON && AppBudgetPolicy->Confirmed;
+                }
+#endif
+#if( APP_BATCH_ON == 1 )
+                if( BatchIsActive( ) == true )
+                {
+                    BatchPushRecord( );
+                }
+                if( ( NextTx == true ) && ( ( BatchIsActive( ) == false ) || ( BatchFlushRequired( ) == true ) ) )
+#else
                 if( NextTx == true )
+#endif
+#if( APP_FRAG_ON == 1 )
+                // The fragments have priority over the periodic uplinks
+                if( FragTxGetStatus( ) != FRAG_STATUS_RUNNING )
+#endif
                 {
                     SerialDisplayUpdateUplinkAcked( false );
                     SerialDisplayUpdateDonwlinkRxData( false );
@@ -936,7 +1985,11 @@ int main( void )
                 else
                 {
                     // Schedule next packet transmission
+#if( APP_BUDGET_ON == 1 )
+                    TxDutyCycleTime = AppBudgetPolicy->Period + randr( -APP_TX_DUTYCYCLE_RND, APP_TX_DUTYCYCLE_RND );
+#else
                     TxDutyCycleTime = APP_TX_DUTYCYCLE + randr( -APP_TX_DUTYCYCLE_RND, APP_TX_DUTYCYCLE_RND );
+#endif
                 }
                 DeviceState = DEVICE_STATE_CYCLE;
                 break;
@@ -19,10 +19,26 @@ Maintainer: Miguel Luis and Gregory Cristian
 #define STRING_STACK_LIMIT    120
 #endif
 
+/*!
+ * Transmission ring buffer size. Must be a power of 2
+ */
+#ifndef VT100_TX_BUFFER_SIZE
+#define VT100_TX_BUFFER_SIZE  256
+#endif
+
+/*!
+ * Reception ring buffer size. Must be a power of 2
+ */
+#ifndef VT100_RX_BUFFER_SIZE
+#define VT100_RX_BUFFER_SIZE  64
+#endif
+
 /**
  * Implements VT100 terminal commands support.
  * Implments also the same behaviour has RawSerial class. The only difference
- * is located in putc fucntion where writeable check is made befor sending the character.
+ * is located in putc fucntion where the character is queued into a ring buffer
+ * drained by the transmission interrupt. The received chars are queued by the
+ * reception interrupt.
  */
 class VT100 : public SerialBase
 {
@@ -52,8 +68,9 @@ public:
         WHITE   = 7,
     };
 
-    VT100( PinName tx, PinName rx ): SerialBase( tx, rx, 115200 )
+    VT100( PinName tx, PinName rx ): SerialBase( tx, rx, 115200 ), TxHead( 0 ), TxTail( 0 ), TxIrqOn( false ), TxDropped( 0 ), RxHead( 0 ), RxTail( 0 )
     {
+        attach( callback( this, &VT100::OnRxIrq ), SerialBase::RxIrq );
         // initializes terminal to "power-on" settings
         // ESC c
         this->printf( "\x1B\x63" );
@@ -134,12 +151,18 @@ public:
     
     bool Readable( void )
     {
-        return this->readable( );
+        return RxHead != RxTail;
     }
     
     uint8_t GetChar( void )
     {
-        return this->getc( );
+        uint8_t c;
+
+        while( Readable( ) == false );
+
+        c = RxBuffer[RxTail & ( VT100_RX_BUFFER_SIZE - 1 )];
+        RxTail++;
+        return c;
     }
 
     /*
@@ -154,16 +177,69 @@ public:
         return _base_getc( );
     }
 
-    /** Write a char to the serial port
+    /** Write a char to the serial port. Never waits: the char is dropped when
+     *  the ring buffer is full. Callers which must not lose chars check
+     *  GetTxFree first and resume later
      *
      * @param c The char to write
      *
-     * @returns The written char or -1 if an error occured
+     * @returns The written char, EOF when dropped
      */
     int putc( int c )
     {
-        while( this->writeable( ) != 1 );
-        return _base_putc( c );
+        if( GetTxFree( ) == 0 )
+        {
+            TxDropped++;
+            return EOF;
+        }
+
+        __disable_irq( );
+        TxBuffer[TxHead & ( VT100_TX_BUFFER_SIZE - 1 )] = c;
+        TxHead++;
+        if( TxIrqOn == false )
+        {
+            TxIrqOn = true;
+            attach( callback( this, &VT100::OnTxIrq ), SerialBase::TxIrq );
+        }
+        __enable_irq( );
+        return c;
+    }
+
+    /** Get the free space of the transmission ring buffer
+     *
+     * @returns Number of chars which can be written without waiting
+     */
+    uint16_t GetTxFree( void )
+    {
+        return VT100_TX_BUFFER_SIZE - ( uint16_t )( TxHead - TxTail );
+    }
+
+    /** Get the number of chars dropped because the ring buffer was full
+     *
+     * @returns Number of dropped chars
+     */
+    uint32_t GetTxDropped( void )
+    {
+        return TxDropped;
+    }
+
+    /** Write the chars fitting in the ring buffer. Never waits
+     *
+     * @param buffer The chars to write
+     * @param size   Number of chars
+     *
+     * @returns Number of chars written, the caller resumes with the others
+     */
+    uint16_t Write( const uint8_t *buffer, uint16_t size )
+    {
+        uint16_t free = GetTxFree( );
+
+        size = ( size < free ) ? size : free;
+        for( uint16_t i = 0; i < size; i++ )
+        {
+            putc( buffer[i] );
+        }
+        return size;
     }
 
     /** Write a string to the serial port
@@ -206,7 +282,50 @@ public:
     }
 
 private:
-    
+    /*
+     * Transmission interrupt. Moves the queued chars to the UART and disables
+     * itself once the ring buffer is empty
+     */
+    void OnTxIrq( void )
+    {
+        while( ( TxTail != TxHead ) && ( this->writeable( ) == 1 ) )
+        {
+            _base_putc( TxBuffer[TxTail & ( VT100_TX_BUFFER_SIZE - 1 )] );
+            TxTail++;
+        }
+        if( TxTail == TxHead )
+        {
+            attach( Callback<void( )>( ), SerialBase::TxIrq );
+            TxIrqOn = false;
+        }
+    }
+
+    /*
+     * Reception interrupt. Queues the received chars, drops them when the
+     * ring buffer is full
+     */
+    void OnRxIrq( void )
+    {
+        while( this->readable( ) == 1 )
+        {
+            uint8_t c = _base_getc( );
+
+            if( ( uint16_t )( RxHead - RxTail ) < VT100_RX_BUFFER_SIZE )
+            {
+                RxBuffer[RxHead & ( VT100_RX_BUFFER_SIZE - 1 )] = c;
+                RxHead++;
+            }
+        }
+    }
+
+    uint8_t TxBuffer[VT100_TX_BUFFER_SIZE];
+    volatile uint16_t TxHead;
+    volatile uint16_t TxTail;
+    volatile bool TxIrqOn;
+    volatile uint32_t TxDropped;
+    uint8_t RxBuffer[VT100_RX_BUFFER_SIZE];
+    volatile uint16_t RxHead;
+    volatile uint16_t RxTail;
 };
 
 #endif // __VT100_H__
@@ -17,6 +17,13 @@ Maintainer: Miguel Luis and Gregory Cristian
 
 SX1276MB1xAS Radio( NULL );
 
+#if( BATTERY_MEASURE_ON == 1 )
+/*!
+ * Battery measurement input
+ */
+static AnalogIn BatteryMeasure( BATTERY_MEASURE_PIN );
+#endif
+
 /*!
  * Nested interrupt counter.
  *
@@ -42,10 +49,100 @@ void BoardEnableIrq( void )
 void BoardInit( void )
 {
     TimerTimeCounterInit( );
+#if( PROFILE_ON == 1 )
+    ProfileInit( );
+#endif
 }
 
 
+uint16_t BoardGetBatteryVoltage( void )
+{
+#if( BATTERY_MEASURE_ON == 1 )
+    uint32_t sample = BatteryMeasure.read_u16( );
+
+    return ( sample * BATTERY_ADC_VREF * BATTERY_DIVIDER_RATIO ) / 65535;
+#else
+    return BATTERY_MAX_LEVEL;
+#endif
+}
+
 uint8_t BoardGetBatteryLevel( void ) 
 {
-    return 0xFE;
+    uint16_t batteryVoltage = BoardGetBatteryVoltage( );
+
+    if( batteryVoltage >= BATTERY_MAX_LEVEL )
+    {
+        return 254;
+    }
+    else if( batteryVoltage > BATTERY_MIN_LEVEL )
+    {
+        return ( ( 253 * ( batteryVoltage - BATTERY_MIN_LEVEL ) ) / ( BATTERY_MAX_LEVEL - BATTERY_MIN_LEVEL ) ) + 1;
+    }
+    // The battery is empty. 0 is reserved for an external power source
+    return 1;
+}
+
+uint32_t BoardFlashGetEnd( void )
+{
+    return FLASH_BASE + FLASH_SIZE;
+}
+
+bool BoardFlashErase( uint32_t address, uint32_t size )
+{
+    FLASH_EraseInitTypeDef eraseInit;
+    uint32_t pageError = 0;
+    HAL_StatusTypeDef status;
+
+    if( ( ( address % BOARD_FLASH_PAGE_SIZE ) != 0 ) || ( ( size % BOARD_FLASH_PAGE_SIZE ) != 0 ) ||
+        ( address < FLASH_BASE ) || ( ( address + size ) > BoardFlashGetEnd( ) ) )
+    {
+        return false;
+    }
+    if( size == 0 )
+    {
+        return true;
+    }
+
+    eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+    eraseInit.PageAddress = address;
+    eraseInit.NbPages = size / BOARD_FLASH_PAGE_SIZE;
+
+    HAL_FLASH_Unlock( );
+    status = HAL_FLASHEx_Erase( &eraseInit, &pageError );
+    HAL_FLASH_Lock( );
+    return status == HAL_OK;
+}
+
+bool BoardFlashWrite( uint32_t address, const uint8_t *buffer, uint32_t size )
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    if( ( ( address % BOARD_FLASH_WORD_SIZE ) != 0 ) || ( ( size % BOARD_FLASH_WORD_SIZE ) != 0 ) ||
+        ( address < FLASH_BASE ) || ( ( address + size ) > BoardFlashGetEnd( ) ) )
+    {
+        return false;
+    }
+
+    HAL_FLASH_Unlock( );
+    for( uint32_t i = 0; ( i < size ) && ( status == HAL_OK ); i += BOARD_FLASH_WORD_SIZE )
+    {
+        // Little endian word built byte per byte, the source may be unaligned
+        uint32_t word = ( uint32_t )buffer[i] | ( ( uint32_t )buffer[i + 1] << 8 ) |
+                        ( ( uint32_t )buffer[i + 2] << 16 ) | ( ( uint32_t )buffer[i + 3] << 24 );
+
+        status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_WORD, address + i, word );
+    }
+    HAL_FLASH_Lock( );
+    return status == HAL_OK;
+}
+
+bool BoardFlashRead( uint32_t address, uint8_t *buffer, uint32_t size )
+{
+    if( ( address < FLASH_BASE ) || ( ( address + size ) > BoardFlashGetEnd( ) ) )
+    {
+        return false;
+    }
+    // The flash is memory mapped
+    memcpy1( buffer, ( const uint8_t* )( uintptr_t )address, size );
+    return true;
 }
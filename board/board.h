@@ -17,12 +17,55 @@ Maintainer: Miguel Luis and Gregory Cristian
 
 #include "mbed.h"
 #include "system/timer.h"
+#include "system/trace.h"
+#include "system/log.h"
+#include "system/profile.h"
+#include "system/capture.h"
+#include "system/framepool.h"
 #include "debug.h"
 #include "system/utilities.h"
 #include "sx1276-hal.h"
 
 #define USE_BAND_868
 
+/*!
+ * Battery thresholds [mV]. Defaults for 2 AA alkaline cells
+ */
+#define BATTERY_MAX_LEVEL                           3000
+#define BATTERY_MIN_LEVEL                           2000
+#define BATTERY_SHUTDOWN_LEVEL                      1800
+
+/*!
+ * Battery measurement enable/disable
+ *
+ * \remark The NUCLEO board and the SX1276 shield do not wire the battery to
+ *         BATTERY_MEASURE_PIN, the input floats. Set to 1 once the resistor
+ *         divider is fitted. When disabled the battery is reported as full
+ */
+#define BATTERY_MEASURE_ON                          0
+
+/*!
+ * Battery measurement input. The battery is connected through a resistor
+ * divider of ratio 1 / BATTERY_DIVIDER_RATIO
+ */
+#define BATTERY_MEASURE_PIN                         A1
+#define BATTERY_DIVIDER_RATIO                       2
+
+/*!
+ * ADC reference voltage [mV]
+ */
+#define BATTERY_ADC_VREF                            3300
+
+/*!
+ * MCU flash erase granularity [bytes]
+ */
+#define BOARD_FLASH_PAGE_SIZE                       FLASH_PAGE_SIZE
+
+/*!
+ * MCU flash programming granularity [bytes]
+ */
+#define BOARD_FLASH_WORD_SIZE                       4
+
 extern SX1276MB1xAS Radio;
 
 /*!
@@ -44,11 +87,60 @@ void BoardEnableIrq( void );
  */
 void BoardInit( void );
 
+/*!
+ * \brief Measure the Battery voltage
+ *
+ * \retval value  battery voltage in mV
+ */
+uint16_t BoardGetBatteryVoltage( void );
+
 /*!
  * \brief Measure the Battery level
  *
- * \retval value  battery level ( 0: very low, 254: fully charged )
+ * \retval value  battery level ( 1: very low, 254: fully charged )
  */
 uint8_t BoardGetBatteryLevel( void );
 
+/*!
+ * \brief Gets the end of the MCU flash
+ *
+ * \retval address Address following the last flash byte
+ */
+uint32_t BoardFlashGetEnd( void );
+
+/*!
+ * \brief Erases MCU flash pages. Erased flash reads as 0x00
+ *
+ * \remark A page erase takes about 3.2 ms. The CPU only keeps running during
+ *         the erase when it executes from the other flash bank
+ *
+ * \param [IN] address First page address. Must be page aligned
+ * \param [IN] size    Size to erase. Must be a multiple of the page size
+ *
+ * \retval status [true: success, false: failure]
+ */
+bool BoardFlashErase( uint32_t address, uint32_t size );
+
+/*!
+ * \brief Programs erased MCU flash words
+ *
+ * \param [IN] address Destination address. Must be word aligned
+ * \param [IN] buffer  Data to program. May be unaligned
+ * \param [IN] size    Data size. Must be a multiple of the word size
+ *
+ * \retval status [true: success, false: failure]
+ */
+bool BoardFlashWrite( uint32_t address, const uint8_t *buffer, uint32_t size );
+
+/*!
+ * \brief Reads the MCU flash
+ *
+ * \param [IN]  address Source address
+ * \param [OUT] buffer  Destination buffer
+ * \param [IN]  size    Size to read
+ *
+ * \retval status [true: success, false: failure]
+ */
+bool BoardFlashRead( uint32_t address, uint8_t *buffer, uint32_t size );
+
 #endif // __BOARD_H__
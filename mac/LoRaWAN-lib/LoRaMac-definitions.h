@@ -23,7 +23,37 @@ Maintainer: Miguel Luis and Gregory Cristian
  */
 #define LC( channelIndex )            ( uint16_t )( 1 << ( channelIndex - 1 ) )
 
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+
+#if defined( USE_BAND_470 ) || defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
+    #error "The CN470 and US915 bands cannot be built with the EU433, CN779 and EU868 bands."
+#endif
+
+/*!
+ * Regions built in the image. The EU433, CN779 and EU868 regions share the
+ * dynamic channel plan and may be built together, MIB_REGION selects the
+ * active one. The regional parameters of a single region build are resolved
+ * at compile time
+ */
 #if defined( USE_BAND_433 )
+#define LORAMAC_REGION_EU433_ON                     1
+#else
+#define LORAMAC_REGION_EU433_ON                     0
+#endif
+
+#if defined( USE_BAND_780 )
+#define LORAMAC_REGION_CN779_ON                     1
+#else
+#define LORAMAC_REGION_CN779_ON                     0
+#endif
+
+#if defined( USE_BAND_868 )
+#define LORAMAC_REGION_EU868_ON                     1
+#else
+#define LORAMAC_REGION_EU868_ON                     0
+#endif
+
+#define LORAMAC_NB_REGIONS                          ( LORAMAC_REGION_EU433_ON + LORAMAC_REGION_CN779_ON + LORAMAC_REGION_EU868_ON )
 
 /*!
  * LoRaMac maximum number of channels
@@ -66,22 +96,20 @@ Maintainer: Miguel Luis and Gregory Cristian
 #define LORAMAC_MAX_RX1_DR_OFFSET                   5
 
 /*!
- * Minimal Tx output power that can be used by the node
- */
-#define LORAMAC_MIN_TX_POWER                        TX_POWER_M5_DBM
-
-/*!
- * Maximal Tx output power that can be used by the node
+ * Minimal Tx output power that can be used by the node.
+ * EU433 / CN779: TX_POWER_M5_DBM, EU868: TX_POWER_02_DBM
  */
-#define LORAMAC_MAX_TX_POWER                        TX_POWER_10_DBM
+#define LORAMAC_MIN_TX_POWER                        5
 
 /*!
- * Default Tx output power used by the node
+ * Maximal Tx output power that can be used by the node.
+ * EU433 / CN779: TX_POWER_10_DBM, EU868: TX_POWER_20_DBM
  */
-#define LORAMAC_DEFAULT_TX_POWER                    TX_POWER_10_DBM
+#define LORAMAC_MAX_TX_POWER                        0
 
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 )
 /*!
- * LoRaMac TxPower definition
+ * LoRaMac EU433 and CN779 TxPower definition
  */
 #define TX_POWER_10_DBM                             0
 #define TX_POWER_07_DBM                             1
@@ -89,6 +117,19 @@ Maintainer: Miguel Luis and Gregory Cristian
 #define TX_POWER_01_DBM                             3
 #define TX_POWER_M2_DBM                             4
 #define TX_POWER_M5_DBM                             5
+#endif
+
+#if defined( USE_BAND_868 )
+/*!
+ * LoRaMac EU868 TxPower definition
+ */
+#define TX_POWER_20_DBM                             0
+#define TX_POWER_14_DBM                             1
+#define TX_POWER_11_DBM                             2
+#define TX_POWER_08_DBM                             3
+#define TX_POWER_05_DBM                             4
+#define TX_POWER_02_DBM                             5
+#endif
 
 /*!
  * LoRaMac datarates definition
@@ -110,245 +151,121 @@ Maintainer: Miguel Luis and Gregory Cristian
 #endif
 
 /*!
- * Second reception window channel definition.
+ * Class B beacon frame size and RFU fields sizes
  */
-// Channel = { Frequency [Hz], Datarate }
-#define RX_WND_2_CHANNEL                                  { 434665000, DR_0 }
+#define BEACON_SIZE                                 17
+#define BEACON_RFU1_SIZE                            2
+#define BEACON_RFU2_SIZE                            0
 
 /*!
  * LoRaMac maximum number of bands
  */
+#if defined( USE_BAND_868 )
+#define LORA_MAX_NB_BANDS                           5
+#else
 #define LORA_MAX_NB_BANDS                           1
+#endif
 
-// Band = { DutyCycle, TxMaxPower, LastTxDoneTime, TimeOff }
-#define BAND0              { 100, TX_POWER_10_DBM, 0,  0 } //  1.0 %
-
-/*!
- * LoRaMac default channels
- */
-// Channel = { Frequency [Hz], { ( ( DrMax << 4 ) | DrMin ) }, Band }
-#define LC1                { 433175000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
-#define LC2                { 433375000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
-#define LC3                { 433575000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
-
-/*!
- * LoRaMac channels which are allowed for the join procedure
- */
-#define JOIN_CHANNELS      ( uint16_t )( LC( 1 ) | LC( 2 ) | LC( 3 ) )
-
-#elif defined( USE_BAND_470 )
-
-/*!
- * LoRaMac maximum number of channels
- */
-#define LORA_MAX_NB_CHANNELS                        96
-
-/*!
- * Minimal datarate that can be used by the node
- */
-#define LORAMAC_TX_MIN_DATARATE                     DR_0
-
-/*!
- * Maximal datarate that can be used by the node
- */
-#define LORAMAC_TX_MAX_DATARATE                     DR_5
-
-/*!
- * Minimal datarate that can be used by the node
- */
-#define LORAMAC_RX_MIN_DATARATE                     DR_0
-
-/*!
- * Maximal datarate that can be used by the node
- */
-#define LORAMAC_RX_MAX_DATARATE                     DR_5
-
-/*!
- * Default datarate used by the node
- */
-#define LORAMAC_DEFAULT_DATARATE                    DR_0
-
-/*!
- * Minimal Rx1 receive datarate offset
- */
-#define LORAMAC_MIN_RX1_DR_OFFSET                   0
-
-/*!
- * Maximal Rx1 receive datarate offset
- */
-#define LORAMAC_MAX_RX1_DR_OFFSET                   3
-
-/*!
- * Minimal Tx output power that can be used by the node
- */
-#define LORAMAC_MIN_TX_POWER                        TX_POWER_2_DBM
-
-/*!
- * Maximal Tx output power that can be used by the node
- */
-#define LORAMAC_MAX_TX_POWER                        TX_POWER_17_DBM
-
-/*!
- * Default Tx output power used by the node
- */
-#define LORAMAC_DEFAULT_TX_POWER                    TX_POWER_14_DBM
-
-/*!
- * LoRaMac TxPower definition
- */
-#define TX_POWER_17_DBM                             0
-#define TX_POWER_16_DBM                             1
-#define TX_POWER_14_DBM                             2
-#define TX_POWER_12_DBM                             3
-#define TX_POWER_10_DBM                             4
-#define TX_POWER_7_DBM                              5
-#define TX_POWER_5_DBM                              6
-#define TX_POWER_2_DBM                              7
-
-
+#if defined( USE_BAND_433 )
 /*!
- * LoRaMac datarates definition
+ * EU433 default Tx output power
  */
-#define DR_0                                        0  // SF12 - BW125 |
-#define DR_1                                        1  // SF11 - BW125 |
-#define DR_2                                        2  // SF10 - BW125 |
-#define DR_3                                        3  // SF9  - BW125 |
-#define DR_4                                        4  // SF8  - BW125 |
-#define DR_5                                        5  // SF7  - BW125 |
+#define EU433_DEFAULT_TX_POWER                      TX_POWER_10_DBM
 
 /*!
- * Second reception window channel definition.
+ * EU433 second reception window channel and class B beacon channel. The ping
+ * slots use the beacon channel by default
  */
 // Channel = { Frequency [Hz], Datarate }
-#define RX_WND_2_CHANNEL                                  { 505300000, DR_0 }
-
-/*!
- * LoRaMac maximum number of bands
- */
-#define LORA_MAX_NB_BANDS                           1
+#define EU433_RX_WND_2_CHANNEL                            { 434665000, DR_0 }
+#define EU433_BEACON_CHANNEL                              { 434665000, DR_3 }
 
 // Band = { DutyCycle, TxMaxPower, LastTxDoneTime, TimeOff }
-#define BAND0              { 1, TX_POWER_17_DBM, 0,  0 } //  100.0 %
-
-#elif defined( USE_BAND_780 )
-
-/*!
- * LoRaMac maximum number of channels
- */
-#define LORA_MAX_NB_CHANNELS                        16
-
-/*!
- * Minimal datarate that can be used by the node
- */
-#define LORAMAC_TX_MIN_DATARATE                     DR_0
+#define EU433_BAND0        { 100, TX_POWER_10_DBM, 0,  0 } //  1.0 %
 
 /*!
- * Maximal datarate that can be used by the node
- */
-#define LORAMAC_TX_MAX_DATARATE                     DR_7
-
-/*!
- * Minimal datarate that can be used by the node
+ * EU433 default channels
  */
-#define LORAMAC_RX_MIN_DATARATE                     DR_0
-
-/*!
- * Maximal datarate that can be used by the node
- */
-#define LORAMAC_RX_MAX_DATARATE                     DR_7
-
-/*!
- * Default datarate used by the node
- */
-#define LORAMAC_DEFAULT_DATARATE                    DR_0
-
-/*!
- * Minimal Rx1 receive datarate offset
- */
-#define LORAMAC_MIN_RX1_DR_OFFSET                   0
-
-/*!
- * Maximal Rx1 receive datarate offset
- */
-#define LORAMAC_MAX_RX1_DR_OFFSET                   5
-
-/*!
- * Minimal Tx output power that can be used by the node
- */
-#define LORAMAC_MIN_TX_POWER                        TX_POWER_M5_DBM
+// Channel = { Frequency [Hz], { ( ( DrMax << 4 ) | DrMin ) }, Band }
+#define EU433_LC1          { 433175000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
+#define EU433_LC2          { 433375000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
+#define EU433_LC3          { 433575000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
+#endif
 
+#if defined( USE_BAND_780 )
 /*!
- * Maximal Tx output power that can be used by the node
+ * CN779 default Tx output power
  */
-#define LORAMAC_MAX_TX_POWER                        TX_POWER_10_DBM
+#define CN779_DEFAULT_TX_POWER                      TX_POWER_10_DBM
 
 /*!
- * Default Tx output power used by the node
+ * CN779 second reception window channel and class B beacon channel. The ping
+ * slots use the beacon channel by default
  */
-#define LORAMAC_DEFAULT_TX_POWER                    TX_POWER_10_DBM
+// Channel = { Frequency [Hz], Datarate }
+#define CN779_RX_WND_2_CHANNEL                            { 786000000, DR_0 }
+#define CN779_BEACON_CHANNEL                              { 785000000, DR_3 }
 
-/*!
- * LoRaMac TxPower definition
- */
-#define TX_POWER_10_DBM                             0
-#define TX_POWER_07_DBM                             1
-#define TX_POWER_04_DBM                             2
-#define TX_POWER_01_DBM                             3
-#define TX_POWER_M2_DBM                             4
-#define TX_POWER_M5_DBM                             5
+// Band = { DutyCycle, TxMaxPower, LastTxDoneTime, TimeOff }
+#define CN779_BAND0        { 100, TX_POWER_10_DBM, 0,  0 } //  1.0 %
 
 /*!
- * LoRaMac datarates definition
+ * CN779 default channels
  */
-#define DR_0                                        0  // SF12 - BW125
-#define DR_1                                        1  // SF11 - BW125
-#define DR_2                                        2  // SF10 - BW125
-#define DR_3                                        3  // SF9  - BW125
-#define DR_4                                        4  // SF8  - BW125
-#define DR_5                                        5  // SF7  - BW125
-#define DR_6                                        6  // SF7  - BW250
-#define DR_7                                        7  // FSK
+// Channel = { Frequency [Hz], { ( ( DrMax << 4 ) | DrMin ) }, Band }
+#define CN779_LC1          { 779500000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
+#define CN779_LC2          { 779700000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
+#define CN779_LC3          { 779900000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
+#endif
 
+#if defined( USE_BAND_868 )
 /*!
- * Verification of default datarate
+ * EU868 default Tx output power
  */
-#if ( LORAMAC_DEFAULT_DATARATE > DR_5 )
-#error "A default DR higher than DR_5 may lead to connectivity loss."
-#endif
+#define EU868_DEFAULT_TX_POWER                      TX_POWER_14_DBM
 
 /*!
- * Second reception window channel definition.
+ * EU868 second reception window channel and class B beacon channel. The ping
+ * slots use the beacon channel by default
  */
 // Channel = { Frequency [Hz], Datarate }
-#define RX_WND_2_CHANNEL                                  { 786000000, DR_0 }
+#define EU868_RX_WND_2_CHANNEL                            { 869525000, DR_0 }
+#define EU868_BEACON_CHANNEL                              { 869525000, DR_3 }
 
 /*!
- * LoRaMac maximum number of bands
+ * LoRaMac EU868 default bands
  */
-#define LORA_MAX_NB_BANDS                           1
+typedef enum
+{
+    BAND_G1_0,
+    BAND_G1_1,
+    BAND_G1_2,
+    BAND_G1_3,
+    BAND_G1_4,
+}BandId_t;
 
 // Band = { DutyCycle, TxMaxPower, LastTxDoneTime, TimeOff }
-#define BAND0              { 100, TX_POWER_10_DBM, 0,  0 } //  1.0 %
+#define EU868_BAND0        { 100 , TX_POWER_14_DBM, 0,  0 } //  1.0 %
+#define EU868_BAND1        { 100 , TX_POWER_14_DBM, 0,  0 } //  1.0 %
+#define EU868_BAND2        { 1000, TX_POWER_14_DBM, 0,  0 } //  0.1 %
+#define EU868_BAND3        { 10  , TX_POWER_14_DBM, 0,  0 } // 10.0 %
+#define EU868_BAND4        { 100 , TX_POWER_14_DBM, 0,  0 } //  1.0 %
 
 /*!
- * LoRaMac default channels
+ * EU868 default channels
  */
 // Channel = { Frequency [Hz], { ( ( DrMax << 4 ) | DrMin ) }, Band }
-#define LC1                { 779500000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
-#define LC2                { 779700000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
-#define LC3                { 779900000, { ( ( DR_5 << 4 ) | DR_0 ) }, 0 }
-
-/*!
- * LoRaMac channels which are allowed for the join procedure
- */
-#define JOIN_CHANNELS      ( uint16_t )( LC( 1 ) | LC( 2 ) | LC( 3 ) )
+#define EU868_LC1          { 868100000, { ( ( DR_5 << 4 ) | DR_0 ) }, 1 }
+#define EU868_LC2          { 868300000, { ( ( DR_5 << 4 ) | DR_0 ) }, 1 }
+#define EU868_LC3          { 868500000, { ( ( DR_5 << 4 ) | DR_0 ) }, 1 }
+#endif
 
-#elif defined( USE_BAND_868 )
+#elif defined( USE_BAND_470 )
 
 /*!
  * LoRaMac maximum number of channels
  */
-#define LORA_MAX_NB_CHANNELS                        16
+#define LORA_MAX_NB_CHANNELS                        96
 
 /*!
  * Minimal datarate that can be used by the node
@@ -358,7 +275,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 /*!
  * Maximal datarate that can be used by the node
  */
-#define LORAMAC_TX_MAX_DATARATE                     DR_7
+#define LORAMAC_TX_MAX_DATARATE                     DR_5
 
 /*!
  * Minimal datarate that can be used by the node
@@ -368,7 +285,7 @@ Maintainer: Miguel Luis and Gregory Cristian
 /*!
  * Maximal datarate that can be used by the node
  */
-#define LORAMAC_RX_MAX_DATARATE                     DR_7
+#define LORAMAC_RX_MAX_DATARATE                     DR_5
 
 /*!
  * Default datarate used by the node
@@ -383,17 +300,17 @@ Maintainer: Miguel Luis and Gregory Cristian
 /*!
  * Maximal Rx1 receive datarate offset
  */
-#define LORAMAC_MAX_RX1_DR_OFFSET                   5
+#define LORAMAC_MAX_RX1_DR_OFFSET                   3
 
 /*!
  * Minimal Tx output power that can be used by the node
  */
-#define LORAMAC_MIN_TX_POWER                        TX_POWER_02_DBM
+#define LORAMAC_MIN_TX_POWER                        TX_POWER_2_DBM
 
 /*!
  * Maximal Tx output power that can be used by the node
  */
-#define LORAMAC_MAX_TX_POWER                        TX_POWER_20_DBM
+#define LORAMAC_MAX_TX_POWER                        TX_POWER_17_DBM
 
 /*!
  * Default Tx output power used by the node
@@ -403,74 +320,53 @@ Maintainer: Miguel Luis and Gregory Cristian
 /*!
  * LoRaMac TxPower definition
  */
-#define TX_POWER_20_DBM                             0
-#define TX_POWER_14_DBM                             1
-#define TX_POWER_11_DBM                             2
-#define TX_POWER_08_DBM                             3
-#define TX_POWER_05_DBM                             4
-#define TX_POWER_02_DBM                             5
+#define TX_POWER_17_DBM                             0
+#define TX_POWER_16_DBM                             1
+#define TX_POWER_14_DBM                             2
+#define TX_POWER_12_DBM                             3
+#define TX_POWER_10_DBM                             4
+#define TX_POWER_7_DBM                              5
+#define TX_POWER_5_DBM                              6
+#define TX_POWER_2_DBM                              7
 
-/*!
- * LoRaMac datarates definition
- */
-#define DR_0                                        0  // SF12 - BW125
-#define DR_1                                        1  // SF11 - BW125
-#define DR_2                                        2  // SF10 - BW125
-#define DR_3                                        3  // SF9  - BW125
-#define DR_4                                        4  // SF8  - BW125
-#define DR_5                                        5  // SF7  - BW125
-#define DR_6                                        6  // SF7  - BW250
-#define DR_7                                        7  // FSK
 
 /*!
- * Verification of default datarate
+ * LoRaMac datarates definition
  */
-#if ( LORAMAC_DEFAULT_DATARATE > DR_5 )
-#error "A default DR higher than DR_5 may lead to connectivity loss."
-#endif
+#define DR_0                                        0  // SF12 - BW125 |
+#define DR_1                                        1  // SF11 - BW125 |
+#define DR_2                                        2  // SF10 - BW125 |
+#define DR_3                                        3  // SF9  - BW125 |
+#define DR_4                                        4  // SF8  - BW125 |
+#define DR_5                                        5  // SF7  - BW125 |
 
 /*!
  * Second reception window channel definition.
  */
 // Channel = { Frequency [Hz], Datarate }
-#define RX_WND_2_CHANNEL                                  { 869525000, DR_0 }
+#define RX_WND_2_CHANNEL                                  { 505300000, DR_0 }
 
 /*!
- * LoRaMac maximum number of bands
+ * Class B beacon channel. The ping slots use the same channel by default.
+ * First channel of the beacon frequency hopping pattern
  */
-#define LORA_MAX_NB_BANDS                           5
+// Channel = { Frequency [Hz], Datarate }
+#define BEACON_CHANNEL                                    { 508300000, DR_2 }
 
 /*!
- * LoRaMac EU868 default bands
+ * Class B beacon frame size and RFU fields sizes
  */
-typedef enum
-{
-    BAND_G1_0,
-    BAND_G1_1,
-    BAND_G1_2,
-    BAND_G1_3,
-    BAND_G1_4,
-}BandId_t;
-
-// Band = { DutyCycle, TxMaxPower, LastTxDoneTime, TimeOff }
-#define BAND0              { 100 , TX_POWER_14_DBM, 0,  0 } //  1.0 %
-#define BAND1              { 100 , TX_POWER_14_DBM, 0,  0 } //  1.0 %
-#define BAND2              { 1000, TX_POWER_14_DBM, 0,  0 } //  0.1 %
-#define BAND3              { 10  , TX_POWER_14_DBM, 0,  0 } // 10.0 %
-#define BAND4              { 100 , TX_POWER_14_DBM, 0,  0 } //  1.0 %
+#define BEACON_SIZE                                 19
+#define BEACON_RFU1_SIZE                            3
+#define BEACON_RFU2_SIZE                            1
 
 /*!
- * LoRaMac default channels
+ * LoRaMac maximum number of bands
  */
-// Channel = { Frequency [Hz], { ( ( DrMax << 4 ) | DrMin ) }, Band }
-#define LC1                { 868100000, { ( ( DR_5 << 4 ) | DR_0 ) }, 1 }
-#define LC2                { 868300000, { ( ( DR_5 << 4 ) | DR_0 ) }, 1 }
-#define LC3                { 868500000, { ( ( DR_5 << 4 ) | DR_0 ) }, 1 }
+#define LORA_MAX_NB_BANDS                           1
 
-/*!
- * LoRaMac channels which are allowed for the join procedure
- */
-#define JOIN_CHANNELS      ( uint16_t )( LC( 1 ) | LC( 2 ) | LC( 3 ) )
+// Band = { DutyCycle, TxMaxPower, LastTxDoneTime, TimeOff }
+#define BAND0              { 1, TX_POWER_17_DBM, 0,  0 } //  100.0 %
 
 #elif defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
 
@@ -570,6 +466,20 @@ typedef enum
 // Channel = { Frequency [Hz], Datarate }
 #define RX_WND_2_CHANNEL                                  { 923300000, DR_8 }
 
+/*!
+ * Class B beacon channel. The ping slots use the same channel by default.
+ * First channel of the beacon frequency hopping pattern
+ */
+// Channel = { Frequency [Hz], Datarate }
+#define BEACON_CHANNEL                                    { 923300000, DR_8 }
+
+/*!
+ * Class B beacon frame size and RFU fields sizes
+ */
+#define BEACON_SIZE                                 23
+#define BEACON_RFU1_SIZE                            5
+#define BEACON_RFU2_SIZE                            3
+
 /*!
  * LoRaMac maximum number of bands
  */
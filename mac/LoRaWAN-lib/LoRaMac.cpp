@@ -41,6 +41,12 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jä
  */
 #define LORA_MAC_FRMPAYLOAD_OVERHEAD                13 // MHDR(1) + FHDR(7) + Port(1) + MIC(4)
 
+/*!
+ * Period of the energy accounting updates [ms]. The radio operating mode
+ * times are 32 bits microsecond counters which wrap around after 71 minutes
+ */
+#define ENERGY_UPDATE_PERIOD                        1800000
+
 /*!
  * LoRaMac duty cycle for the back-off procedure during the first hour.
  */
@@ -56,6 +62,60 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jä
  */
 #define BACKOFF_DC_24_HOURS                         10000
 
+/*!
+ * Class B beacon reserved time at the beginning of the beacon period [ms]
+ */
+#define BEACON_RESERVED                             2120
+
+/*!
+ * Class B beacon guard time at the end of the beacon period [ms]. The node
+ * does not transmit during the guard and the reserved times
+ */
+#define BEACON_GUARD                                3000
+
+/*!
+ * Class B beacon acquisition timeout [ms]
+ */
+#define BEACON_ACQUISITION_TIMEOUT                  ( BEACON_INTERVAL + BEACON_RESERVED )
+
+/*!
+ * Maximum time the node keeps the class B operation without receiving a
+ * beacon [ms]
+ */
+#define BEACONLESS_OPERATION_PERIOD                 7200000
+
+/*!
+ * Class B beacon preamble length in symbols
+ */
+#define BEACON_PREAMBLE_LENGTH                      10
+
+/*!
+ * Maximum clock drift of the node used to widen the class B windows [ppm]
+ */
+#define BEACON_CLOCK_DRIFT                          100
+
+/*!
+ * Maximum radio symbol timeout
+ */
+#define BEACON_MAX_SYMBOL_TIMEOUT                   1023
+
+/*!
+ * Class B ping slot length [ms]
+ */
+#define PING_SLOT_WINDOW                            30
+
+/*!
+ * Number of ping slots of a beacon period
+ */
+#define PING_SLOT_NB_SLOTS                          4096
+
+/*!
+ * Rx window slots used by the class B. Slots 0 and 1 are the class A
+ * RX1 and RX2 windows
+ */
+#define RX_SLOT_BEACON                              2
+#define RX_SLOT_PING                                3
+
 /*!
  * Device IEEE EUI
  */
@@ -90,11 +150,17 @@ static uint8_t LoRaMacAppSKey[] =
 };
 
 /*!
- * Device nonce is a random value extracted by issuing a sequence of RSSI
- * measurements
+ * Device nonce of the last join request
  */
 static uint16_t LoRaMacDevNonce;
 
+/*!
+ * Device nonce of the next join request. Seeded with a random value extracted
+ * by issuing a sequence of RSSI measurements, then incremented so that the
+ * nonces are not reused
+ */
+static uint16_t LoRaMacNextDevNonce;
+
 /*!
  * Network ID ( 3 bytes )
  */
@@ -106,9 +172,20 @@ static uint32_t LoRaMacNetID;
 static uint32_t LoRaMacDevAddr;
 
 /*!
- * Multicast channels linked list
+ * Multicast channels table. Open addressing with linear probing, the home
+ * slot of a channel is given by a hash of its address
+ */
+static MulticastParams_t MulticastChannels[LORAMAC_MC_TABLE_SIZE];
+
+/*!
+ * Multicast channels table slots in use
+ */
+static bool MulticastChannelsInUse[LORAMAC_MC_TABLE_SIZE];
+
+/*!
+ * Number of multicast channels in the table
  */
-static MulticastParams_t *MulticastChannels = NULL;
+static uint8_t MulticastChannelsNb = 0;
 
 /*!
  * Actual device class
@@ -126,9 +203,10 @@ static bool PublicNetwork;
 static bool RepeaterSupport;
 
 /*!
- * Buffer containing the data to be sent or received.
+ * Frame pool block of the frame to be sent. Held from PrepareFrame until the
+ * end of the transmission procedure, the retransmissions send it again
  */
-static uint8_t LoRaMacBuffer[LORAMAC_PHY_MAXPAYLOAD];
+static uint8_t *LoRaMacBuffer = NULL;
 
 /*!
  * Length of packet in LoRaMacBuffer
@@ -140,11 +218,6 @@ static uint16_t LoRaMacBufferPktLen = 0;
  */
 static uint8_t LoRaMacTxPayloadLen = 0;
 
-/*!
- * Buffer containing the upper layer data.
- */
-static uint8_t LoRaMacRxPayload[LORAMAC_PHY_MAXPAYLOAD];
-
 /*!
  * LoRaMAC frame counter. Each time a packet is sent the counter is incremented.
  * Only the 16 LSB bits are sent
@@ -220,7 +293,7 @@ static uint8_t MacCommandsBuffer[LORA_MAC_COMMAND_MAX_LENGTH];
  */
 static uint8_t MacCommandsBufferToRepeat[LORA_MAC_COMMAND_MAX_LENGTH];
 
-#if defined( USE_BAND_433 )
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
 /*!
  * Data rates table definition
  */
@@ -242,107 +315,210 @@ const uint8_t MaxPayloadOfDatarate[] = { 51, 51, 51, 115, 242, 242, 242, 242 };
 const uint8_t MaxPayloadOfDatarateRepeater[] = { 51, 51, 51, 115, 222, 222, 222, 222 };
 
 /*!
- * Tx output powers table definition
+ * Sub-band frequency range. Assigns the band of the channels added by the
+ * network
  */
-const int8_t TxPowers[]    = { 10, 7, 4, 1, -2, -5 };
+typedef struct sBandRange
+{
+    uint32_t FreqMin;
+    uint32_t FreqMax;
+    uint8_t Band;
+}BandRange_t;
 
 /*!
- * LoRaMac bands
+ * Regional parameters of the regions sharing the dynamic channel plan
  */
-static Band_t Bands[LORA_MAX_NB_BANDS] =
+typedef struct sRegion
 {
-    BAND0,
-};
+    LoRaMacRegion_t Id;
+    /*!
+     * Tx output powers table definition
+     */
+    int8_t TxPowers[LORAMAC_MIN_TX_POWER + 1];
+    int8_t DefaultTxPower;
+    Rx2ChannelParams_t Rx2Channel;
+    Rx2ChannelParams_t BeaconChannel;
+    /*!
+     * Default bands and channels
+     */
+    Band_t Bands[LORA_MAX_NB_BANDS];
+    ChannelParams_t Channels[3];
+    /*!
+     * Channels re-enabled when no other channel is available
+     */
+    uint16_t DefaultChannelsMask;
+    /*!
+     * Channels allowed for the join procedure
+     */
+    uint16_t JoinChannelsMask;
+    /*!
+     * Datarate of the FSK modem
+     */
+    int8_t FskDatarate;
+    /*!
+     * Sub-bands of the channels added by the network. Without sub-bands the
+     * channels use the band 0
+     */
+    const BandRange_t *BandRanges;
+    uint8_t NbBandRanges;
+}Region_t;
 
+#if defined( USE_BAND_433 )
 /*!
- * LoRaMAC channels
+ * EU433 regional parameters
  */
-static ChannelParams_t Channels[LORA_MAX_NB_CHANNELS] =
+static const Region_t RegionEU433 =
 {
-    LC1,
-    LC2,
-    LC3,
+    LORAMAC_REGION_EU433,
+    { 10, 7, 4, 1, -2, -5 },
+    EU433_DEFAULT_TX_POWER,
+    EU433_RX_WND_2_CHANNEL,
+    EU433_BEACON_CHANNEL,
+    { EU433_BAND0 },
+    { EU433_LC1, EU433_LC2, EU433_LC3 },
+    LC( 1 ) + LC( 2 ) + LC( 3 ),
+    LC( 1 ) + LC( 2 ) + LC( 3 ),
+    DR_7,
+    NULL,
+    0,
 };
-#elif defined( USE_BAND_470 )
+#endif
 
+#if defined( USE_BAND_780 )
 /*!
- * Data rates table definition
+ * CN779 regional parameters
  */
-const uint8_t Datarates[]  = { 12, 11, 10,  9,  8,  7 };
+static const Region_t RegionCN779 =
+{
+    LORAMAC_REGION_CN779,
+    { 10, 7, 4, 1, -2, -5 },
+    CN779_DEFAULT_TX_POWER,
+    CN779_RX_WND_2_CHANNEL,
+    CN779_BEACON_CHANNEL,
+    { CN779_BAND0 },
+    { CN779_LC1, CN779_LC2, CN779_LC3 },
+    LC( 1 ) + LC( 2 ) + LC( 3 ),
+    LC( 1 ) + LC( 2 ) + LC( 3 ),
+    DR_7,
+    NULL,
+    0,
+};
+#endif
 
+#if defined( USE_BAND_868 )
 /*!
- * Bandwidths table definition in Hz
+ * EU868 sub-bands
  */
-const uint32_t Bandwidths[] = { 125e3, 125e3, 125e3, 125e3, 125e3, 125e3 };
+static const BandRange_t EU868BandRanges[] =
+{
+    { 863000000, 864999999, BAND_G1_2 },
+    { 865000000, 868000000, BAND_G1_0 },
+    { 868000001, 868600000, BAND_G1_1 },
+    { 868700000, 869200000, BAND_G1_2 },
+    { 869400000, 869650000, BAND_G1_3 },
+    { 869700000, 870000000, BAND_G1_4 },
+};
 
 /*!
- * Maximum payload with respect to the datarate index. Cannot operate with repeater.
+ * EU868 regional parameters
  */
-const uint8_t MaxPayloadOfDatarate[] = { 51, 51, 51, 115, 222, 222 };
+static const Region_t RegionEU868 =
+{
+    LORAMAC_REGION_EU868,
+    { 20, 14, 11,  8,  5,  2 },
+    EU868_DEFAULT_TX_POWER,
+    EU868_RX_WND_2_CHANNEL,
+    EU868_BEACON_CHANNEL,
+    { EU868_BAND0, EU868_BAND1, EU868_BAND2, EU868_BAND3, EU868_BAND4 },
+    { EU868_LC1, EU868_LC2, EU868_LC3 },
+    LC( 1 ) + LC( 2 ) + LC( 3 ),
+    LC( 1 ) + LC( 2 ) + LC( 3 ),
+    DR_7,
+    EU868BandRanges,
+    sizeof( EU868BandRanges ) / sizeof( EU868BandRanges[0] ),
+};
+#endif
 
 /*!
- * Maximum payload with respect to the datarate index. Can operate with repeater.
+ * Regions built in the image, the first one is active after the
+ * initialization
  */
-const uint8_t MaxPayloadOfDatarateRepeater[] = { 51, 51, 51, 115, 222, 222 };
+static const Region_t* const Regions[LORAMAC_NB_REGIONS] =
+{
+#if defined( USE_BAND_868 )
+    &RegionEU868,
+#endif
+#if defined( USE_BAND_433 )
+    &RegionEU433,
+#endif
+#if defined( USE_BAND_780 )
+    &RegionCN779,
+#endif
+};
 
+#if( LORAMAC_NB_REGIONS > 1 )
 /*!
- * Tx output powers table definition
+ * Active region, selected by MIB_REGION
  */
-const int8_t TxPowers[]    = { 17, 16, 14, 12, 10, 7, 5, 2 };
+static const Region_t* ActiveRegion = NULL;
+#else
+/*!
+ * Single region build. The regional parameters are constants, the compiler
+ * folds their accesses
+ */
+#define ActiveRegion                                Regions[0]
+#endif
 
 /*!
- * LoRaMac bands
+ * Tx output powers table of the active region
  */
-static Band_t Bands[LORA_MAX_NB_BANDS] =
-{
-    BAND0,
-};
+#define TxPowers                                    ( ActiveRegion->TxPowers )
 
 /*!
- * LoRaMAC channels
+ * Checks if the datarate is the FSK datarate of the active region
  */
-static ChannelParams_t Channels[LORA_MAX_NB_CHANNELS];
+#define IsFskDatarate( datarate )                   ( ( datarate ) == ActiveRegion->FskDatarate )
 
 /*!
- * Defines the first channel for RX window 1 for CN470 band
+ * Channels of the active region allowed for the join procedure
  */
-#define LORAMAC_FIRST_RX1_CHANNEL           ( (uint32_t) 500.3e6 )
+#define JoinChannelsMask                            ( ActiveRegion->JoinChannelsMask )
 
 /*!
- * Defines the last channel for RX window 1 for CN470 band
+ * LoRaMac bands, defaults of the active region
  */
-#define LORAMAC_LAST_RX1_CHANNEL            ( (uint32_t) 509.7e6 )
+static Band_t Bands[LORA_MAX_NB_BANDS];
 
 /*!
- * Defines the step width of the channels for RX window 1
+ * LoRaMAC channels, default channels of the active region
  */
-#define LORAMAC_STEPWIDTH_RX1_CHANNEL       ( (uint32_t) 200e3 )
+static ChannelParams_t Channels[LORA_MAX_NB_CHANNELS];
+#elif defined( USE_BAND_470 )
 
-#elif defined( USE_BAND_780 )
 /*!
  * Data rates table definition
  */
-const uint8_t Datarates[]  = { 12, 11, 10,  9,  8,  7,  7, 50 };
+const uint8_t Datarates[]  = { 12, 11, 10,  9,  8,  7 };
 
 /*!
  * Bandwidths table definition in Hz
  */
-const uint32_t Bandwidths[] = { 125e3, 125e3, 125e3, 125e3, 125e3, 125e3, 250e3, 0 };
+const uint32_t Bandwidths[] = { 125e3, 125e3, 125e3, 125e3, 125e3, 125e3 };
 
 /*!
  * Maximum payload with respect to the datarate index. Cannot operate with repeater.
  */
-const uint8_t MaxPayloadOfDatarate[] = { 51, 51, 51, 115, 242, 242, 242, 242 };
+const uint8_t MaxPayloadOfDatarate[] = { 51, 51, 51, 115, 222, 222 };
 
 /*!
  * Maximum payload with respect to the datarate index. Can operate with repeater.
  */
-const uint8_t MaxPayloadOfDatarateRepeater[] = { 51, 51, 51, 115, 222, 222, 222, 222 };
+const uint8_t MaxPayloadOfDatarateRepeater[] = { 51, 51, 51, 115, 222, 222 };
 
 /*!
  * Tx output powers table definition
  */
-const int8_t TxPowers[]    = { 10, 7, 4, 1, -2, -5 };
+const int8_t TxPowers[]    = { 17, 16, 14, 12, 10, 7, 5, 2 };
 
 /*!
  * LoRaMac bands
@@ -355,59 +531,33 @@ static Band_t Bands[LORA_MAX_NB_BANDS] =
 /*!
  * LoRaMAC channels
  */
-static ChannelParams_t Channels[LORA_MAX_NB_CHANNELS] =
-{
-    LC1,
-    LC2,
-    LC3,
-};
-#elif defined( USE_BAND_868 )
-/*!
- * Data rates table definition
- */
-const uint8_t Datarates[]  = { 12, 11, 10,  9,  8,  7,  7, 50 };
+static ChannelParams_t Channels[LORA_MAX_NB_CHANNELS];
 
 /*!
- * Bandwidths table definition in Hz
+ * Defines the first channel for RX window 1 for CN470 band
  */
-const uint32_t Bandwidths[] = { 125e3, 125e3, 125e3, 125e3, 125e3, 125e3, 250e3, 0 };
+#define LORAMAC_FIRST_RX1_CHANNEL           ( (uint32_t) 500.3e6 )
 
 /*!
- * Maximum payload with respect to the datarate index. Cannot operate with repeater.
+ * Defines the last channel for RX window 1 for CN470 band
  */
-const uint8_t MaxPayloadOfDatarate[] = { 51, 51, 51, 115, 242, 242, 242, 242 };
+#define LORAMAC_LAST_RX1_CHANNEL            ( (uint32_t) 509.7e6 )
 
 /*!
- * Maximum payload with respect to the datarate index. Can operate with repeater.
+ * Defines the step width of the channels for RX window 1
  */
-const uint8_t MaxPayloadOfDatarateRepeater[] = { 51, 51, 51, 115, 222, 222, 222, 222 };
+#define LORAMAC_STEPWIDTH_RX1_CHANNEL       ( (uint32_t) 200e3 )
 
 /*!
- * Tx output powers table definition
+ * The band has no FSK datarate
  */
-const int8_t TxPowers[]    = { 20, 14, 11,  8,  5,  2 };
+#define IsFskDatarate( datarate )                   false
 
 /*!
- * LoRaMac bands
+ * All the channels are allowed for the join procedure
  */
-static Band_t Bands[LORA_MAX_NB_BANDS] =
-{
-    BAND0,
-    BAND1,
-    BAND2,
-    BAND3,
-    BAND4,
-};
+#define JoinChannelsMask                            0xFFFF
 
-/*!
- * LoRaMAC channels
- */
-static ChannelParams_t Channels[LORA_MAX_NB_CHANNELS] =
-{
-    LC1,
-    LC2,
-    LC3,
-};
 #elif defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
 /*!
  * Data rates table definition
@@ -479,6 +629,16 @@ static uint16_t ChannelsMaskRemaining[6];
  */
 #define LORAMAC_STEPWIDTH_RX1_CHANNEL       ( (uint32_t) 600e3 )
 
+/*!
+ * The band has no FSK datarate
+ */
+#define IsFskDatarate( datarate )                   false
+
+/*!
+ * All the channels are allowed for the join procedure
+ */
+#define JoinChannelsMask                            0xFFFF
+
 #else
     #error "Please define a frequency band in the compiler options."
 #endif
@@ -603,6 +763,117 @@ typedef struct
  */
 static RxConfigParams_t RxWindowsParams[2];
 
+/*!
+ * Reception windows timing calibration context
+ */
+typedef struct sRxTiming
+{
+    /*!
+     * Time of the last radio valid header event
+     */
+    TimerTime_t HeaderTime;
+    /*!
+     * Indicates if HeaderTime belongs to the current uplink
+     */
+    bool HeaderValid;
+    /*!
+     * Mean timing error of the downlinks, scaled by 8 [ms]
+     */
+    int32_t Offset;
+    /*!
+     * Mean deviation of the timing error, scaled by 4 [ms]
+     */
+    uint32_t Deviation;
+    /*!
+     * Number of timing measurements
+     */
+    uint8_t NbSamples;
+    /*!
+     * Number of uplinks since the last timing measurement
+     */
+    uint8_t NbUncalibrated;
+}RxTiming_t;
+
+/*!
+ * Reception windows timing calibration
+ */
+static RxTiming_t RxTiming;
+
+/*!
+ * Device side ADR context
+ */
+typedef struct sLinkAdr
+{
+    /*!
+     * Set by MIB_LINK_ADR
+     */
+    bool Enabled;
+    /*!
+     * Indicates if the network drives the ADR with LinkADRReq commands
+     */
+    bool ServerControlled;
+    /*!
+     * Estimated uplink SNR at the default TX power and 125 kHz [0.25 dB]
+     */
+    int16_t History[LINK_ADR_HISTORY_SIZE];
+    /*!
+     * Next history entry
+     */
+    uint8_t Index;
+    /*!
+     * Number of samples since the last reset
+     */
+    uint8_t NbSamples;
+}LinkAdr_t;
+
+/*!
+ * Device side ADR
+ */
+static LinkAdr_t LinkAdr;
+
+/*!
+ * Radio current consumption table
+ */
+static LoRaMacEnergyTable_t EnergyTable;
+
+/*!
+ * Energy of the last completed transaction and of the current one
+ */
+static LoRaMacEnergy_t Energy;
+static LoRaMacEnergy_t EnergyCurrent;
+
+/*!
+ * Charge drawn during the current transaction [nA.us]
+ */
+static uint64_t EnergyCharge;
+
+/*!
+ * Receive mode time [us] and charge [nA.us] outside of the transactions
+ */
+static uint64_t EnergyBackgroundRxTime;
+static uint64_t EnergyBackgroundCharge;
+
+/*!
+ * Set while the energy accounting is updated. An interrupt updating it
+ * meanwhile leaves the times to the interrupted update
+ */
+static volatile bool EnergyUpdating = false;
+
+/*!
+ * Energy accounting periodic update timer
+ */
+static TimerEvent_t EnergyTimer;
+
+/*!
+ * Radio operating modes times at the last energy update
+ */
+static RadioOpModeTimes_t EnergyTimes;
+
+/*!
+ * Tx power index of the last transmitted frame
+ */
+static int8_t EnergyTxPower;
+
 /*!
  * Acknowledge timeout timer. Used for packet retransmissions.
  */
@@ -653,11 +924,124 @@ static McpsConfirm_t McpsConfirm;
  */
 static MlmeConfirm_t MlmeConfirm;
 
+/*!
+ * Structure to hold MLME indication data.
+ */
+static MlmeIndication_t MlmeIndication;
+
 /*!
  * Holds the current rx window slot
  */
 static uint8_t RxSlot = 0;
 
+/*!
+ * Class B beacon states
+ */
+typedef enum eBeaconState
+{
+    /*!
+     * Class B beacon tracking stopped
+     */
+    BEACON_STATE_OFF,
+    /*!
+     * Listening continuously for a beacon
+     */
+    BEACON_STATE_ACQUISITION,
+    /*!
+     * Beacon period synchronized. Also used during the beacon-less operation
+     */
+    BEACON_STATE_LOCKED,
+}BeaconState_t;
+
+/*!
+ * Class B beacon tracking context
+ */
+static struct sBeaconCtx
+{
+    /*!
+     * Beacon tracking state
+     */
+    BeaconState_t State;
+    /*!
+     * Local time of the current beacon period start
+     */
+    TimerTime_t PeriodStart;
+    /*!
+     * GPS time of the current beacon period start [s]
+     */
+    uint32_t BeaconTime;
+    /*!
+     * Number of consecutive beacons missed
+     */
+    uint16_t NbMissed;
+    /*!
+     * Timing error accumulated since the last beacon received [ms]
+     */
+    uint32_t WindowWidening;
+    /*!
+     * Rssi and Snr of the last beacon received
+     */
+    int16_t Rssi;
+    uint8_t Snr;
+}BeaconCtx;
+
+/*!
+ * Class B beacon channel. Regional default set by the initialization
+ */
+static Rx2ChannelParams_t BeaconChannel;
+
+/*!
+ * Beacon window parameters
+ */
+static RxConfigParams_t BeaconRxParams;
+
+/*!
+ * Beacon window and beacon acquisition timeout timer
+ */
+static TimerEvent_t BeaconTimer;
+
+/*!
+ * Class B ping slot channel. Regional default set by the initialization
+ */
+static Rx2ChannelParams_t PingSlotChannel;
+
+/*!
+ * Ping slot periodicity. The node opens 2^( 7 - periodicity ) ping slots per
+ * beacon period
+ */
+static uint8_t PingSlotPeriodicity = 7;
+
+/*!
+ * Ping slot periodicity requested to the network server
+ */
+static uint8_t PingSlotPeriodicityReq = 7;
+
+/*!
+ * Ping slot periodicity accepted by the network server. Applied from the next
+ * beacon period
+ */
+static uint8_t PingSlotPeriodicityNew = 7;
+
+/*!
+ * Ping slot offset of the current beacon period
+ */
+static uint16_t PingSlotOffset = 0;
+
+/*!
+ * Index of the next ping slot of the current beacon period
+ */
+static uint16_t PingSlotNext = 0;
+
+/*!
+ * Ping slot window parameters
+ */
+static RxConfigParams_t PingSlotRxParams;
+
+/*!
+ * Ping slot timer
+ */
+static TimerEvent_t PingSlotTimer;
+
 /*!
  * LoRaMac tx/rx operation state
  */
@@ -675,10 +1059,27 @@ static void OnRadioTxDone( void );
 static void PrepareRxDoneAbort( void );
 
 /*!
- * \brief Function to be executed on Radio Rx Done event
+ * \brief Function to be executed on Radio Rx Done event. Takes the ownership
+ *        of the frame pool block holding the frame
  */
 static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr );
 
+/*!
+ * \brief Processes a received frame. The frame is decrypted in place
+ */
+static void ProcessRxFrame( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr );
+
+/*!
+ * \brief Releases the frame pool block lent to the application by the MCPS
+ *        indication
+ */
+static void McpsIndicationRelease( void );
+
+/*!
+ * \brief Releases the frame pool block of the sent frame
+ */
+static void ReleaseTxBuffer( void );
+
 /*!
  * \brief Function executed on Radio Tx Timeout event
  */
@@ -694,6 +1095,11 @@ static void OnRadioRxError( void );
  */
 static void OnRadioRxTimeout( void );
 
+/*!
+ * \brief Function executed on Radio Valid Header event
+ */
+static void OnRadioValidHeader( void );
+
 /*!
  * \brief Function executed on Resend Frame timer event.
  */
@@ -720,36 +1126,142 @@ static void OnRxWindow2TimerEvent( void );
 static void OnAckTimeoutTimerEvent( void );
 
 /*!
- * \brief Searches and set the next random available channel
- *
- * \param [OUT] Time to wait for the next transmission according to the duty
- *              cycle.
- *
- * \retval status  Function status [1: OK, 0: Unable to find a channel on the
- *                                  current datarate]
+ * \brief Function executed on Beacon timer event. Opens the beacon window or
+ *        terminates the beacon acquisition
  */
-static bool SetNextChannel( TimerTime_t* time );
+static void OnBeaconTimerEvent( void );
 
 /*!
- * \brief Initializes and opens the reception window
+ * \brief Function executed on Ping slot timer event
+ */
+static void OnPingSlotTimerEvent( void );
+
+/*!
+ * \brief Function executed on Energy timer event. Updates the energy
+ *        accounting before the radio times wrap around
+ */
+static void OnEnergyTimerEvent( void );
+
+/*!
+ * \brief Initializes and opens the beacon reception window
  *
- * \param [IN] freq window channel frequency
- * \param [IN] datarate window channel datarate
- * \param [IN] bandwidth window channel bandwidth
- * \param [IN] timeout window channel timeout
+ * \param [IN] timeout window timeout in symbols
+ * \param [IN] rxContinuous continuous reception, used by the beacon acquisition
  *
  * \retval status Operation status [true: Success, false: Fail]
  */
-static bool RxWindowSetup( uint32_t freq, int8_t datarate, uint32_t bandwidth, uint16_t timeout, bool rxContinuous );
+static bool RxBeaconSetup( uint16_t timeout, bool rxContinuous );
 
 /*!
- * \brief Verifies if the RX window 2 frequency is in range
+ * \brief Validates a received beacon frame
  *
- * \param [IN] freq window channel frequency
+ * \param [IN]  payload    Beacon frame
+ * \param [IN]  size       Beacon frame size
+ * \param [OUT] beaconTime GPS time of the beacon [s]
  *
- * \retval status  Function status [1: OK, 0: Frequency not applicable]
+ * \retval status [true: valid beacon, false: invalid beacon]
  */
-static bool Rx2FreqInRange( uint32_t freq );
+static bool BeaconValidate( uint8_t *payload, uint16_t size, uint32_t *beaconTime );
+
+/*!
+ * \brief Function to be executed on Radio Rx Done event of the beacon window
+ */
+static void OnBeaconRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr, TimerTime_t rxDoneTime );
+
+/*!
+ * \brief Function to be executed when the beacon window ends without beacon
+ */
+static void OnBeaconRxFailure( void );
+
+/*!
+ * \brief Schedules the beacon window and the ping slots of the current beacon
+ *        period
+ */
+static void BeaconNewPeriod( void );
+
+/*!
+ * \brief Stops the class B beacon tracking and ping slots
+ */
+static void BeaconStop( void );
+
+/*!
+ * \brief Computes the ping slots of the current beacon period and schedules
+ *        the first one
+ */
+static void PingSlotNewPeriod( void );
+
+/*!
+ * \brief Schedules the next ping slot of the current beacon period
+ */
+static void PingSlotScheduleNext( void );
+
+/*!
+ * \brief Notifies a class B event to the upper layer
+ *
+ * \param [IN] status Event status
+ */
+static void BeaconIndicate( LoRaMacEventInfoStatus_t status );
+
+/*!
+ * \brief Computes the delay needed so that a transmission and its receive
+ *        windows do not overlap the beacon guard and reserved times
+ *
+ * \param [IN] txDelay Transmission delay [ms]
+ *
+ * \retval txDelay Transmission delay [ms]
+ */
+static TimerTime_t BeaconGuardTxDelay( TimerTime_t txDelay );
+
+/*!
+ * \brief Searches and set the next random available channel
+ *
+ * \param [OUT] Time to wait for the next transmission according to the duty
+ *              cycle.
+ *
+ * \retval status  Function status [1: OK, 0: Unable to find a channel on the
+ *                                  current datarate]
+ */
+static bool SetNextChannel( TimerTime_t* time );
+
+/*!
+ * \brief Initializes and opens the reception window
+ *
+ * \param [IN] freq window channel frequency
+ * \param [IN] datarate window channel datarate
+ * \param [IN] bandwidth window channel bandwidth
+ * \param [IN] timeout window channel timeout
+ *
+ * \retval status Operation status [true: Success, false: Fail]
+ */
+static bool RxWindowSetup( uint32_t freq, int8_t datarate, uint32_t bandwidth, uint16_t timeout, bool rxContinuous );
+
+/*!
+ * \brief Computes the home slot of a multicast address in the multicast
+ *        channels table
+ *
+ * \param [IN] address multicast address
+ *
+ * \retval index Home slot index
+ */
+static uint8_t MulticastChannelHash( uint32_t address );
+
+/*!
+ * \brief Searches a multicast address in the multicast channels table
+ *
+ * \param [IN] address multicast address
+ *
+ * \retval channel Pointer to the multicast channel. NULL if not found
+ */
+static MulticastParams_t* MulticastChannelFind( uint32_t address );
+
+/*!
+ * \brief Verifies if the RX window 2 frequency is in range
+ *
+ * \param [IN] freq window channel frequency
+ *
+ * \retval status  Function status [1: OK, 0: Frequency not applicable]
+ */
+static bool Rx2FreqInRange( uint32_t freq );
 
 /*!
  * \brief Adds a new MAC command to be sent.
@@ -997,6 +1509,14 @@ LoRaMacStatus_t SetTxContinuousWave1( uint16_t timeout, uint32_t frequency, uint
  */
 static void ResetMacParameters( void );
 
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+/*!
+ * \brief Applies the defaults of the active region: bands, default channels,
+ *        TX power, receive window 2 and class B channels
+ */
+static void RegionSetDefaults( void );
+#endif
+
 /*
  * Rx window precise timing
  *
@@ -1047,10 +1567,187 @@ static void ResetMacParameters( void );
  */
 static RxConfigParams_t ComputeRxWindowParameters( int8_t datarate, uint32_t rxError );
 
-static void OnRadioTxDone( void )
+/*!
+ * \brief Resets the reception windows timing calibration. The windows are
+ *        sized from SystemMaxRxError until enough downlinks are measured
+ */
+static void RxTimingReset( void );
+
+/*!
+ * \brief Measures the timing error of the downlink received in the current
+ *        RX1 or RX2 window and updates the timing error estimate
+ *
+ * \remark The error is the difference between the radio valid header event
+ *         and the end of the header expected from the receive delay
+ */
+static void RxTimingUpdate( void );
+
+/*!
+ * \brief Gets the timing error the reception windows must cover
+ *
+ * \param [OUT] offset      Mean timing error to add to the windows delays [ms]
+ *
+ * \retval rxError          Maximum timing error of the receiver [ms]
+ */
+static uint32_t RxTimingGetError( int32_t *offset );
+
+/*!
+ * \brief Clears the device side ADR link margin samples
+ *
+ * \param [IN] serverControlled Network driven ADR state
+ */
+static void LinkAdrReset( bool serverControlled );
+
+/*!
+ * \brief Gets the noise increase of a datarate bandwidth over 125 kHz
+ *
+ * \param [IN] datarate     Datarate
+ *
+ * \retval offset           Noise increase [0.25 dB]
+ */
+static int16_t LinkAdrNoiseOffset( int8_t datarate );
+
+/*!
+ * \brief Gets the SNR a datarate requires at the gateway, normalized to a
+ *        125 kHz bandwidth
+ *
+ * \param [IN] datarate     Uplink datarate
+ *
+ * \retval snr              Required SNR [0.25 dB], INT16_MAX when the datarate
+ *                          is not a LoRa one
+ */
+static int16_t LinkAdrRequiredSnr( int8_t datarate );
+
+/*!
+ * \brief Adds the link margin sample of a unicast downlink
+ *
+ * \param [IN] snr          Downlink SNR [0.25 dB]
+ */
+static void LinkAdrOnDownlink( int8_t snr );
+
+/*!
+ * \brief Adds the link margin sample of a link check answer
+ *
+ * \param [IN] margin       Demodulation margin of the last uplink [dB]
+ * \param [IN] nbGateways   Number of gateways which received the last uplink
+ */
+static void LinkAdrOnLinkCheck( uint8_t margin, uint8_t nbGateways );
+
+/*!
+ * \brief Adds a link margin sample and selects the fastest datarate and the
+ *        lowest TX power which keep LINK_ADR_MARGIN
+ *
+ * \param [IN] snr          Estimated uplink SNR at the default TX power,
+ *                          normalized to a 125 kHz bandwidth [0.25 dB]
+ */
+static void LinkAdrUpdate( int16_t snr );
+
+/*!
+ * \brief Computes the payload keystreams of the next uplink and of the next
+ *        expected downlink while the MAC is idle
+ */
+static void PrecomputeKeyStreams( void );
+
+/*!
+ * \brief Initializes the energy accounting with the default current table
+ *
+ * \remark The default currents are the typical values of the SX1276
+ *         datasheet
+ */
+static void EnergyInit( void );
+
+/*!
+ * \brief Adds the radio time and charge since the last update to the current
+ *        transaction, or to the background outside of the transactions
+ */
+static void EnergyUpdate( void );
+
+/*!
+ * \brief Starts the energy accounting of a new transaction
+ *
+ * \param [IN] transaction  Transaction type
+ */
+static void EnergyStart( LoRaMacEnergyTransaction_t transaction );
+
+/*!
+ * \brief Ends the current transaction and publishes its energy
+ */
+static void EnergyEnd( void );
+
+/*!
+ * Computes the time on air of an uplink frame without configuring the radio.
+ *
+ * \param [IN] datarate     Tx datarate to be used
+ * \param [IN] pktLen       PHY payload length
+ *
+ * \retval airTime          Time on air of the frame [ms]
+ */
+static TimerTime_t ComputeTxTimeOnAir( int8_t datarate, uint8_t pktLen );
+
+/*!
+ * \brief Reads the current time. The time is an input of the MAC layer, it
+ *        is captured
+ *
+ * \remark The read only functions, LoRaMacQueryTxPlan and LoRaMacSessionGet,
+ *         read the time directly: their readings are not captured
+ *
+ * \retval time Current time [ms]
+ */
+static TimerTime_t MacGetCurrentTime( void );
+
+/*!
+ * \brief Gets the time elapsed since a time read by MacGetCurrentTime
+ *
+ * \param [IN] savedTime Time read by MacGetCurrentTime [ms]
+ *
+ * \retval time Elapsed time [ms]
+ */
+static TimerTime_t MacGetElapsedTime( TimerTime_t savedTime );
+
+/*!
+ * \brief Adds a channel. Same as LoRaMacChannelAdd, without capture, for the
+ *        channels set by the network
+ */
+static LoRaMacStatus_t ChannelAdd( uint8_t id, ChannelParams_t params );
+
+/*!
+ * \brief Removes a channel. Same as LoRaMacChannelRemove, without capture,
+ *        for the channels removed by the network
+ */
+static LoRaMacStatus_t ChannelRemove( uint8_t id );
+
+static TimerTime_t MacGetCurrentTime( void )
 {
     TimerTime_t curTime = TimerGetCurrentTime( );
 
+    CAPTURE( CAPTURE_TIME, &curTime, sizeof( curTime ), NULL, 0 );
+    return curTime;
+}
+
+static TimerTime_t MacGetElapsedTime( TimerTime_t savedTime )
+{
+    return ( TimerTime_t )( MacGetCurrentTime( ) - savedTime );
+}
+
+static void OnRadioTxDone( void )
+{
+    TimerTime_t curTime = 0;
+
+    TRACE_RADIO( TRACE_RADIO_TX_DONE, 0, 0 );
+    CAPTURE_EVENT( CAPTURE_RADIO_TX_DONE );
+    // Read after the event is captured, the readings follow their event in
+    // the capture
+    curTime = MacGetCurrentTime( );
+
+    RxTiming.HeaderValid = false;
+    if( RxTiming.NbUncalibrated < 255 )
+    {
+        RxTiming.NbUncalibrated++;
+    }
+
+    EnergyUpdate( );
+    EnergyCurrent.NbTx++;
+
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1105,6 +1802,8 @@ static void OnRadioTxDone( void )
 
 static void PrepareRxDoneAbort( void )
 {
+    TRACE_MAC( TRACE_MAC_RX_ABORT, McpsIndication.Status, 0 );
+
     LoRaMacState |= LORAMAC_RX_ABORT;
 
     if( NodeAckRequested )
@@ -1122,6 +1821,40 @@ static void PrepareRxDoneAbort( void )
 
 static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
 {
+    FramePoolHandOff( payload, FRAME_POOL_MAC );
+
+    ProcessRxFrame( payload, size, rssi, snr );
+
+    // The block is still owned by the MAC layer when it holds no payload for
+    // the application
+    if( FramePoolGetOwner( payload ) == FRAME_POOL_MAC )
+    {
+        FramePoolFree( payload );
+    }
+}
+
+static void McpsIndicationRelease( void )
+{
+    if( McpsIndication.Buffer != NULL )
+    {
+        FramePoolFree( McpsIndication.Buffer );
+    }
+    McpsIndication.Buffer = NULL;
+    McpsIndication.BufferSize = 0;
+}
+
+static void ReleaseTxBuffer( void )
+{
+    if( LoRaMacBuffer != NULL )
+    {
+        FramePoolFree( LoRaMacBuffer );
+        LoRaMacBuffer = NULL;
+    }
+}
+
+static void ProcessRxFrame( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+{
+    PROFILE_SCOPE( PROFILE_RADIO_RX_DONE );
     LoRaMacHeader_t macHdr;
     LoRaMacFrameCtrl_t fCtrl;
     bool skipIndication = false;
@@ -1146,6 +1879,21 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     uint8_t multicast = 0;
 
     bool isMicOk = false;
+#if( CAPTURE_MAC_ON )
+    uint8_t captureHeader[3] = { ( uint8_t )( rssi & 0xFF ), ( uint8_t )( ( rssi >> 8 ) & 0xFF ), ( uint8_t )snr };
+#endif
+
+    TRACE_RADIO( TRACE_RADIO_RX_DONE, size, rssi );
+    CAPTURE( CAPTURE_RADIO_RX_DONE, captureHeader, sizeof( captureHeader ), payload, size );
+
+    if( RxSlot == RX_SLOT_BEACON )
+    {
+        TimerTime_t rxDoneTime = MacGetCurrentTime( );
+
+        Radio.Sleep( );
+        OnBeaconRxDone( payload, size, rssi, snr, rxDoneTime );
+        return;
+    }
 
     McpsConfirm.AckReceived = false;
     McpsIndication.Rssi = rssi;
@@ -1154,8 +1902,8 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     McpsIndication.Port = 0;
     McpsIndication.Multicast = 0;
     McpsIndication.FramePending = 0;
-    McpsIndication.Buffer = NULL;
-    McpsIndication.BufferSize = 0;
+    // A payload not indicated yet is lost
+    McpsIndicationRelease( );
     McpsIndication.RxData = false;
     McpsIndication.AckReceived = false;
     McpsIndication.DownLinkCounter = 0;
@@ -1175,36 +1923,34 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                 PrepareRxDoneAbort( );
                 return;
             }
-            LoRaMacJoinDecrypt( payload + 1, size - 1, LoRaMacAppKey, LoRaMacRxPayload + 1 );
-
-            LoRaMacRxPayload[0] = macHdr.Value;
+            LoRaMacJoinDecrypt( payload + 1, size - 1, LoRaMacAppKey, payload + 1 );
 
-            LoRaMacJoinComputeMic( LoRaMacRxPayload, size - LORAMAC_MFR_LEN, LoRaMacAppKey, &mic );
+            LoRaMacJoinComputeMic( payload, size - LORAMAC_MFR_LEN, LoRaMacAppKey, &mic );
 
-            micRx |= ( uint32_t )LoRaMacRxPayload[size - LORAMAC_MFR_LEN];
-            micRx |= ( ( uint32_t )LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 1] << 8 );
-            micRx |= ( ( uint32_t )LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 2] << 16 );
-            micRx |= ( ( uint32_t )LoRaMacRxPayload[size - LORAMAC_MFR_LEN + 3] << 24 );
+            micRx |= ( uint32_t )payload[size - LORAMAC_MFR_LEN];
+            micRx |= ( ( uint32_t )payload[size - LORAMAC_MFR_LEN + 1] << 8 );
+            micRx |= ( ( uint32_t )payload[size - LORAMAC_MFR_LEN + 2] << 16 );
+            micRx |= ( ( uint32_t )payload[size - LORAMAC_MFR_LEN + 3] << 24 );
 
             if( micRx == mic )
             {
-                LoRaMacJoinComputeSKeys( LoRaMacAppKey, LoRaMacRxPayload + 1, LoRaMacDevNonce, LoRaMacNwkSKey, LoRaMacAppSKey );
+                LoRaMacJoinComputeSKeys( LoRaMacAppKey, payload + 1, LoRaMacDevNonce, LoRaMacNwkSKey, LoRaMacAppSKey );
 
-                LoRaMacNetID = ( uint32_t )LoRaMacRxPayload[4];
-                LoRaMacNetID |= ( ( uint32_t )LoRaMacRxPayload[5] << 8 );
-                LoRaMacNetID |= ( ( uint32_t )LoRaMacRxPayload[6] << 16 );
+                LoRaMacNetID = ( uint32_t )payload[4];
+                LoRaMacNetID |= ( ( uint32_t )payload[5] << 8 );
+                LoRaMacNetID |= ( ( uint32_t )payload[6] << 16 );
 
-                LoRaMacDevAddr = ( uint32_t )LoRaMacRxPayload[7];
-                LoRaMacDevAddr |= ( ( uint32_t )LoRaMacRxPayload[8] << 8 );
-                LoRaMacDevAddr |= ( ( uint32_t )LoRaMacRxPayload[9] << 16 );
-                LoRaMacDevAddr |= ( ( uint32_t )LoRaMacRxPayload[10] << 24 );
+                LoRaMacDevAddr = ( uint32_t )payload[7];
+                LoRaMacDevAddr |= ( ( uint32_t )payload[8] << 8 );
+                LoRaMacDevAddr |= ( ( uint32_t )payload[9] << 16 );
+                LoRaMacDevAddr |= ( ( uint32_t )payload[10] << 24 );
 
                 // DLSettings
-                LoRaMacParams.Rx1DrOffset = ( LoRaMacRxPayload[11] >> 4 ) & 0x07;
-                LoRaMacParams.Rx2Channel.Datarate = LoRaMacRxPayload[11] & 0x0F;
+                LoRaMacParams.Rx1DrOffset = ( payload[11] >> 4 ) & 0x07;
+                LoRaMacParams.Rx2Channel.Datarate = payload[11] & 0x0F;
 
                 // RxDelay
-                LoRaMacParams.ReceiveDelay1 = ( LoRaMacRxPayload[12] & 0x0F );
+                LoRaMacParams.ReceiveDelay1 = ( payload[12] & 0x0F );
                 if( LoRaMacParams.ReceiveDelay1 == 0 )
                 {
                     LoRaMacParams.ReceiveDelay1 = 1;
@@ -1222,14 +1968,14 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                     LoRaMacState |= LORAMAC_TX_CONFIG;
                     for( uint8_t i = 3, j = 0; i < ( 5 + 3 ); i++, j += 3 )
                     {
-                        param.Frequency = ( ( uint32_t )LoRaMacRxPayload[13 + j] | ( ( uint32_t )LoRaMacRxPayload[14 + j] << 8 ) | ( ( uint32_t )LoRaMacRxPayload[15 + j] << 16 ) ) * 100;
+                        param.Frequency = ( ( uint32_t )payload[13 + j] | ( ( uint32_t )payload[14 + j] << 8 ) | ( ( uint32_t )payload[15 + j] << 16 ) ) * 100;
                         if( param.Frequency != 0 )
                         {
-                            LoRaMacChannelAdd( i, param );
+                            ChannelAdd( i, param );
                         }
                         else
                         {
-                            LoRaMacChannelRemove( i );
+                            ChannelRemove( i );
                         }
                     }
                     LoRaMacState &= ~LORAMAC_TX_CONFIG;
@@ -1254,18 +2000,13 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
                 if( address != LoRaMacDevAddr )
                 {
-                    curMulticastParams = MulticastChannels;
-                    while( curMulticastParams != NULL )
+                    curMulticastParams = MulticastChannelFind( address );
+                    if( curMulticastParams != NULL )
                     {
-                        if( address == curMulticastParams->Address )
-                        {
-                            multicast = 1;
-                            nwkSKey = curMulticastParams->NwkSKey;
-                            appSKey = curMulticastParams->AppSKey;
-                            downLinkCounter = curMulticastParams->DownLinkCounter;
-                            break;
-                        }
-                        curMulticastParams = curMulticastParams->Next;
+                        multicast = 1;
+                        nwkSKey = curMulticastParams->NwkSKey;
+                        appSKey = curMulticastParams->AppSKey;
+                        downLinkCounter = curMulticastParams->DownLinkCounter;
                     }
                     if( multicast == 0 )
                     {
@@ -1339,6 +2080,12 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
 
                     McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
 
+                    if( multicast == 0 )
+                    {
+                        RxTimingUpdate( );
+                        LinkAdrOnDownlink( snr );
+                    }
+
                     AdrAckCounter = 0;
                     MacCommandsBufferToRepeatIndex = 0;
 
@@ -1427,10 +2174,10 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                                                        address,
                                                        DOWN_LINK,
                                                        downLinkCounter,
-                                                       LoRaMacRxPayload );
+                                                       payload + appPayloadStartIndex );
 
                                 // Decode frame payload MAC commands
-                                ProcessMacCommands( LoRaMacRxPayload, 0, frameLen, snr );
+                                ProcessMacCommands( payload, appPayloadStartIndex, appPayloadStartIndex + frameLen, snr );
                             }
                             else
                             {
@@ -1451,11 +2198,13 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                                                    address,
                                                    DOWN_LINK,
                                                    downLinkCounter,
-                                                   LoRaMacRxPayload );
+                                                   payload + appPayloadStartIndex );
 
                             if( skipIndication == false )
                             {
-                                McpsIndication.Buffer = LoRaMacRxPayload;
+                                // Lent to the application until the indication returns
+                                FramePoolHandOff( payload, FRAME_POOL_APP );
+                                McpsIndication.Buffer = payload + appPayloadStartIndex;
                                 McpsIndication.BufferSize = frameLen;
                                 McpsIndication.RxData = true;
                             }
@@ -1494,6 +2243,8 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                             }
                         }
                     }
+                    TRACE_MAC( TRACE_MAC_RX_FRAME, macHdr.Value, sequenceCounter );
+
                     // Provide always an indication, skip the callback to the user application,
                     // in case of a confirmed downlink retransmission.
                     LoRaMacFlags.Bits.McpsInd = 1;
@@ -1501,6 +2252,8 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
                 }
                 else
                 {
+                    TRACE_MAC( TRACE_MAC_MIC_FAIL, macHdr.Value, sequenceCounter );
+                    LOG_WARNING( MAC, "LoRaMac: MIC failure, address 0x%08X, counter %u\n", address, downLinkCounter );
                     McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_MIC_FAIL;
 
                     PrepareRxDoneAbort( );
@@ -1510,11 +2263,11 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
             break;
         case FRAME_TYPE_PROPRIETARY:
             {
-                memcpy1( LoRaMacRxPayload, &payload[pktHeaderLen], size );
+                FramePoolHandOff( payload, FRAME_POOL_APP );
 
                 McpsIndication.McpsIndication = MCPS_PROPRIETARY;
                 McpsIndication.Status = LORAMAC_EVENT_INFO_STATUS_OK;
-                McpsIndication.Buffer = LoRaMacRxPayload;
+                McpsIndication.Buffer = payload + pktHeaderLen;
                 McpsIndication.BufferSize = size - pktHeaderLen;
 
                 LoRaMacFlags.Bits.McpsInd = 1;
@@ -1532,8 +2285,20 @@ static void OnRadioRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t
     TimerStart( &MacStateCheckTimer );
 }
 
+static void OnRadioValidHeader( void )
+{
+    TRACE_RADIO( TRACE_RADIO_VALID_HEADER, 0, 0 );
+    CAPTURE_EVENT( CAPTURE_RADIO_VALID_HEADER );
+
+    RxTiming.HeaderTime = MacGetCurrentTime( );
+    RxTiming.HeaderValid = true;
+}
+
 static void OnRadioTxTimeout( void )
 {
+    TRACE_RADIO( TRACE_RADIO_TX_TIMEOUT, 0, 0 );
+    CAPTURE_EVENT( CAPTURE_RADIO_TX_TIMEOUT );
+
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1550,6 +2315,19 @@ static void OnRadioTxTimeout( void )
 
 static void OnRadioRxError( void )
 {
+    TRACE_RADIO( TRACE_RADIO_RX_ERROR, RxSlot, 0 );
+    CAPTURE_EVENT( CAPTURE_RADIO_RX_ERROR );
+
+    if( ( RxSlot == RX_SLOT_BEACON ) || ( RxSlot == RX_SLOT_PING ) )
+    {
+        Radio.Sleep( );
+        if( RxSlot == RX_SLOT_BEACON )
+        {
+            OnBeaconRxFailure( );
+        }
+        return;
+    }
+
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1567,7 +2345,7 @@ static void OnRadioRxError( void )
         }
         MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_RX1_ERROR;
 
-        if( TimerGetElapsedTime( AggregatedLastTxDoneTime ) >= RxWindow2Delay )
+        if( MacGetElapsedTime( AggregatedLastTxDoneTime ) >= RxWindow2Delay )
         {
             LoRaMacFlags.Bits.MacDone = 1;
         }
@@ -1585,6 +2363,19 @@ static void OnRadioRxError( void )
 
 static void OnRadioRxTimeout( void )
 {
+    TRACE_RADIO( TRACE_RADIO_RX_TIMEOUT, RxSlot, 0 );
+    CAPTURE_EVENT( CAPTURE_RADIO_RX_TIMEOUT );
+
+    if( ( RxSlot == RX_SLOT_BEACON ) || ( RxSlot == RX_SLOT_PING ) )
+    {
+        Radio.Sleep( );
+        if( RxSlot == RX_SLOT_BEACON )
+        {
+            OnBeaconRxFailure( );
+        }
+        return;
+    }
+
     if( LoRaMacDeviceClass != CLASS_C )
     {
         Radio.Sleep( );
@@ -1743,8 +2534,8 @@ static void OnMacStateCheckTimerEvent( void )
             else
             {
 #if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
-                // Re-enable default channels LC1, LC2, LC3
-                LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ( LC( 1 ) + LC( 2 ) + LC( 3 ) );
+                // Re-enable the default channels of the region
+                LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ActiveRegion->DefaultChannelsMask;
 #elif defined( USE_BAND_470 )
                 // Re-enable default channels
                 memcpy1( ( uint8_t* )LoRaMacParams.ChannelsMask, ( uint8_t* )LoRaMacParamsDefaults.ChannelsMask, sizeof( LoRaMacParams.ChannelsMask ) );
@@ -1777,6 +2568,11 @@ static void OnMacStateCheckTimerEvent( void )
     }
     if( LoRaMacState == LORAMAC_IDLE )
     {
+        if( ( LoRaMacFlags.Bits.McpsReq == 1 ) || ( LoRaMacFlags.Bits.MlmeReq == 1 ) )
+        {
+            EnergyEnd( );
+        }
+
         if( LoRaMacFlags.Bits.McpsReq == 1 )
         {
             LoRaMacPrimitives->MacMcpsConfirm( &McpsConfirm );
@@ -1791,6 +2587,9 @@ static void OnMacStateCheckTimerEvent( void )
 
         // Procedure done. Reset variables.
         LoRaMacFlags.Bits.MacDone = 0;
+        ReleaseTxBuffer( );
+
+        PrecomputeKeyStreams( );
     }
     else
     {
@@ -1809,9 +2608,19 @@ static void OnMacStateCheckTimerEvent( void )
         {
             LoRaMacPrimitives->MacMcpsIndication( &McpsIndication );
         }
+        McpsIndicationRelease( );
         LoRaMacFlags.Bits.McpsIndSkip = 0;
         LoRaMacFlags.Bits.McpsInd = 0;
     }
+
+    if( LoRaMacFlags.Bits.MlmeInd == 1 )
+    {
+        if( LoRaMacPrimitives->MacMlmeIndication != NULL )
+        {
+            LoRaMacPrimitives->MacMlmeIndication( &MlmeIndication );
+        }
+        LoRaMacFlags.Bits.MlmeInd = 0;
+    }
 }
 
 static void OnTxDelayedTimerEvent( void )
@@ -1886,8 +2695,11 @@ static void OnAckTimeoutTimerEvent( void )
 
     if( NodeAckRequested == true )
     {
+        TRACE_MAC( TRACE_MAC_ACK_TIMEOUT, AckTimeoutRetriesCounter, 0 );
         AckTimeoutRetry = true;
         LoRaMacState &= ~LORAMAC_ACK_REQ;
+        // The acknowledge may have been missed by too narrow windows
+        RxTimingReset( );
     }
     if( LoRaMacDeviceClass == CLASS_C )
     {
@@ -1895,44 +2707,331 @@ static void OnAckTimeoutTimerEvent( void )
     }
 }
 
-static bool SetNextChannel( TimerTime_t* time )
+static void OnBeaconTimerEvent( void )
 {
-    uint8_t nbEnabledChannels = 0;
-    uint8_t delayTx = 0;
-    uint8_t enabledChannels[LORA_MAX_NB_CHANNELS];
-    TimerTime_t nextTxDelay = ( TimerTime_t )( -1 );
-
-    memset1( enabledChannels, 0, LORA_MAX_NB_CHANNELS );
+    TimerStop( &BeaconTimer );
 
-#if defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
-    if( CountNbEnabled125kHzChannels( ChannelsMaskRemaining ) == 0 )
-    { // Restore default channels
-        memcpy1( ( uint8_t* ) ChannelsMaskRemaining, ( uint8_t* ) LoRaMacParams.ChannelsMask, 8 );
-    }
-    if( ( LoRaMacParams.ChannelsDatarate >= DR_4 ) && ( ( ChannelsMaskRemaining[4] & 0x00FF ) == 0 ) )
-    { // Make sure, that the channels are activated
-        ChannelsMaskRemaining[4] = LoRaMacParams.ChannelsMask[4];
-    }
-#elif defined( USE_BAND_470 )
-    if( ( CountBits( LoRaMacParams.ChannelsMask[0], 16 ) == 0 ) &&
-        ( CountBits( LoRaMacParams.ChannelsMask[1], 16 ) == 0 ) &&
-        ( CountBits( LoRaMacParams.ChannelsMask[2], 16 ) == 0 ) &&
-        ( CountBits( LoRaMacParams.ChannelsMask[3], 16 ) == 0 ) &&
-        ( CountBits( LoRaMacParams.ChannelsMask[4], 16 ) == 0 ) &&
-        ( CountBits( LoRaMacParams.ChannelsMask[5], 16 ) == 0 ) )
+    if( BeaconCtx.State == BEACON_STATE_ACQUISITION )
     {
-        memcpy1( ( uint8_t* )LoRaMacParams.ChannelsMask, ( uint8_t* )LoRaMacParamsDefaults.ChannelsMask, sizeof( LoRaMacParams.ChannelsMask ) );
+        Radio.Sleep( );
+        BeaconCtx.State = BEACON_STATE_OFF;
+        BeaconIndicate( LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND );
     }
-#else
-    if( CountBits( LoRaMacParams.ChannelsMask[0], 16 ) == 0 )
+    else if( BeaconCtx.State == BEACON_STATE_LOCKED )
+    {
+        // The beacon window is skipped when an uplink is in progress
+        if( ( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING ) ||
+            ( RxBeaconSetup( BeaconRxParams.RxWindowTimeout, false ) == false ) )
+        {
+            OnBeaconRxFailure( );
+        }
+    }
+}
+
+static void OnPingSlotTimerEvent( void )
+{
+    TimerStop( &PingSlotTimer );
+
+    if( ( LoRaMacDeviceClass == CLASS_B ) && ( ( LoRaMacState & LORAMAC_TX_RUNNING ) == 0 ) )
+    {
+        if( RxWindowSetup( PingSlotChannel.Frequency, PingSlotRxParams.Datarate, PingSlotRxParams.Bandwidth, PingSlotRxParams.RxWindowTimeout, false ) == true )
+        {
+            RxSlot = RX_SLOT_PING;
+        }
+    }
+    PingSlotNext++;
+    PingSlotScheduleNext( );
+}
+
+static bool RxBeaconSetup( uint16_t timeout, bool rxContinuous )
+{
+    if( Radio.GetStatus( ) != RF_IDLE )
+    {
+        return false;
+    }
+
+    Radio.SetChannel( BeaconChannel.Frequency );
+    // Beacons use an implicit header without payload CRC and no IQ inversion
+    Radio.SetRxConfig( MODEM_LORA, BeaconRxParams.Bandwidth, Datarates[BeaconChannel.Datarate], 1, 0, BEACON_PREAMBLE_LENGTH, timeout, true, BEACON_SIZE, false, 0, 0, false, rxContinuous );
+
+    if( rxContinuous == false )
+    {
+        Radio.Rx( LoRaMacParams.MaxRxWindow );
+    }
+    else
+    {
+        Radio.Rx( 0 ); // Continuous mode
+    }
+    RxSlot = RX_SLOT_BEACON;
+    return true;
+}
+
+static uint16_t BeaconCrc( uint8_t *buffer, uint16_t length )
+{
+    // CRC-16 CCITT, initial value 0
+    uint16_t crc = 0;
+
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        crc ^= ( uint16_t )buffer[i] << 8;
+        for( uint8_t j = 0; j < 8; j++ )
+        {
+            crc = ( ( crc & 0x8000 ) != 0 ) ? ( ( crc << 1 ) ^ 0x1021 ) : ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+static bool BeaconValidate( uint8_t *payload, uint16_t size, uint32_t *beaconTime )
+{
+    uint8_t index = BEACON_RFU1_SIZE + 4;
+    uint16_t crc = 0;
+
+    if( size != BEACON_SIZE )
+    {
+        return false;
+    }
+
+    // The first CRC protects the network common part
+    crc = ( uint16_t )payload[index] | ( ( uint16_t )payload[index + 1] << 8 );
+    if( BeaconCrc( payload, index ) != crc )
+    {
+        return false;
+    }
+
+    *beaconTime = ( uint32_t )payload[BEACON_RFU1_SIZE];
+    *beaconTime |= ( ( uint32_t )payload[BEACON_RFU1_SIZE + 1] << 8 );
+    *beaconTime |= ( ( uint32_t )payload[BEACON_RFU1_SIZE + 2] << 16 );
+    *beaconTime |= ( ( uint32_t )payload[BEACON_RFU1_SIZE + 3] << 24 );
+
+    // Beacons are sent at the beginning of the beacon periods
+    return ( ( *beaconTime % ( BEACON_INTERVAL / 1000 ) ) == 0 );
+}
+
+static void OnBeaconRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr, TimerTime_t rxDoneTime )
+{
+    uint32_t beaconTime = 0;
+
+    if( BeaconValidate( payload, size, &beaconTime ) == false )
+    {
+        if( BeaconCtx.State == BEACON_STATE_ACQUISITION )
+        { // Keep on listening until the acquisition timeout
+            RxBeaconSetup( 0, true );
+        }
+        else
+        {
+            OnBeaconRxFailure( );
+        }
+        return;
+    }
+
+    TimerStop( &BeaconTimer );
+
+    // The beacon period starts at the beginning of the beacon transmission
+    BeaconCtx.PeriodStart = rxDoneTime - Radio.TimeOnAir( MODEM_LORA, BEACON_SIZE );
+    BeaconCtx.BeaconTime = beaconTime;
+    BeaconCtx.NbMissed = 0;
+    BeaconCtx.Rssi = rssi;
+    BeaconCtx.Snr = snr;
+    BeaconCtx.State = BEACON_STATE_LOCKED;
+
+    BeaconNewPeriod( );
+    BeaconIndicate( LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED );
+}
+
+static void OnBeaconRxFailure( void )
+{
+    if( BeaconCtx.State == BEACON_STATE_ACQUISITION )
+    {
+        RxBeaconSetup( 0, true );
+        return;
+    }
+    if( BeaconCtx.State != BEACON_STATE_LOCKED )
+    {
+        return;
+    }
+
+    // Beacon-less operation. The node keeps the beacon period timing
+    BeaconCtx.NbMissed++;
+    BeaconCtx.PeriodStart += BEACON_INTERVAL;
+    BeaconCtx.BeaconTime += BEACON_INTERVAL / 1000;
+
+    if( ( ( uint32_t )BeaconCtx.NbMissed * BEACON_INTERVAL ) >= BEACONLESS_OPERATION_PERIOD )
+    {
+        BeaconStop( );
+        if( LoRaMacDeviceClass == CLASS_B )
+        {
+            LoRaMacDeviceClass = CLASS_A;
+        }
+        BeaconIndicate( LORAMAC_EVENT_INFO_STATUS_BEACON_LOST );
+        return;
+    }
+
+    BeaconNewPeriod( );
+    BeaconIndicate( LORAMAC_EVENT_INFO_STATUS_BEACON_MISSED );
+}
+
+static void BeaconNewPeriod( void )
+{
+    // PeriodStart may be a few ms ahead of the current time after a missed beacon
+    int32_t elapsed = ( int32_t )MacGetElapsedTime( BeaconCtx.PeriodStart );
+    int32_t delay = 0;
+
+    // The windows are widened by the clock drift since the last beacon received
+    BeaconCtx.WindowWidening = ( ( uint32_t )( BeaconCtx.NbMissed + 1 ) * ( BEACON_INTERVAL / 1000 ) * BEACON_CLOCK_DRIFT ) / 1000;
+
+    BeaconRxParams = ComputeRxWindowParameters( BeaconChannel.Datarate, LoRaMacParams.SystemMaxRxError + BeaconCtx.WindowWidening );
+    BeaconRxParams.RxWindowTimeout = MIN( BeaconRxParams.RxWindowTimeout, BEACON_MAX_SYMBOL_TIMEOUT );
+    delay = BEACON_INTERVAL + BeaconRxParams.RxOffset - elapsed;
+    TimerSetValue( &BeaconTimer, MAX( delay, 1 ) );
+    TimerStart( &BeaconTimer );
+
+    // A new ping slot periodicity applies from the beginning of a beacon period
+    PingSlotPeriodicity = PingSlotPeriodicityNew;
+    PingSlotNewPeriod( );
+}
+
+static void PingSlotNewPeriod( void )
+{
+    uint16_t pingPeriod = 0;
+
+    TimerStop( &PingSlotTimer );
+    if( LoRaMacDeviceClass != CLASS_B )
+    {
+        return;
+    }
+
+    pingPeriod = PING_SLOT_NB_SLOTS >> ( 7 - PingSlotPeriodicity );
+    LoRaMacBeaconComputePingOffset( BeaconCtx.BeaconTime, LoRaMacDevAddr, pingPeriod, &PingSlotOffset );
+    PingSlotRxParams = ComputeRxWindowParameters( PingSlotChannel.Datarate, LoRaMacParams.SystemMaxRxError + BeaconCtx.WindowWidening );
+    PingSlotNext = 0;
+    PingSlotScheduleNext( );
+}
+
+static void BeaconStop( void )
+{
+    TimerStop( &BeaconTimer );
+    TimerStop( &PingSlotTimer );
+    if( ( RxSlot == RX_SLOT_BEACON ) || ( RxSlot == RX_SLOT_PING ) )
+    {
+        Radio.Sleep( );
+    }
+    BeaconCtx.State = BEACON_STATE_OFF;
+}
+
+static void PingSlotScheduleNext( void )
+{
+    int32_t elapsed = ( int32_t )MacGetElapsedTime( BeaconCtx.PeriodStart );
+    int32_t slotStart = 0;
+    uint16_t pingPeriod = PING_SLOT_NB_SLOTS >> ( 7 - PingSlotPeriodicity );
+    uint16_t pingNb = 1 << ( 7 - PingSlotPeriodicity );
+
+    for( ; PingSlotNext < pingNb; PingSlotNext++ )
+    {
+        slotStart = BEACON_RESERVED + ( ( int32_t )PingSlotOffset + ( ( int32_t )PingSlotNext * pingPeriod ) ) * PING_SLOT_WINDOW + PingSlotRxParams.RxOffset;
+        if( slotStart > elapsed )
+        {
+            TimerSetValue( &PingSlotTimer, slotStart - elapsed );
+            TimerStart( &PingSlotTimer );
+            return;
+        }
+    }
+    // The next ping slots are scheduled at the next beacon period
+}
+
+static void BeaconIndicate( LoRaMacEventInfoStatus_t status )
+{
+    memset1( ( uint8_t* )&MlmeIndication, 0, sizeof( MlmeIndication ) );
+    MlmeIndication.MlmeIndication = MLME_BEACON;
+    MlmeIndication.Status = status;
+    if( status == LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED )
+    {
+        MlmeIndication.BeaconTime = BeaconCtx.BeaconTime;
+        MlmeIndication.Rssi = BeaconCtx.Rssi;
+        MlmeIndication.Snr = BeaconCtx.Snr;
+    }
+    else if( status == LORAMAC_EVENT_INFO_STATUS_BEACON_MISSED )
+    { // Expected time of the missed beacon
+        MlmeIndication.BeaconTime = BeaconCtx.BeaconTime;
+    }
+    LoRaMacFlags.Bits.MlmeInd = 1;
+
+    // Trig OnMacCheckTimerEvent call as soon as possible
+    TimerSetValue( &MacStateCheckTimer, 1 );
+    TimerStart( &MacStateCheckTimer );
+}
+
+static TimerTime_t BeaconGuardTxDelay( TimerTime_t txDelay )
+{
+    int32_t elapsed = 0;
+    int32_t txStart = 0;
+    int32_t txEnd = 0;
+
+    if( BeaconCtx.State != BEACON_STATE_LOCKED )
+    {
+        return txDelay;
+    }
+
+    elapsed = ( int32_t )MacGetElapsedTime( BeaconCtx.PeriodStart );
+    // Time of the transmission and of its receive windows in the beacon period
+    txStart = ( ( elapsed + ( int32_t )txDelay ) % BEACON_INTERVAL + BEACON_INTERVAL ) % BEACON_INTERVAL;
+    txEnd = txStart + ( int32_t )ComputeTxTimeOnAir( LoRaMacParams.ChannelsDatarate, LoRaMacBufferPktLen ) +
+            ( int32_t )RxWindow2Delay + ( int32_t )LoRaMacParams.MaxRxWindow;
+
+    if( txStart < BEACON_RESERVED )
+    {
+        txDelay += BEACON_RESERVED - txStart;
+    }
+    else if( txEnd > ( BEACON_INTERVAL - BEACON_GUARD ) )
+    {
+        txDelay += ( BEACON_INTERVAL - txStart ) + BEACON_RESERVED;
+    }
+    return txDelay;
+}
+
+static bool SetNextChannel( TimerTime_t* time )
+{
+    PROFILE_SCOPE( PROFILE_SET_NEXT_CHANNEL );
+    uint8_t nbEnabledChannels = 0;
+    uint8_t delayTx = 0;
+    uint8_t enabledChannels[LORA_MAX_NB_CHANNELS];
+    TimerTime_t nextTxDelay = ( TimerTime_t )( -1 );
+    TimerTime_t curTime = 0;
+
+    memset1( enabledChannels, 0, LORA_MAX_NB_CHANNELS );
+
+#if defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
+    if( CountNbEnabled125kHzChannels( ChannelsMaskRemaining ) == 0 )
+    { // Restore default channels
+        memcpy1( ( uint8_t* ) ChannelsMaskRemaining, ( uint8_t* ) LoRaMacParams.ChannelsMask, 8 );
+    }
+    if( ( LoRaMacParams.ChannelsDatarate >= DR_4 ) && ( ( ChannelsMaskRemaining[4] & 0x00FF ) == 0 ) )
+    { // Make sure, that the channels are activated
+        ChannelsMaskRemaining[4] = LoRaMacParams.ChannelsMask[4];
+    }
+#elif defined( USE_BAND_470 )
+    if( ( CountBits( LoRaMacParams.ChannelsMask[0], 16 ) == 0 ) &&
+        ( CountBits( LoRaMacParams.ChannelsMask[1], 16 ) == 0 ) &&
+        ( CountBits( LoRaMacParams.ChannelsMask[2], 16 ) == 0 ) &&
+        ( CountBits( LoRaMacParams.ChannelsMask[3], 16 ) == 0 ) &&
+        ( CountBits( LoRaMacParams.ChannelsMask[4], 16 ) == 0 ) &&
+        ( CountBits( LoRaMacParams.ChannelsMask[5], 16 ) == 0 ) )
+    {
+        memcpy1( ( uint8_t* )LoRaMacParams.ChannelsMask, ( uint8_t* )LoRaMacParamsDefaults.ChannelsMask, sizeof( LoRaMacParams.ChannelsMask ) );
+    }
+#else
+    if( CountBits( LoRaMacParams.ChannelsMask[0], 16 ) == 0 )
     {
         // Re-enable default channels, if no channel is enabled
-        LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ( LC( 1 ) + LC( 2 ) + LC( 3 ) );
+        LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ActiveRegion->DefaultChannelsMask;
     }
 #endif
 
+    // The time offs are checked against a single reading
+    curTime = MacGetCurrentTime( );
+
     // Update Aggregated duty cycle
-    if( AggregatedTimeOff <= TimerGetElapsedTime( AggregatedLastTxDoneTime ) )
+    if( AggregatedTimeOff <= ( TimerTime_t )( curTime - AggregatedLastTxDoneTime ) )
     {
         AggregatedTimeOff = 0;
 
@@ -1941,13 +3040,13 @@ static bool SetNextChannel( TimerTime_t* time )
         {
             if( ( IsLoRaMacNetworkJoined == false ) || ( DutyCycleOn == true ) )
             {
-                if( Bands[i].TimeOff <= TimerGetElapsedTime( Bands[i].LastTxDoneTime ) )
+                if( Bands[i].TimeOff <= ( TimerTime_t )( curTime - Bands[i].LastTxDoneTime ) )
                 {
                     Bands[i].TimeOff = 0;
                 }
                 if( Bands[i].TimeOff != 0 )
                 {
-                    nextTxDelay = MIN( Bands[i].TimeOff - TimerGetElapsedTime( Bands[i].LastTxDoneTime ), nextTxDelay );
+                    nextTxDelay = MIN( Bands[i].TimeOff - ( TimerTime_t )( curTime - Bands[i].LastTxDoneTime ), nextTxDelay );
                 }
             }
             else
@@ -1974,15 +3073,13 @@ static bool SetNextChannel( TimerTime_t* time )
                     { // Check if the channel is enabled
                         continue;
                     }
-#if defined( USE_BAND_868 ) || defined( USE_BAND_433 ) || defined( USE_BAND_780 )
                     if( IsLoRaMacNetworkJoined == false )
                     {
-                        if( ( JOIN_CHANNELS & ( 1 << j ) ) == 0 )
+                        if( ( JoinChannelsMask & ( 1 << j ) ) == 0 )
                         {
                             continue;
                         }
                     }
-#endif
                     if( ( ( Channels[i + j].DrRange.Fields.Min <= LoRaMacParams.ChannelsDatarate ) &&
                           ( LoRaMacParams.ChannelsDatarate <= Channels[i + j].DrRange.Fields.Max ) ) == false )
                     { // Check if the current channel selection supports the given datarate
@@ -2001,7 +3098,7 @@ static bool SetNextChannel( TimerTime_t* time )
     else
     {
         delayTx++;
-        nextTxDelay = AggregatedTimeOff - TimerGetElapsedTime( AggregatedLastTxDoneTime );
+        nextTxDelay = AggregatedTimeOff - ( TimerTime_t )( curTime - AggregatedLastTxDoneTime );
     }
 
     if( nbEnabledChannels > 0 )
@@ -2039,11 +3136,13 @@ static bool RxWindowSetup( uint32_t freq, int8_t datarate, uint32_t bandwidth, u
     {
         Radio.SetChannel( freq );
 
+        // Drop the header event of the previous window
+        RxTiming.HeaderValid = false;
+
         // Store downlink datarate
         McpsIndication.RxDatarate = ( uint8_t ) datarate;
 
-#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
-        if( datarate == DR_7 )
+        if( IsFskDatarate( datarate ) )
         {
             modem = MODEM_FSK;
             Radio.SetRxConfig( modem, 50e3, downlinkDatarate * 1e3, 0, 83.333e3, 5, timeout, false, 0, true, 0, 0, false, rxContinuous );
@@ -2053,10 +3152,6 @@ static bool RxWindowSetup( uint32_t freq, int8_t datarate, uint32_t bandwidth, u
             modem = MODEM_LORA;
             Radio.SetRxConfig( modem, bandwidth, downlinkDatarate, 1, 0, 8, timeout, false, 0, false, 0, 0, true, rxContinuous );
         }
-#elif defined( USE_BAND_470 ) || defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
-        modem = MODEM_LORA;
-        Radio.SetRxConfig( modem, bandwidth, downlinkDatarate, 1, 0, 8, timeout, false, 0, false, 0, 0, true, rxContinuous );
-#endif
 
         if( RepeaterSupport == true )
         {
@@ -2075,6 +3170,7 @@ static bool RxWindowSetup( uint32_t freq, int8_t datarate, uint32_t bandwidth, u
         {
             Radio.Rx( 0 ); // Continuous mode
         }
+        TRACE_MAC( TRACE_MAC_RX_WINDOW, datarate, timeout );
         return true;
     }
     return false;
@@ -2304,6 +3400,11 @@ static bool AdrNextDr( bool adrEnabled, bool updateChannelMask, int8_t* datarate
             {
                 adrAckReq = true;
                 LoRaMacParams.ChannelsTxPower = LORAMAC_MAX_TX_POWER;
+                if( updateChannelMask == true )
+                {
+                    // The link is lost, the device side ADR learns it again
+                    LinkAdrReset( false );
+                }
             }
             else
             {
@@ -2322,8 +3423,8 @@ static bool AdrNextDr( bool adrEnabled, bool updateChannelMask, int8_t* datarate
                     {
                         if( updateChannelMask == true )
                         {
-                            // Re-enable default channels LC1, LC2, LC3
-                            LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ( LC( 1 ) + LC( 2 ) + LC( 3 ) );
+                            // Re-enable the default channels of the region
+                            LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ActiveRegion->DefaultChannelsMask;
                         }
                     }
 #elif defined( USE_BAND_470 )
@@ -2444,6 +3545,15 @@ static LoRaMacStatus_t AddMacCommand( uint8_t cmd, uint8_t p1, uint8_t p2 )
                 status = LORAMAC_STATUS_OK;
             }
             break;
+        case MOTE_MAC_PING_SLOT_INFO_REQ:
+            if( MacCommandsBufferIndex < ( bufLen - 1 ) )
+            {
+                MacCommandsBuffer[MacCommandsBufferIndex++] = cmd;
+                // Periodicity
+                MacCommandsBuffer[MacCommandsBufferIndex++] = p1 & 0x07;
+                status = LORAMAC_STATUS_OK;
+            }
+            break;
         default:
             return LORAMAC_STATUS_SERVICE_UNKNOWN;
     }
@@ -2488,6 +3598,7 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
             }
             case MOTE_MAC_LINK_ADR_ANS:
             case MOTE_MAC_NEW_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_INFO_REQ:
             { // 1 byte payload
                 i++;
                 break;
@@ -2507,8 +3618,12 @@ static uint8_t ParseMacCommandsToRepeat( uint8_t* cmdBufIn, uint8_t length, uint
 
 static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t commandsSize, uint8_t snr )
 {
+    PROFILE_SCOPE( PROFILE_PROCESS_MAC_COMMANDS );
+
     while( macIndex < commandsSize )
     {
+        TRACE_MAC( TRACE_MAC_COMMAND, payload[macIndex], 0 );
+
         // Decode Frame MAC commands
         switch( payload[macIndex++] )
         {
@@ -2516,6 +3631,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                 MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
                 MlmeConfirm.DemodMargin = payload[macIndex++];
                 MlmeConfirm.NbGateways = payload[macIndex++];
+                LinkAdrOnLinkCheck( MlmeConfirm.DemodMargin, MlmeConfirm.NbGateways );
                 break;
             case SRV_MAC_LINK_ADR_REQ:
                 {
@@ -2682,6 +3798,9 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     }
                     if( ( status & 0x07 ) == 0x07 )
                     {
+                        // The network drives the ADR, the device side ADR yields
+                        LinkAdrReset( true );
+
                         LoRaMacParams.ChannelsDatarate = datarate;
                         LoRaMacParams.ChannelsTxPower = txPower;
 
@@ -2758,6 +3877,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     if( ( LoRaMacCallbacks != NULL ) && ( LoRaMacCallbacks->GetBatteryLevel != NULL ) )
                     {
                         batteryLevel = LoRaMacCallbacks->GetBatteryLevel( );
+                        CAPTURE( CAPTURE_BATTERY_LEVEL, &batteryLevel, sizeof( batteryLevel ), NULL, 0 );
                     }
                     AddMacCommand( MOTE_MAC_DEV_STATUS_ANS, batteryLevel, snr );
                     break;
@@ -2789,7 +3909,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                         }
                         else
                         {
-                            if( LoRaMacChannelRemove( channelIndex ) != LORAMAC_STATUS_OK )
+                            if( ChannelRemove( channelIndex ) != LORAMAC_STATUS_OK )
                             {
                                 status &= 0xFC;
                             }
@@ -2797,7 +3917,7 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     }
                     else
                     {
-                        switch( LoRaMacChannelAdd( channelIndex, chParam ) )
+                        switch( ChannelAdd( channelIndex, chParam ) )
                         {
                             case LORAMAC_STATUS_OK:
                             {
@@ -2843,6 +3963,11 @@ static void ProcessMacCommands( uint8_t *payload, uint8_t macIndex, uint8_t comm
                     AddMacCommand( MOTE_MAC_RX_TIMING_SETUP_ANS, 0, 0 );
                 }
                 break;
+            case SRV_MAC_PING_SLOT_INFO_ANS:
+                MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+                // The new periodicity applies from the next beacon period
+                PingSlotPeriodicityNew = PingSlotPeriodicityReq;
+                break;
             default:
                 // Unknown command. ABORT MAC commands processing
                 return;
@@ -2868,6 +3993,7 @@ LoRaMacStatus_t Send( LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uin
     // Validate status
     if( status != LORAMAC_STATUS_OK )
     {
+        ReleaseTxBuffer( );
         return status;
     }
 
@@ -2877,6 +4003,10 @@ LoRaMacStatus_t Send( LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uin
     McpsConfirm.UpLinkCounter = UpLinkCounter;
 
     status = ScheduleTx( );
+    if( status != LORAMAC_STATUS_OK )
+    {
+        ReleaseTxBuffer( );
+    }
 
     return status;
 }
@@ -2884,6 +4014,8 @@ LoRaMacStatus_t Send( LoRaMacHeader_t *macHdr, uint8_t fPort, void *fBuffer, uin
 static LoRaMacStatus_t ScheduleTx( void )
 {
     TimerTime_t dutyCycleTimeOff = 0;
+    uint32_t rxError = LoRaMacParams.SystemMaxRxError;
+    int32_t rxOffset = 0;
 
     // Check if the device is off
     if( MaxDCycle == 255 )
@@ -2902,19 +4034,25 @@ static LoRaMacStatus_t ScheduleTx( void )
         LoRaMacParams.ChannelsDatarate = LoRaMacParamsDefaults.ChannelsDatarate;
 
 #if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
-        // Re-enable default channels LC1, LC2, LC3
-        LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ( LC( 1 ) + LC( 2 ) + LC( 3 ) );
+        // Re-enable the default channels of the region
+        LoRaMacParams.ChannelsMask[0] = LoRaMacParams.ChannelsMask[0] | ActiveRegion->DefaultChannelsMask;
 #endif
     }
 
+    // Use the measured timing error once the network is joined
+    if( IsLoRaMacNetworkJoined == true )
+    {
+        rxError = RxTimingGetError( &rxOffset );
+    }
+
     // Compute Rx1 windows parameters
 #if ( defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID ) )
-    RxWindowsParams[0] = ComputeRxWindowParameters( DatarateOffsets[LoRaMacParams.ChannelsDatarate][LoRaMacParams.Rx1DrOffset], LoRaMacParams.SystemMaxRxError );
+    RxWindowsParams[0] = ComputeRxWindowParameters( DatarateOffsets[LoRaMacParams.ChannelsDatarate][LoRaMacParams.Rx1DrOffset], rxError );
 #else
-    RxWindowsParams[0] = ComputeRxWindowParameters( MAX( DR_0, LoRaMacParams.ChannelsDatarate - LoRaMacParams.Rx1DrOffset ), LoRaMacParams.SystemMaxRxError );
+    RxWindowsParams[0] = ComputeRxWindowParameters( MAX( DR_0, LoRaMacParams.ChannelsDatarate - LoRaMacParams.Rx1DrOffset ), rxError );
 #endif
     // Compute Rx2 windows parameters
-    RxWindowsParams[1] = ComputeRxWindowParameters( LoRaMacParams.Rx2Channel.Datarate, LoRaMacParams.SystemMaxRxError );
+    RxWindowsParams[1] = ComputeRxWindowParameters( LoRaMacParams.Rx2Channel.Datarate, rxError );
 
     if( IsLoRaMacNetworkJoined == false )
     {
@@ -2927,10 +4065,13 @@ static LoRaMacStatus_t ScheduleTx( void )
         {
             return LORAMAC_STATUS_LENGTH_ERROR;
         }
-        RxWindow1Delay = LoRaMacParams.ReceiveDelay1 + RxWindowsParams[0].RxOffset;
-        RxWindow2Delay = LoRaMacParams.ReceiveDelay2 + RxWindowsParams[1].RxOffset;
+        RxWindow1Delay = LoRaMacParams.ReceiveDelay1 + RxWindowsParams[0].RxOffset + rxOffset;
+        RxWindow2Delay = LoRaMacParams.ReceiveDelay2 + RxWindowsParams[1].RxOffset + rxOffset;
     }
 
+    // Keep the class B beacon guard and reserved times free
+    dutyCycleTimeOff = BeaconGuardTxDelay( dutyCycleTimeOff );
+
     // Schedule transmission of frame
     if( dutyCycleTimeOff == 0 )
     {
@@ -2951,7 +4092,7 @@ static LoRaMacStatus_t ScheduleTx( void )
 static uint16_t JoinDutyCycle( void )
 {
     uint16_t dutyCycle = 0;
-    TimerTime_t timeElapsed = TimerGetElapsedTime( LoRaMacInitializationTime );
+    TimerTime_t timeElapsed = MacGetElapsedTime( LoRaMacInitializationTime );
 
     if( timeElapsed < 3600e3 )
     {
@@ -3064,6 +4205,8 @@ static void ResetMacParameters( void )
     MaxDCycle = 0;
     AggregatedDCycle = 1;
 
+    LinkAdrReset( false );
+
     MacCommandsBufferIndex = 0;
     MacCommandsBufferToRepeatIndex = 0;
 
@@ -3087,19 +4230,36 @@ static void ResetMacParameters( void )
     MacCommandsInNextTx = false;
 
     // Reset Multicast downlink counters
-    MulticastParams_t *cur = MulticastChannels;
-    while( cur != NULL )
+    for( uint8_t i = 0; i < LORAMAC_MC_TABLE_SIZE; i++ )
     {
-        cur->DownLinkCounter = 0;
-        cur = cur->Next;
+        MulticastChannels[i].DownLinkCounter = 0;
     }
 
     // Initialize channel index.
     Channel = LORA_MAX_NB_CHANNELS;
 }
 
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+static void RegionSetDefaults( void )
+{
+    memcpy1( ( uint8_t* )Bands, ( const uint8_t* )ActiveRegion->Bands, sizeof( Bands ) );
+
+    // The channels added by the network or the application are removed
+    memset1( ( uint8_t* )Channels, 0, sizeof( Channels ) );
+    memcpy1( ( uint8_t* )Channels, ( const uint8_t* )ActiveRegion->Channels, sizeof( ActiveRegion->Channels ) );
+
+    LoRaMacParamsDefaults.ChannelsMask[0] = ActiveRegion->DefaultChannelsMask;
+    LoRaMacParamsDefaults.ChannelsTxPower = ActiveRegion->DefaultTxPower;
+    LoRaMacParamsDefaults.Rx2Channel = ActiveRegion->Rx2Channel;
+
+    BeaconChannel = ActiveRegion->BeaconChannel;
+    PingSlotChannel = ActiveRegion->BeaconChannel;
+}
+#endif
+
 LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl, uint8_t fPort, void *fBuffer, uint16_t fBufferSize )
 {
+    PROFILE_SCOPE( PROFILE_PREPARE_FRAME );
     uint16_t i;
     uint8_t pktHeaderLen = 0;
     uint32_t mic = 0;
@@ -3110,6 +4270,16 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
 
     NodeAckRequested = false;
 
+    // The block is kept by the retransmissions of the same procedure
+    if( LoRaMacBuffer == NULL )
+    {
+        LoRaMacBuffer = FramePoolAlloc( FRAME_POOL_MAC );
+        if( LoRaMacBuffer == NULL )
+        {
+            return LORAMAC_STATUS_BUSY;
+        }
+    }
+
     if( fBuffer == NULL )
     {
         fBufferSize = 0;
@@ -3129,7 +4299,7 @@ LoRaMacStatus_t PrepareFrame( LoRaMacHeader_t *macHdr, LoRaMacFrameCtrl_t *fCtrl
             memcpyr( LoRaMacBuffer + LoRaMacBufferPktLen, LoRaMacDevEui, 8 );
             LoRaMacBufferPktLen += 8;
 
-            LoRaMacDevNonce = Radio.Random( );
+            LoRaMacDevNonce = LoRaMacNextDevNonce++;
 
             LoRaMacBuffer[LoRaMacBufferPktLen++] = LoRaMacDevNonce & 0xFF;
             LoRaMacBuffer[LoRaMacBufferPktLen++] = ( LoRaMacDevNonce >> 8 ) & 0xFF;
@@ -3252,6 +4422,10 @@ LoRaMacStatus_t SendFrameOnChannel( ChannelParams_t channel )
     txPowerIndex = LimitTxPower( LoRaMacParams.ChannelsTxPower, Bands[channel.Band].TxMaxPower );
     txPower = TxPowers[txPowerIndex];
 
+    // Account the time spent so far at the previous Tx power
+    EnergyUpdate( );
+    EnergyTxPower = txPowerIndex;
+
     MlmeConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
     McpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_ERROR;
     McpsConfirm.Datarate = LoRaMacParams.ChannelsDatarate;
@@ -3261,7 +4435,7 @@ LoRaMacStatus_t SendFrameOnChannel( ChannelParams_t channel )
     Radio.SetChannel( channel.Frequency );
 
 #if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
-    if( LoRaMacParams.ChannelsDatarate == DR_7 )
+    if( IsFskDatarate( LoRaMacParams.ChannelsDatarate ) )
     { // High Speed FSK channel
         Radio.SetMaxPayloadLength( MODEM_FSK, LoRaMacBufferPktLen );
         Radio.SetTxConfig( MODEM_FSK, txPower, 25e3, 0, datarate * 1e3, 0, 5, false, true, 0, 0, false, 3e3 );
@@ -3314,6 +4488,7 @@ LoRaMacStatus_t SendFrameOnChannel( ChannelParams_t channel )
     }
 
     // Send now
+    TRACE_MAC( TRACE_MAC_TX, LoRaMacParams.ChannelsDatarate, channel.Frequency / 100000 );
     Radio.Send( LoRaMacBuffer, LoRaMacBufferPktLen );
 
     LoRaMacState |= LORAMAC_TX_RUNNING;
@@ -3355,6 +4530,8 @@ LoRaMacStatus_t SetTxContinuousWave1( uint16_t timeout, uint32_t frequency, uint
 
 LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacCallback_t *callbacks )
 {
+    uint32_t seed;
+
     if( primitives == NULL )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
@@ -3384,14 +4561,10 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     AggregatedTimeOff = 0;
 
     // Duty cycle
-#if defined( USE_BAND_433 )
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
     DutyCycleOn = true;
 #elif defined( USE_BAND_470 )
     DutyCycleOn = false;
-#elif defined( USE_BAND_780 )
-    DutyCycleOn = true;
-#elif defined( USE_BAND_868 )
-    DutyCycleOn = true;
 #elif defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
     DutyCycleOn = false;
 #else
@@ -3399,7 +4572,6 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
 #endif
 
     // Reset to defaults
-    LoRaMacParamsDefaults.ChannelsTxPower = LORAMAC_DEFAULT_TX_POWER;
     LoRaMacParamsDefaults.ChannelsDatarate = LORAMAC_DEFAULT_DATARATE;
 
     LoRaMacParamsDefaults.SystemMaxRxError = 10;
@@ -3413,22 +4585,29 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     LoRaMacParamsDefaults.ChannelsNbRep = 1;
     LoRaMacParamsDefaults.Rx1DrOffset = 0;
 
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+#if( LORAMAC_NB_REGIONS > 1 )
+    ActiveRegion = Regions[0];
+#endif
+    // Bands, default channels, TX power, receive window 2 and class B
+    // channels of the active region
+    RegionSetDefaults( );
+#else
+    LoRaMacParamsDefaults.ChannelsTxPower = LORAMAC_DEFAULT_TX_POWER;
     LoRaMacParamsDefaults.Rx2Channel = ( Rx2ChannelParams_t )RX_WND_2_CHANNEL;
+    BeaconChannel = ( Rx2ChannelParams_t )BEACON_CHANNEL;
+    PingSlotChannel = BeaconChannel;
+#endif
 
-    // Channel mask
-#if defined( USE_BAND_433 )
-    LoRaMacParamsDefaults.ChannelsMask[0] = LC( 1 ) + LC( 2 ) + LC( 3 );
-#elif defined ( USE_BAND_470 )
+    // Channel mask, RegionSetDefaults sets it for the regions of the
+    // dynamic channel plan
+#if defined ( USE_BAND_470 )
     LoRaMacParamsDefaults.ChannelsMask[0] = 0xFFFF;
     LoRaMacParamsDefaults.ChannelsMask[1] = 0xFFFF;
     LoRaMacParamsDefaults.ChannelsMask[2] = 0xFFFF;
     LoRaMacParamsDefaults.ChannelsMask[3] = 0xFFFF;
     LoRaMacParamsDefaults.ChannelsMask[4] = 0xFFFF;
     LoRaMacParamsDefaults.ChannelsMask[5] = 0xFFFF;
-#elif defined( USE_BAND_780 )
-    LoRaMacParamsDefaults.ChannelsMask[0] = LC( 1 ) + LC( 2 ) + LC( 3 );
-#elif defined( USE_BAND_868 )
-    LoRaMacParamsDefaults.ChannelsMask[0] = LC( 1 ) + LC( 2 ) + LC( 3 );
 #elif defined( USE_BAND_915 )
     LoRaMacParamsDefaults.ChannelsMask[0] = 0xFFFF;
     LoRaMacParamsDefaults.ChannelsMask[1] = 0xFFFF;
@@ -3443,8 +4622,6 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     LoRaMacParamsDefaults.ChannelsMask[3] = 0x0000;
     LoRaMacParamsDefaults.ChannelsMask[4] = 0x0001;
     LoRaMacParamsDefaults.ChannelsMask[5] = 0x0000;
-#else
-    #error "Please define a frequency band in the compiler options."
 #endif
 
 #if defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
@@ -3492,9 +4669,14 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     TimerInit( &RxWindowTimer1, OnRxWindow1TimerEvent );
     TimerInit( &RxWindowTimer2, OnRxWindow2TimerEvent );
     TimerInit( &AckTimeoutTimer, OnAckTimeoutTimerEvent );
+    TimerInit( &BeaconTimer, OnBeaconTimerEvent );
+    TimerInit( &PingSlotTimer, OnPingSlotTimerEvent );
+    TimerInit( &EnergyTimer, OnEnergyTimerEvent );
+    TimerSetValue( &EnergyTimer, ENERGY_UPDATE_PERIOD );
+    BeaconCtx.State = BEACON_STATE_OFF;
 
     // Store the current initialization time
-    LoRaMacInitializationTime = TimerGetCurrentTime( );
+    LoRaMacInitializationTime = MacGetCurrentTime( );
 
     // Initialize Radio driver
     RadioEvents.TxDone = OnRadioTxDone;
@@ -3502,10 +4684,20 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
     RadioEvents.RxError = OnRadioRxError;
     RadioEvents.TxTimeout = OnRadioTxTimeout;
     RadioEvents.RxTimeout = OnRadioRxTimeout;
+    RadioEvents.ValidHeader = OnRadioValidHeader;
     Radio.Init( &RadioEvents );
 
-    // Random seed initialization
-    srand1( Radio.Random( ) );
+    EnergyInit( );
+
+    RxTimingReset( );
+
+    // Random seed initialization. The channels selection and the backoffs
+    // drawn from randr are deterministic once the seed is captured
+    seed = Radio.Random( );
+    CAPTURE( CAPTURE_RANDOM, &seed, sizeof( seed ), NULL, 0 );
+    srand1( seed );
+    LoRaMacNextDevNonce = Radio.Random( );
+    CAPTURE( CAPTURE_RANDOM, &LoRaMacNextDevNonce, sizeof( LoRaMacNextDevNonce ), NULL, 0 );
 
     PublicNetwork = true;
     Radio.SetPublicNetwork( PublicNetwork );
@@ -3557,43 +4749,175 @@ LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo )
     return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
+LoRaMacStatus_t LoRaMacQueryTxPlan( uint8_t size, LoRaMacTxPlan_t* txPlan )
 {
-    LoRaMacStatus_t status = LORAMAC_STATUS_OK;
+    int8_t datarate = LoRaMacParamsDefaults.ChannelsDatarate;
+    uint8_t fOptLen = MacCommandsBufferIndex + MacCommandsBufferToRepeatIndex;
+    uint16_t pktLen = size + fOptLen + LORA_MAC_FRMPAYLOAD_OVERHEAD;
+    uint16_t maxN = 0;
+    uint16_t dutyCycle = 0;
+    TimerTime_t aggregatedTxDelay = 0;
+    TimerTime_t bandTxDelay = 0;
+    TimerTime_t txDelay = 0;
+    TimerTime_t elapsedTime = 0;
 
-    if( mibGet == NULL )
+    if( txPlan == NULL )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
 
-    switch( mibGet->Type )
+    // Check if the device is off
+    if( MaxDCycle == 255 )
     {
-        case MIB_DEVICE_CLASS:
-        {
-            mibGet->Param.Class = LoRaMacDeviceClass;
-            break;
-        }
-        case MIB_NETWORK_JOINED:
-        {
-            mibGet->Param.IsNetworkJoined = IsLoRaMacNetworkJoined;
-            break;
-        }
-        case MIB_ADR:
+        return LORAMAC_STATUS_DEVICE_OFF;
+    }
+
+    AdrNextDr( AdrCtrlOn, false, &datarate );
+
+    txPlan->FOptsLen = fOptLen;
+    txPlan->CurrentDatarate = datarate;
+
+    // Remaining aggregated time-off
+    elapsedTime = TimerGetElapsedTime( AggregatedLastTxDoneTime );
+    if( ( MaxDCycle != 0 ) && ( AggregatedTimeOff > elapsedTime ) )
+    {
+        aggregatedTxDelay = AggregatedTimeOff - elapsedTime;
+    }
+
+    for( int8_t dr = LORAMAC_TX_MIN_DATARATE; dr <= LORAMAC_TX_MAX_DATARATE; dr++ )
+    {
+        LoRaMacTxPlanEntry_t *entry = &txPlan->Entries[dr - LORAMAC_TX_MIN_DATARATE];
+
+        if( RepeaterSupport == true )
         {
-            mibGet->Param.AdrEnable = AdrCtrlOn;
-            break;
+            maxN = MaxPayloadOfDatarateRepeater[dr];
         }
-        case MIB_NET_ID:
+        else
         {
-            mibGet->Param.NetID = LoRaMacNetID;
-            break;
+            maxN = MaxPayloadOfDatarate[dr];
         }
-        case MIB_DEV_ADDR:
+
+        entry->Datarate = dr;
+        entry->Allowed = false;
+        entry->PayloadFits = ValidatePayloadLength( size, dr, fOptLen );
+        entry->MaxPossiblePayload = ( maxN > fOptLen ) ? ( maxN - fOptLen ) : 0;
+        entry->TimeOnAir = ComputeTxTimeOnAir( dr, MIN( pktLen, LORAMAC_PHY_MAXPAYLOAD ) );
+        entry->TxDelay = 0;
+        entry->TimeOff = 0;
+        entry->NbTxPerHour = 0;
+
+        // Search the enabled channel with the shortest band time-off
+        bandTxDelay = ( TimerTime_t )( -1 );
+        dutyCycle = 1;
+        for( uint8_t i = 0, k = 0; i < LORA_MAX_NB_CHANNELS; i += 16, k++ )
         {
-            mibGet->Param.DevAddr = LoRaMacDevAddr;
-            break;
-        }
-        case MIB_NWK_SKEY:
+            for( uint8_t j = 0; j < 16; j++ )
+            {
+                if( ( LoRaMacParams.ChannelsMask[k] & ( 1 << j ) ) == 0 )
+                {
+                    continue;
+                }
+                if( Channels[i + j].Frequency == 0 )
+                { // Check if the channel is enabled
+                    continue;
+                }
+                if( IsLoRaMacNetworkJoined == false )
+                {
+                    if( ( JoinChannelsMask & ( 1 << j ) ) == 0 )
+                    {
+                        continue;
+                    }
+                }
+                if( ( ( Channels[i + j].DrRange.Fields.Min <= dr ) &&
+                      ( dr <= Channels[i + j].DrRange.Fields.Max ) ) == false )
+                { // Check if the current channel selection supports the given datarate
+                    continue;
+                }
+
+                txDelay = 0;
+                if( ( IsLoRaMacNetworkJoined == false ) || ( DutyCycleOn == true ) )
+                {
+                    elapsedTime = TimerGetElapsedTime( Bands[Channels[i + j].Band].LastTxDoneTime );
+                    if( Bands[Channels[i + j].Band].TimeOff > elapsedTime )
+                    {
+                        txDelay = Bands[Channels[i + j].Band].TimeOff - elapsedTime;
+                    }
+                }
+                if( txDelay < bandTxDelay )
+                {
+                    bandTxDelay = txDelay;
+                    dutyCycle = Bands[Channels[i + j].Band].DCycle;
+                }
+                entry->Allowed = true;
+            }
+        }
+
+        if( entry->Allowed == false )
+        {
+            continue;
+        }
+
+        entry->TxDelay = MAX( bandTxDelay, aggregatedTxDelay );
+
+        // Time-off imposed by the transmission, same rules as CalculateBackOff
+        if( IsLoRaMacNetworkJoined == false )
+        {
+            dutyCycle = MAX( dutyCycle, JoinDutyCycle( ) );
+        }
+        else if( DutyCycleOn == false )
+        {
+            dutyCycle = 1;
+        }
+        dutyCycle = MAX( MAX( dutyCycle, AggregatedDCycle ), 1 );
+        entry->TimeOff = entry->TimeOnAir * dutyCycle - entry->TimeOnAir;
+
+        // Residual duty-cycle budget within the next hour
+        if( entry->TxDelay < 3600e3 )
+        {
+            entry->NbTxPerHour = MIN( ( ( uint32_t )3600e3 - entry->TxDelay ) / ( entry->TimeOnAir + entry->TimeOff ), 0xFFFF );
+        }
+    }
+
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
+{
+    LoRaMacStatus_t status = LORAMAC_STATUS_OK;
+
+    if( mibGet == NULL )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+
+    switch( mibGet->Type )
+    {
+        case MIB_DEVICE_CLASS:
+        {
+            mibGet->Param.Class = LoRaMacDeviceClass;
+            break;
+        }
+        case MIB_NETWORK_JOINED:
+        {
+            mibGet->Param.IsNetworkJoined = IsLoRaMacNetworkJoined;
+            break;
+        }
+        case MIB_ADR:
+        {
+            mibGet->Param.AdrEnable = AdrCtrlOn;
+            break;
+        }
+        case MIB_NET_ID:
+        {
+            mibGet->Param.NetID = LoRaMacNetID;
+            break;
+        }
+        case MIB_DEV_ADDR:
+        {
+            mibGet->Param.DevAddr = LoRaMacDevAddr;
+            break;
+        }
+        case MIB_NWK_SKEY:
         {
             mibGet->Param.NwkSKey = LoRaMacNwkSKey;
             break;
@@ -3700,7 +5024,7 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
         }
         case MIB_MULTICAST_CHANNEL:
         {
-            mibGet->Param.MulticastList = MulticastChannels;
+            mibGet->Param.NbMulticastChannels = MulticastChannelsNb;
             break;
         }
         case MIB_SYSTEM_MAX_RX_ERROR:
@@ -3713,6 +5037,44 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
             mibGet->Param.MinRxSymbols = LoRaMacParams.MinRxSymbols;
             break;
         }
+        case MIB_ENERGY:
+        {
+            mibGet->Param.Energy = &Energy;
+            break;
+        }
+        case MIB_ENERGY_TABLE:
+        {
+            mibGet->Param.EnergyTable = &EnergyTable;
+            break;
+        }
+#if( PROFILE_ON == 1 )
+        case MIB_PROFILE:
+        {
+            mibGet->Param.ProfileStats = ProfileGetStats( );
+            break;
+        }
+#endif
+        case MIB_LINK_ADR:
+        {
+            mibGet->Param.LinkAdrEnable = LinkAdr.Enabled;
+            break;
+        }
+        case MIB_DEV_NONCE:
+        {
+            mibGet->Param.DevNonce = LoRaMacNextDevNonce;
+            break;
+        }
+        case MIB_REGION:
+        {
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+            mibGet->Param.Region = ActiveRegion->Id;
+#elif defined( USE_BAND_470 )
+            mibGet->Param.Region = LORAMAC_REGION_CN470;
+#else
+            mibGet->Param.Region = LORAMAC_REGION_US915;
+#endif
+            break;
+        }
         default:
             status = LORAMAC_STATUS_SERVICE_UNKNOWN;
             break;
@@ -3721,6 +5083,102 @@ LoRaMacStatus_t LoRaMacMibGetRequestConfirm( MibRequestConfirm_t *mibGet )
     return status;
 }
 
+#if( CAPTURE_MAC_ON )
+/*!
+ * \brief Captures a MIB set request. The parameters passed by pointer are
+ *        captured by value
+ *
+ * \param [IN] mibSet MIB set request
+ */
+static void CaptureMibSet( MibRequestConfirm_t *mibSet )
+{
+    uint8_t header[1] = { ( uint8_t )mibSet->Type };
+    uint8_t param[5] = { 0 };
+    const uint8_t *data = param;
+    uint16_t size = 0;
+
+    switch( mibSet->Type )
+    {
+        case MIB_DEVICE_CLASS:
+            param[0] = ( uint8_t )mibSet->Param.Class;
+            size = 1;
+            break;
+        case MIB_REGION:
+            param[0] = ( uint8_t )mibSet->Param.Region;
+            size = 1;
+            break;
+        case MIB_NETWORK_JOINED:
+        case MIB_ADR:
+        case MIB_PUBLIC_NETWORK:
+        case MIB_REPEATER_SUPPORT:
+        case MIB_LINK_ADR:
+        case MIB_CHANNELS_NB_REP:
+        case MIB_CHANNELS_DEFAULT_DATARATE:
+        case MIB_CHANNELS_DATARATE:
+        case MIB_CHANNELS_DEFAULT_TX_POWER:
+        case MIB_CHANNELS_TX_POWER:
+        case MIB_MIN_RX_SYMBOLS:
+            // 8 bits members of the parameter union
+            data = ( const uint8_t* )&mibSet->Param;
+            size = 1;
+            break;
+        case MIB_DEV_NONCE:
+            data = ( const uint8_t* )&mibSet->Param.DevNonce;
+            size = sizeof( mibSet->Param.DevNonce );
+            break;
+        case MIB_NET_ID:
+        case MIB_DEV_ADDR:
+        case MIB_MAX_RX_WINDOW_DURATION:
+        case MIB_RECEIVE_DELAY_1:
+        case MIB_RECEIVE_DELAY_2:
+        case MIB_JOIN_ACCEPT_DELAY_1:
+        case MIB_JOIN_ACCEPT_DELAY_2:
+        case MIB_UPLINK_COUNTER:
+        case MIB_DOWNLINK_COUNTER:
+        case MIB_SYSTEM_MAX_RX_ERROR:
+            // 32 bits members of the parameter union
+            data = ( const uint8_t* )&mibSet->Param;
+            size = sizeof( uint32_t );
+            break;
+        case MIB_NWK_SKEY:
+        case MIB_APP_SKEY:
+            data = ( mibSet->Type == MIB_NWK_SKEY ) ? mibSet->Param.NwkSKey : mibSet->Param.AppSKey;
+            size = ( data != NULL ) ? 16 : 0;
+            break;
+        case MIB_RX2_CHANNEL:
+        case MIB_RX2_DEFAULT_CHANNEL:
+        {
+            Rx2ChannelParams_t rx2Channel = ( mibSet->Type == MIB_RX2_CHANNEL ) ? mibSet->Param.Rx2Channel : mibSet->Param.Rx2DefaultChannel;
+
+            param[0] = rx2Channel.Frequency & 0xFF;
+            param[1] = ( rx2Channel.Frequency >> 8 ) & 0xFF;
+            param[2] = ( rx2Channel.Frequency >> 16 ) & 0xFF;
+            param[3] = ( rx2Channel.Frequency >> 24 ) & 0xFF;
+            param[4] = rx2Channel.Datarate;
+            size = 5;
+            break;
+        }
+        case MIB_CHANNELS_MASK:
+        case MIB_CHANNELS_DEFAULT_MASK:
+            // Same number of words as read by the request
+            data = ( const uint8_t* )( ( mibSet->Type == MIB_CHANNELS_MASK ) ? mibSet->Param.ChannelsMask : mibSet->Param.ChannelsDefaultMask );
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+            size = ( data != NULL ) ? 2 : 0;
+#else
+            size = ( data != NULL ) ? sizeof( LoRaMacParams.ChannelsMask ) : 0;
+#endif
+            break;
+        case MIB_ENERGY_TABLE:
+            data = ( const uint8_t* )mibSet->Param.EnergyTable;
+            size = ( data != NULL ) ? sizeof( LoRaMacEnergyTable_t ) : 0;
+            break;
+        default:
+            break;
+    }
+    CaptureWrite( CAPTURE_MIB_SET, header, sizeof( header ), data, size );
+}
+#endif
+
 LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
 {
     LoRaMacStatus_t status = LORAMAC_STATUS_OK;
@@ -3729,6 +5187,9 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
+#if( CAPTURE_MAC_ON )
+    CaptureMibSet( mibSet );
+#endif
     if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
     {
         return LORAMAC_STATUS_BUSY;
@@ -3738,21 +5199,31 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
     {
         case MIB_DEVICE_CLASS:
         {
+            if( ( mibSet->Param.Class == CLASS_B ) && ( BeaconCtx.State != BEACON_STATE_LOCKED ) )
+            {
+                // The class B requires a locked beacon
+                status = LORAMAC_STATUS_PARAMETER_INVALID;
+                break;
+            }
             LoRaMacDeviceClass = mibSet->Param.Class;
             switch( LoRaMacDeviceClass )
             {
                 case CLASS_A:
                 {
+                    BeaconStop( );
                     // Set the radio into sleep to setup a defined state
                     Radio.Sleep( );
                     break;
                 }
                 case CLASS_B:
                 {
+                    // The ping slots start in the current beacon period
+                    PingSlotNewPeriod( );
                     break;
                 }
                 case CLASS_C:
                 {
+                    BeaconStop( );
                     // Set the NodeAckRequested indicator to default
                     NodeAckRequested = false;
                     OnRxWindow2TimerEvent( );
@@ -4038,6 +5509,72 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
             LoRaMacParams.MinRxSymbols = LoRaMacParamsDefaults.MinRxSymbols = mibSet->Param.MinRxSymbols;
             break;
         }
+        case MIB_ENERGY_TABLE:
+        {
+            if( mibSet->Param.EnergyTable != NULL )
+            {
+                EnergyTable = *mibSet->Param.EnergyTable;
+            }
+            else
+            {
+                status = LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            break;
+        }
+#if( PROFILE_ON == 1 )
+        case MIB_PROFILE:
+        {
+            ProfileReset( );
+            break;
+        }
+#endif
+        case MIB_LINK_ADR:
+        {
+            LinkAdr.Enabled = mibSet->Param.LinkAdrEnable;
+            LinkAdrReset( false );
+            break;
+        }
+        case MIB_DEV_NONCE:
+        {
+            LoRaMacNextDevNonce = mibSet->Param.DevNonce;
+            break;
+        }
+        case MIB_REGION:
+        {
+            MibRequestConfirm_t mibGet;
+
+            mibGet.Type = MIB_REGION;
+            LoRaMacMibGetRequestConfirm( &mibGet );
+            if( mibSet->Param.Region == mibGet.Param.Region )
+            {
+                break;
+            }
+#if( LORAMAC_NB_REGIONS > 1 )
+            // The region changes before the activation only
+            status = LORAMAC_STATUS_PARAMETER_INVALID;
+            if( ( IsLoRaMacNetworkJoined == true ) || ( LoRaMacDeviceClass != CLASS_A ) )
+            {
+                break;
+            }
+            for( uint8_t i = 0; i < LORAMAC_NB_REGIONS; i++ )
+            {
+                if( Regions[i]->Id == mibSet->Param.Region )
+                {
+                    ActiveRegion = Regions[i];
+                    RegionSetDefaults( );
+                    ResetMacParameters( );
+                    // The TX currents depend on the regional output powers
+                    EnergyInit( );
+                    status = LORAMAC_STATUS_OK;
+                    break;
+                }
+            }
+#else
+            // Not built in the image
+            status = LORAMAC_STATUS_PARAMETER_INVALID;
+#endif
+            break;
+        }
         default:
             status = LORAMAC_STATUS_SERVICE_UNKNOWN;
             break;
@@ -4046,7 +5583,100 @@ LoRaMacStatus_t LoRaMacMibSetRequestConfirm( MibRequestConfirm_t *mibSet )
     return status;
 }
 
-LoRaMacStatus_t LoRaMacChannelAdd( uint8_t id, ChannelParams_t params )
+LoRaMacStatus_t LoRaMacSessionGet( LoRaMacSession_t *session )
+{
+    TimerTime_t elapsedTime = 0;
+
+    if( session == NULL )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    if( IsLoRaMacNetworkJoined == false )
+    {
+        return LORAMAC_STATUS_NO_NETWORK_JOINED;
+    }
+
+    session->UpLinkCounter = UpLinkCounter;
+    session->DownLinkCounter = DownLinkCounter;
+    session->NetID = LoRaMacNetID;
+    session->DevAddr = LoRaMacDevAddr;
+    memcpy1( session->NwkSKey, LoRaMacNwkSKey, sizeof( session->NwkSKey ) );
+    memcpy1( session->AppSKey, LoRaMacAppSKey, sizeof( session->AppSKey ) );
+    session->MaxDCycle = MaxDCycle;
+    session->Params = LoRaMacParams;
+    memcpy1( ( uint8_t* )session->Channels, ( uint8_t* )Channels, sizeof( session->Channels ) );
+
+    // The time offs are relative to the last transmissions, which a reset
+    // forgets. Only the remaining parts are stored
+    for( uint8_t i = 0; i < LORA_MAX_NB_BANDS; i++ )
+    {
+        elapsedTime = TimerGetElapsedTime( Bands[i].LastTxDoneTime );
+        session->BandsTimeOff[i] = ( Bands[i].TimeOff > elapsedTime ) ? ( Bands[i].TimeOff - elapsedTime ) : 0;
+    }
+    elapsedTime = TimerGetElapsedTime( AggregatedLastTxDoneTime );
+    session->AggregatedTimeOff = ( AggregatedTimeOff > elapsedTime ) ? ( AggregatedTimeOff - elapsedTime ) : 0;
+
+    return LORAMAC_STATUS_OK;
+}
+
+/*!
+ * Captured part of a restored session. The channels of the bands with fixed
+ * channels do not fit in a record, they are left out
+ */
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+#define SESSION_CAPTURE_SIZE                        sizeof( LoRaMacSession_t )
+#else
+#define SESSION_CAPTURE_SIZE                        offsetof( LoRaMacSession_t, Channels )
+#endif
+
+LoRaMacStatus_t LoRaMacSessionRestore( LoRaMacSession_t *session )
+{
+    TimerTime_t curTime = 0;
+
+    if( session == NULL )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    CAPTURE( CAPTURE_SESSION_RESTORE, NULL, 0, ( const uint8_t* )session, SESSION_CAPTURE_SIZE );
+    if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
+    {
+        return LORAMAC_STATUS_BUSY;
+    }
+    if( ( ValueInRange( session->Params.ChannelsDatarate, LORAMAC_TX_MIN_DATARATE, LORAMAC_TX_MAX_DATARATE ) == false ) ||
+        ( ValueInRange( session->Params.Rx2Channel.Datarate, LORAMAC_RX_MIN_DATARATE, LORAMAC_RX_MAX_DATARATE ) == false ) ||
+        ( session->MaxDCycle == 255 ) )
+    {
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+
+    curTime = MacGetCurrentTime( );
+
+    // The up-links sent after the last store are unknown
+    UpLinkCounter = session->UpLinkCounter + LORAMAC_SESSION_FCNT_GAP;
+    DownLinkCounter = session->DownLinkCounter;
+    LoRaMacNetID = session->NetID;
+    LoRaMacDevAddr = session->DevAddr;
+    memcpy1( LoRaMacNwkSKey, session->NwkSKey, sizeof( LoRaMacNwkSKey ) );
+    memcpy1( LoRaMacAppSKey, session->AppSKey, sizeof( LoRaMacAppSKey ) );
+    MaxDCycle = session->MaxDCycle;
+    AggregatedDCycle = 1 << MaxDCycle;
+    LoRaMacParams = session->Params;
+    memcpy1( ( uint8_t* )Channels, ( uint8_t* )session->Channels, sizeof( Channels ) );
+    for( uint8_t i = 0; i < LORA_MAX_NB_BANDS; i++ )
+    {
+        Bands[i].LastTxDoneTime = curTime;
+        Bands[i].TimeOff = session->BandsTimeOff[i];
+    }
+    AggregatedLastTxDoneTime = curTime;
+    AggregatedTimeOff = session->AggregatedTimeOff;
+    IsLoRaMacNetworkJoined = true;
+
+    PrecomputeKeyStreams( );
+
+    return LORAMAC_STATUS_OK;
+}
+
+static LoRaMacStatus_t ChannelAdd( uint8_t id, ChannelParams_t params )
 {
 #if defined( USE_BAND_470 ) || defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
     return LORAMAC_STATUS_PARAMETER_INVALID;
@@ -4100,34 +5730,20 @@ LoRaMacStatus_t LoRaMacChannelAdd( uint8_t id, ChannelParams_t params )
     // Validate the frequency
     if( ( Radio.CheckRfFrequency( params.Frequency ) == true ) && ( params.Frequency > 0 ) && ( frequencyInvalid == false ) )
     {
-#if defined( USE_BAND_868 )
-        if( ( params.Frequency >= 863000000 ) && ( params.Frequency < 865000000 ) )
-        {
-            band = BAND_G1_2;
-        }
-        else if( ( params.Frequency >= 865000000 ) && ( params.Frequency <= 868000000 ) )
-        {
-            band = BAND_G1_0;
-        }
-        else if( ( params.Frequency > 868000000 ) && ( params.Frequency <= 868600000 ) )
-        {
-            band = BAND_G1_1;
-        }
-        else if( ( params.Frequency >= 868700000 ) && ( params.Frequency <= 869200000 ) )
-        {
-            band = BAND_G1_2;
-        }
-        else if( ( params.Frequency >= 869400000 ) && ( params.Frequency <= 869650000 ) )
-        {
-            band = BAND_G1_3;
-        }
-        else if( ( params.Frequency >= 869700000 ) && ( params.Frequency <= 870000000 ) )
-        {
-            band = BAND_G1_4;
-        }
-        else
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+        if( ActiveRegion->NbBandRanges > 0 )
         {
             frequencyInvalid = true;
+            for( uint8_t i = 0; i < ActiveRegion->NbBandRanges; i++ )
+            {
+                if( ( params.Frequency >= ActiveRegion->BandRanges[i].FreqMin ) &&
+                    ( params.Frequency <= ActiveRegion->BandRanges[i].FreqMax ) )
+                {
+                    band = ActiveRegion->BandRanges[i].Band;
+                    frequencyInvalid = false;
+                    break;
+                }
+            }
         }
 #endif
     }
@@ -4158,9 +5774,21 @@ LoRaMacStatus_t LoRaMacChannelAdd( uint8_t id, ChannelParams_t params )
 #endif
 }
 
-LoRaMacStatus_t LoRaMacChannelRemove( uint8_t id )
+LoRaMacStatus_t LoRaMacChannelAdd( uint8_t id, ChannelParams_t params )
 {
-#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
+#if( CAPTURE_MAC_ON )
+    uint8_t captureData[6] = { id, ( uint8_t )( params.Frequency & 0xFF ), ( uint8_t )( ( params.Frequency >> 8 ) & 0xFF ),
+                               ( uint8_t )( ( params.Frequency >> 16 ) & 0xFF ), ( uint8_t )( ( params.Frequency >> 24 ) & 0xFF ),
+                               ( uint8_t )params.DrRange.Value };
+#endif
+
+    CAPTURE( CAPTURE_CHANNEL_ADD, NULL, 0, captureData, sizeof( captureData ) );
+    return ChannelAdd( id, params );
+}
+
+static LoRaMacStatus_t ChannelRemove( uint8_t id )
+{
+#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
     if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
     {
         if( ( LoRaMacState & LORAMAC_TX_CONFIG ) != LORAMAC_TX_CONFIG )
@@ -4190,79 +5818,201 @@ LoRaMacStatus_t LoRaMacChannelRemove( uint8_t id )
 #endif
 }
 
+LoRaMacStatus_t LoRaMacChannelRemove( uint8_t id )
+{
+    CAPTURE( CAPTURE_CHANNEL_REMOVE, &id, sizeof( id ), NULL, 0 );
+    return ChannelRemove( id );
+}
+
+static uint8_t MulticastChannelHash( uint32_t address )
+{
+    // Multiplicative hashing. Spreads the consecutive addresses of a network
+    // server allocation
+    return ( uint8_t )( ( uint32_t )( address * 2654435769UL ) >> ( 32 - LORAMAC_MC_TABLE_BITS ) );
+}
+
+static MulticastParams_t* MulticastChannelFind( uint32_t address )
+{
+    uint8_t index = MulticastChannelHash( address );
+
+    // The table always has a free slot which ends the search
+    while( MulticastChannelsInUse[index] == true )
+    {
+        if( MulticastChannels[index].Address == address )
+        {
+            return &MulticastChannels[index];
+        }
+        index = ( index + 1 ) & ( LORAMAC_MC_TABLE_SIZE - 1 );
+    }
+    return NULL;
+}
+
+#if( CAPTURE_MAC_ON )
+/*!
+ * \brief Captures a multicast channel link request
+ *
+ * \param [IN] channelParam Multicast channel
+ */
+static void CaptureMulticastLink( MulticastParams_t *channelParam )
+{
+    uint8_t data[4 + 16 + 16];
+
+    data[0] = channelParam->Address & 0xFF;
+    data[1] = ( channelParam->Address >> 8 ) & 0xFF;
+    data[2] = ( channelParam->Address >> 16 ) & 0xFF;
+    data[3] = ( channelParam->Address >> 24 ) & 0xFF;
+    memcpy1( data + 4, channelParam->NwkSKey, 16 );
+    memcpy1( data + 20, channelParam->AppSKey, 16 );
+    CaptureWrite( CAPTURE_MULTICAST_LINK, NULL, 0, data, sizeof( data ) );
+}
+#endif
+
 LoRaMacStatus_t LoRaMacMulticastChannelLink( MulticastParams_t *channelParam )
 {
+    MulticastParams_t *channel = NULL;
+    uint8_t index = 0;
+
     if( channelParam == NULL )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
+#if( CAPTURE_MAC_ON )
+    CaptureMulticastLink( channelParam );
+#endif
     if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
     {
         return LORAMAC_STATUS_BUSY;
     }
 
+    channel = MulticastChannelFind( channelParam->Address );
+    if( channel == NULL )
+    {
+        if( MulticastChannelsNb >= LORAMAC_MAX_MC_CHANNELS )
+        {
+            return LORAMAC_STATUS_PARAMETER_INVALID;
+        }
+        // Take the first free slot from the home slot
+        index = MulticastChannelHash( channelParam->Address );
+        while( MulticastChannelsInUse[index] == true )
+        {
+            index = ( index + 1 ) & ( LORAMAC_MC_TABLE_SIZE - 1 );
+        }
+        channel = &MulticastChannels[index];
+        MulticastChannelsInUse[index] = true;
+        MulticastChannelsNb++;
+    }
+
+    channel->Address = channelParam->Address;
+    memcpy1( channel->NwkSKey, channelParam->NwkSKey, sizeof( channel->NwkSKey ) );
+    memcpy1( channel->AppSKey, channelParam->AppSKey, sizeof( channel->AppSKey ) );
     // Reset downlink counter
-    channelParam->DownLinkCounter = 0;
+    channel->DownLinkCounter = 0;
+
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacMulticastChannelUnlink( uint32_t address )
+{
+    MulticastParams_t *channel = NULL;
+    uint8_t index = 0;
+    uint8_t next = 0;
+    uint8_t home = 0;
 
-    if( MulticastChannels == NULL )
+    CAPTURE( CAPTURE_MULTICAST_UNLINK, &address, sizeof( address ), NULL, 0 );
+    if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
     {
-        // New node is the fist element
-        MulticastChannels = channelParam;
+        return LORAMAC_STATUS_BUSY;
     }
-    else
+
+    channel = MulticastChannelFind( address );
+    if( channel == NULL )
     {
-        MulticastParams_t *cur = MulticastChannels;
+        return LORAMAC_STATUS_PARAMETER_INVALID;
+    }
+    index = channel - MulticastChannels;
+    MulticastChannelsInUse[index] = false;
+    MulticastChannelsNb--;
 
-        // Search the last node in the list
-        while( cur->Next != NULL )
+    // Move back the following channels of the probe sequence which can no
+    // longer be reached through the freed slot
+    next = ( index + 1 ) & ( LORAMAC_MC_TABLE_SIZE - 1 );
+    while( MulticastChannelsInUse[next] == true )
+    {
+        home = MulticastChannelHash( MulticastChannels[next].Address );
+        if( ( ( next - home ) & ( LORAMAC_MC_TABLE_SIZE - 1 ) ) >= ( ( next - index ) & ( LORAMAC_MC_TABLE_SIZE - 1 ) ) )
         {
-            cur = cur->Next;
+            MulticastChannels[index] = MulticastChannels[next];
+            MulticastChannelsInUse[index] = true;
+            MulticastChannelsInUse[next] = false;
+            index = next;
         }
-        // This function always finds the last node
-        cur->Next = channelParam;
+        next = ( next + 1 ) & ( LORAMAC_MC_TABLE_SIZE - 1 );
     }
 
     return LORAMAC_STATUS_OK;
 }
 
-LoRaMacStatus_t LoRaMacMulticastChannelUnlink( MulticastParams_t *channelParam )
+LoRaMacStatus_t LoRaMacMulticastChannelGet( uint32_t address, MulticastParams_t *channelParam )
 {
-    if( channelParam == NULL )
+    MulticastParams_t *channel = MulticastChannelFind( address );
+
+    if( ( channel == NULL ) || ( channelParam == NULL ) )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
-    if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
-    {
-        return LORAMAC_STATUS_BUSY;
-    }
+    *channelParam = *channel;
 
-    if( MulticastChannels != NULL )
-    {
-        if( MulticastChannels == channelParam )
-        {
-          // First element
-          MulticastChannels = channelParam->Next;
-        }
-        else
-        {
-            MulticastParams_t *cur = MulticastChannels;
+    return LORAMAC_STATUS_OK;
+}
+
+#if( CAPTURE_MAC_ON )
+/*!
+ * \brief Captures a MLME request. The join identifiers and key are captured
+ *        by value
+ *
+ * \param [IN] mlmeRequest MLME request
+ */
+static void CaptureMlmeRequest( MlmeReq_t *mlmeRequest )
+{
+    uint8_t data[1 + 8 + 8 + 16 + 1];
+    uint8_t size = 1;
 
-            // Search the node in the list
-            while( cur->Next && cur->Next != channelParam )
+    data[0] = ( uint8_t )mlmeRequest->Type;
+    switch( mlmeRequest->Type )
+    {
+        case MLME_JOIN:
+            if( ( mlmeRequest->Req.Join.DevEui != NULL ) && ( mlmeRequest->Req.Join.AppEui != NULL ) &&
+                ( mlmeRequest->Req.Join.AppKey != NULL ) )
             {
-                cur = cur->Next;
+                memcpy1( data + 1, mlmeRequest->Req.Join.DevEui, 8 );
+                memcpy1( data + 9, mlmeRequest->Req.Join.AppEui, 8 );
+                memcpy1( data + 17, mlmeRequest->Req.Join.AppKey, 16 );
+                data[33] = mlmeRequest->Req.Join.NbTrials;
+                size = 34;
             }
-            // If we found the node, remove it
-            if( cur->Next )
+            break;
+        case MLME_TXCW:
+        case MLME_TXCW_1:
+            data[size++] = mlmeRequest->Req.TxCw.Timeout & 0xFF;
+            data[size++] = ( mlmeRequest->Req.TxCw.Timeout >> 8 ) & 0xFF;
+            if( mlmeRequest->Type == MLME_TXCW_1 )
             {
-                cur->Next = channelParam->Next;
+                data[size++] = mlmeRequest->Req.TxCw.Frequency & 0xFF;
+                data[size++] = ( mlmeRequest->Req.TxCw.Frequency >> 8 ) & 0xFF;
+                data[size++] = ( mlmeRequest->Req.TxCw.Frequency >> 16 ) & 0xFF;
+                data[size++] = ( mlmeRequest->Req.TxCw.Frequency >> 24 ) & 0xFF;
+                data[size++] = mlmeRequest->Req.TxCw.Power;
             }
-        }
-        channelParam->Next = NULL;
+            break;
+        case MLME_PING_SLOT_INFO:
+            data[size++] = mlmeRequest->Req.PingSlotInfo.Periodicity;
+            break;
+        default:
+            break;
     }
-
-    return LORAMAC_STATUS_OK;
+    CaptureWrite( CAPTURE_MLME_REQUEST, NULL, 0, data, size );
 }
+#endif
 
 LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
 {
@@ -4273,7 +6023,11 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
-    if( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING )
+#if( CAPTURE_MAC_ON )
+    CaptureMlmeRequest( mlmeRequest );
+#endif
+    if( ( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING ) ||
+        ( BeaconCtx.State == BEACON_STATE_ACQUISITION ) )
     {
         return LORAMAC_STATUS_BUSY;
     }
@@ -4333,6 +6087,7 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
             // Add a +1, since we start to count from 0
             LoRaMacParams.ChannelsDatarate = AlternateDatarate( JoinRequestTrials + 1 );
 
+            EnergyStart( ENERGY_TRANSACTION_JOIN );
             status = Send( &macHdr, 0, NULL, 0 );
             break;
         }
@@ -4359,6 +6114,49 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
             status = SetTxContinuousWave1( mlmeRequest->Req.TxCw.Timeout, mlmeRequest->Req.TxCw.Frequency, mlmeRequest->Req.TxCw.Power );
             break;
         }
+        case MLME_BEACON_ACQUISITION:
+        {
+#if defined( USE_BAND_470 ) || defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
+            // Beacon frequency hopping is not supported
+            status = LORAMAC_STATUS_SERVICE_UNKNOWN;
+#else
+            if( IsLoRaMacNetworkJoined == false )
+            {
+                return LORAMAC_STATUS_NO_NETWORK_JOINED;
+            }
+            if( LoRaMacDeviceClass == CLASS_C )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+
+            BeaconStop( );
+            BeaconCtx.NbMissed = 0;
+            BeaconRxParams = ComputeRxWindowParameters( BeaconChannel.Datarate, LoRaMacParams.SystemMaxRxError );
+            if( RxBeaconSetup( 0, true ) == false )
+            {
+                return LORAMAC_STATUS_BUSY;
+            }
+            BeaconCtx.State = BEACON_STATE_ACQUISITION;
+            TimerSetValue( &BeaconTimer, BEACON_ACQUISITION_TIMEOUT );
+            TimerStart( &BeaconTimer );
+            status = LORAMAC_STATUS_OK;
+#endif
+            break;
+        }
+        case MLME_PING_SLOT_INFO:
+        {
+            if( mlmeRequest->Req.PingSlotInfo.Periodicity > 7 )
+            {
+                return LORAMAC_STATUS_PARAMETER_INVALID;
+            }
+            LoRaMacFlags.Bits.MlmeReq = 1;
+            // LoRaMac will send this command piggy-pack
+            MlmeConfirm.MlmeRequest = mlmeRequest->Type;
+            PingSlotPeriodicityReq = mlmeRequest->Req.PingSlotInfo.Periodicity;
+
+            status = AddMacCommand( MOTE_MAC_PING_SLOT_INFO_REQ, PingSlotPeriodicityReq, 0 );
+            break;
+        }
         default:
             break;
     }
@@ -4367,11 +6165,53 @@ LoRaMacStatus_t LoRaMacMlmeRequest( MlmeReq_t *mlmeRequest )
     {
         NodeAckRequested = false;
         LoRaMacFlags.Bits.MlmeReq = 0;
+        EnergyCurrent.Transaction = ENERGY_TRANSACTION_NONE;
     }
 
     return status;
 }
 
+#if( CAPTURE_MAC_ON )
+/*!
+ * \brief Captures a MCPS request and its payload
+ *
+ * \param [IN] mcpsRequest MCPS request
+ */
+static void CaptureMcpsRequest( McpsReq_t *mcpsRequest )
+{
+    uint8_t header[4] = { ( uint8_t )mcpsRequest->Type, 0, 0, 0 };
+    const uint8_t *payload = NULL;
+    uint16_t size = 0;
+
+    switch( mcpsRequest->Type )
+    {
+        case MCPS_UNCONFIRMED:
+            header[1] = mcpsRequest->Req.Unconfirmed.fPort;
+            header[2] = mcpsRequest->Req.Unconfirmed.Datarate;
+            header[3] = 1;
+            payload = ( const uint8_t* )mcpsRequest->Req.Unconfirmed.fBuffer;
+            size = mcpsRequest->Req.Unconfirmed.fBufferSize;
+            break;
+        case MCPS_CONFIRMED:
+            header[1] = mcpsRequest->Req.Confirmed.fPort;
+            header[2] = mcpsRequest->Req.Confirmed.Datarate;
+            header[3] = mcpsRequest->Req.Confirmed.NbTrials;
+            payload = ( const uint8_t* )mcpsRequest->Req.Confirmed.fBuffer;
+            size = mcpsRequest->Req.Confirmed.fBufferSize;
+            break;
+        case MCPS_PROPRIETARY:
+            header[2] = mcpsRequest->Req.Proprietary.Datarate;
+            header[3] = 1;
+            payload = ( const uint8_t* )mcpsRequest->Req.Proprietary.fBuffer;
+            size = mcpsRequest->Req.Proprietary.fBufferSize;
+            break;
+        default:
+            break;
+    }
+    CaptureWrite( CAPTURE_MCPS_REQUEST, header, sizeof( header ), payload, size );
+}
+#endif
+
 LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
 {
     LoRaMacStatus_t status = LORAMAC_STATUS_SERVICE_UNKNOWN;
@@ -4381,13 +6221,18 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
     uint16_t fBufferSize;
     int8_t datarate;
     bool readyToSend = false;
+    LoRaMacEnergyTransaction_t transaction = ENERGY_TRANSACTION_NONE;
 
     if( mcpsRequest == NULL )
     {
         return LORAMAC_STATUS_PARAMETER_INVALID;
     }
+#if( CAPTURE_MAC_ON )
+    CaptureMcpsRequest( mcpsRequest );
+#endif
     if( ( ( LoRaMacState & LORAMAC_TX_RUNNING ) == LORAMAC_TX_RUNNING ) ||
-        ( ( LoRaMacState & LORAMAC_TX_DELAYED ) == LORAMAC_TX_DELAYED ) )
+        ( ( LoRaMacState & LORAMAC_TX_DELAYED ) == LORAMAC_TX_DELAYED ) ||
+        ( BeaconCtx.State == BEACON_STATE_ACQUISITION ) )
     {
         return LORAMAC_STATUS_BUSY;
     }
@@ -4402,6 +6247,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
         {
             readyToSend = true;
             AckTimeoutRetries = 1;
+            transaction = ENERGY_TRANSACTION_UNCONFIRMED;
 
             macHdr.Bits.MType = FRAME_TYPE_DATA_UNCONFIRMED_UP;
             fPort = mcpsRequest->Req.Unconfirmed.fPort;
@@ -4415,6 +6261,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
             readyToSend = true;
             AckTimeoutRetriesCounter = 1;
             AckTimeoutRetries = mcpsRequest->Req.Confirmed.NbTrials;
+            transaction = ENERGY_TRANSACTION_CONFIRMED;
 
             macHdr.Bits.MType = FRAME_TYPE_DATA_CONFIRMED_UP;
             fPort = mcpsRequest->Req.Confirmed.fPort;
@@ -4427,6 +6274,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
         {
             readyToSend = true;
             AckTimeoutRetries = 1;
+            transaction = ENERGY_TRANSACTION_PROPRIETARY;
 
             macHdr.Bits.MType = FRAME_TYPE_PROPRIETARY;
             fBuffer = mcpsRequest->Req.Proprietary.fBuffer;
@@ -4452,6 +6300,7 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
             }
         }
 
+        EnergyStart( transaction );
         status = Send( &macHdr, fPort, fBuffer, fBufferSize );
         if( status == LORAMAC_STATUS_OK )
         {
@@ -4461,25 +6310,46 @@ LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t *mcpsRequest )
         else
         {
             NodeAckRequested = false;
+            EnergyCurrent.Transaction = ENERGY_TRANSACTION_NONE;
         }
     }
 
     return status;
 }
 
+#if( CAPTURE_MAC_ON )
+/*!
+ * \brief Captures a LoRaMacTest function call
+ *
+ * \param [IN] request Function
+ * \param [IN] value   Function parameter
+ */
+static void CaptureTestRequest( CaptureTestRequest_t request, uint16_t value )
+{
+    uint8_t data[3] = { ( uint8_t )request, ( uint8_t )( value & 0xFF ), ( uint8_t )( ( value >> 8 ) & 0xFF ) };
+
+    CaptureWrite( CAPTURE_TEST_REQUEST, NULL, 0, data, sizeof( data ) );
+}
+#else
+#define CaptureTestRequest( request, value )
+#endif
+
 void LoRaMacTestRxWindowsOn( bool enable )
 {
+    CaptureTestRequest( CAPTURE_TEST_RX_WINDOWS_ON, enable );
     IsRxWindowsEnabled = enable;
 }
 
 void LoRaMacTestSetMic( uint16_t txPacketCounter )
 {
+    CaptureTestRequest( CAPTURE_TEST_SET_MIC, txPacketCounter );
     UpLinkCounter = txPacketCounter;
     IsUpLinkCounterFixed = true;
 }
 
 void LoRaMacTestSetDutyCycleOn( bool enable )
 {
+    CaptureTestRequest( CAPTURE_TEST_SET_DUTY_CYCLE_ON, enable );
 #if ( defined( USE_BAND_868 ) || defined( USE_BAND_433 ) || defined( USE_BAND_780 ) )
     DutyCycleOn = enable;
 #else
@@ -4489,6 +6359,7 @@ void LoRaMacTestSetDutyCycleOn( bool enable )
 
 void LoRaMacTestSetChannel( uint8_t channel )
 {
+    CaptureTestRequest( CAPTURE_TEST_SET_CHANNEL, channel );
     Channel = channel;
 }
 
@@ -4512,13 +6383,11 @@ static RxConfigParams_t ComputeRxWindowParameters( int8_t datarate, uint32_t rxE
             break;
     }
 
-#if defined( USE_BAND_433 ) || defined( USE_BAND_780 ) || defined( USE_BAND_868 )
-    if( datarate == DR_7 )
+    if( IsFskDatarate( datarate ) )
     { // FSK
         tSymbol = ( 1.0 / ( double )Datarates[datarate] ) * 8.0; // 1 symbol equals 1 byte
     }
     else
-#endif
     { // LoRa
         tSymbol = ( ( double )( 1 << Datarates[datarate] ) / ( double )Bandwidths[datarate] ) * 1e3;
     }
@@ -4529,3 +6398,348 @@ static RxConfigParams_t ComputeRxWindowParameters( int8_t datarate, uint32_t rxE
 
     return rxConfigParams;
 }
+
+static void RxTimingReset( void )
+{
+    RxTiming.Offset = 0;
+    RxTiming.Deviation = 0;
+    RxTiming.NbSamples = 0;
+    RxTiming.NbUncalibrated = 0;
+}
+
+static void RxTimingUpdate( void )
+{
+    int8_t datarate = 0;
+    uint32_t expected = 0;
+    int32_t error = 0;
+    int32_t delta = 0;
+
+    // RX2 is continuous in class C, the frame arrival time is unrelated to
+    // the window
+    if( ( RxTiming.HeaderValid == false ) || ( RxSlot > 1 ) ||
+        ( ( RxSlot == 1 ) && ( LoRaMacDeviceClass == CLASS_C ) ) )
+    {
+        return;
+    }
+    RxTiming.HeaderValid = false;
+
+    datarate = RxWindowsParams[RxSlot].Datarate;
+    if( IsFskDatarate( datarate ) )
+    { // FSK
+        return;
+    }
+
+    // The header ends 12.25 preamble symbols plus 8 header symbols after the
+    // start of the frame
+    expected = ( RxSlot == 0 ) ? LoRaMacParams.ReceiveDelay1 : LoRaMacParams.ReceiveDelay2;
+    expected += ( ( 81UL << Datarates[datarate] ) * 1000 ) / ( 4 * Bandwidths[datarate] );
+
+    error = ( int32_t )( RxTiming.HeaderTime - AggregatedLastTxDoneTime ) - ( int32_t )expected;
+
+    if( RxTiming.NbSamples == 0 )
+    {
+        // Start from the static error so that a single measurement does not
+        // shrink the windows
+        RxTiming.Offset = error * 8;
+        RxTiming.Deviation = LoRaMacParams.SystemMaxRxError * 2;
+    }
+    else
+    {
+        delta = error - ( RxTiming.Offset / 8 );
+        RxTiming.Offset += delta;
+        RxTiming.Deviation -= RxTiming.Deviation / 4;
+        RxTiming.Deviation += ( delta < 0 ) ? -delta : delta;
+    }
+    if( RxTiming.NbSamples < 255 )
+    {
+        RxTiming.NbSamples++;
+    }
+    RxTiming.NbUncalibrated = 0;
+}
+
+static uint32_t RxTimingGetError( int32_t *offset )
+{
+    // Deviation holds 4 times the mean deviation
+    uint32_t rxError = RxTiming.Deviation + RX_TIMING_MARGIN;
+
+    *offset = 0;
+    if( ( RxTiming.NbSamples < RX_TIMING_MIN_SAMPLES ) ||
+        ( RxTiming.NbUncalibrated > RX_TIMING_MAX_UNCALIBRATED ) )
+    {
+        return LoRaMacParams.SystemMaxRxError;
+    }
+    *offset = RxTiming.Offset / 8;
+    return MIN( rxError, LoRaMacParams.SystemMaxRxError );
+}
+
+static void LinkAdrReset( bool serverControlled )
+{
+    LinkAdr.ServerControlled = serverControlled;
+    LinkAdr.Index = 0;
+    LinkAdr.NbSamples = 0;
+}
+
+static int16_t LinkAdrNoiseOffset( int8_t datarate )
+{
+    // 3 dB each time the bandwidth doubles
+    if( Bandwidths[datarate] > 250e3 )
+    {
+        return 24;
+    }
+    if( Bandwidths[datarate] > 125e3 )
+    {
+        return 12;
+    }
+    return 0;
+}
+
+static int16_t LinkAdrRequiredSnr( int8_t datarate )
+{
+    uint8_t sf = Datarates[datarate];
+
+    if( ( sf < 7 ) || ( sf > 12 ) )
+    {
+        return INT16_MAX;
+    }
+    // SF7 demodulates down to -7.5 dB, each spreading factor gains 2.5 dB
+    return -30 - ( sf - 7 ) * 10 + LinkAdrNoiseOffset( datarate );
+}
+
+static void LinkAdrOnDownlink( int8_t snr )
+{
+    int8_t datarate = McpsIndication.RxDatarate;
+
+    if( LinkAdrRequiredSnr( datarate ) == INT16_MAX )
+    {
+        return;
+    }
+    // The SNR does not depend on the spreading factor, only the bandwidth and
+    // the link asymmetry are accounted
+    LinkAdrUpdate( snr + LinkAdrNoiseOffset( datarate ) - LINK_ADR_DOWNLINK_OFFSET * 4 );
+}
+
+static void LinkAdrOnLinkCheck( uint8_t margin, uint8_t nbGateways )
+{
+    int16_t snr;
+
+    if( ( margin == 255 ) || ( LinkAdrRequiredSnr( McpsConfirm.Datarate ) == INT16_MAX ) )
+    {
+        return;
+    }
+    // The margin is measured on the last uplink, sent with the McpsConfirm
+    // datarate and TX power
+    snr = LinkAdrRequiredSnr( McpsConfirm.Datarate ) + margin * 4;
+    snr += ( TxPowers[LoRaMacParamsDefaults.ChannelsTxPower] - TxPowers[McpsConfirm.TxPower] ) * 4;
+    if( nbGateways < 2 )
+    {
+        snr -= LINK_ADR_DIVERSITY_OFFSET * 4;
+    }
+    LinkAdrUpdate( snr );
+}
+
+static void LinkAdrUpdate( int16_t snr )
+{
+    int16_t budget = snr;
+    int8_t datarate = LORAMAC_TX_MIN_DATARATE;
+    int8_t txPower = LoRaMacParamsDefaults.ChannelsTxPower;
+
+    if( ( LinkAdr.Enabled == false ) || ( AdrCtrlOn == false ) || ( LinkAdr.ServerControlled == true ) )
+    {
+        return;
+    }
+
+    LinkAdr.History[LinkAdr.Index] = snr;
+    LinkAdr.Index = ( LinkAdr.Index + 1 ) % LINK_ADR_HISTORY_SIZE;
+    if( LinkAdr.NbSamples < 255 )
+    {
+        LinkAdr.NbSamples++;
+    }
+
+    // The weakest sample of the history bounds the link budget
+    for( uint8_t i = 0; i < MIN( LinkAdr.NbSamples, LINK_ADR_HISTORY_SIZE ); i++ )
+    {
+        budget = MIN( budget, LinkAdr.History[i] );
+    }
+    budget -= LINK_ADR_MARGIN * 4;
+
+    // Fastest datarate closing the link at the default TX power. The bands
+    // limit the maximal TX power, it does not add margin
+    for( int8_t dr = LORAMAC_TX_MAX_DATARATE; dr > LORAMAC_TX_MIN_DATARATE; dr-- )
+    {
+        if( ( LinkAdrRequiredSnr( dr ) <= budget ) && ( ValidateDatarate( dr, LoRaMacParams.ChannelsMask ) == true ) )
+        {
+            datarate = dr;
+            break;
+        }
+    }
+
+    // Lowest TX power keeping the margin at this datarate
+    budget -= LinkAdrRequiredSnr( datarate );
+    while( ( txPower < LORAMAC_MIN_TX_POWER ) &&
+           ( ( TxPowers[LoRaMacParamsDefaults.ChannelsTxPower] - TxPowers[txPower + 1] ) * 4 <= budget ) )
+    {
+        txPower++;
+    }
+    if( budget < 0 )
+    {
+        // No margin left at the slowest datarate
+        txPower = LORAMAC_MAX_TX_POWER;
+    }
+
+    if( LinkAdr.NbSamples < LINK_ADR_MIN_SAMPLES )
+    {
+        // Too few samples to speed up, only the safe direction is taken
+        datarate = MIN( datarate, LoRaMacParams.ChannelsDatarate );
+        txPower = MIN( txPower, LoRaMacParams.ChannelsTxPower );
+    }
+    LoRaMacParams.ChannelsDatarate = datarate;
+    LoRaMacParams.ChannelsTxPower = txPower;
+}
+
+static void EnergyInit( void )
+{
+    uint8_t i;
+    int32_t current = 0;
+
+    EnergyTable.Sleep = 200;
+    EnergyTable.Standby = 1600000;
+    EnergyTable.Rx = 11500000;
+    for( i = 0; i <= LORAMAC_MIN_TX_POWER; i++ )
+    {
+        if( TxPowers[i] > 14 )
+        { // PA_BOOST output, 87 mA at 17 dBm and 120 mA at 20 dBm
+            current = 87000 + ( TxPowers[i] - 17 ) * 11000;
+        }
+        else
+        { // RFO output, 20 mA at 7 dBm and 29 mA at 13 dBm
+            current = MAX( 20000 + ( TxPowers[i] - 7 ) * 1500, 10000 );
+        }
+        EnergyTable.Tx[i] = ( uint32_t )current * 1000;
+    }
+
+    memset1( ( uint8_t* )&Energy, 0, sizeof( Energy ) );
+    memset1( ( uint8_t* )&EnergyCurrent, 0, sizeof( EnergyCurrent ) );
+    EnergyCharge = 0;
+    EnergyBackgroundRxTime = 0;
+    EnergyBackgroundCharge = 0;
+    EnergyTxPower = LORAMAC_MAX_TX_POWER;
+    Radio.GetOpModeTimes( &EnergyTimes );
+    TimerStart( &EnergyTimer );
+}
+
+static void OnEnergyTimerEvent( void )
+{
+    TimerStart( &EnergyTimer );
+    EnergyUpdate( );
+}
+
+static void EnergyUpdate( void )
+{
+    RadioOpModeTimes_t times;
+    uint32_t txTime = 0;
+    uint32_t rxTime = 0;
+    uint32_t standbyTime = 0;
+    uint32_t sleepTime = 0;
+    uint64_t charge = 0;
+
+    if( EnergyUpdating == true )
+    {
+        return;
+    }
+    EnergyUpdating = true;
+
+    Radio.GetOpModeTimes( &times );
+    txTime = times.Tx - EnergyTimes.Tx;
+    rxTime = times.Rx - EnergyTimes.Rx;
+    standbyTime = times.Standby - EnergyTimes.Standby;
+    sleepTime = times.Sleep - EnergyTimes.Sleep;
+    EnergyTimes = times;
+
+    charge = ( uint64_t )txTime * EnergyTable.Tx[EnergyTxPower] +
+             ( uint64_t )rxTime * EnergyTable.Rx +
+             ( uint64_t )standbyTime * EnergyTable.Standby +
+             ( uint64_t )sleepTime * EnergyTable.Sleep;
+
+    if( EnergyCurrent.Transaction != ENERGY_TRANSACTION_NONE )
+    {
+        EnergyCurrent.TxTime += txTime;
+        EnergyCurrent.RxTime += rxTime;
+        EnergyCurrent.StandbyTime += standbyTime;
+        EnergyCurrent.SleepTime += sleepTime;
+        EnergyCharge += charge;
+    }
+    else
+    { // Class B and class C receptions between the transactions
+        EnergyBackgroundRxTime += rxTime;
+        EnergyBackgroundCharge += charge;
+        // 1 nAh = 3.6e9 nA.us
+        Energy.BackgroundRxTime = ( uint32_t )( EnergyBackgroundRxTime / 1000 );
+        Energy.BackgroundCharge = ( uint32_t )( EnergyBackgroundCharge / 3600000000UL );
+    }
+
+    EnergyUpdating = false;
+}
+
+static void EnergyStart( LoRaMacEnergyTransaction_t transaction )
+{
+    // The energy consumed since the last transaction goes to the background
+    EnergyUpdate( );
+
+    memset1( ( uint8_t* )&EnergyCurrent, 0, sizeof( EnergyCurrent ) );
+    EnergyCurrent.Transaction = transaction;
+    EnergyCharge = 0;
+}
+
+static void EnergyEnd( void )
+{
+    uint32_t nbTransactions = Energy.NbTransactions;
+    uint32_t totalCharge = Energy.TotalCharge;
+
+    if( EnergyCurrent.Transaction == ENERGY_TRANSACTION_NONE )
+    {
+        return;
+    }
+    EnergyUpdate( );
+
+    // 1 nAh = 3.6e9 nA.us
+    EnergyCurrent.Charge = ( uint32_t )( EnergyCharge / 3600000000UL );
+
+    Energy = EnergyCurrent;
+    Energy.NbTransactions = nbTransactions + 1;
+    Energy.TotalCharge = totalCharge + EnergyCurrent.Charge;
+    Energy.BackgroundRxTime = ( uint32_t )( EnergyBackgroundRxTime / 1000 );
+    Energy.BackgroundCharge = ( uint32_t )( EnergyBackgroundCharge / 3600000000UL );
+
+    EnergyCurrent.Transaction = ENERGY_TRANSACTION_NONE;
+}
+
+static void PrecomputeKeyStreams( void )
+{
+    if( IsLoRaMacNetworkJoined == false )
+    {
+        return;
+    }
+    // Applicative payloads are encrypted with the AppSKey
+    LoRaMacPayloadPrecompute( LoRaMacAppSKey, LoRaMacDevAddr, UP_LINK, UpLinkCounter );
+    LoRaMacPayloadPrecompute( LoRaMacAppSKey, LoRaMacDevAddr, DOWN_LINK, DownLinkCounter + 1 );
+}
+
+static TimerTime_t ComputeTxTimeOnAir( int8_t datarate, uint8_t pktLen )
+{
+    double tSymbol = 0.0;
+    double nPayload = 0.0;
+    uint8_t sf = Datarates[datarate];
+
+    if( IsFskDatarate( datarate ) )
+    { // FSK - preamble( 5 ) + sync word( 3 ) + length( 1 ) + payload + CRC( 2 ) bytes
+        return ( TimerTime_t )ceil( ( 8.0 * ( 5 + 3 + 1 + pktLen + 2 ) ) / ( double )Datarates[datarate] );
+    }
+    // LoRa - 8 symbols preamble, explicit header, CRC on, coding rate 4/5
+    tSymbol = ( ( double )( 1 << sf ) / ( double )Bandwidths[datarate] ) * 1e3;
+    // Low datarate optimization is enabled for symbols longer than 16 ms
+    nPayload = ceil( ( 8.0 * pktLen - 4.0 * sf + 28.0 + 16.0 ) /
+                     ( 4.0 * ( sf - ( ( tSymbol > 16.0 ) ? 2 : 0 ) ) ) ) * 5.0;
+    nPayload = 8.0 + ( ( nPayload > 0.0 ) ? nPayload : 0.0 );
+
+    return ( TimerTime_t )floor( ( 8.0 + 4.25 + nPayload ) * tSymbol + 0.999 );
+}
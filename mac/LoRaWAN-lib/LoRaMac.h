@@ -48,6 +48,7 @@
 
 // Includes board dependent definitions such as channels frequencies
 #include "LoRaMac-definitions.h"
+#include "profile.h"
 
 /*!
  * Beacon interval in ms
@@ -79,11 +80,35 @@
  */
 #define MAX_RX_WINDOW                               3000
 
+/*!
+ * Number of downlink timing measurements needed before the receive windows
+ * are sized from the measured timing error
+ */
+#define RX_TIMING_MIN_SAMPLES                       4
+
+/*!
+ * Number of uplinks without downlink timing measurement after which the
+ * receive windows are sized from SystemMaxRxError again
+ */
+#define RX_TIMING_MAX_UNCALIBRATED                  32
+
+/*!
+ * Margin added to the measured timing error. Covers the timer resolution [ms]
+ */
+#define RX_TIMING_MARGIN                            2
+
 /*!
  * Maximum allowed gap for the FCNT field
  */
 #define MAX_FCNT_GAP                                16384
 
+/*!
+ * Up-link counter increment applied by \ref LoRaMacSessionRestore. The
+ * session must be stored at least once every LORAMAC_SESSION_FCNT_GAP up-links
+ * so that a restored session never reuses a frame counter
+ */
+#define LORAMAC_SESSION_FCNT_GAP                    16
+
 /*!
  * ADR acknowledgement counter limit
  */
@@ -94,6 +119,35 @@
  */
 #define ADR_ACK_DELAY                               32
 
+/*!
+ * Number of link margin samples kept by the device side ADR
+ */
+#define LINK_ADR_HISTORY_SIZE                       8
+
+/*!
+ * Number of link margin samples required before the device side ADR speeds
+ * up the datarate or lowers the TX power
+ */
+#define LINK_ADR_MIN_SAMPLES                        4
+
+/*!
+ * Margin kept above the demodulation floor of the gateways [dB]
+ */
+#define LINK_ADR_MARGIN                             10
+
+/*!
+ * Uplink SNR estimated from a downlink SNR, offset removed from the downlink
+ * SNR [dB]. The gateways transmit at a higher power than the device, partly
+ * balanced by their better receivers
+ */
+#define LINK_ADR_DOWNLINK_OFFSET                    6
+
+/*!
+ * Offset removed from the link check margin heard by a single gateway, which
+ * has no reception diversity [dB]
+ */
+#define LINK_ADR_DIVERSITY_OFFSET                   3
+
 /*!
  * Number of seconds after the start of the second reception window without
  * receiving an acknowledge.
@@ -164,6 +218,33 @@ typedef enum eDeviceClass
     CLASS_C,
 }DeviceClass_t;
 
+/*!
+ * LoRaWAN regions definition
+ */
+typedef enum eLoRaMacRegion
+{
+    /*!
+     * European 433 MHz band, USE_BAND_433
+     */
+    LORAMAC_REGION_EU433,
+    /*!
+     * Chinese 470 MHz band, USE_BAND_470
+     */
+    LORAMAC_REGION_CN470,
+    /*!
+     * Chinese 779 MHz band, USE_BAND_780
+     */
+    LORAMAC_REGION_CN779,
+    /*!
+     * European 868 MHz band, USE_BAND_868
+     */
+    LORAMAC_REGION_EU868,
+    /*!
+     * North american 915 MHz band, USE_BAND_915 or USE_BAND_915_HYBRID
+     */
+    LORAMAC_REGION_US915,
+}LoRaMacRegion_t;
+
 /*!
  * LoRaMAC channels parameters definition
  */
@@ -320,6 +401,22 @@ typedef struct sLoRaMacParams
     uint16_t ChannelsMask[6];
 }LoRaMacParams_t;
 
+/*!
+ * Number of bits of the multicast channels table index
+ */
+#define LORAMAC_MC_TABLE_BITS                       5
+
+/*!
+ * Size of the multicast channels table
+ */
+#define LORAMAC_MC_TABLE_SIZE                       ( 1 << LORAMAC_MC_TABLE_BITS )
+
+/*!
+ * Maximum number of multicast channels. The table is kept at most 3/4 full so
+ * that the lookups stay short
+ */
+#define LORAMAC_MAX_MC_CHANNELS                     ( ( LORAMAC_MC_TABLE_SIZE * 3 ) / 4 )
+
 /*!
  * LoRaMAC multicast channel parameter
  */
@@ -341,10 +438,6 @@ typedef struct sMulticastParams
      * Downlink counter
      */
     uint32_t DownLinkCounter;
-    /*!
-     * Reference pointer to the next multicast channel parameters in the list
-     */
-    struct sMulticastParams *Next;
 }MulticastParams_t;
 
 /*!
@@ -423,6 +516,10 @@ typedef enum eLoRaMacMoteCmd
      * RXTimingSetupAns
      */
     MOTE_MAC_RX_TIMING_SETUP_ANS     = 0x08,
+    /*!
+     * PingSlotInfoReq
+     */
+    MOTE_MAC_PING_SLOT_INFO_REQ      = 0x10,
 }LoRaMacMoteCmd_t;
 
 /*!
@@ -460,6 +557,10 @@ typedef enum eLoRaMacSrvCmd
      * RXTimingSetupReq
      */
     SRV_MAC_RX_TIMING_SETUP_REQ      = 0x08,
+    /*!
+     * PingSlotInfoAns
+     */
+    SRV_MAC_PING_SLOT_INFO_ANS       = 0x10,
 }LoRaMacSrvCmd_t;
 
 /*!
@@ -611,6 +712,24 @@ typedef enum eLoRaMacEventInfoStatus
      * message integrity check failure
      */
     LORAMAC_EVENT_INFO_STATUS_MIC_FAIL,
+    /*!
+     * A beacon has been received. The beacon is locked
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED,
+    /*!
+     * The expected beacon has not been received. The node keeps its ping
+     * slots in beacon-less operation
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_MISSED,
+    /*!
+     * No beacon has been received for the beacon-less operation period. The
+     * node reverted to class A
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_LOST,
+    /*!
+     * The beacon acquisition did not find a beacon
+     */
+    LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND,
 }LoRaMacEventInfoStatus_t;
 
 /*!
@@ -647,6 +766,10 @@ typedef union eLoRaMacFlags_t
          * MAC cycle done
          */
         uint8_t MacDone         : 1;
+        /*!
+         * MLME-Ind pending
+         */
+        uint8_t MlmeInd         : 1;
     }Bits;
 }LoRaMacFlags_t;
 
@@ -888,7 +1011,8 @@ typedef struct sMcpsIndication
      */
     uint8_t FramePending;
     /*!
-     * Pointer to the received data stream
+     * Pointer to the received data stream. Points in a frame pool block,
+     * valid until the indication callback returns
      */
     uint8_t *Buffer;
     /*!
@@ -910,7 +1034,7 @@ typedef struct sMcpsIndication
     /*!
      * Receive window
      *
-     * [0: Rx window 1, 1: Rx window 2]
+     * [0: Rx window 1, 1: Rx window 2, 3: Class B ping slot]
      */
     uint8_t RxSlot;
     /*!
@@ -931,9 +1055,12 @@ typedef struct sMcpsIndication
  *
  * Name                  | Request | Indication | Response | Confirm
  * --------------------- | :-----: | :--------: | :------: | :-----:
- * \ref MLME_JOIN        | YES     | NO         | NO       | YES
- * \ref MLME_LINK_CHECK  | YES     | NO         | NO       | YES
- * \ref MLME_TXCW        | YES     | NO         | NO       | YES
+ * \ref MLME_JOIN                | YES     | NO         | NO       | YES
+ * \ref MLME_LINK_CHECK          | YES     | NO         | NO       | YES
+ * \ref MLME_TXCW                | YES     | NO         | NO       | YES
+ * \ref MLME_BEACON_ACQUISITION  | YES     | NO         | NO       | NO
+ * \ref MLME_PING_SLOT_INFO      | YES     | NO         | NO       | YES
+ * \ref MLME_BEACON              | NO      | YES        | NO       | NO
  *
  * The following table provides links to the function implementations of the
  * related MLME primitives.
@@ -942,6 +1069,7 @@ typedef struct sMcpsIndication
  * ---------------- | :---------------------:
  * MLME-Request     | \ref LoRaMacMlmeRequest
  * MLME-Confirm     | MacMlmeConfirm in \ref LoRaMacPrimitives_t
+ * MLME-Indication  | MacMlmeIndication in \ref LoRaMacPrimitives_t
  */
 typedef enum eMlme
 {
@@ -969,6 +1097,25 @@ typedef enum eMlme
      * LoRaWAN end-device certification
      */
     MLME_TXCW_1,
+    /*!
+     * Starts the class B beacon acquisition. The result is given by an
+     * MLME_BEACON indication
+     *
+     * LoRaWAN Specification V1.0.2, chapter 8.1
+     */
+    MLME_BEACON_ACQUISITION,
+    /*!
+     * PingSlotInfoReq - Informs the server of the ping slot periodicity
+     *
+     * LoRaWAN Specification V1.0.2, chapter 8.3
+     */
+    MLME_PING_SLOT_INFO,
+    /*!
+     * Beacon reception status. Indication only
+     *
+     * LoRaWAN Specification V1.0.2, chapter 8.1
+     */
+    MLME_BEACON,
 }Mlme_t;
 
 /*!
@@ -1019,6 +1166,18 @@ typedef struct sMlmeReqTxCw
     uint8_t Power;
 }MlmeReqTxCw_t;
 
+/*!
+ * LoRaMAC MLME-Request for the ping slot info service
+ */
+typedef struct sMlmeReqPingSlotInfo
+{
+    /*!
+     * Ping slot periodicity [0:7]. The node opens 2^( 7 - Periodicity ) ping
+     * slots per beacon period
+     */
+    uint8_t Periodicity;
+}MlmeReqPingSlotInfo_t;
+
 /*!
  * LoRaMAC MLME-Request structure
  */
@@ -1042,6 +1201,10 @@ typedef struct sMlmeReq
          * MLME-Request parameters for Tx continuous mode request
          */
         MlmeReqTxCw_t TxCw;
+        /*!
+         * MLME-Request parameters for a ping slot info request
+         */
+        MlmeReqPingSlotInfo_t PingSlotInfo;
     }Req;
 }MlmeReq_t;
 
@@ -1077,6 +1240,126 @@ typedef struct sMlmeConfirm
     uint8_t NbRetries;
 }MlmeConfirm_t;
 
+/*!
+ * LoRaMAC MLME-Indication primitive
+ */
+typedef struct sMlmeIndication
+{
+    /*!
+     * MLME-Indication type
+     */
+    Mlme_t MlmeIndication;
+    /*!
+     * Status of the operation
+     */
+    LoRaMacEventInfoStatus_t Status;
+    /*!
+     * GPS time of the current beacon period [s]. Estimated on
+     * LORAMAC_EVENT_INFO_STATUS_BEACON_MISSED, 0 when no beacon is tracked
+     */
+    uint32_t BeaconTime;
+    /*!
+     * Rssi of the received beacon. 0 unless
+     * LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED
+     */
+    int16_t Rssi;
+    /*!
+     * Snr of the received beacon. 0 unless
+     * LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED
+     */
+    uint8_t Snr;
+}MlmeIndication_t;
+
+/*!
+ * LoRaMAC transaction types of the energy accounting
+ */
+typedef enum eLoRaMacEnergyTransaction
+{
+    /*!
+     * No transaction completed yet
+     */
+    ENERGY_TRANSACTION_NONE,
+    /*!
+     * Join procedure, all join request trials included
+     */
+    ENERGY_TRANSACTION_JOIN,
+    /*!
+     * Unconfirmed uplink, repetitions included
+     */
+    ENERGY_TRANSACTION_UNCONFIRMED,
+    /*!
+     * Confirmed uplink, retransmissions included
+     */
+    ENERGY_TRANSACTION_CONFIRMED,
+    /*!
+     * Proprietary uplink
+     */
+    ENERGY_TRANSACTION_PROPRIETARY,
+}LoRaMacEnergyTransaction_t;
+
+/*!
+ * Radio current consumption table of the energy accounting [nA]
+ */
+typedef struct sLoRaMacEnergyTable
+{
+    /*!
+     * Sleep mode current
+     */
+    uint32_t Sleep;
+    /*!
+     * Standby mode current
+     */
+    uint32_t Standby;
+    /*!
+     * Receive mode current
+     */
+    uint32_t Rx;
+    /*!
+     * Transmit mode current of each Tx power index
+     */
+    uint32_t Tx[LORAMAC_MIN_TX_POWER + 1];
+}LoRaMacEnergyTable_t;
+
+/*!
+ * Radio energy consumed by the last completed MAC transaction. A transaction
+ * starts with the MCPS or MLME join request and ends with its confirm. The
+ * radio activity outside of the transactions is accounted as background
+ */
+typedef struct sLoRaMacEnergy
+{
+    /*!
+     * Type of the last transaction
+     */
+    LoRaMacEnergyTransaction_t Transaction;
+    /*!
+     * Number of frames transmitted by the last transaction
+     */
+    uint8_t NbTx;
+    /*!
+     * Time spent by the radio in each mode during the last transaction [us]
+     */
+    uint32_t TxTime;
+    uint32_t RxTime;
+    uint32_t StandbyTime;
+    uint32_t SleepTime;
+    /*!
+     * Charge drawn by the radio during the last transaction [nAh]
+     */
+    uint32_t Charge;
+    /*!
+     * Number of completed transactions and sum of their charges [nAh]
+     */
+    uint32_t NbTransactions;
+    uint32_t TotalCharge;
+    /*!
+     * Receive mode time [ms] and charge [nAh] outside of the transactions
+     * since the initialization. Class B beacon and ping slots and class C
+     * continuous reception
+     */
+    uint32_t BackgroundRxTime;
+    uint32_t BackgroundCharge;
+}LoRaMacEnergy_t;
+
 /*!
  * LoRa Mac Information Base (MIB)
  *
@@ -1112,6 +1395,12 @@ typedef struct sMlmeConfirm
  * \ref MIB_MULTICAST_CHANNEL        | YES | NO
  * \ref MIB_SYSTEM_MAX_RX_ERROR      | YES | YES
  * \ref MIB_MIN_RX_SYMBOLS           | YES | YES
+ * \ref MIB_ENERGY                   | YES | NO
+ * \ref MIB_ENERGY_TABLE             | YES | YES
+ * \ref MIB_PROFILE                  | YES | YES
+ * \ref MIB_REGION                   | YES | YES
+ * \ref MIB_LINK_ADR                 | YES | YES
+ * \ref MIB_DEV_NONCE                | YES | YES
  *
  * The following table provides links to the function implementations of the
  * related MIB primitives:
@@ -1127,6 +1416,9 @@ typedef enum eMib
      * LoRaWAN device class
      *
      * LoRaWAN Specification V1.0.1
+     *
+     * \remark Switching to CLASS_B requires a locked beacon. Refer to
+     *         \ref MLME_BEACON_ACQUISITION
      */
     MIB_DEVICE_CLASS,
     /*!
@@ -1312,9 +1604,8 @@ typedef enum eMib
      */
     MIB_DOWNLINK_COUNTER,
     /*!
-     * Multicast channels. A get request will return a pointer to the first
-     * entry of the multicast channel linked list. If the pointer is equal to
-     * NULL, the list is empty.
+     * Multicast channels. A get request will return the number of multicast
+     * channels linked. Refer to \ref LoRaMacMulticastChannelGet
      */
     MIB_MULTICAST_CHANNEL,
     /*!
@@ -1328,6 +1619,51 @@ typedef enum eMib
      * Default: 6 symbols
      */
     MIB_MIN_RX_SYMBOLS,
+    /*!
+     * Radio energy consumed by the last MAC transaction
+     */
+    MIB_ENERGY,
+    /*!
+     * Radio current consumption table used to compute the energy
+     */
+    MIB_ENERGY_TABLE,
+    /*!
+     * Hot path profiler statistics. A set clears them
+     *
+     * \remark Requires PROFILE_ON
+     */
+    MIB_PROFILE,
+    /*!
+     * Active region. A set applies the regional defaults: bands, default
+     * channels, TX power, receive window 2 and class B channels
+     *
+     * \remark Only the regions built in the image may be selected, the EU433,
+     *         CN779 and EU868 regions may be built together. The region is set
+     *         before the activation, while the device is not joined
+     */
+    MIB_REGION,
+    /*!
+     * Device side ADR. The datarate and the TX power follow the link margin
+     * estimated from the downlinks SNR and the link check answers
+     *
+     * \remark Requires \ref MIB_ADR. The device side ADR yields to the network
+     *         once a LinkADRReq is accepted, until the ADR acknowledgement
+     *         back-off, a new activation or a new set
+     *
+     * [true: enabled, false: disabled]
+     */
+    MIB_LINK_ADR,
+    /*!
+     * DevNonce of the next join request. The MAC layer increments it on each
+     * join request
+     *
+     * \remark An application with non-volatile memory stores the value before
+     *         each join request and sets it back after a reset so that a
+     *         DevNonce is never reused
+     *
+     * Default: random value
+     */
+    MIB_DEV_NONCE,
 }Mib_t;
 
 /*!
@@ -1492,11 +1828,11 @@ typedef union uMibParam
      */
     uint32_t DownLinkCounter;
     /*!
-     * Multicast channel
+     * Number of multicast channels
      *
      * Related MIB type: \ref MIB_MULTICAST_CHANNEL
      */
-    MulticastParams_t* MulticastList;
+    uint8_t NbMulticastChannels;
     /*!
      * System overall timing error in milliseconds. 
      *
@@ -1509,6 +1845,43 @@ typedef union uMibParam
      * Related MIB type: \ref MIB_MIN_RX_SYMBOLS
      */
     uint8_t MinRxSymbols;
+    /*!
+     * Radio energy consumed by the last MAC transaction
+     *
+     * Related MIB type: \ref MIB_ENERGY
+     */
+    LoRaMacEnergy_t* Energy;
+    /*!
+     * Radio current consumption table. The table is copied on set
+     *
+     * Related MIB type: \ref MIB_ENERGY_TABLE
+     */
+    LoRaMacEnergyTable_t* EnergyTable;
+    /*!
+     * Profiler statistics, table of PROFILE_NB_REGIONS entries indexed by
+     * ProfileRegion_t
+     *
+     * Related MIB type: \ref MIB_PROFILE
+     */
+    const ProfileStats_t* ProfileStats;
+    /*!
+     * Active region
+     *
+     * Related MIB type: \ref MIB_REGION
+     */
+    LoRaMacRegion_t Region;
+    /*!
+     * Activation state of the device side ADR
+     *
+     * Related MIB type: \ref MIB_LINK_ADR
+     */
+    bool LinkAdrEnable;
+    /*!
+     * DevNonce of the next join request
+     *
+     * Related MIB type: \ref MIB_DEV_NONCE
+     */
+    uint16_t DevNonce;
 }MibParam_t;
 
 /*!
@@ -1542,6 +1915,123 @@ typedef struct sLoRaMacTxInfo
     uint8_t CurrentPayloadSize;
 }LoRaMacTxInfo_t;
 
+/*!
+ * LoRaMAC tx plan for a single datarate
+ */
+typedef struct sLoRaMacTxPlanEntry
+{
+    /*!
+     * Datarate of this entry
+     */
+    int8_t Datarate;
+    /*!
+     * Set to true when at least one enabled channel supports the datarate
+     */
+    bool Allowed;
+    /*!
+     * Set to true when the applicative payload and the pending MAC commands
+     * fit into a single frame on this datarate
+     */
+    bool PayloadFits;
+    /*!
+     * Maximum applicative payload, taking the pending MAC commands into account
+     */
+    uint8_t MaxPossiblePayload;
+    /*!
+     * Time on air of the resulting frame [ms]
+     */
+    TimerTime_t TimeOnAir;
+    /*!
+     * Delay until the earliest possible transmission [ms], taking the band
+     * and the aggregated time-off into account. 0 means the frame can be sent
+     * immediately
+     */
+    TimerTime_t TxDelay;
+    /*!
+     * Time-off the transmission will impose on its band [ms]
+     */
+    TimerTime_t TimeOff;
+    /*!
+     * Residual duty-cycle budget. Number of frames of the given size which
+     * can still be sent on this datarate within the next hour
+     */
+    uint16_t NbTxPerHour;
+}LoRaMacTxPlanEntry_t;
+
+/*!
+ * LoRaMAC tx plan
+ */
+typedef struct sLoRaMacTxPlan
+{
+    /*!
+     * Number of FOpts bytes the pending MAC commands will take
+     */
+    uint8_t FOptsLen;
+    /*!
+     * Datarate the LoRaMAC will use for the next frame ( configured datarate
+     * or the next datarate according to ADR )
+     */
+    int8_t CurrentDatarate;
+    /*!
+     * Tx plan for each datarate from LORAMAC_TX_MIN_DATARATE up to
+     * LORAMAC_TX_MAX_DATARATE
+     */
+    LoRaMacTxPlanEntry_t Entries[LORAMAC_TX_MAX_DATARATE - LORAMAC_TX_MIN_DATARATE + 1];
+}LoRaMacTxPlan_t;
+
+/*!
+ * LoRaMAC session context. Holds the state the node needs to resume the
+ * communication without a new join. The fields which change on every
+ * transaction come first so that they can be stored as a single range
+ */
+typedef struct sLoRaMacSession
+{
+    /*!
+     * LoRaWAN Up-link counter
+     */
+    uint32_t UpLinkCounter;
+    /*!
+     * LoRaWAN Down-link counter
+     */
+    uint32_t DownLinkCounter;
+    /*!
+     * Aggregated duty cycle time off remaining when the session was read [ms]
+     */
+    TimerTime_t AggregatedTimeOff;
+    /*!
+     * Duty cycle time off of each band remaining when the session was read [ms]
+     */
+    TimerTime_t BandsTimeOff[LORA_MAX_NB_BANDS];
+    /*!
+     * Network ID ( 3 bytes )
+     */
+    uint32_t NetID;
+    /*!
+     * End-device address
+     */
+    uint32_t DevAddr;
+    /*!
+     * Network session key
+     */
+    uint8_t NwkSKey[16];
+    /*!
+     * Application session key
+     */
+    uint8_t AppSKey[16];
+    /*!
+     * Aggregated duty cycle set by the DutyCycleReq MAC command
+     */
+    uint8_t MaxDCycle;
+    /*!
+     * MAC layer parameters
+     */
+    LoRaMacParams_t Params;
+    /*!
+     * Channels plan
+     */
+    ChannelParams_t Channels[LORA_MAX_NB_CHANNELS];
+}LoRaMacSession_t;
+
 /*!
  * LoRaMAC Status
  */
@@ -1617,6 +2107,12 @@ typedef struct sLoRaMacPrimitives
      * \param   [OUT] MLME-Confirm parameters
      */
     void ( *MacMlmeConfirm )( MlmeConfirm_t *MlmeConfirm );
+    /*!
+     * \brief   MLME-Indication primitive. Optional, may be NULL
+     *
+     * \param   [OUT] MLME-Indication parameters
+     */
+    void ( *MacMlmeIndication )( MlmeIndication_t *MlmeIndication );
 }LoRaMacPrimitives_t;
 
 typedef struct sLoRaMacCallback
@@ -1676,6 +2172,55 @@ LoRaMacStatus_t LoRaMacInitialization( LoRaMacPrimitives_t *primitives, LoRaMacC
  */
 LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo );
 
+/*!
+ * \brief   Queries the LoRaMAC for a transmission plan of the next frame with
+ *          a given payload size. For every uplink datarate, the LoRaMAC reports
+ *          the time on air, the earliest possible transmission time and the
+ *          residual duty-cycle budget. The scheduled MAC commands are taken
+ *          into account.
+ *
+ * \param   [IN] size - Size of applicative payload to be send next
+ *
+ * \param   [OUT] txPlan - The structure \ref LoRaMacTxPlan_t contains the
+ *                         plan for each datarate.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID,
+ *          \ref LORAMAC_STATUS_DEVICE_OFF.
+ */
+LoRaMacStatus_t LoRaMacQueryTxPlan( uint8_t size, LoRaMacTxPlan_t* txPlan );
+
+/*!
+ * \brief   Reads the LoRaMAC session context so that the application can
+ *          store it in non-volatile memory
+ *
+ * \param   [OUT] session - Session context
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID,
+ *          \ref LORAMAC_STATUS_NO_NETWORK_JOINED.
+ */
+LoRaMacStatus_t LoRaMacSessionGet( LoRaMacSession_t *session );
+
+/*!
+ * \brief   Restores a LoRaMAC session context. The node is in the joined
+ *          state on success
+ *
+ * \remark  The up-link counter resumes LORAMAC_SESSION_FCNT_GAP frames after
+ *          the stored value. The remaining duty cycle time offs count from the
+ *          restoration
+ *
+ * \param   [IN] session - Session context read by \ref LoRaMacSessionGet
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_BUSY,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID.
+ */
+LoRaMacStatus_t LoRaMacSessionRestore( LoRaMacSession_t *session );
+
 /*!
  * \brief   LoRaMAC channel add service
  *
@@ -1715,7 +2260,10 @@ LoRaMacStatus_t LoRaMacChannelRemove( uint8_t id );
 /*!
  * \brief   LoRaMAC multicast channel link service
  *
- * \details Links a multicast channel into the linked list.
+ * \details Adds a multicast channel to the multicast channels table. The
+ *          parameters are copied, the structure may be released by the caller.
+ *          Linking an address already in the table updates its keys. The
+ *          downlink counter is reset.
  *
  * \param   [IN] channelParam - Multicast channel parameters to link.
  *
@@ -1729,16 +2277,31 @@ LoRaMacStatus_t LoRaMacMulticastChannelLink( MulticastParams_t *channelParam );
 /*!
  * \brief   LoRaMAC multicast channel unlink service
  *
- * \details Unlinks a multicast channel from the linked list.
+ * \details Removes a multicast channel from the multicast channels table.
  *
- * \param   [IN] channelParam - Multicast channel parameters to unlink.
+ * \param   [IN] address - Address of the multicast channel to unlink.
  *
  * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
  *          \ref LORAMAC_STATUS_OK,
  *          \ref LORAMAC_STATUS_BUSY,
  *          \ref LORAMAC_STATUS_PARAMETER_INVALID.
  */
-LoRaMacStatus_t LoRaMacMulticastChannelUnlink( MulticastParams_t *channelParam );
+LoRaMacStatus_t LoRaMacMulticastChannelUnlink( uint32_t address );
+
+/*!
+ * \brief   LoRaMAC multicast channel get service
+ *
+ * \details Reads the parameters and the downlink counter of a multicast
+ *          channel.
+ *
+ * \param   [IN]  address      - Address of the multicast channel.
+ * \param   [OUT] channelParam - Multicast channel parameters.
+ *
+ * \retval  LoRaMacStatus_t Status of the operation. Possible returns are:
+ *          \ref LORAMAC_STATUS_OK,
+ *          \ref LORAMAC_STATUS_PARAMETER_INVALID.
+ */
+LoRaMacStatus_t LoRaMacMulticastChannelGet( uint32_t address, MulticastParams_t *channelParam );
 
 /*!
  * \brief   LoRaMAC MIB-Get
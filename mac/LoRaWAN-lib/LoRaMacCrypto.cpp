@@ -20,9 +20,7 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jä
 #include <stdlib.h>
 #include <stdint.h>
 #include "utilities.h"
-
-#include "aes.h"
-#include "cmac.h"
+#include "profile.h"
 
 #include "LoRaMacCrypto.h"
 
@@ -32,108 +30,178 @@ Maintainer: Miguel Luis ( Semtech ), Gregory Cristian ( Semtech ) and Daniel Jä
 #define LORAMAC_MIC_BLOCK_B0_SIZE                   16
 
 /*!
- * MIC field computation initial data
+ * Crypto context of the MAC layer
  */
-static uint8_t MicBlockB0[] = { 0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                              };
+static LoRaMacCryptoCtx_t MacCryptoCtx;
 
 /*!
- * Contains the computed MIC field.
+ * \brief Compares two AES keys
  *
- * \remark Only the 4 first bytes are used
+ * \retval [true: equal keys, false: different keys]
  */
-static uint8_t Mic[16];
+static bool KeyEqual( const uint8_t *key1, const uint8_t *key2 )
+{
+    uint8_t i;
+
+    for( i = 0; i < 16; i++ )
+    {
+        if( key1[i] != key2[i] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
 /*!
- * Encryption aBlock and sBlock
+ * \brief Loads a key in the AES context. The key schedule is only computed
+ *        when the key changes
+ *
+ * \param [IN]  ctx             Crypto context
+ * \param [IN]  key             AES key to be used
  */
-static uint8_t aBlock[] = { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                          };
-static uint8_t sBlock[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-                          };
+static void AesSetKey( LoRaMacCryptoCtx_t *ctx, const uint8_t *key )
+{
+    if( ( ctx->AesKeyValid == true ) && ( KeyEqual( ctx->AesKey, key ) == true ) )
+    {
+        return;
+    }
+    memset1( ctx->Aes.ksch, '\0', 240 );
+    aes_set_key( key, 16, &ctx->Aes );
+    memcpy1( ctx->AesKey, key, 16 );
+    ctx->AesKeyValid = true;
+}
 
 /*!
- * AES computation context variable
+ * \brief Starts a CMAC computation
+ *
+ * \param [IN]  ctx             Crypto context
+ * \param [IN]  key             AES key to be used
  */
-static aes_context AesContext;
+static void AesCmacStart( LoRaMacCryptoCtx_t *ctx, const uint8_t *key )
+{
+    if( ( ctx->CmacKeyValid == true ) && ( KeyEqual( ctx->CmacKey, key ) == true ) )
+    {
+        // Same as AES_CMAC_Init but keeps the key schedule
+        memset1( ctx->Cmac->X, 0, sizeof( ctx->Cmac->X ) );
+        ctx->Cmac->M_n = 0;
+        return;
+    }
+    AES_CMAC_Init( ctx->Cmac );
+    AES_CMAC_SetKey( ctx->Cmac, key );
+    memcpy1( ctx->CmacKey, key, 16 );
+    ctx->CmacKeyValid = true;
+}
 
 /*!
- * CMAC computation context variable
+ * \brief Sets the frame parameters of the encryption aBlock
  */
-static AES_CMAC_CTX AesCmacCtx[1];
+static void SetABlock( LoRaMacCryptoCtx_t *ctx, uint32_t address, uint8_t dir, uint32_t sequenceCounter )
+{
+    ctx->ABlock[0] = 0x01;
+
+    ctx->ABlock[5] = dir;
+
+    ctx->ABlock[6] = ( address ) & 0xFF;
+    ctx->ABlock[7] = ( address >> 8 ) & 0xFF;
+    ctx->ABlock[8] = ( address >> 16 ) & 0xFF;
+    ctx->ABlock[9] = ( address >> 24 ) & 0xFF;
+
+    ctx->ABlock[10] = ( sequenceCounter ) & 0xFF;
+    ctx->ABlock[11] = ( sequenceCounter >> 8 ) & 0xFF;
+    ctx->ABlock[12] = ( sequenceCounter >> 16 ) & 0xFF;
+    ctx->ABlock[13] = ( sequenceCounter >> 24 ) & 0xFF;
+}
 
 /*!
- * \brief Computes the LoRaMAC frame MIC field  
+ * \brief Checks if a keystream has been computed for a frame
  *
- * \param [IN]  buffer          Data buffer
- * \param [IN]  size            Data buffer size
- * \param [IN]  key             AES key to be used
- * \param [IN]  address         Frame address
- * \param [IN]  dir             Frame direction [0: uplink, 1: downlink]
- * \param [IN]  sequenceCounter Frame sequence counter
- * \param [OUT] mic Computed MIC field
+ * \retval [true: keystream available, false: keystream not available]
  */
-void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+static bool KeyStreamMatch( LoRaMacKeyStream_t *keyStream, const uint8_t *key, uint32_t address, uint32_t sequenceCounter )
 {
-    MicBlockB0[5] = dir;
-    
-    MicBlockB0[6] = ( address ) & 0xFF;
-    MicBlockB0[7] = ( address >> 8 ) & 0xFF;
-    MicBlockB0[8] = ( address >> 16 ) & 0xFF;
-    MicBlockB0[9] = ( address >> 24 ) & 0xFF;
+    return ( keyStream->Valid == true ) && ( keyStream->Address == address ) &&
+           ( keyStream->SequenceCounter == sequenceCounter ) && ( KeyEqual( keyStream->Key, key ) == true );
+}
 
-    MicBlockB0[10] = ( sequenceCounter ) & 0xFF;
-    MicBlockB0[11] = ( sequenceCounter >> 8 ) & 0xFF;
-    MicBlockB0[12] = ( sequenceCounter >> 16 ) & 0xFF;
-    MicBlockB0[13] = ( sequenceCounter >> 24 ) & 0xFF;
+/*!
+ * \brief Converts the first 4 bytes of a CMAC to a MIC field
+ */
+static uint32_t MicFromCmac( const uint8_t *cmac )
+{
+    return ( uint32_t )( ( uint32_t )cmac[3] << 24 | ( uint32_t )cmac[2] << 16 | ( uint32_t )cmac[1] << 8 | ( uint32_t )cmac[0] );
+}
 
-    MicBlockB0[15] = size & 0xFF;
+void LoRaMacComputeMicCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+{
+    ctx->MicBlockB0[0] = 0x49;
 
-    AES_CMAC_Init( AesCmacCtx );
+    ctx->MicBlockB0[5] = dir;
+    
+    ctx->MicBlockB0[6] = ( address ) & 0xFF;
+    ctx->MicBlockB0[7] = ( address >> 8 ) & 0xFF;
+    ctx->MicBlockB0[8] = ( address >> 16 ) & 0xFF;
+    ctx->MicBlockB0[9] = ( address >> 24 ) & 0xFF;
+
+    ctx->MicBlockB0[10] = ( sequenceCounter ) & 0xFF;
+    ctx->MicBlockB0[11] = ( sequenceCounter >> 8 ) & 0xFF;
+    ctx->MicBlockB0[12] = ( sequenceCounter >> 16 ) & 0xFF;
+    ctx->MicBlockB0[13] = ( sequenceCounter >> 24 ) & 0xFF;
 
-    AES_CMAC_SetKey( AesCmacCtx, key );
+    ctx->MicBlockB0[15] = size & 0xFF;
 
-    AES_CMAC_Update( AesCmacCtx, MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
+    AesCmacStart( ctx, key );
+
+    AES_CMAC_Update( ctx->Cmac, ctx->MicBlockB0, LORAMAC_MIC_BLOCK_B0_SIZE );
     
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
+    AES_CMAC_Update( ctx->Cmac, buffer, size & 0xFF );
     
-    AES_CMAC_Final( Mic, AesCmacCtx );
+    AES_CMAC_Final( ctx->Mic, ctx->Cmac );
     
-    *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
+    *mic = MicFromCmac( ctx->Mic );
 }
 
-void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
+void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic )
+{
+    PROFILE_SCOPE( PROFILE_COMPUTE_MIC );
+
+    LoRaMacComputeMicCtx( &MacCryptoCtx, buffer, size, key, address, dir, sequenceCounter, mic );
+}
+
+void LoRaMacPayloadEncryptCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
 {
     uint16_t i;
     uint8_t bufferIndex = 0;
     uint16_t ctr = 1;
+    LoRaMacKeyStream_t *keyStream = &ctx->KeyStreams[dir & 0x01];
 
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
-
-    aBlock[5] = dir;
-
-    aBlock[6] = ( address ) & 0xFF;
-    aBlock[7] = ( address >> 8 ) & 0xFF;
-    aBlock[8] = ( address >> 16 ) & 0xFF;
-    aBlock[9] = ( address >> 24 ) & 0xFF;
+    if( KeyStreamMatch( keyStream, key, address, sequenceCounter ) == true )
+    {
+        // Use the keystream computed ahead of time
+        while( ( size > 0 ) && ( bufferIndex < LORAMAC_KEYSTREAM_SIZE ) )
+        {
+            encBuffer[bufferIndex] = buffer[bufferIndex] ^ keyStream->Block[bufferIndex];
+            bufferIndex++;
+            size--;
+        }
+        if( size == 0 )
+        {
+            return;
+        }
+        ctr += LORAMAC_KEYSTREAM_SIZE / 16;
+    }
 
-    aBlock[10] = ( sequenceCounter ) & 0xFF;
-    aBlock[11] = ( sequenceCounter >> 8 ) & 0xFF;
-    aBlock[12] = ( sequenceCounter >> 16 ) & 0xFF;
-    aBlock[13] = ( sequenceCounter >> 24 ) & 0xFF;
+    AesSetKey( ctx, key );
+    SetABlock( ctx, address, dir, sequenceCounter );
 
     while( size >= 16 )
     {
-        aBlock[15] = ( ( ctr ) & 0xFF );
+        ctx->ABlock[15] = ( ( ctr ) & 0xFF );
         ctr++;
-        aes_encrypt( aBlock, sBlock, &AesContext );
+        aes_encrypt( ctx->ABlock, ctx->SBlock, &ctx->Aes );
         for( i = 0; i < 16; i++ )
         {
-            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
+            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ ctx->SBlock[i];
         }
         size -= 16;
         bufferIndex += 16;
@@ -141,42 +209,79 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
 
     if( size > 0 )
     {
-        aBlock[15] = ( ( ctr ) & 0xFF );
-        aes_encrypt( aBlock, sBlock, &AesContext );
+        ctx->ABlock[15] = ( ( ctr ) & 0xFF );
+        aes_encrypt( ctx->ABlock, ctx->SBlock, &ctx->Aes );
         for( i = 0; i < size; i++ )
         {
-            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ sBlock[i];
+            encBuffer[bufferIndex + i] = buffer[bufferIndex + i] ^ ctx->SBlock[i];
         }
     }
 }
 
+void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer )
+{
+    LoRaMacPayloadEncryptCtx( &MacCryptoCtx, buffer, size, key, address, dir, sequenceCounter, encBuffer );
+}
+
+void LoRaMacPayloadDecryptCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
+{
+    LoRaMacPayloadEncryptCtx( ctx, buffer, size, key, address, dir, sequenceCounter, decBuffer );
+}
+
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer )
 {
-    LoRaMacPayloadEncrypt( buffer, size, key, address, dir, sequenceCounter, decBuffer );
+    LoRaMacPayloadEncryptCtx( &MacCryptoCtx, buffer, size, key, address, dir, sequenceCounter, decBuffer );
 }
 
-void LoRaMacJoinComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic )
+void LoRaMacPayloadPrecompute( const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter )
+{
+    uint8_t i;
+    LoRaMacCryptoCtx_t *ctx = &MacCryptoCtx;
+    LoRaMacKeyStream_t *keyStream = &ctx->KeyStreams[dir & 0x01];
+
+    if( KeyStreamMatch( keyStream, key, address, sequenceCounter ) == true )
+    {
+        return;
+    }
+
+    AesSetKey( ctx, key );
+    SetABlock( ctx, address, dir, sequenceCounter );
+
+    for( i = 0; i < ( LORAMAC_KEYSTREAM_SIZE / 16 ); i++ )
+    {
+        ctx->ABlock[15] = ( ( i + 1 ) & 0xFF );
+        aes_encrypt( ctx->ABlock, keyStream->Block + ( i * 16 ), &ctx->Aes );
+    }
+    memcpy1( keyStream->Key, key, 16 );
+    keyStream->Address = address;
+    keyStream->SequenceCounter = sequenceCounter;
+    keyStream->Valid = true;
+}
+
+void LoRaMacJoinComputeMicCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic )
 {
-    AES_CMAC_Init( AesCmacCtx );
+    AesCmacStart( ctx, key );
 
-    AES_CMAC_SetKey( AesCmacCtx, key );
+    AES_CMAC_Update( ctx->Cmac, buffer, size & 0xFF );
 
-    AES_CMAC_Update( AesCmacCtx, buffer, size & 0xFF );
+    AES_CMAC_Final( ctx->Mic, ctx->Cmac );
 
-    AES_CMAC_Final( Mic, AesCmacCtx );
+    *mic = MicFromCmac( ctx->Mic );
+}
 
-    *mic = ( uint32_t )( ( uint32_t )Mic[3] << 24 | ( uint32_t )Mic[2] << 16 | ( uint32_t )Mic[1] << 8 | ( uint32_t )Mic[0] );
+void LoRaMacJoinComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic )
+{
+    LoRaMacJoinComputeMicCtx( &MacCryptoCtx, buffer, size, key, mic );
 }
 
 void LoRaMacJoinDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer )
 {
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
-    aes_encrypt( buffer, decBuffer, &AesContext );
+    AesSetKey( &MacCryptoCtx, key );
+    aes_encrypt( buffer, decBuffer, &MacCryptoCtx.Aes );
     // Check if optional CFList is included
     if( size >= 16 )
     {
-        aes_encrypt( buffer + 16, decBuffer + 16, &AesContext );
+        aes_encrypt( buffer + 16, decBuffer + 16, &MacCryptoCtx.Aes );
     }
 }
 
@@ -185,18 +290,41 @@ void LoRaMacJoinComputeSKeys( const uint8_t *key, const uint8_t *appNonce, uint1
     uint8_t nonce[16];
     uint8_t *pDevNonce = ( uint8_t * )&devNonce;
     
-    memset1( AesContext.ksch, '\0', 240 );
-    aes_set_key( key, 16, &AesContext );
+    AesSetKey( &MacCryptoCtx, key );
 
     memset1( nonce, 0, sizeof( nonce ) );
     nonce[0] = 0x01;
     memcpy1( nonce + 1, appNonce, 6 );
     memcpy1( nonce + 7, pDevNonce, 2 );
-    aes_encrypt( nonce, nwkSKey, &AesContext );
+    aes_encrypt( nonce, nwkSKey, &MacCryptoCtx.Aes );
 
     memset1( nonce, 0, sizeof( nonce ) );
     nonce[0] = 0x02;
     memcpy1( nonce + 1, appNonce, 6 );
     memcpy1( nonce + 7, pDevNonce, 2 );
-    aes_encrypt( nonce, appSKey, &AesContext );
+    aes_encrypt( nonce, appSKey, &MacCryptoCtx.Aes );
+}
+
+void LoRaMacBeaconComputePingOffset( uint32_t beaconTime, uint32_t address, uint16_t pingPeriod, uint16_t *pingOffset )
+{
+    uint8_t zeroKey[16];
+    uint8_t block[16];
+    uint8_t rand[16];
+
+    // Rand = aes128_encrypt( 16 x 0x00, BeaconTime | DevAddr | pad16 )
+    memset1( zeroKey, 0, sizeof( zeroKey ) );
+    AesSetKey( &MacCryptoCtx, zeroKey );
+
+    memset1( block, 0, sizeof( block ) );
+    block[0] = beaconTime & 0xFF;
+    block[1] = ( beaconTime >> 8 ) & 0xFF;
+    block[2] = ( beaconTime >> 16 ) & 0xFF;
+    block[3] = ( beaconTime >> 24 ) & 0xFF;
+    block[4] = address & 0xFF;
+    block[5] = ( address >> 8 ) & 0xFF;
+    block[6] = ( address >> 16 ) & 0xFF;
+    block[7] = ( address >> 24 ) & 0xFF;
+    aes_encrypt( block, rand, &MacCryptoCtx.Aes );
+
+    *pingOffset = ( rand[0] + ( rand[1] * 256 ) ) % pingPeriod;
 }
@@ -36,6 +36,74 @@
 #ifndef __LORAMAC_CRYPTO_H__
 #define __LORAMAC_CRYPTO_H__
 
+#include "aes.h"
+#include "cmac.h"
+
+/*!
+ * Size of the payload keystream computed ahead of time for each direction.
+ * Must be a multiple of 16
+ */
+#define LORAMAC_KEYSTREAM_SIZE                      64
+
+/*!
+ * Payload keystream computed ahead of time
+ */
+typedef struct sLoRaMacKeyStream
+{
+    /*!
+     * Indicates if the keystream has been computed
+     */
+    bool Valid;
+    /*!
+     * Frame parameters of the keystream
+     */
+    uint8_t Key[16];
+    uint32_t Address;
+    uint32_t SequenceCounter;
+    /*!
+     * Keystream blocks
+     */
+    uint8_t Block[LORAMAC_KEYSTREAM_SIZE];
+}LoRaMacKeyStream_t;
+
+/*!
+ * Crypto computation state. The functions without a context parameter use the
+ * context of the MAC layer, which its interrupt handlers may use at any time.
+ * Other users call the *Ctx functions with their own context, zero initialized
+ * before its first use
+ */
+typedef struct sLoRaMacCryptoCtx
+{
+    /*!
+     * AES context and its key. The key schedule is only computed when the key
+     * changes
+     */
+    aes_context Aes;
+    uint8_t AesKey[16];
+    bool AesKeyValid;
+    /*!
+     * CMAC context and its key
+     */
+    AES_CMAC_CTX Cmac[1];
+    uint8_t CmacKey[16];
+    bool CmacKeyValid;
+    /*!
+     * MIC computation block B0 and result. Only the 4 first bytes of the
+     * result are used
+     */
+    uint8_t MicBlockB0[16];
+    uint8_t Mic[16];
+    /*!
+     * Encryption aBlock and sBlock
+     */
+    uint8_t ABlock[16];
+    uint8_t SBlock[16];
+    /*!
+     * Uplink and downlink keystreams
+     */
+    LoRaMacKeyStream_t KeyStreams[2];
+}LoRaMacCryptoCtx_t;
+
 /*!
  * Computes the LoRaMAC frame MIC field
  *
@@ -49,6 +117,14 @@
  */
 void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic );
 
+/*!
+ * Computes the LoRaMAC frame MIC field with the given context
+ *
+ * \param [IN]  ctx             - Crypto context
+ * \see LoRaMacComputeMic
+ */
+void LoRaMacComputeMicCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint32_t *mic );
+
 /*!
  * Computes the LoRaMAC payload encryption
  *
@@ -62,6 +138,14 @@ void LoRaMacComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key
  */
 void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer );
 
+/*!
+ * Computes the LoRaMAC payload encryption with the given context
+ *
+ * \param [IN]  ctx             - Crypto context
+ * \see LoRaMacPayloadEncrypt
+ */
+void LoRaMacPayloadEncryptCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *encBuffer );
+
 /*!
  * Computes the LoRaMAC payload decryption
  *
@@ -71,10 +155,30 @@ void LoRaMacPayloadEncrypt( const uint8_t *buffer, uint16_t size, const uint8_t
  * \param [IN]  address         - Frame address
  * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
  * \param [IN]  sequenceCounter - Frame sequence counter
- * \param [OUT] decBuffer       - Decrypted buffer
+ * \param [OUT] decBuffer       - Decrypted buffer, may be the data buffer
  */
 void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer );
 
+/*!
+ * Computes the LoRaMAC payload decryption with the given context
+ *
+ * \param [IN]  ctx             - Crypto context
+ * \see LoRaMacPayloadDecrypt
+ */
+void LoRaMacPayloadDecryptCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter, uint8_t *decBuffer );
+
+/*!
+ * Computes the first LORAMAC_KEYSTREAM_SIZE bytes of the payload keystream of
+ * a frame. A later encryption or decryption of the frame only XORs them with
+ * the payload. One keystream is kept per direction
+ *
+ * \param [IN]  key             - AES key to be used
+ * \param [IN]  address         - Frame address
+ * \param [IN]  dir             - Frame direction [0: uplink, 1: downlink]
+ * \param [IN]  sequenceCounter - Frame sequence counter
+ */
+void LoRaMacPayloadPrecompute( const uint8_t *key, uint32_t address, uint8_t dir, uint32_t sequenceCounter );
+
 /*!
  * Computes the LoRaMAC Join Request frame MIC field
  *
@@ -85,13 +189,21 @@ void LoRaMacPayloadDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t
  */
 void LoRaMacJoinComputeMic( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic );
 
+/*!
+ * Computes the LoRaMAC Join Request frame MIC field with the given context
+ *
+ * \param [IN]  ctx             - Crypto context
+ * \see LoRaMacJoinComputeMic
+ */
+void LoRaMacJoinComputeMicCtx( LoRaMacCryptoCtx_t *ctx, const uint8_t *buffer, uint16_t size, const uint8_t *key, uint32_t *mic );
+
 /*!
  * Computes the LoRaMAC join frame decryption
  *
  * \param [IN]  buffer          - Data buffer
  * \param [IN]  size            - Data buffer size
  * \param [IN]  key             - AES key to be used
- * \param [OUT] decBuffer       - Decrypted buffer
+ * \param [OUT] decBuffer       - Decrypted buffer, may be the data buffer
  */
 void LoRaMacJoinDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *key, uint8_t *decBuffer );
 
@@ -106,6 +218,16 @@ void LoRaMacJoinDecrypt( const uint8_t *buffer, uint16_t size, const uint8_t *ke
  */
 void LoRaMacJoinComputeSKeys( const uint8_t *key, const uint8_t *appNonce, uint16_t devNonce, uint8_t *nwkSKey, uint8_t *appSKey );
 
+/*!
+ * Computes the class B ping slot offset of a beacon period
+ *
+ * \param [IN]  beaconTime      - GPS time of the beacon period [s]
+ * \param [IN]  address         - Device or multicast group address
+ * \param [IN]  pingPeriod      - Number of slots between two ping slots
+ * \param [OUT] pingOffset      - Ping slot offset [0:pingPeriod - 1]
+ */
+void LoRaMacBeaconComputePingOffset( uint32_t beaconTime, uint32_t address, uint16_t pingPeriod, uint16_t *pingOffset );
+
 /*! \} defgroup LORAMAC */
 
 #endif // __LORAMAC_CRYPTO_H__
@@ -21,40 +21,32 @@
 
 /** @file debug.h */
 
-#ifndef NDEBUG
+#include "log.h"
 
-#include <stdarg.h>
-#include <stdio.h>
+#ifndef NDEBUG
 
 /** Output a debug message
- * 
- * @param format printf-style format string, followed by variables
+ *
+ * The message is recorded as a token of the deferred log: the format string
+ * address and the arguments are stored, tools/log_decode.py expands them on
+ * the host. The arguments are integers or pointers casted to uint32_t, at most
+ * LOG_MAX_ARGS. The messages are filtered at compile time by LOG_LEVEL_RADIO
+ *
+ * @param format printf-style format string literal, followed by variables
  */
-static inline void debug(const char *format, ...) {
-    va_list args;
-    va_start(args, format);
-    vfprintf(stderr, format, args);
-    va_end(args);
-}
+#define debug( ... )                    LOG( RADIO, LOG_LEVEL_DEBUG, __VA_ARGS__ )
 
 /** Conditionally output a debug message
- * 
+ *
  * @param condition output only if condition is true
- * @param format printf-style format string, followed by variables
+ * @param format printf-style format string literal, followed by variables
  */
-static inline void debug_if(bool condition, const char *format, ...) {
-    if(condition) {
-        va_list args;
-        va_start(args, format);
-        vfprintf(stderr, format, args);
-        va_end(args);
-    }
-}
+#define debug_if( condition, ... )      do { if( condition ) { debug( __VA_ARGS__ ); } } while( 0 )
 
 #else
 
-static inline void debug(const char *format, ...) {}
-static inline void debug(bool condition, const char *format, ...) {}
+#define debug( ... )
+#define debug_if( condition, ... )
 
 #endif
 
@@ -63,8 +63,35 @@ typedef struct
      * @param [IN] channelDetected    Channel Activity detected during the CAD
      */
     void ( *CadDone ) ( bool channelActivityDetected );
+    /*!
+     * @brief Valid Header callback prototype. LoRa only
+     *
+     * @remark Called when the header of the frame being received has been
+     *         demodulated. Gives the time of arrival of the frame
+     */
+    void ( *ValidHeader ) ( void );
 }RadioEvents_t;
 
+/*!
+ * @brief Time spent by the radio in each operating mode since its creation [us]
+ *
+ * @remark The counters wrap around. Differences between two readings remain
+ *         valid as long as they are less than 71 minutes apart
+ */
+typedef struct
+{
+    uint32_t Sleep;
+    uint32_t Standby;
+    /*!
+     * Synthesizer and transmitter modes
+     */
+    uint32_t Tx;
+    /*!
+     * Synthesizer, receiver and CAD modes
+     */
+    uint32_t Rx;
+}RadioOpModeTimes_t;
+
 /*!
  *    Interface for the radios, contains the main functions that a radio needs, and 5 callback functions
  */
@@ -332,6 +359,12 @@ public:
      * @param [IN] enable if true, it enables a public network
      */
     virtual void SetPublicNetwork( bool enable ) = 0;
+    /*!
+     * @brief Gets the time spent in each operating mode, current mode included
+     *
+     * @param [OUT] times Operating modes times
+     */
+    virtual void GetOpModeTimes( RadioOpModeTimes_t *times ) = 0;
 };
 
 #endif // __RADIO_H__
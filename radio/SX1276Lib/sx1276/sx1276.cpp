@@ -13,6 +13,43 @@ License: Revised BSD License, see LICENSE.TXT file include in the project
 Maintainers: Miguel Luis, Gregory Cristian and Nicolas Huguenin
 */
 #include "sx1276.h"
+#include "debug.h"
+#include "profile.h"
+#include "capture.h"
+#include "framepool.h"
+
+/*!
+ * \brief Records a LoRa frame sent or received on air
+ *
+ * \param [IN] type      CAPTURE_AIR_TX or CAPTURE_AIR_RX
+ * \param [IN] frequency Channel frequency [Hz]
+ * \param [IN] datarate  Spreading factor
+ * \param [IN] bandwidth Bandwidth register value [7: 125 kHz, 8: 250 kHz, 9: 500 kHz]
+ * \param [IN] rssi      Packet RSSI [dBm]
+ * \param [IN] snr       Packet SNR [0.25 dB]
+ * \param [IN] payload   Frame payload
+ * \param [IN] size      Frame payload size
+ */
+#if( CAPTURE_AIR_ON )
+static inline void CaptureAirFrame( uint8_t type, uint32_t frequency, uint32_t datarate, uint32_t bandwidth,
+                                    int16_t rssi, int8_t snr, const uint8_t *payload, uint8_t size )
+{
+    uint8_t header[9];
+
+    header[0] = frequency & 0xFF;
+    header[1] = ( frequency >> 8 ) & 0xFF;
+    header[2] = ( frequency >> 16 ) & 0xFF;
+    header[3] = ( frequency >> 24 ) & 0xFF;
+    header[4] = datarate;
+    header[5] = bandwidth - 7;
+    header[6] = rssi & 0xFF;
+    header[7] = ( rssi >> 8 ) & 0xFF;
+    header[8] = snr;
+    CAPTURE_AIR( type, header, sizeof( header ), payload, size );
+}
+#else
+#define CaptureAirFrame( type, frequency, datarate, bandwidth, rssi, snr, payload, size )
+#endif
 
 const FskBandwidth_t SX1276::FskBandwidths[] =
 {
@@ -52,7 +89,7 @@ SX1276::SX1276( RadioEvents_t *events,
                 isRadioActive( false )
 {
     wait_ms( 10 );
-    this->rxtxBuffer = new uint8_t[RX_BUFFER_SIZE];
+    this->rxtxBuffer = NULL;
 
     this->RadioEvents = events;
 
@@ -66,11 +103,16 @@ SX1276::SX1276( RadioEvents_t *events,
     this->dioIrq[5] = NULL;
 
     this->settings.State = RF_IDLE;
+
+    // The radio is in standby after the power on
+    this->opModeCurrent = RF_OPMODE_STANDBY;
+    this->opModeTimestamp = us_ticker_read( );
+    memset( &this->opModeTimes, 0, sizeof( this->opModeTimes ) );
 }
 
 SX1276::~SX1276( )
 {
-    delete this->rxtxBuffer;
+    ReleaseBuffer( );
     delete this->dioIrq;
 }
 
@@ -191,6 +233,24 @@ void SX1276::RxChainCalibration( void )
     SetChannel( initialFreq );
 }
 
+bool SX1276::AcquireBuffer( void )
+{
+    if( this->rxtxBuffer == NULL )
+    {
+        this->rxtxBuffer = FramePoolAlloc( FRAME_POOL_RADIO );
+    }
+    return this->rxtxBuffer != NULL;
+}
+
+void SX1276::ReleaseBuffer( void )
+{
+    if( this->rxtxBuffer != NULL )
+    {
+        FramePoolFree( this->rxtxBuffer );
+        this->rxtxBuffer = NULL;
+    }
+}
+
 /*!
  * Returns the known FSK bandwidth registers value
  *
@@ -220,6 +280,8 @@ void SX1276::SetRxConfig( RadioModems_t modem, uint32_t bandwidth,
                          bool crcOn, bool freqHopOn, uint8_t hopPeriod,
                          bool iqInverted, bool rxContinuous )
 {
+    PROFILE_SCOPE( PROFILE_SET_RX_CONFIG );
+
     SetModem( modem );
 
     switch( modem )
@@ -602,6 +664,18 @@ void SX1276::Send( uint8_t *buffer, uint8_t size )
     {
     case MODEM_FSK:
         {
+            // The frames larger than the FIFO are copied, the caller buffer
+            // may be reused before TxDone
+            if( ( size > 64 ) && ( AcquireBuffer( ) == false ) )
+            {
+                LOG_WARNING( RADIO, "SX1276: no frame buffer, %u bytes not sent\n", size );
+                if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->TxTimeout != NULL ) )
+                {
+                    this->RadioEvents->TxTimeout( );
+                }
+                return;
+            }
+
             this->settings.FskPacketHandler.NbBytes = 0;
             this->settings.FskPacketHandler.Size = size;
 
@@ -661,6 +735,9 @@ void SX1276::Send( uint8_t *buffer, uint8_t size )
             // Write payload buffer
             WriteFifo( buffer, size );
             txTimeout = this->settings.LoRa.TxTimeout;
+
+            CaptureAirFrame( CAPTURE_AIR_TX, this->settings.Channel, this->settings.LoRa.Datarate, this->settings.LoRa.Bandwidth,
+                             0, 0, buffer, size );
         }
         break;
     }
@@ -675,6 +752,7 @@ void SX1276::Sleep( void )
 
     SetOpMode( RF_OPMODE_SLEEP );
     this->settings.State = RF_IDLE;
+    ReleaseBuffer( );
 }
 
 void SX1276::Standby( void )
@@ -684,6 +762,7 @@ void SX1276::Standby( void )
 
     SetOpMode( RF_OPMODE_STANDBY );
     this->settings.State = RF_IDLE;
+    ReleaseBuffer( );
 }
 
 void SX1276::Rx( uint32_t timeout )
@@ -791,28 +870,28 @@ void SX1276::Rx( uint32_t timeout )
                 Write( REG_LR_IRQFLAGSMASK, //RFLR_IRQFLAGS_RXTIMEOUT |
                                                   //RFLR_IRQFLAGS_RXDONE |
                                                   //RFLR_IRQFLAGS_PAYLOADCRCERROR |
-                                                  RFLR_IRQFLAGS_VALIDHEADER |
+                                                  //RFLR_IRQFLAGS_VALIDHEADER |
                                                   RFLR_IRQFLAGS_TXDONE |
                                                   RFLR_IRQFLAGS_CADDONE |
                                                   //RFLR_IRQFLAGS_FHSSCHANGEDCHANNEL |
                                                   RFLR_IRQFLAGS_CADDETECTED );
 
-                // DIO0=RxDone, DIO2=FhssChangeChannel
-                Write( REG_DIOMAPPING1, ( Read( REG_DIOMAPPING1 ) & RFLR_DIOMAPPING1_DIO0_MASK & RFLR_DIOMAPPING1_DIO2_MASK  ) | RFLR_DIOMAPPING1_DIO0_00 | RFLR_DIOMAPPING1_DIO2_00 );
+                // DIO0=RxDone, DIO2=FhssChangeChannel, DIO3=ValidHeader
+                Write( REG_DIOMAPPING1, ( Read( REG_DIOMAPPING1 ) & RFLR_DIOMAPPING1_DIO0_MASK & RFLR_DIOMAPPING1_DIO2_MASK & RFLR_DIOMAPPING1_DIO3_MASK ) | RFLR_DIOMAPPING1_DIO0_00 | RFLR_DIOMAPPING1_DIO2_00 | RFLR_DIOMAPPING1_DIO3_01 );
             }
             else
             {
                 Write( REG_LR_IRQFLAGSMASK, //RFLR_IRQFLAGS_RXTIMEOUT |
                                                   //RFLR_IRQFLAGS_RXDONE |
                                                   //RFLR_IRQFLAGS_PAYLOADCRCERROR |
-                                                  RFLR_IRQFLAGS_VALIDHEADER |
+                                                  //RFLR_IRQFLAGS_VALIDHEADER |
                                                   RFLR_IRQFLAGS_TXDONE |
                                                   RFLR_IRQFLAGS_CADDONE |
                                                   RFLR_IRQFLAGS_FHSSCHANGEDCHANNEL |
                                                   RFLR_IRQFLAGS_CADDETECTED );
 
-                // DIO0=RxDone
-                Write( REG_DIOMAPPING1, ( Read( REG_DIOMAPPING1 ) & RFLR_DIOMAPPING1_DIO0_MASK ) | RFLR_DIOMAPPING1_DIO0_00 );
+                // DIO0=RxDone, DIO3=ValidHeader
+                Write( REG_DIOMAPPING1, ( Read( REG_DIOMAPPING1 ) & RFLR_DIOMAPPING1_DIO0_MASK & RFLR_DIOMAPPING1_DIO3_MASK ) | RFLR_DIOMAPPING1_DIO0_00 | RFLR_DIOMAPPING1_DIO3_01 );
             }
             Write( REG_LR_FIFORXBASEADDR, 0 );
             Write( REG_LR_FIFOADDRPTR, 0 );
@@ -820,14 +899,21 @@ void SX1276::Rx( uint32_t timeout )
         break;
     }
 
-    memset( rxtxBuffer, 0, ( size_t )RX_BUFFER_SIZE );
-
     this->settings.State = RF_RX_RUNNING;
     if( timeout != 0 )
     {
         rxTimeoutTimer.attach_us( mbed::callback( this, &SX1276::OnTimeoutIrq ), timeout * 1e3 );
     }
 
+    // The FSK frames are read while they are received. The LoRa frames are
+    // read at RxDone
+    if( ( this->settings.Modem == MODEM_FSK ) && ( AcquireBuffer( ) == false ) )
+    {
+        // The window expires without reception
+        LOG_WARNING( RADIO, "SX1276: no frame buffer, Rx not started\n" );
+        return;
+    }
+
     if( this->settings.Modem == MODEM_FSK )
     {
         SetOpMode( RF_OPMODE_RECEIVER );
@@ -1002,6 +1088,42 @@ void SX1276::SetOpMode( uint8_t opMode )
         SetAntSw( opMode );
     }
     Write( REG_OPMODE, ( Read( REG_OPMODE ) & RF_OPMODE_MASK ) | opMode );
+    OpModeAccount( opMode );
+}
+
+void SX1276::OpModeAccount( uint8_t opMode )
+{
+    uint32_t now = us_ticker_read( );
+    uint32_t elapsed = now - this->opModeTimestamp;
+
+    switch( this->opModeCurrent )
+    {
+    case RF_OPMODE_SLEEP:
+        this->opModeTimes.Sleep += elapsed;
+        break;
+    case RF_OPMODE_STANDBY:
+        this->opModeTimes.Standby += elapsed;
+        break;
+    case RF_OPMODE_SYNTHESIZER_TX:
+    case RF_OPMODE_TRANSMITTER:
+        this->opModeTimes.Tx += elapsed;
+        break;
+    default:
+        this->opModeTimes.Rx += elapsed;
+        break;
+    }
+    this->opModeCurrent = opMode;
+    this->opModeTimestamp = now;
+}
+
+void SX1276::GetOpModeTimes( RadioOpModeTimes_t *times )
+{
+    // Account the time spent so far in the current mode. The radio IRQs
+    // also update the counters
+    __disable_irq( );
+    OpModeAccount( this->opModeCurrent );
+    *times = this->opModeTimes;
+    __enable_irq( );
 }
 
 void SX1276::SetModem( RadioModems_t modem )
@@ -1080,6 +1202,7 @@ void SX1276::OnTimeoutIrq( void )
     switch( this->settings.State )
     {
     case RF_RX_RUNNING:
+        debug( "SX1276: Rx timeout, modem %u\n", this->settings.Modem );
         if( this->settings.Modem == MODEM_FSK )
         {
             this->settings.FskPacketHandler.PreambleDetected = false;
@@ -1104,6 +1227,7 @@ void SX1276::OnTimeoutIrq( void )
             {
                 this->settings.State = RF_IDLE;
                 rxTimeoutSyncWord.detach( );
+                ReleaseBuffer( );
             }
         }
         if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->RxTimeout != NULL ) )
@@ -1117,6 +1241,7 @@ void SX1276::OnTimeoutIrq( void )
         // it depends on the platform design.
         // 
         // The workaround is to put the radio in a known state. Thus, we re-initialize it.
+        LOG_WARNING( RADIO, "SX1276: Tx timeout, modem %u, radio reset\n", this->settings.Modem );
 
         // BEGIN WORKAROUND
 
@@ -1138,6 +1263,7 @@ void SX1276::OnTimeoutIrq( void )
         // END WORKAROUND
 
         this->settings.State = RF_IDLE;
+        ReleaseBuffer( );
         if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->TxTimeout != NULL ) )
         {
             this->RadioEvents->TxTimeout( );
@@ -1150,7 +1276,9 @@ void SX1276::OnTimeoutIrq( void )
 
 void SX1276::OnDio0Irq( void )
 {
+    PROFILE_SCOPE( PROFILE_DIO0_IRQ );
     volatile uint8_t irqFlags = 0;
+    uint8_t *buffer = NULL;
 
     switch( this->settings.State )
     {
@@ -1165,6 +1293,7 @@ void SX1276::OnDio0Irq( void )
                     irqFlags = Read( REG_IRQFLAGS2 );
                     if( ( irqFlags & RF_IRQFLAGS2_CRCOK ) != RF_IRQFLAGS2_CRCOK )
                     {
+                        debug( "SX1276: FSK Rx CRC error, %u bytes\n", this->settings.FskPacketHandler.NbBytes );
                         // Clear Irqs
                         Write( REG_IRQFLAGS1, RF_IRQFLAGS1_RSSI |
                                                     RF_IRQFLAGS1_PREAMBLEDETECT |
@@ -1177,6 +1306,7 @@ void SX1276::OnDio0Irq( void )
                         {
                             rxTimeoutSyncWord.detach( );
                             this->settings.State = RF_IDLE;
+                            OpModeAccount( RF_OPMODE_STANDBY );
                         }
                         else
                         {
@@ -1220,11 +1350,24 @@ void SX1276::OnDio0Irq( void )
 
                 rxTimeoutTimer.detach( );
 
+                // The frame block goes to the RxDone callback
+                buffer = rxtxBuffer;
+                rxtxBuffer = NULL;
+
                 if( this->settings.Fsk.RxContinuous == false )
                 {
                     this->settings.State = RF_IDLE;
+                    OpModeAccount( RF_OPMODE_STANDBY );
                     rxTimeoutSyncWord.detach( );
                 }
+                else if( AcquireBuffer( ) == false )
+                {
+                    // No block for the next frame, the reception stops
+                    LOG_WARNING( RADIO, "SX1276: no frame buffer, Rx stopped\n" );
+                    rxTimeoutSyncWord.detach( );
+                    SetOpMode( RF_OPMODE_STANDBY );
+                    this->settings.State = RF_IDLE;
+                }
                 else
                 {
                     // Continuous mode restart Rx chain
@@ -1235,7 +1378,11 @@ void SX1276::OnDio0Irq( void )
 
                 if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->RxDone != NULL ) )
                 {
-                    this->RadioEvents->RxDone( rxtxBuffer, this->settings.FskPacketHandler.Size, this->settings.FskPacketHandler.RssiValue, 0 );
+                    this->RadioEvents->RxDone( buffer, this->settings.FskPacketHandler.Size, this->settings.FskPacketHandler.RssiValue, 0 );
+                }
+                else
+                {
+                    FramePoolFree( buffer );
                 }
                 this->settings.FskPacketHandler.PreambleDetected = false;
                 this->settings.FskPacketHandler.SyncWordDetected = false;
@@ -1252,12 +1399,14 @@ void SX1276::OnDio0Irq( void )
                     irqFlags = Read( REG_LR_IRQFLAGS );
                     if( ( irqFlags & RFLR_IRQFLAGS_PAYLOADCRCERROR_MASK ) == RFLR_IRQFLAGS_PAYLOADCRCERROR )
                     {
+                        debug( "SX1276: LoRa Rx CRC error\n" );
                         // Clear Irq
                         Write( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_PAYLOADCRCERROR );
 
                         if( this->settings.LoRa.RxContinuous == false )
                         {
                             this->settings.State = RF_IDLE;
+                            OpModeAccount( RF_OPMODE_STANDBY );
                         }
                         rxTimeoutTimer.detach( );
 
@@ -1307,18 +1456,41 @@ void SX1276::OnDio0Irq( void )
                         }
                     }
 
-                    this->settings.LoRaPacketHandler.Size = Read( REG_LR_RXNBBYTES );
-                    ReadFifo( rxtxBuffer, this->settings.LoRaPacketHandler.Size );
-
                     if( this->settings.LoRa.RxContinuous == false )
                     {
                         this->settings.State = RF_IDLE;
+                        OpModeAccount( RF_OPMODE_STANDBY );
                     }
                     rxTimeoutTimer.detach( );
 
+                    this->settings.LoRaPacketHandler.Size = Read( REG_LR_RXNBBYTES );
+                    if( AcquireBuffer( ) == false )
+                    {
+                        // The frame is left in the FIFO and reported as a reception error
+                        LOG_WARNING( RADIO, "SX1276: no frame buffer, %u bytes dropped\n", this->settings.LoRaPacketHandler.Size );
+                        if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->RxError != NULL ) )
+                        {
+                            this->RadioEvents->RxError( );
+                        }
+                        break;
+                    }
+                    ReadFifo( rxtxBuffer, this->settings.LoRaPacketHandler.Size );
+
+                    // The frame block goes to the RxDone callback
+                    buffer = rxtxBuffer;
+                    rxtxBuffer = NULL;
+
+                    CaptureAirFrame( CAPTURE_AIR_RX, this->settings.Channel, this->settings.LoRa.Datarate, this->settings.LoRa.Bandwidth,
+                                     this->settings.LoRaPacketHandler.RssiValue, this->settings.LoRaPacketHandler.SnrValue,
+                                     buffer, this->settings.LoRaPacketHandler.Size );
+
                     if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->RxDone != NULL ) )
                     {
-                        this->RadioEvents->RxDone( rxtxBuffer, this->settings.LoRaPacketHandler.Size, this->settings.LoRaPacketHandler.RssiValue, this->settings.LoRaPacketHandler.SnrValue );
+                        this->RadioEvents->RxDone( buffer, this->settings.LoRaPacketHandler.Size, this->settings.LoRaPacketHandler.RssiValue, this->settings.LoRaPacketHandler.SnrValue );
+                    }
+                    else
+                    {
+                        FramePoolFree( buffer );
                     }
                 }
                 break;
@@ -1338,6 +1510,8 @@ void SX1276::OnDio0Irq( void )
             case MODEM_FSK:
             default:
                 this->settings.State = RF_IDLE;
+                OpModeAccount( RF_OPMODE_STANDBY );
+                ReleaseBuffer( );
                 if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->TxDone != NULL ) )
                 {
                     this->RadioEvents->TxDone( );
@@ -1390,6 +1564,7 @@ void SX1276::OnDio1Irq( void )
                 Write( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_RXTIMEOUT );
 
                 this->settings.State = RF_IDLE;
+                OpModeAccount( RF_OPMODE_STANDBY );
                 if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->RxTimeout != NULL ) )
                 {
                     this->RadioEvents->RxTimeout( );
@@ -1504,7 +1679,17 @@ void SX1276::OnDio3Irq( void )
     case MODEM_FSK:
         break;
     case MODEM_LORA:
-        if( ( Read( REG_LR_IRQFLAGS ) & RFLR_IRQFLAGS_CADDETECTED ) == RFLR_IRQFLAGS_CADDETECTED )
+        if( this->settings.State == RF_RX_RUNNING )
+        {
+            // DIO3=ValidHeader
+            // Clear Irq
+            Write( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_VALIDHEADER );
+            if( ( this->RadioEvents != NULL ) && ( this->RadioEvents->ValidHeader != NULL ) )
+            {
+                this->RadioEvents->ValidHeader( );
+            }
+        }
+        else if( ( Read( REG_LR_IRQFLAGS ) & RFLR_IRQFLAGS_CADDETECTED ) == RFLR_IRQFLAGS_CADDETECTED )
         {
             // Clear Irq
             Write( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_CADDETECTED | RFLR_IRQFLAGS_CADDONE );
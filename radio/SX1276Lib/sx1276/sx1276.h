@@ -42,8 +42,6 @@ Maintainers: Miguel Luis, Gregory Cristian and Nicolas Huguenin
 #define XTAL_FREQ                                   32000000
 #define FREQ_STEP                                   61.03515625
 
-#define RX_BUFFER_SIZE                              256
-
 /*!
  * Constant values need to compute the RSSI value
  */
@@ -83,6 +81,10 @@ protected:
 
     uint8_t boardConnected; //1 = SX1276MB1LAS; 0 = SX1276MB1MAS
 
+    /*!
+     * Frame pool block of the frame being received, or of the FSK frame being
+     * sent. The received frames are handed over to the RxDone callback
+     */
     uint8_t *rxtxBuffer;
 
     /*!
@@ -99,6 +101,14 @@ protected:
 
     RadioSettings_t settings;
 
+    /*!
+     * Operating modes energy accounting. Current operating mode, time of the
+     * last transition and accumulated times
+     */
+    uint8_t opModeCurrent;
+    uint32_t opModeTimestamp;
+    RadioOpModeTimes_t opModeTimes;
+
     static const FskBandwidth_t FskBandwidths[];
 protected:
 
@@ -109,6 +119,18 @@ protected:
     */
     void RxChainCalibration( void );
 
+    /*!
+     * \brief Allocates the frame pool block of the driver, if not held yet
+     *
+     * \retval status [true: block held, false: no free block]
+     */
+    bool AcquireBuffer( void );
+
+    /*!
+     * \brief Releases the frame pool block of the driver, if held
+     */
+    void ReleaseBuffer( void );
+
 public:
     SX1276( RadioEvents_t *events,
             PinName mosi, PinName miso, PinName sclk, PinName nss, PinName reset,
@@ -370,6 +392,13 @@ public:
      */
     virtual void SetPublicNetwork( bool enable );
 
+    /*!
+     * @brief Gets the time spent in each operating mode, current mode included
+     *
+     * @param [OUT] times Operating modes times
+     */
+    virtual void GetOpModeTimes( RadioOpModeTimes_t *times );
+
     //-------------------------------------------------------------------------
     //                        Board relative functions
     //-------------------------------------------------------------------------
@@ -455,6 +484,15 @@ protected:
      */
     virtual void SetOpMode( uint8_t opMode );
 
+    /*!
+     * @brief Accounts the time spent in the current operating mode and
+     *        records the new one. Must also be called when the radio changes
+     *        its operating mode by itself
+     *
+     * @param [IN] opMode New operating mode
+     */
+    void OpModeAccount( uint8_t opMode );
+
     /*
      * SX1276 DIO IRQ callback functions prototype
      */
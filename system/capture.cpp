@@ -0,0 +1,185 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Capture of the LoRaMAC inputs. Records the radio events with
+             their payload, the timer expirations, the random numbers and the
+             API requests, in the order they are consumed by the MAC layer
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "capture.h"
+
+#if( CAPTURE_ON == 1 )
+
+/*!
+ * Record header size in the ring: type, data size and timestamp
+ */
+#define CAPTURE_HEADER_SIZE                         7
+
+/*!
+ * Capture ring. The first byte of a record, its type, is written last. It
+ * reads CAPTURE_RECORD_NONE while the record is being filled
+ */
+static volatile uint8_t CaptureBuffer[CAPTURE_BUFFER_SIZE];
+
+/*!
+ * Free running write and read indexes, in bytes. Head is only changed by the
+ * writers, Tail by the reader
+ */
+static volatile uint16_t CaptureHead = 0;
+static volatile uint16_t CaptureTail = 0;
+
+/*!
+ * Number of records dropped since the last drain
+ */
+static volatile uint16_t CaptureDropped = 0;
+
+/*!
+ * \brief Copies bytes to the ring
+ *
+ * \retval index Ring index following the copied bytes
+ */
+static uint16_t CapturePut( uint16_t index, const uint8_t *data, uint16_t size )
+{
+    while( size-- > 0 )
+    {
+        CaptureBuffer[index++ & ( CAPTURE_BUFFER_SIZE - 1 )] = *data++;
+    }
+    return index;
+}
+
+/*!
+ * \brief Reads a byte of the ring
+ */
+static uint8_t CaptureGet( uint16_t index )
+{
+    return CaptureBuffer[index & ( CAPTURE_BUFFER_SIZE - 1 )];
+}
+
+/*!
+ * \brief Writes a record frame header, the data is appended by the caller
+ *        before DebugFrameEnd
+ *
+ * \retval data Start of the record data in the frame
+ */
+static uint8_t* CaptureFrameHeader( uint8_t *buffer, uint8_t type, uint16_t size, uint32_t time )
+{
+    uint8_t *payload = DebugFrameBegin( buffer, DEBUG_FRAME_CAPTURE, CAPTURE_PAYLOAD_SIZE( size ) );
+
+    payload[0] = type;
+    payload[1] = time & 0xFF;
+    payload[2] = ( time >> 8 ) & 0xFF;
+    payload[3] = ( time >> 16 ) & 0xFF;
+    payload[4] = ( time >> 24 ) & 0xFF;
+    return payload + CAPTURE_PAYLOAD_SIZE( 0 );
+}
+
+void CaptureWrite( uint8_t type, const void *header, uint8_t headerSize, const uint8_t *data, uint16_t size )
+{
+    uint32_t primask = __get_PRIMASK( );
+    uint32_t time = us_ticker_read( );
+    uint16_t length = headerSize + size;
+    uint16_t head;
+    uint16_t index;
+
+    if( length > CAPTURE_MAX_DATA_SIZE )
+    {
+        length = CAPTURE_MAX_DATA_SIZE;
+        size = length - headerSize;
+    }
+
+    // Same reservation scheme as the event trace: the slot is reserved with
+    // the interrupts masked, the record is filled outside
+    __disable_irq( );
+    head = CaptureHead;
+    if( ( uint16_t )( head - CaptureTail ) > ( CAPTURE_BUFFER_SIZE - CAPTURE_HEADER_SIZE - length ) )
+    {
+        CaptureDropped++;
+        __set_PRIMASK( primask );
+        return;
+    }
+    CaptureHead = head + CAPTURE_HEADER_SIZE + length;
+    CaptureBuffer[head & ( CAPTURE_BUFFER_SIZE - 1 )] = CAPTURE_RECORD_NONE;
+    __set_PRIMASK( primask );
+
+    CaptureBuffer[( head + 1 ) & ( CAPTURE_BUFFER_SIZE - 1 )] = length & 0xFF;
+    CaptureBuffer[( head + 2 ) & ( CAPTURE_BUFFER_SIZE - 1 )] = ( length >> 8 ) & 0xFF;
+    index = CapturePut( head + 3, ( const uint8_t* )&time, sizeof( time ) );
+    if( header != NULL )
+    {
+        index = CapturePut( index, ( const uint8_t* )header, headerSize );
+    }
+    if( data != NULL )
+    {
+        CapturePut( index, data, size );
+    }
+    // Commits the record
+    __DMB( );
+    CaptureBuffer[head & ( CAPTURE_BUFFER_SIZE - 1 )] = type;
+}
+
+uint16_t CaptureDrain( uint8_t *buffer, uint16_t size )
+{
+    uint8_t type;
+    uint16_t dropped;
+    uint16_t dataSize;
+    uint16_t length = 0;
+    uint32_t time;
+    uint8_t *data;
+
+    while( CaptureTail != CaptureHead )
+    {
+        type = CaptureGet( CaptureTail );
+        if( type == CAPTURE_RECORD_NONE )
+        {
+            // Reserved by an interrupted writer
+            break;
+        }
+        __DMB( );
+        dataSize = CaptureGet( CaptureTail + 1 ) | ( CaptureGet( CaptureTail + 2 ) << 8 );
+        if( ( size - length ) < CAPTURE_FRAME_SIZE( dataSize ) )
+        {
+            break;
+        }
+        time = 0;
+        for( uint8_t i = 0; i < sizeof( time ); i++ )
+        {
+            time |= ( uint32_t )CaptureGet( CaptureTail + 3 + i ) << ( 8 * i );
+        }
+        data = CaptureFrameHeader( buffer + length, type, dataSize, time );
+        for( uint16_t i = 0; i < dataSize; i++ )
+        {
+            data[i] = CaptureGet( CaptureTail + CAPTURE_HEADER_SIZE + i );
+        }
+        length += DebugFrameEnd( buffer + length );
+
+        // Releases the record
+        CaptureTail += CAPTURE_HEADER_SIZE + dataSize;
+    }
+
+    // The records were dropped after the ones stored in the ring, reported
+    // once those are drained
+    if( ( CaptureDropped != 0 ) && ( CaptureTail == CaptureHead ) && ( ( size - length ) >= ( uint16_t )CAPTURE_FRAME_SIZE( sizeof( dropped ) ) ) )
+    {
+        __disable_irq( );
+        dropped = CaptureDropped;
+        CaptureDropped = 0;
+        __enable_irq( );
+
+        data = CaptureFrameHeader( buffer + length, CAPTURE_RECORD_DROPPED, sizeof( dropped ), us_ticker_read( ) );
+        data[0] = dropped & 0xFF;
+        data[1] = ( dropped >> 8 ) & 0xFF;
+        length += DebugFrameEnd( buffer + length );
+    }
+    return length;
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Capture of the LoRaMAC inputs. Records the radio events with
+             their payload, the timer expirations, the time readings, the
+             random numbers and the API requests, in the order they are
+             consumed by the MAC layer. Records the frames sent and received
+             on air by the radio driver. tools/host/mac_replay.cpp replays a
+             capture on the MAC layer built for the host
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "debugframe.h"
+
+/*!
+ * Capture enable/disable
+ */
+#ifndef CAPTURE_ON
+#define CAPTURE_ON                                  0
+#endif
+
+/*!
+ * Record classes
+ */
+#define CAPTURE_CLASS_MAC                           0x01
+#define CAPTURE_CLASS_AIR                           0x02
+
+/*!
+ * Captured record classes. The records of the other classes compile to
+ * nothing
+ */
+#ifndef CAPTURE_CLASS_MASK
+#define CAPTURE_CLASS_MASK                          ( CAPTURE_CLASS_MAC | CAPTURE_CLASS_AIR )
+#endif
+
+#define CAPTURE_MAC_ON                              ( ( CAPTURE_ON == 1 ) && ( ( CAPTURE_CLASS_MASK & CAPTURE_CLASS_MAC ) != 0 ) )
+#define CAPTURE_AIR_ON                              ( ( CAPTURE_ON == 1 ) && ( ( CAPTURE_CLASS_MASK & CAPTURE_CLASS_AIR ) != 0 ) )
+
+/*!
+ * Size of the ring in bytes. A record takes 7 bytes plus its data. Must be a
+ * power of 2
+ */
+#define CAPTURE_BUFFER_SIZE                         512
+
+/*!
+ * Maximum data size of a record: radio payload and its air frame header
+ */
+#define CAPTURE_MAX_DATA_SIZE                       ( 255 + 9 )
+
+/*!
+ * Drained record, payload of a DEBUG_FRAME_CAPTURE frame. The data size is
+ * the payload size minus 5
+ *
+ * Byte 0           : Record type
+ * Byte 1..4        : Timestamp [us] ( little endian )
+ * Byte 5..         : Data
+ */
+#define CAPTURE_PAYLOAD_SIZE( size )                ( 5 + ( size ) )
+#define CAPTURE_FRAME_SIZE( size )                  DEBUG_FRAME_SIZE( CAPTURE_PAYLOAD_SIZE( size ) )
+
+/*!
+ * Record types. The tools/capture_decode.py decoder mirrors this list. The
+ * multi-byte data fields are little endian
+ */
+typedef enum eCaptureRecord
+{
+    CAPTURE_RECORD_NONE,
+    /*!
+     * Records lost because the ring was full. Data: uint16_t number of records
+     */
+    CAPTURE_RECORD_DROPPED,
+    /*!
+     * Radio events
+     *
+     * RX_DONE   Data: int16_t RSSI, int8_t SNR, payload
+     */
+    CAPTURE_RADIO_TX_DONE,
+    CAPTURE_RADIO_TX_TIMEOUT,
+    CAPTURE_RADIO_RX_DONE,
+    CAPTURE_RADIO_RX_ERROR,
+    CAPTURE_RADIO_RX_TIMEOUT,
+    CAPTURE_RADIO_VALID_HEADER,
+    /*!
+     * Timer expiry. Data: uint32_t callback address
+     */
+    CAPTURE_TIMER_FIRE,
+    /*!
+     * Radio random number. Data: value consumed by the MAC layer, 2 bytes
+     * for the join nonce, 4 bytes for the randr seed
+     */
+    CAPTURE_RANDOM,
+    /*!
+     * LoRaMAC API requests. The parameters passed by pointer are recorded by
+     * value
+     *
+     * MCPS_REQUEST Data: uint8_t Mcps_t, port, datarate, number of trials,
+     *              payload
+     * MLME_REQUEST Data: uint8_t Mlme_t, then
+     *              JOIN       : DevEui[8], AppEui[8], AppKey[16],
+     *                           uint8_t number of trials
+     *              TXCW       : uint16_t timeout
+     *              TXCW_1     : uint16_t timeout, uint32_t frequency,
+     *                           uint8_t power
+     *              PING_SLOT_INFO: uint8_t periodicity
+     * MIB_SET      Data: uint8_t Mib_t, then the parameter: 1 byte for the
+     *              enumerations, booleans and 8 bits values, 2 bytes for
+     *              the join nonce, 4 bytes for the 32 bits values, the key
+     *              for the session keys, uint32_t frequency and uint8_t
+     *              datarate for the RX2 channels, the channels mask words
+     *              read by the band and the raw LoRaMacEnergyTable_t
+     */
+    CAPTURE_MCPS_REQUEST,
+    CAPTURE_MLME_REQUEST,
+    CAPTURE_MIB_SET,
+    /*!
+     * Air frames, CAPTURE_CLASS_AIR. LoRa modem only
+     *
+     * Data: uint32_t frequency [Hz], uint8_t spreading factor,
+     *       uint8_t bandwidth [0: 125 kHz, 1: 250 kHz, 2: 500 kHz],
+     *       int16_t RSSI [dBm], int8_t SNR [0.25 dB], payload. RSSI and SNR
+     *       are 0 for the sent frames
+     */
+    CAPTURE_AIR_TX,
+    CAPTURE_AIR_RX,
+    /*!
+     * Current time read by the MAC layer. Data: uint32_t time [ms]
+     */
+    CAPTURE_TIME,
+    /*!
+     * Battery level read by the MAC layer. Data: uint8_t level
+     */
+    CAPTURE_BATTERY_LEVEL,
+    /*!
+     * LoRaMAC API requests, continued
+     *
+     * SESSION_RESTORE  Data: raw LoRaMacSession_t. The channels are left out
+     *                  on the bands with fixed channels
+     * CHANNEL_ADD      Data: uint8_t id, uint32_t frequency, uint8_t
+     *                  datarate range
+     * CHANNEL_REMOVE   Data: uint8_t id
+     * MULTICAST_LINK   Data: uint32_t address, NwkSKey[16], AppSKey[16]
+     * MULTICAST_UNLINK Data: uint32_t address
+     * TEST_REQUEST     Data: uint8_t CaptureTestRequest_t, uint16_t value
+     */
+    CAPTURE_SESSION_RESTORE,
+    CAPTURE_CHANNEL_ADD,
+    CAPTURE_CHANNEL_REMOVE,
+    CAPTURE_MULTICAST_LINK,
+    CAPTURE_MULTICAST_UNLINK,
+    CAPTURE_TEST_REQUEST,
+}CaptureRecord_t;
+
+/*!
+ * LoRaMacTest functions recorded by CAPTURE_TEST_REQUEST
+ */
+typedef enum eCaptureTestRequest
+{
+    CAPTURE_TEST_RX_WINDOWS_ON,
+    CAPTURE_TEST_SET_MIC,
+    CAPTURE_TEST_SET_DUTY_CYCLE_ON,
+    CAPTURE_TEST_SET_CHANNEL,
+}CaptureTestRequest_t;
+
+/*!
+ * Per class capture macros. CAPTURE( type, header, headerSize, data, size )
+ * records the MAC inputs
+ */
+#if( CAPTURE_MAC_ON )
+#define CAPTURE( type, header, headerSize, data, size ) CaptureWrite( type, header, headerSize, data, size )
+#else
+#define CAPTURE( type, header, headerSize, data, size )
+#endif
+
+#if( CAPTURE_AIR_ON )
+#define CAPTURE_AIR( type, header, headerSize, data, size ) CaptureWrite( type, header, headerSize, data, size )
+#else
+#define CAPTURE_AIR( type, header, headerSize, data, size )
+#endif
+
+#define CAPTURE_EVENT( type )                       CAPTURE( type, NULL, 0, NULL, 0 )
+
+/*!
+ * \brief Appends a record to the capture ring. The record data is the header
+ *        followed by the data. May be called from any interrupt level. The
+ *        record is dropped when the ring is full
+ *
+ * \param [IN] type       Record type
+ * \param [IN] header     Record data header, may be NULL
+ * \param [IN] headerSize Header size
+ * \param [IN] data       Record data, may be NULL
+ * \param [IN] size       Data size
+ */
+void CaptureWrite( uint8_t type, const void *header, uint8_t headerSize, const uint8_t *data, uint16_t size );
+
+/*!
+ * \brief Moves the committed records out of the ring. Must be called from the
+ *        main loop only
+ *
+ * \param [OUT] buffer Receives the framed records. Must hold at least
+ *                     CAPTURE_FRAME_SIZE( CAPTURE_MAX_DATA_SIZE ) bytes
+ * \param [IN]  size   Buffer size
+ *
+ * \retval size Number of bytes written to the buffer
+ */
+uint16_t CaptureDrain( uint8_t *buffer, uint16_t size );
+
+#endif // __CAPTURE_H__
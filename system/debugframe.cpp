@@ -0,0 +1,48 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Frames of the debug UART
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "debugframe.h"
+
+uint8_t* DebugFrameBegin( uint8_t *buffer, uint8_t type, uint16_t size )
+{
+    buffer[0] = DEBUG_FRAME_SYNC;
+    buffer[1] = type;
+    buffer[2] = size & 0xFF;
+    buffer[3] = ( size >> 8 ) & 0xFF;
+    return buffer + DEBUG_FRAME_HEADER_SIZE;
+}
+
+uint16_t DebugFrameEnd( uint8_t *buffer )
+{
+    uint16_t size = ( uint16_t )buffer[2] | ( ( uint16_t )buffer[3] << 8 );
+    uint16_t crc = DebugFrameCrc( 0xFFFF, buffer + 1, DEBUG_FRAME_HEADER_SIZE - 1 + size );
+
+    buffer[DEBUG_FRAME_HEADER_SIZE + size] = crc & 0xFF;
+    buffer[DEBUG_FRAME_HEADER_SIZE + size + 1] = ( crc >> 8 ) & 0xFF;
+    return DEBUG_FRAME_SIZE( size );
+}
+
+uint16_t DebugFrameCrc( uint16_t crc, const uint8_t *buffer, uint16_t size )
+{
+    // Byte-wise form of the bit by bit computation, without table
+    for( uint16_t i = 0; i < size; i++ )
+    {
+        crc = ( crc >> 8 ) | ( crc << 8 );
+        crc ^= buffer[i];
+        crc ^= ( crc & 0xFF ) >> 4;
+        crc ^= crc << 12;
+        crc ^= ( crc & 0xFF ) << 5;
+    }
+    return crc;
+}
@@ -0,0 +1,78 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Frames of the debug UART. The trace records, the log messages
+             and the captured MAC inputs share the UART with one frame format
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __DEBUG_FRAME_H__
+#define __DEBUG_FRAME_H__
+
+#include <stdint.h>
+
+/*!
+ * Debug UART frame
+ *
+ * Byte 0           : DEBUG_FRAME_SYNC
+ * Byte 1           : Frame type
+ * Byte 2..3        : Payload size ( little endian )
+ * Byte 4..         : Payload
+ * Last 2 bytes     : CRC-16 CCITT ( polynomial 0x1021, initial value 0xFFFF )
+ *                    of the bytes from 1 to the end of the payload ( little
+ *                    endian )
+ *
+ * A decoder looking for the frames of one type checks the CRC of every
+ * frame and skips the whole frames of the other types. The payload bytes of
+ * a frame are never taken for the start of another one
+ */
+#define DEBUG_FRAME_SYNC                            0xA5
+#define DEBUG_FRAME_HEADER_SIZE                     4
+#define DEBUG_FRAME_SIZE( size )                    ( DEBUG_FRAME_HEADER_SIZE + ( size ) + 2 )
+
+/*!
+ * Frame types. The tools/debug_frame.py reader mirrors this list
+ */
+#define DEBUG_FRAME_TRACE                           0x01
+#define DEBUG_FRAME_LOG                             0x02
+#define DEBUG_FRAME_CAPTURE                         0x03
+
+/*!
+ * \brief Writes the frame header
+ *
+ * \param [OUT] buffer Frame, DEBUG_FRAME_SIZE( size ) bytes
+ * \param [IN]  type   Frame type
+ * \param [IN]  size   Payload size
+ *
+ * \retval payload     Start of the payload in the frame
+ */
+uint8_t* DebugFrameBegin( uint8_t *buffer, uint8_t type, uint16_t size );
+
+/*!
+ * \brief Appends the CRC to a frame whose header and payload are written
+ *
+ * \param [IN] buffer Frame
+ *
+ * \retval size       Frame size
+ */
+uint16_t DebugFrameEnd( uint8_t *buffer );
+
+/*!
+ * \brief Computes the CRC-16 CCITT of a buffer
+ *
+ * \param [IN] crc    Initial value, 0xFFFF for a new computation
+ * \param [IN] buffer Data
+ * \param [IN] size   Data size
+ *
+ * \retval crc        CRC of the data
+ */
+uint16_t DebugFrameCrc( uint16_t crc, const uint8_t *buffer, uint16_t size );
+
+#endif // __DEBUG_FRAME_H__
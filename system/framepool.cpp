@@ -0,0 +1,93 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Frame buffer pool shared by the radio driver and the MAC layer
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "framepool.h"
+
+/*!
+ * Pool blocks. Word aligned for the FIFO and AES accesses
+ */
+static uint32_t FramePoolBlocks[FRAME_POOL_NB_BLOCKS][FRAME_POOL_BLOCK_SIZE / sizeof( uint32_t )];
+
+/*!
+ * Owner of each block
+ */
+static volatile uint8_t FramePoolOwners[FRAME_POOL_NB_BLOCKS];
+
+/*!
+ * \brief Finds the block holding a pointer
+ *
+ * \retval index Block index, FRAME_POOL_NB_BLOCKS when not in the pool
+ */
+static uint8_t FramePoolIndex( const uint8_t *buffer )
+{
+    const uint8_t *start = ( const uint8_t* )FramePoolBlocks;
+
+    if( ( buffer < start ) || ( buffer >= ( start + sizeof( FramePoolBlocks ) ) ) )
+    {
+        return FRAME_POOL_NB_BLOCKS;
+    }
+    return ( buffer - start ) / FRAME_POOL_BLOCK_SIZE;
+}
+
+uint8_t *FramePoolAlloc( FramePoolOwner_t owner )
+{
+    uint32_t primask = __get_PRIMASK( );
+
+    __disable_irq( );
+    for( uint8_t i = 0; i < FRAME_POOL_NB_BLOCKS; i++ )
+    {
+        if( FramePoolOwners[i] == FRAME_POOL_FREE )
+        {
+            FramePoolOwners[i] = owner;
+            __set_PRIMASK( primask );
+            return ( uint8_t* )FramePoolBlocks[i];
+        }
+    }
+    __set_PRIMASK( primask );
+    return NULL;
+}
+
+bool FramePoolHandOff( const uint8_t *buffer, FramePoolOwner_t owner )
+{
+    uint8_t index = FramePoolIndex( buffer );
+
+    if( ( index >= FRAME_POOL_NB_BLOCKS ) || ( FramePoolOwners[index] == FRAME_POOL_FREE ) )
+    {
+        return false;
+    }
+    FramePoolOwners[index] = owner;
+    return true;
+}
+
+void FramePoolFree( const uint8_t *buffer )
+{
+    uint8_t index = FramePoolIndex( buffer );
+
+    if( index < FRAME_POOL_NB_BLOCKS )
+    {
+        FramePoolOwners[index] = FRAME_POOL_FREE;
+    }
+}
+
+FramePoolOwner_t FramePoolGetOwner( const uint8_t *buffer )
+{
+    uint8_t index = FramePoolIndex( buffer );
+
+    if( index >= FRAME_POOL_NB_BLOCKS )
+    {
+        return FRAME_POOL_FREE;
+    }
+    return ( FramePoolOwner_t )FramePoolOwners[index];
+}
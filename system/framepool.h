@@ -0,0 +1,92 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Frame buffer pool shared by the radio driver and the MAC layer.
+             Fixed size blocks with an explicit owner. A received frame goes
+             from the radio to the MAC layer, is decrypted in place and is
+             lent to the application for the indication before its release
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __FRAMEPOOL_H__
+#define __FRAMEPOOL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Block size. Holds the largest radio frame, a FSK frame with its length
+ */
+#define FRAME_POOL_BLOCK_SIZE                       256
+
+/*!
+ * Number of blocks. A class A device holds at most the frame being sent,
+ * kept for the retransmissions, and the frame received in a window
+ */
+#ifndef FRAME_POOL_NB_BLOCKS
+#define FRAME_POOL_NB_BLOCKS                        2
+#endif
+
+/*!
+ * Block owners
+ */
+typedef enum eFramePoolOwner
+{
+    FRAME_POOL_FREE,
+    /*!
+     * Radio driver, while a frame is received or a FSK frame is sent
+     */
+    FRAME_POOL_RADIO,
+    /*!
+     * MAC layer, frame being sent or received frame being processed
+     */
+    FRAME_POOL_MAC,
+    /*!
+     * Application, received frame payload during the MCPS indication
+     */
+    FRAME_POOL_APP,
+}FramePoolOwner_t;
+
+/*!
+ * \brief Allocates a block. May be called from any interrupt level
+ *
+ * \param [IN] owner Owner of the block
+ *
+ * \retval buffer Block of FRAME_POOL_BLOCK_SIZE bytes, NULL when none is free
+ */
+uint8_t *FramePoolAlloc( FramePoolOwner_t owner );
+
+/*!
+ * \brief Hands a block over to a new owner
+ *
+ * \param [IN] buffer Pointer in the block
+ * \param [IN] owner  New owner of the block
+ *
+ * \retval status [true: handed over, false: not an allocated block]
+ */
+bool FramePoolHandOff( const uint8_t *buffer, FramePoolOwner_t owner );
+
+/*!
+ * \brief Releases a block. May be called from any interrupt level
+ *
+ * \param [IN] buffer Pointer in the block. Ignored when not in the pool
+ */
+void FramePoolFree( const uint8_t *buffer );
+
+/*!
+ * \brief Gets the owner of a block
+ *
+ * \param [IN] buffer Pointer in the block
+ *
+ * \retval owner FRAME_POOL_FREE when the block is free or not in the pool
+ */
+FramePoolOwner_t FramePoolGetOwner( const uint8_t *buffer );
+
+#endif // __FRAMEPOOL_H__
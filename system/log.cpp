@@ -0,0 +1,151 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Tokenized deferred logging. The call sites record the address of
+             the format string and the raw arguments, tools/log_decode.py
+             expands the format strings from the application ELF file
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "log.h"
+
+/*!
+ * Message header size in words: format string address, timestamp and
+ * level / number of arguments
+ */
+#define LOG_HEADER_SIZE                             3
+
+/*!
+ * Log ring. The first word of a message, the format string address, is
+ * written last. It reads 0 while the message is being filled
+ */
+static volatile uint32_t LogBuffer[LOG_BUFFER_SIZE];
+
+/*!
+ * Free running write and read indexes, in words. Head is only changed by the
+ * writers, Tail by the reader
+ */
+static volatile uint16_t LogHead = 0;
+static volatile uint16_t LogTail = 0;
+
+/*!
+ * Number of messages dropped since the last drain
+ */
+static volatile uint16_t LogDropped = 0;
+
+/*!
+ * \brief Writes a 32 bits value in little endian
+ */
+static uint8_t* LogPut32( uint8_t *buffer, uint32_t value )
+{
+    *buffer++ = value & 0xFF;
+    *buffer++ = ( value >> 8 ) & 0xFF;
+    *buffer++ = ( value >> 16 ) & 0xFF;
+    *buffer++ = ( value >> 24 ) & 0xFF;
+    return buffer;
+}
+
+/*!
+ * \brief Writes a message frame
+ *
+ * \retval size Frame size
+ */
+static uint16_t LogFrame( uint8_t *buffer, uint8_t info, uint32_t time, uint32_t format, const volatile uint32_t *args, uint16_t index )
+{
+    uint8_t nbArgs = info & 0x0F;
+    uint8_t *p = DebugFrameBegin( buffer, DEBUG_FRAME_LOG, LOG_PAYLOAD_SIZE( nbArgs ) );
+
+    *p++ = info;
+    p = LogPut32( p, time );
+    p = LogPut32( p, format );
+    for( uint8_t i = 0; i < nbArgs; i++ )
+    {
+        p = LogPut32( p, args[( index + i ) & ( LOG_BUFFER_SIZE - 1 )] );
+    }
+    return DebugFrameEnd( buffer );
+}
+
+void LogWrite( uint8_t level, const char *format, uint8_t nbArgs, const uint32_t *args )
+{
+    uint32_t primask = __get_PRIMASK( );
+    uint16_t size = LOG_HEADER_SIZE + nbArgs;
+    uint16_t head;
+
+    // Same reservation scheme as the event trace: the slot is reserved with
+    // the interrupts masked, the message is filled outside
+    __disable_irq( );
+    head = LogHead;
+    if( ( uint16_t )( head - LogTail ) > ( LOG_BUFFER_SIZE - size ) )
+    {
+        LogDropped++;
+        __set_PRIMASK( primask );
+        return;
+    }
+    LogHead = head + size;
+    LogBuffer[head & ( LOG_BUFFER_SIZE - 1 )] = 0;
+    __set_PRIMASK( primask );
+
+    LogBuffer[( head + 1 ) & ( LOG_BUFFER_SIZE - 1 )] = us_ticker_read( );
+    LogBuffer[( head + 2 ) & ( LOG_BUFFER_SIZE - 1 )] = ( level << 4 ) | nbArgs;
+    for( uint8_t i = 0; i < nbArgs; i++ )
+    {
+        LogBuffer[( head + LOG_HEADER_SIZE + i ) & ( LOG_BUFFER_SIZE - 1 )] = args[i];
+    }
+    // Commits the message
+    __DMB( );
+    LogBuffer[head & ( LOG_BUFFER_SIZE - 1 )] = ( uint32_t )( uintptr_t )format;
+}
+
+bool LogIsEmpty( void )
+{
+    return LogTail == LogHead;
+}
+
+uint16_t LogDrain( uint8_t *buffer, uint16_t size )
+{
+    uint32_t format;
+    uint32_t dropped;
+    uint8_t info;
+    uint16_t length = 0;
+
+    while( LogTail != LogHead )
+    {
+        format = LogBuffer[LogTail & ( LOG_BUFFER_SIZE - 1 )];
+        if( format == 0 )
+        {
+            // Reserved by an interrupted writer
+            break;
+        }
+        __DMB( );
+        info = LogBuffer[( LogTail + 2 ) & ( LOG_BUFFER_SIZE - 1 )] & 0xFF;
+        if( ( size - length ) < LOG_FRAME_SIZE( info & 0x0F ) )
+        {
+            break;
+        }
+        length += LogFrame( buffer + length, info, LogBuffer[( LogTail + 1 ) & ( LOG_BUFFER_SIZE - 1 )], format,
+                            LogBuffer, LogTail + LOG_HEADER_SIZE );
+
+        // Releases the message
+        LogTail += LOG_HEADER_SIZE + ( info & 0x0F );
+    }
+
+    // The messages were dropped after the ones stored in the ring
+    if( ( LogDropped != 0 ) && ( ( size - length ) >= LOG_FRAME_SIZE( 1 ) ) )
+    {
+        __disable_irq( );
+        dropped = LogDropped;
+        LogDropped = 0;
+        __enable_irq( );
+
+        length += LogFrame( buffer + length, ( LOG_LEVEL_NONE << 4 ) | 1, us_ticker_read( ), 0, &dropped, 0 );
+    }
+    return length;
+}
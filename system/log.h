@@ -0,0 +1,161 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Tokenized deferred logging. The call sites record the address of
+             the format string and the raw arguments, tools/log_decode.py
+             expands the format strings from the application ELF file
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "debugframe.h"
+
+/*!
+ * Logging enable/disable
+ */
+#ifndef LOG_ON
+#define LOG_ON                                      1
+#endif
+
+/*!
+ * Log levels
+ */
+#define LOG_LEVEL_NONE                              0
+#define LOG_LEVEL_ERROR                             1
+#define LOG_LEVEL_WARNING                           2
+#define LOG_LEVEL_INFO                              3
+#define LOG_LEVEL_DEBUG                             4
+
+/*!
+ * Per module log levels. The messages above the level of their module
+ * compile to nothing
+ */
+#ifndef LOG_LEVEL_RADIO
+#define LOG_LEVEL_RADIO                             LOG_LEVEL_WARNING
+#endif
+
+#ifndef LOG_LEVEL_MAC
+#define LOG_LEVEL_MAC                               LOG_LEVEL_WARNING
+#endif
+
+#ifndef LOG_LEVEL_APP
+#define LOG_LEVEL_APP                               LOG_LEVEL_INFO
+#endif
+
+/*!
+ * Maximum number of arguments of a message. The arguments are integers or
+ * pointers casted to uint32_t, the format strings may not use floating point
+ * conversions
+ */
+#define LOG_MAX_ARGS                                4
+
+/*!
+ * Size of the ring in 32 bits words. A message takes 3 words plus one word
+ * per argument. Must be a power of 2
+ */
+#define LOG_BUFFER_SIZE                             64
+
+/*!
+ * Drained message, payload of a DEBUG_FRAME_LOG frame
+ *
+ * Byte 0           : Level ( 4 MSB ), number of arguments ( 4 LSB )
+ * Byte 1..4        : Timestamp [us] ( little endian )
+ * Byte 5..8        : Format string address ( little endian ). 0 for the lost
+ *                    messages record, its argument is the number of messages
+ * Byte 9..         : Arguments, 4 bytes each ( little endian )
+ */
+#define LOG_PAYLOAD_SIZE( nbArgs )                  ( 9 + ( 4 * ( nbArgs ) ) )
+#define LOG_FRAME_SIZE( nbArgs )                    DEBUG_FRAME_SIZE( LOG_PAYLOAD_SIZE( nbArgs ) )
+
+/*!
+ * Logging macros. The message is recorded only if its level is enabled for
+ * the module: LOG( RADIO, LOG_LEVEL_DEBUG, "Rx timeout %u\n", symbols )
+ */
+#if( LOG_ON == 1 )
+#define LOG( module, level, ... )                   do { if( ( level ) <= LOG_LEVEL_##module ) { LogPrint( level, __VA_ARGS__ ); } } while( 0 )
+#else
+#define LOG( module, level, ... )
+#endif
+
+#define LOG_ERROR( module, ... )                    LOG( module, LOG_LEVEL_ERROR, __VA_ARGS__ )
+#define LOG_WARNING( module, ... )                  LOG( module, LOG_LEVEL_WARNING, __VA_ARGS__ )
+#define LOG_INFO( module, ... )                     LOG( module, LOG_LEVEL_INFO, __VA_ARGS__ )
+#define LOG_DEBUG( module, ... )                    LOG( module, LOG_LEVEL_DEBUG, __VA_ARGS__ )
+
+/*!
+ * \brief Appends a message to the log ring. May be called from any interrupt
+ *        level. The message is dropped when the ring is full
+ *
+ * \param [IN] level  Message level
+ * \param [IN] format Format string. Must be a string literal
+ * \param [IN] nbArgs Number of arguments
+ * \param [IN] args   Arguments
+ */
+void LogWrite( uint8_t level, const char *format, uint8_t nbArgs, const uint32_t *args );
+
+/*!
+ * \brief Moves the committed messages out of the ring. Must be called from the
+ *        main loop only
+ *
+ * \param [OUT] buffer Receives the framed messages
+ * \param [IN]  size   Buffer size
+ *
+ * \retval size Number of bytes written to the buffer
+ */
+uint16_t LogDrain( uint8_t *buffer, uint16_t size );
+
+/*!
+ * \brief Indicates if all the messages have been drained
+ *
+ * \retval [true: ring empty, false: messages pending]
+ */
+bool LogIsEmpty( void );
+
+/*!
+ * Per number of arguments helpers used by the LOG macro
+ */
+static inline void LogPrint( uint8_t level, const char *format )
+{
+    LogWrite( level, format, 0, NULL );
+}
+
+static inline void LogPrint( uint8_t level, const char *format, uint32_t arg0 )
+{
+    uint32_t args[1] = { arg0 };
+
+    LogWrite( level, format, 1, args );
+}
+
+static inline void LogPrint( uint8_t level, const char *format, uint32_t arg0, uint32_t arg1 )
+{
+    uint32_t args[2] = { arg0, arg1 };
+
+    LogWrite( level, format, 2, args );
+}
+
+static inline void LogPrint( uint8_t level, const char *format, uint32_t arg0, uint32_t arg1, uint32_t arg2 )
+{
+    uint32_t args[3] = { arg0, arg1, arg2 };
+
+    LogWrite( level, format, 3, args );
+}
+
+static inline void LogPrint( uint8_t level, const char *format, uint32_t arg0, uint32_t arg1, uint32_t arg2, uint32_t arg3 )
+{
+    uint32_t args[4] = { arg0, arg1, arg2, arg3 };
+
+    LogWrite( level, format, 4, args );
+}
+
+#endif // __LOG_H__
@@ -0,0 +1,156 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Hot path profiler. Measures the duration of code regions in core
+             clock cycles and keeps per region statistics
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "utilities.h"
+#include "log.h"
+#include "profile.h"
+
+#if( PROFILE_ON == 1 )
+
+/*!
+ * SysTick counter mask, used on the cores without DWT cycle counter
+ */
+#define PROFILE_SYSTICK_MASK                        0x00FFFFFF
+
+/*!
+ * Regions names, printed by ProfileDump
+ */
+static const char *ProfileNames[PROFILE_NB_REGIONS] =
+{
+    "PrepareFrame",
+    "LoRaMacComputeMic",
+    "OnRadioRxDone",
+    "SetNextChannel",
+    "SetRxConfig",
+    "OnDio0Irq",
+    "ProcessMacCommands",
+};
+
+/*!
+ * Statistics table
+ */
+static ProfileStats_t ProfileStats[PROFILE_NB_REGIONS];
+
+void ProfileInit( void )
+{
+#if( __CORTEX_M >= 3 )
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#else
+    // Free running on the core clock, no interrupt
+    SysTick->LOAD = PROFILE_SYSTICK_MASK;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
+    ProfileReset( );
+}
+
+uint32_t ProfileGetCycles( void )
+{
+#if( __CORTEX_M >= 3 )
+    return DWT->CYCCNT;
+#else
+    // SysTick counts down
+    return PROFILE_SYSTICK_MASK - SysTick->VAL;
+#endif
+}
+
+uint32_t ProfileGetElapsed( uint32_t start )
+{
+#if( __CORTEX_M >= 3 )
+    return ProfileGetCycles( ) - start;
+#else
+    return ( ProfileGetCycles( ) - start ) & PROFILE_SYSTICK_MASK;
+#endif
+}
+
+void ProfileRecord( ProfileRegion_t region, uint32_t start )
+{
+    ProfileStats_t *stats = &ProfileStats[region];
+    uint32_t cycles = ProfileGetElapsed( start );
+    uint32_t primask = __get_PRIMASK( );
+    uint32_t bound;
+    uint8_t bucket = 0;
+
+    bound = cycles >> PROFILE_BUCKET_SHIFT;
+    while( ( bound != 0 ) && ( bucket < ( PROFILE_NB_BUCKETS - 1 ) ) )
+    {
+        bound >>= 1;
+        bucket++;
+    }
+
+    // The same region may be measured from the main loop and an interrupt
+    __disable_irq( );
+    stats->Count++;
+    stats->Total += cycles;
+    if( cycles < stats->Min )
+    {
+        stats->Min = cycles;
+    }
+    if( cycles > stats->Max )
+    {
+        stats->Max = cycles;
+    }
+    if( stats->Histogram[bucket] != 0xFFFF )
+    {
+        stats->Histogram[bucket]++;
+    }
+    __set_PRIMASK( primask );
+}
+
+const ProfileStats_t* ProfileGetStats( void )
+{
+    return ProfileStats;
+}
+
+void ProfileReset( void )
+{
+    uint32_t primask = __get_PRIMASK( );
+
+    __disable_irq( );
+    for( uint8_t i = 0; i < PROFILE_NB_REGIONS; i++ )
+    {
+        memset1( ( uint8_t* )&ProfileStats[i], 0, sizeof( ProfileStats_t ) );
+        ProfileStats[i].Min = UINT32_MAX;
+    }
+    __set_PRIMASK( primask );
+}
+
+void ProfileDump( ProfileRegion_t region )
+{
+    const char *name = ProfileNames[region];
+    ProfileStats_t stats;
+
+    __disable_irq( );
+    stats = ProfileStats[region];
+    __enable_irq( );
+
+    if( region == 0 )
+    {
+        LOG_INFO( APP, "Profile: core clock %u Hz, histogram bucket 0 < %u cycles\n", SystemCoreClock, 1 << PROFILE_BUCKET_SHIFT );
+    }
+    if( stats.Count == 0 )
+    {
+        return;
+    }
+    LOG_INFO( APP, "Profile %s: %u calls, mean %u cycles\n", ( uint32_t )( uintptr_t )name, stats.Count, ( uint32_t )( stats.Total / stats.Count ) );
+    LOG_INFO( APP, "Profile %s: min %u, max %u cycles\n", ( uint32_t )( uintptr_t )name, stats.Min, stats.Max );
+    LOG_INFO( APP, "  histogram %u %u %u %u\n", stats.Histogram[0], stats.Histogram[1], stats.Histogram[2], stats.Histogram[3] );
+    LOG_INFO( APP, "            %u %u %u %u\n", stats.Histogram[4], stats.Histogram[5], stats.Histogram[6], stats.Histogram[7] );
+}
+
+#endif
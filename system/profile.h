@@ -0,0 +1,158 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Hot path profiler. Measures the duration of code regions in core
+             clock cycles and keeps per region statistics
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdint.h>
+
+/*!
+ * Profiler enable/disable. When disabled the region markers compile to nothing
+ */
+#ifndef PROFILE_ON
+#define PROFILE_ON                                  0
+#endif
+
+/*!
+ * Number of histogram buckets. Bucket 0 counts the durations below
+ * 2^PROFILE_BUCKET_SHIFT cycles, each next bucket doubles the bound. The last
+ * bucket counts all the longer durations
+ */
+#define PROFILE_NB_BUCKETS                          8
+#define PROFILE_BUCKET_SHIFT                        8
+
+/*!
+ * Profiled regions
+ */
+typedef enum eProfileRegion
+{
+    PROFILE_PREPARE_FRAME,
+    PROFILE_COMPUTE_MIC,
+    PROFILE_RADIO_RX_DONE,
+    PROFILE_SET_NEXT_CHANNEL,
+    PROFILE_SET_RX_CONFIG,
+    PROFILE_DIO0_IRQ,
+    PROFILE_PROCESS_MAC_COMMANDS,
+    PROFILE_NB_REGIONS,
+}ProfileRegion_t;
+
+/*!
+ * Region statistics. The durations include the time spent in the interrupts
+ * preempting the region
+ */
+typedef struct sProfileStats
+{
+    /*!
+     * Number of measurements
+     */
+    uint32_t Count;
+    /*!
+     * Minimum and maximum duration [cycles]
+     */
+    uint32_t Min;
+    uint32_t Max;
+    /*!
+     * Sum of the durations [cycles]. Mean = Total / Count
+     */
+    uint64_t Total;
+    /*!
+     * Durations histogram, saturated counters
+     */
+    uint16_t Histogram[PROFILE_NB_BUCKETS];
+}ProfileStats_t;
+
+#if( PROFILE_ON == 1 )
+
+/*!
+ * \brief Initializes the cycle counter. The Cortex-M3 and above cores use the
+ *        DWT cycle counter. The Cortex-M0+ has none, SysTick is then used as a
+ *        free running 24 bits down counter: the regions must be shorter than
+ *        2^24 cycles
+ */
+void ProfileInit( void );
+
+/*!
+ * \brief Reads the cycle counter
+ *
+ * \retval cycles Counter value, incrementing
+ */
+uint32_t ProfileGetCycles( void );
+
+/*!
+ * \brief Computes the number of cycles elapsed since a counter value
+ *
+ * \param [IN] start Counter value returned by ProfileGetCycles
+ *
+ * \retval cycles Elapsed cycles
+ */
+uint32_t ProfileGetElapsed( uint32_t start );
+
+/*!
+ * \brief Records a measurement. May be called from any interrupt level
+ *
+ * \param [IN] region Profiled region
+ * \param [IN] start  Counter value at the region start
+ */
+void ProfileRecord( ProfileRegion_t region, uint32_t start );
+
+/*!
+ * \brief Gets the statistics table
+ *
+ * \retval stats Table of PROFILE_NB_REGIONS entries
+ */
+const ProfileStats_t* ProfileGetStats( void );
+
+/*!
+ * \brief Clears the statistics
+ */
+void ProfileReset( void );
+
+/*!
+ * \brief Prints the statistics of a region to the log. The log ring holds the
+ *        statistics of one region, the application drains it between calls
+ *
+ * \param [IN] region Profiled region
+ */
+void ProfileDump( ProfileRegion_t region );
+
+/*!
+ * Measures a region from the marker to the end of the enclosing scope
+ */
+class ProfileScope
+{
+public:
+    ProfileScope( ProfileRegion_t region ): Region( region ), Start( ProfileGetCycles( ) )
+    {
+    }
+
+    ~ProfileScope( )
+    {
+        ProfileRecord( Region, Start );
+    }
+
+private:
+    ProfileRegion_t Region;
+    uint32_t Start;
+};
+
+#define PROFILE_SCOPE( region )                     ProfileScope profileScope( region )
+
+#else
+
+#define PROFILE_SCOPE( region )
+
+#endif
+
+#endif // __PROFILE_H__
@@ -56,6 +56,31 @@ TimerTime_t TimerGetFutureTime( TimerTime_t eventInFuture )
     return ( TimerTime_t )( CurrentTime + eventInFuture );
 }
 
+/*!
+ * Timer expiries are traced or captured
+ */
+#if( ( TRACE_ON == 1 ) && ( ( TRACE_CLASS_MASK & TRACE_CLASS_TIMER ) != 0 ) ) || ( CAPTURE_MAC_ON )
+#define TIMER_IRQ_HANDLER_ON                        1
+#else
+#define TIMER_IRQ_HANDLER_ON                        0
+#endif
+
+#if( TIMER_IRQ_HANDLER_ON == 1 )
+/*!
+ * \brief Traces the timer expiry before calling the timer callback
+ */
+static void TimerIrqHandler( TimerEvent_t *obj )
+{
+#if( CAPTURE_MAC_ON )
+    uint32_t callback = ( uint32_t )( uintptr_t )obj->Callback;
+#endif
+
+    TRACE_TIMER( TRACE_TIMER_FIRE, 0, ( uint16_t )( uintptr_t )obj->Callback );
+    CAPTURE( CAPTURE_TIMER_FIRE, &callback, sizeof( callback ), NULL, 0 );
+    obj->Callback( );
+}
+#endif
+
 void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) )
 {
     obj->value = 0;
@@ -64,7 +89,11 @@ void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) )
 
 void TimerStart( TimerEvent_t *obj )
 {
+#if( TIMER_IRQ_HANDLER_ON == 1 )
+    obj->Timer.attach_us( mbed::callback( TimerIrqHandler, obj ), obj->value * 1e3 );
+#else
     obj->Timer.attach_us( mbed::callback( obj->Callback ), obj->value * 1e3 );
+#endif
 }
 
 void TimerStop( TimerEvent_t *obj )
@@ -0,0 +1,131 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Binary event trace. Fixed size records with a microsecond
+             timestamp stored in a RAM ring and drained in idle time
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "trace.h"
+
+/*!
+ * Trace record
+ */
+typedef struct sTraceRecord
+{
+    uint32_t Time;
+    uint16_t Arg16;
+    uint8_t Arg8;
+    /*!
+     * Written last. TRACE_EVENT_NONE while the record is being filled
+     */
+    volatile uint8_t Event;
+}TraceRecord_t;
+
+/*!
+ * Trace ring
+ */
+static TraceRecord_t TraceBuffer[TRACE_BUFFER_SIZE];
+
+/*!
+ * Free running write and read indexes. Head is only changed by the writers,
+ * Tail by the reader
+ */
+static volatile uint16_t TraceHead = 0;
+static volatile uint16_t TraceTail = 0;
+
+/*!
+ * Number of records dropped since the last drain
+ */
+static volatile uint16_t TraceDropped = 0;
+
+/*!
+ * \brief Writes a record frame
+ */
+static void TraceFrame( uint8_t *buffer, uint32_t time, uint8_t event, uint8_t arg8, uint16_t arg16 )
+{
+    uint8_t *payload = DebugFrameBegin( buffer, DEBUG_FRAME_TRACE, TRACE_PAYLOAD_SIZE );
+
+    payload[0] = time & 0xFF;
+    payload[1] = ( time >> 8 ) & 0xFF;
+    payload[2] = ( time >> 16 ) & 0xFF;
+    payload[3] = ( time >> 24 ) & 0xFF;
+    payload[4] = event;
+    payload[5] = arg8;
+    payload[6] = arg16 & 0xFF;
+    payload[7] = ( arg16 >> 8 ) & 0xFF;
+    DebugFrameEnd( buffer );
+}
+
+void TraceWrite( uint8_t event, uint8_t arg8, uint16_t arg16 )
+{
+    uint32_t primask = __get_PRIMASK( );
+    TraceRecord_t *record;
+    uint16_t head;
+
+    // The Cortex-M0+ has no exclusive access instructions. The slot is
+    // reserved with the interrupts masked, the record is filled outside
+    __disable_irq( );
+    head = TraceHead;
+    if( ( uint16_t )( head - TraceTail ) >= TRACE_BUFFER_SIZE )
+    {
+        TraceDropped++;
+        __set_PRIMASK( primask );
+        return;
+    }
+    TraceHead = head + 1;
+    __set_PRIMASK( primask );
+
+    record = &TraceBuffer[head & ( TRACE_BUFFER_SIZE - 1 )];
+    record->Time = us_ticker_read( );
+    record->Arg8 = arg8;
+    record->Arg16 = arg16;
+    // Commits the record
+    __DMB( );
+    record->Event = event;
+}
+
+uint16_t TraceDrain( uint8_t *buffer, uint16_t size )
+{
+    TraceRecord_t *record;
+    uint16_t dropped;
+    uint16_t length = 0;
+
+    while( ( ( size - length ) >= TRACE_FRAME_SIZE ) && ( TraceTail != TraceHead ) )
+    {
+        record = &TraceBuffer[TraceTail & ( TRACE_BUFFER_SIZE - 1 )];
+        if( record->Event == TRACE_EVENT_NONE )
+        {
+            // Reserved by an interrupted writer
+            break;
+        }
+        __DMB( );
+        TraceFrame( buffer + length, record->Time, record->Event, record->Arg8, record->Arg16 );
+        length += TRACE_FRAME_SIZE;
+
+        // Releases the slot
+        record->Event = TRACE_EVENT_NONE;
+        TraceTail++;
+    }
+
+    // The records were dropped after the ones stored in the ring
+    if( ( TraceDropped != 0 ) && ( ( size - length ) >= TRACE_FRAME_SIZE ) )
+    {
+        __disable_irq( );
+        dropped = TraceDropped;
+        TraceDropped = 0;
+        __enable_irq( );
+
+        TraceFrame( buffer + length, us_ticker_read( ), TRACE_EVENT_DROPPED, 0, dropped );
+        length += TRACE_FRAME_SIZE;
+    }
+    return length;
+}
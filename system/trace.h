@@ -0,0 +1,150 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Binary event trace. Fixed size records with a microsecond
+             timestamp stored in a RAM ring and drained in idle time
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include "debugframe.h"
+
+/*!
+ * Event trace enable/disable
+ */
+#ifndef TRACE_ON
+#define TRACE_ON                                    1
+#endif
+
+/*!
+ * Event classes
+ */
+#define TRACE_CLASS_RADIO                           0x01
+#define TRACE_CLASS_MAC                             0x02
+#define TRACE_CLASS_TIMER                           0x04
+
+/*!
+ * Traced event classes. The events of the other classes compile to nothing
+ */
+#ifndef TRACE_CLASS_MASK
+#define TRACE_CLASS_MASK                            ( TRACE_CLASS_RADIO | TRACE_CLASS_MAC )
+#endif
+
+/*!
+ * Number of records of the ring. Must be a power of 2
+ */
+#define TRACE_BUFFER_SIZE                           64
+
+/*!
+ * Drained record, payload of a DEBUG_FRAME_TRACE frame
+ *
+ * Byte 0..3 : Timestamp [us] ( little endian )
+ * Byte 4    : Event
+ * Byte 5    : 8 bits argument
+ * Byte 6..7 : 16 bits argument ( little endian )
+ */
+#define TRACE_PAYLOAD_SIZE                          8
+#define TRACE_FRAME_SIZE                            DEBUG_FRAME_SIZE( TRACE_PAYLOAD_SIZE )
+
+/*!
+ * Traced events. The tools/trace_decode.py decoder mirrors this list
+ */
+typedef enum eTraceEvent
+{
+    TRACE_EVENT_NONE,
+    /*!
+     * Records lost because the ring was full. Arg16: number of records
+     */
+    TRACE_EVENT_DROPPED,
+    /*!
+     * Radio events, TRACE_CLASS_RADIO
+     *
+     * RX_DONE   Arg8: size, Arg16: RSSI
+     * RX_ERROR  Arg8: Rx slot
+     * RX_TIMEOUT Arg8: Rx slot
+     */
+    TRACE_RADIO_TX_DONE,
+    TRACE_RADIO_TX_TIMEOUT,
+    TRACE_RADIO_RX_DONE,
+    TRACE_RADIO_RX_ERROR,
+    TRACE_RADIO_RX_TIMEOUT,
+    TRACE_RADIO_VALID_HEADER,
+    /*!
+     * MAC layer events, TRACE_CLASS_MAC
+     *
+     * TX          Arg8: datarate, Arg16: frequency / 100 kHz
+     * RX_WINDOW   Arg8: datarate, Arg16: timeout in symbols
+     * RX_FRAME    Arg8: MAC header, Arg16: 16 LSB of the frame counter
+     * RX_ABORT    Arg8: LoRaMacEventInfoStatus_t
+     * MIC_FAIL    Arg8: MAC header, Arg16: 16 LSB of the frame counter
+     * MAC_COMMAND Arg8: command identifier
+     */
+    TRACE_MAC_TX,
+    TRACE_MAC_RX_WINDOW,
+    TRACE_MAC_RX_FRAME,
+    TRACE_MAC_RX_ABORT,
+    TRACE_MAC_MIC_FAIL,
+    TRACE_MAC_COMMAND,
+    TRACE_MAC_ACK_TIMEOUT,
+    /*!
+     * Timer events, TRACE_CLASS_TIMER
+     *
+     * FIRE      Arg16: 16 LSB of the callback address
+     */
+    TRACE_TIMER_FIRE,
+}TraceEvent_t;
+
+/*!
+ * Per class trace macros
+ */
+#if( TRACE_ON == 1 ) && ( ( TRACE_CLASS_MASK & TRACE_CLASS_RADIO ) != 0 )
+#define TRACE_RADIO( event, arg8, arg16 )           TraceWrite( event, arg8, arg16 )
+#else
+#define TRACE_RADIO( event, arg8, arg16 )
+#endif
+
+#if( TRACE_ON == 1 ) && ( ( TRACE_CLASS_MASK & TRACE_CLASS_MAC ) != 0 )
+#define TRACE_MAC( event, arg8, arg16 )             TraceWrite( event, arg8, arg16 )
+#else
+#define TRACE_MAC( event, arg8, arg16 )
+#endif
+
+#if( TRACE_ON == 1 ) && ( ( TRACE_CLASS_MASK & TRACE_CLASS_TIMER ) != 0 )
+#define TRACE_TIMER( event, arg8, arg16 )           TraceWrite( event, arg8, arg16 )
+#else
+#define TRACE_TIMER( event, arg8, arg16 )
+#endif
+
+/*!
+ * \brief Appends a record to the trace ring. May be called from any
+ *        interrupt level. The record is dropped when the ring is full
+ *
+ * \param [IN] event Event identifier
+ * \param [IN] arg8  8 bits event argument
+ * \param [IN] arg16 16 bits event argument
+ */
+void TraceWrite( uint8_t event, uint8_t arg8, uint16_t arg16 );
+
+/*!
+ * \brief Moves the committed records out of the ring. Must be called from the
+ *        main loop only
+ *
+ * \param [OUT] buffer Receives the framed records
+ * \param [IN]  size   Buffer size
+ *
+ * \retval size Number of bytes written to the buffer, a multiple of
+ *              TRACE_FRAME_SIZE
+ */
+uint16_t TraceDrain( uint8_t *buffer, uint16_t size );
+
+#endif // __TRACE_H__
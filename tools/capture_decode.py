@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: LoRaMAC inputs capture decoder. Renders the records drained by
+#              system/capture.cpp, in the order they were consumed by the MAC
+#              layer, and optionally writes them as JSON, one object per line.
+#              The event trace and log frames sharing the stream are skipped.
+#              The capture file is replayed on the MAC layer by the host build
+#              tools/host/build/replay. tools/capture_pcap.py converts the air
+#              frames
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+#
+# Usage: capture_decode.py [-e <ELF file>] [-o <replay file>] <capture file | serial device> [baudrate]
+#
+#   -e  Resolves the timer callback addresses with the ELF file symbols
+#   -o  Writes the records as JSON
+
+import json
+import struct
+import sys
+
+import debug_frame
+
+# Mirrors CaptureRecord_t in system/capture.h
+RECORDS = [
+    "NONE",
+    "DROPPED",
+    "RADIO_TX_DONE",
+    "RADIO_TX_TIMEOUT",
+    "RADIO_RX_DONE",
+    "RADIO_RX_ERROR",
+    "RADIO_RX_TIMEOUT",
+    "RADIO_VALID_HEADER",
+    "TIMER_FIRE",
+    "RANDOM",
+    "MCPS_REQUEST",
+    "MLME_REQUEST",
+    "MIB_SET",
+    "AIR_TX",
+    "AIR_RX",
+    "TIME",
+    "BATTERY_LEVEL",
+    "SESSION_RESTORE",
+    "CHANNEL_ADD",
+    "CHANNEL_REMOVE",
+    "MULTICAST_LINK",
+    "MULTICAST_UNLINK",
+    "TEST_REQUEST",
+]
+
+BANDWIDTHS = [ 125000, 250000, 500000 ]
+
+# Mirrors Mcps_t in mac/LoRaWAN-lib/LoRaMac.h
+MCPS = [ "UNCONFIRMED", "CONFIRMED", "MULTICAST", "PROPRIETARY" ]
+
+# Mirrors Mlme_t in mac/LoRaWAN-lib/LoRaMac.h
+MLME = [ "JOIN", "LINK_CHECK", "TXCW", "TXCW_1", "BEACON_ACQUISITION", "PING_SLOT_INFO" ]
+
+# Mirrors CaptureTestRequest_t in system/capture.h
+TEST_REQUESTS = [ "RX_WINDOWS_ON", "SET_MIC", "SET_DUTY_CYCLE_ON", "SET_CHANNEL" ]
+
+SHT_SYMTAB = 2
+STT_FUNC = 2
+
+
+class Symbols( object ):
+    """Function symbols of an ELF file, used to name the timer callbacks"""
+
+    def __init__( self, path ):
+        self.names = {}
+        data = open( path, "rb" ).read( )
+        if data[:4] != b"\x7fELF" or data[4] != 1:
+            raise ValueError( "%s is not a 32 bits ELF file" % path )
+        endian = "<" if data[5] == 1 else ">"
+        shoff, = struct.unpack_from( endian + "I", data, 0x20 )
+        shentsize, shnum = struct.unpack_from( endian + "HH", data, 0x2E )
+        sections = [ struct.unpack_from( endian + "IIIIIIIIII", data, shoff + i * shentsize ) for i in range( shnum ) ]
+        for section in sections:
+            if section[1] != SHT_SYMTAB:
+                continue
+            strtab = sections[section[6]]
+            for offset in range( section[4], section[4] + section[5], 16 ):
+                name, value, size, info = struct.unpack_from( endian + "IIIB", data, offset )
+                if ( info & 0x0F ) != STT_FUNC:
+                    continue
+                start = strtab[4] + name
+                end = data.index( b"\0", start )
+                # The Thumb function addresses have the bit 0 set
+                self.names[value & ~1] = data[start:end].decode( "latin-1" )
+
+    def name( self, address ):
+        return self.names.get( address & ~1, "0x%08X" % address )
+
+
+def read_frames( stream ):
+    """Yields ( type, time, data ) tuples. Resynchronizes on errors"""
+    for payload in debug_frame.read_frames( stream, debug_frame.CAPTURE ):
+        if len( payload ) < 5 or payload[0] == 0 or payload[0] >= len( RECORDS ):
+            continue
+        time, = struct.unpack_from( "<I", payload, 1 )
+        yield RECORDS[payload[0]], time, payload[5:]
+
+
+def little( data ):
+    """Unsigned little endian integer of any size"""
+    value = 0
+    for i, b in enumerate( data ):
+        value |= b << ( 8 * i )
+    return value
+
+
+def decode( record, data, symbols ):
+    """Returns the record fields as a dictionary"""
+    fields = {}
+    if record == "DROPPED":
+        fields["count"] = little( data )
+    elif record == "RADIO_RX_DONE":
+        rssi, snr = struct.unpack_from( "<hb", data, 0 )
+        fields.update( rssi=rssi, snr=snr, payload=data[3:].hex( ) )
+    elif record == "TIMER_FIRE":
+        address = little( data )
+        fields["callback"] = symbols.name( address ) if symbols else "0x%08X" % address
+    elif record == "RANDOM":
+        fields["value"] = little( data )
+    elif record == "MCPS_REQUEST":
+        kind, port, datarate, trials = struct.unpack_from( "<BBbB", data, 0 )
+        fields.update( type=MCPS[kind] if kind < len( MCPS ) else kind, port=port, datarate=datarate,
+                       trials=trials, payload=data[4:].hex( ) )
+    elif record == "MLME_REQUEST":
+        kind = MLME[data[0]] if data[0] < len( MLME ) else data[0]
+        fields["type"] = kind
+        if kind == "JOIN":
+            fields.update( deveui=data[1:9].hex( ), appeui=data[9:17].hex( ), appkey=data[17:33].hex( ), trials=data[33] )
+        elif kind == "TXCW":
+            fields["timeout"] = little( data[1:3] )
+        elif kind == "TXCW_1":
+            timeout, frequency, power = struct.unpack_from( "<HIB", data, 1 )
+            fields.update( timeout=timeout, frequency=frequency, power=power )
+        elif kind == "PING_SLOT_INFO":
+            fields["periodicity"] = data[1]
+    elif record == "MIB_SET":
+        # The parameter layout depends on the Mib_t type and on the band
+        fields.update( type=data[0], param=data[1:].hex( ) )
+    elif record == "TIME":
+        fields["time"] = little( data )
+    elif record == "BATTERY_LEVEL":
+        fields["level"] = data[0]
+    elif record == "SESSION_RESTORE":
+        fields["session"] = data.hex( )
+    elif record == "CHANNEL_ADD":
+        id, frequency, datarates = struct.unpack_from( "<BIB", data, 0 )
+        fields.update( id=id, frequency=frequency, min=datarates & 0x0F, max=datarates >> 4 )
+    elif record == "CHANNEL_REMOVE":
+        fields["id"] = data[0]
+    elif record == "MULTICAST_LINK":
+        fields.update( address="%08X" % little( data[0:4] ), nwkskey=data[4:20].hex( ), appskey=data[20:36].hex( ) )
+    elif record == "MULTICAST_UNLINK":
+        fields["address"] = "%08X" % little( data )
+    elif record == "TEST_REQUEST":
+        kind, value = struct.unpack_from( "<BH", data, 0 )
+        fields.update( type=TEST_REQUESTS[kind] if kind < len( TEST_REQUESTS ) else kind, value=value )
+    elif record in ( "AIR_TX", "AIR_RX" ):
+        frequency, sf, bandwidth, rssi, snr = struct.unpack_from( "<IBBhb", data, 0 )
+        fields.update( frequency=frequency, sf=sf, bandwidth=BANDWIDTHS[bandwidth] if bandwidth < len( BANDWIDTHS ) else bandwidth,
+                       payload=data[9:].hex( ) )
+        if record == "AIR_RX":
+            fields.update( rssi=rssi, snr=snr / 4.0 )
+    return fields
+
+
+def main( argv ):
+    symbols = None
+    replay = None
+    args = []
+    i = 1
+    while i < len( argv ):
+        if argv[i] in ( "-e", "-o" ) and i + 1 < len( argv ):
+            if argv[i] == "-e":
+                symbols = Symbols( argv[i + 1] )
+            else:
+                replay = open( argv[i + 1], "w" )
+            i += 2
+        else:
+            args.append( argv[i] )
+            i += 1
+    if len( args ) < 1:
+        sys.stderr.write( "Usage: %s [-e <ELF file>] [-o <replay file>] <capture file | serial device> [baudrate]\n" % argv[0] )
+        return 1
+
+    if len( args ) > 1:
+        import serial
+        stream = serial.Serial( args[0], int( args[1] ), timeout=None )
+    else:
+        stream = open( args[0], "rb" )
+
+    last = None
+    elapsed = 0
+    try:
+        for record, time, data in read_frames( stream ):
+            if last is not None:
+                # The microsecond timestamp wraps around every 71 minutes
+                delta = ( time - last ) & 0xFFFFFFFF
+                if delta >= 0x80000000:
+                    delta -= 0x100000000
+                elapsed += delta
+            last = time
+
+            fields = decode( record, data, symbols )
+            print( "%12.6f  %-18s %s" % ( elapsed / 1e6, record, " ".join( "%s=%s" % item for item in sorted( fields.items( ) ) ) ) )
+            if replay is not None:
+                fields.update( time=elapsed, record=record )
+                replay.write( json.dumps( fields, sort_keys=True ) + "\n" )
+    except KeyboardInterrupt:
+        pass
+    if replay is not None:
+        replay.close( )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit( main( sys.argv ) )
@@ -0,0 +1,106 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: Air frames capture to PCAP converter. Writes the AIR_TX and
+#              AIR_RX records drained by system/capture.cpp as a PCAP file
+#              with the LoRaTap pseudo header, readable by Wireshark. The
+#              output is flushed after each frame, it may be a pipe
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+#
+# Usage: capture_pcap.py [-s <sync word>] <capture file | serial device> [baudrate] <PCAP file | ->
+#
+#   -s  LoRa sync word of the pseudo header, 0x34 ( public network ) by default
+#
+# Live capture: capture_pcap.py /dev/ttyACM0 115200 - | wireshark -k -i -
+
+import struct
+import sys
+import time
+
+from capture_decode import read_frames
+
+PCAP_MAGIC = 0xA1B2C3D4
+LINKTYPE_LORATAP = 270
+SNAPLEN = 65535
+
+LORATAP_VERSION = 0
+LORATAP_LENGTH = 15
+
+# LoRaTap RSSI fields: dBm = -139 + value
+LORATAP_RSSI_OFFSET = 139
+
+
+def loratap( frequency, sf, bandwidth, rssi, snr, sync_word ):
+    """LoRaTap version 0 header. The sent frames have no RSSI / SNR"""
+    value = max( 0, min( 255, rssi + LORATAP_RSSI_OFFSET ) ) if rssi != 0 else 0
+    return struct.pack( ">BBHIBBBBBbB", LORATAP_VERSION, 0, LORATAP_LENGTH, frequency, 1 << bandwidth, sf,
+                        value, value, value, snr, sync_word )
+
+
+def main( argv ):
+    sync_word = 0x34
+    args = []
+    i = 1
+    while i < len( argv ):
+        if argv[i] == "-s" and i + 1 < len( argv ):
+            sync_word = int( argv[i + 1], 0 )
+            i += 2
+        else:
+            args.append( argv[i] )
+            i += 1
+    if len( args ) < 2:
+        sys.stderr.write( "Usage: %s [-s <sync word>] <capture file | serial device> [baudrate] <PCAP file | ->\n" % argv[0] )
+        return 1
+
+    if len( args ) > 2:
+        import serial
+        stream = serial.Serial( args[0], int( args[1] ), timeout=None )
+    else:
+        stream = open( args[0], "rb" )
+    output = sys.stdout.buffer if args[-1] == "-" else open( args[-1], "wb" )
+    output.write( struct.pack( "<IHHiIII", PCAP_MAGIC, 2, 4, 0, 0, SNAPLEN, LINKTYPE_LORATAP ) )
+    output.flush( )
+
+    # The device timestamps are relative, the first frame gets the host time
+    origin = time.time( )
+    last = None
+    elapsed = 0
+    count = 0
+    try:
+        for record, timestamp, data in read_frames( stream ):
+            if last is not None:
+                # The microsecond timestamp wraps around every 71 minutes
+                delta = ( timestamp - last ) & 0xFFFFFFFF
+                if delta >= 0x80000000:
+                    delta -= 0x100000000
+                elapsed += delta
+            last = timestamp
+            if record not in ( "AIR_TX", "AIR_RX" ):
+                continue
+
+            frequency, sf, bandwidth, rssi, snr = struct.unpack_from( "<IBBhb", data, 0 )
+            packet = loratap( frequency, sf, bandwidth, rssi, snr, sync_word ) + data[9:]
+            seconds = origin + elapsed / 1e6
+            output.write( struct.pack( "<IIII", int( seconds ), int( ( seconds % 1 ) * 1e6 ), len( packet ), len( packet ) ) )
+            output.write( packet )
+            output.flush( )
+            count += 1
+    except KeyboardInterrupt:
+        pass
+    if output is not sys.stdout.buffer:
+        output.close( )
+        sys.stderr.write( "%d frames\n" % count )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit( main( sys.argv ) )
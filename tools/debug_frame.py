@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: Debug UART frame reader, shared by the trace, log and capture
+#              decoders. Mirrors system/debugframe.h
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+
+FRAME_SYNC = 0xA5
+HEADER_SIZE = 4
+CRC_SIZE = 2
+
+# Frame types and their maximum payload size
+TRACE = 0x01
+LOG = 0x02
+CAPTURE = 0x03
+
+MAX_PAYLOAD_SIZES = {
+    TRACE: 8,
+    LOG: 9 + 4 * 4,
+    CAPTURE: 5 + 255 + 9,
+}
+
+
+def crc16( data, crc=0xFFFF ):
+    """CRC-16 CCITT, polynomial 0x1021"""
+    for b in data:
+        crc ^= b << 8
+        for _ in range( 8 ):
+            crc = ( ( crc << 1 ) ^ 0x1021 ) if crc & 0x8000 else ( crc << 1 )
+        crc &= 0xFFFF
+    return crc
+
+
+def read_frames( stream, frame_type ):
+    """Yields the payloads of the frames of one type. The frames of the other
+    types are checked and skipped whole. Resynchronizes on errors"""
+    buffer = bytearray( )
+    while True:
+        # A serial port only returns what already arrived so that frames are
+        # yielded as soon as they are complete
+        if hasattr( stream, "in_waiting" ):
+            chunk = stream.read( max( 1, stream.in_waiting ) )
+        else:
+            chunk = stream.read( 256 )
+        if not chunk:
+            return
+        buffer += chunk
+        while len( buffer ) >= HEADER_SIZE:
+            size = buffer[2] | ( buffer[3] << 8 )
+            if buffer[0] != FRAME_SYNC or size > MAX_PAYLOAD_SIZES.get( buffer[1], -1 ):
+                del buffer[0]
+                continue
+            end = HEADER_SIZE + size
+            if len( buffer ) < end + CRC_SIZE:
+                break
+            if crc16( buffer[1:end] ) != ( buffer[end] | ( buffer[end + 1] << 8 ) ):
+                del buffer[0]
+                continue
+            kind = buffer[1]
+            payload = bytes( buffer[HEADER_SIZE:end] )
+            del buffer[:end + CRC_SIZE]
+            if kind == frame_type:
+                yield payload
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: Memory footprint report. Reads the armlink map file and call
+#              graph of the build, prints the RAM / flash usage per object
+#              file and per symbol and the worst case stack depths, then
+#              checks them against the budgets of tools/footprint.ini. Run
+#              by the project after build step, a budget overrun fails the
+#              build
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+#
+# Usage: footprint.py <map file> [budgets file] [number of symbols]
+#
+#   The call graph is read from the .htm file next to the map file. The
+#   number of symbols listed defaults to 20
+
+try:
+    import configparser
+except ImportError:
+    import ConfigParser as configparser
+import os
+import re
+import sys
+
+# Image component sizes: Code (inc. data) RO Data RW Data ZI Data Debug Object Name
+COMPONENT = re.compile( r"^\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)\s+(\S.*?)\s*$" )
+
+# Image symbol table: Symbol Name Value Ov Type Size Object(Section)
+SYMBOL = re.compile( r"^\s+(\S+)\s+(0x[0-9a-fA-F]+)\s+(?:Ov\s+)?(Data|Thumb Code|ARM Code)\s+(\d+)\s+(\S+?)\([^)]*\)\s*$" )
+
+# Call graph: function header and its maximum stack depth. The depth is a
+# lower bound when the function makes indirect calls
+FUNCTION = re.compile( r"<STRONG><a name=\"[^\"]*\"></a>([^<]+)</STRONG>" )
+MAX_DEPTH = re.compile( r"Max Depth = (\d+)( \+ Unknown)?" )
+
+# Start of the RAM in the memory map, mbed_config MBED_RAM_START
+RAM_START = 0x20000000
+
+# Cortex-M exception stack frame, pushed on each interrupt entry
+EXCEPTION_FRAME_SIZE = 32
+
+
+def read_map( path ):
+    """Returns ( objects, totals, symbols ). objects: { name: ( flash, ram ) },
+    totals: ( flash, ram ), symbols: [ ( name, object, kind, size ) ]"""
+    objects = {}
+    totals = None
+    symbols = []
+    section = None
+    for line in open( path, "r", errors="replace" ):
+        if "Image component sizes" in line:
+            section = "components"
+            continue
+        if "Image Symbol Table" in line:
+            section = "symbols"
+            continue
+        if section in ( "components", "libraries" ):
+            if "Object Name" in line or "Library Member Name" in line:
+                section = "components"
+            elif "Library Name" in line:
+                # The library members are already listed
+                section = "libraries"
+            match = COMPONENT.match( line )
+            if match:
+                code, _, ro, rw, zi, _, name = match.groups( )
+                flash, ram = int( code ) + int( ro ) + int( rw ), int( rw ) + int( zi )
+                if name == "Grand Totals":
+                    totals = ( flash, ram )
+                elif section == "components" and not name.endswith( "Totals" ) and not name.startswith( "(incl." ):
+                    objects[name] = ( flash, ram )
+        elif section == "symbols":
+            match = SYMBOL.match( line )
+            if match:
+                name, value, kind, size, obj = match.groups( )
+                if int( size ) == 0:
+                    continue
+                kind = "ram" if int( value, 16 ) >= RAM_START else "flash"
+                symbols.append( ( name, obj, kind, int( size ) ) )
+    return objects, totals, symbols
+
+
+def read_callgraph( path ):
+    """Returns { function: ( maximum stack depth, indirect calls ) }"""
+    depths = {}
+    if not os.path.exists( path ):
+        return depths
+    function = None
+    for line in open( path, "r", errors="replace" ):
+        match = FUNCTION.search( line )
+        if match:
+            function = match.group( 1 )
+        match = MAX_DEPTH.search( line )
+        if match and function is not None and function not in depths:
+            depths[function] = ( int( match.group( 1 ) ), match.group( 2 ) is not None )
+    return depths
+
+
+def main( argv ):
+    if len( argv ) < 2:
+        sys.stderr.write( "Usage: %s <map file> [budgets file] [number of symbols]\n" % argv[0] )
+        return 1
+    budgets = configparser.ConfigParser( )
+    budgets.optionxform = str
+    budgets.read( argv[2] if len( argv ) > 2 else os.path.join( os.path.dirname( os.path.abspath( __file__ ) ), "footprint.ini" ) )
+    nb_symbols = int( argv[3] ) if len( argv ) > 3 else 20
+
+    objects, totals, symbols = read_map( argv[1] )
+    depths = read_callgraph( os.path.splitext( argv[1] )[0] + ".htm" )
+    if not objects:
+        sys.stderr.write( "footprint: no image component sizes in %s\n" % argv[1] )
+        return 1
+
+    errors = []
+
+    def check( section, key, value ):
+        if budgets.has_option( section, key ) and value > budgets.getint( section, key ):
+            errors.append( "%s %s: %d bytes, budget %d" % ( section, key, value, budgets.getint( section, key ) ) )
+            return " OVER"
+        return ""
+
+    print( "%-40s %8s %8s" % ( "Object", "Flash", "RAM" ) )
+    for name, ( flash, ram ) in sorted( objects.items( ), key=lambda item: -item[1][1] ):
+        print( "%-40s %8d %8d%s%s" % ( name, flash, ram, check( "flash", name, flash ), check( "ram", name, ram ) ) )
+    flash, ram = totals if totals is not None else ( sum( value[0] for value in objects.values( ) ), sum( value[1] for value in objects.values( ) ) )
+    print( "%-40s %8d %8d%s%s" % ( "Total", flash, ram, check( "total", "flash", flash ), check( "total", "ram", ram ) ) )
+
+    for kind in ( "ram", "flash" ):
+        print( "\nLargest %s symbols" % kind )
+        for name, obj, _, size in sorted( ( s for s in symbols if s[2] == kind ), key=lambda s: -s[3] )[:nb_symbols]:
+            print( "  %-38s %8d  %s" % ( name, size, obj ) )
+
+    if depths:
+        # The interrupts of the same priority do not nest. The worst case is
+        # the deepest main path plus the deepest handlers of the nesting levels
+        handlers = sorted( ( ( depth + EXCEPTION_FRAME_SIZE, name, unknown ) for name, ( depth, unknown ) in depths.items( ) if name.endswith( "Handler" ) ), reverse=True )
+        nesting = budgets.getint( "stack", "nesting" ) if budgets.has_option( "stack", "nesting" ) else 1
+        main_depth, main_unknown = depths.get( "main", ( 0, False ) )
+        print( "\nStack depths, * indirect calls not included" )
+        print( "  %-38s %8d%s%s" % ( "main", main_depth, " *" if main_unknown else "", check( "stack", "main", main_depth ) ) )
+        for depth, name, unknown in handlers:
+            print( "  %-38s %8d%s%s" % ( name, depth, " *" if unknown else "", check( "stack", "handler", depth ) ) )
+        total = main_depth + sum( handler[0] for handler in handlers[:nesting] )
+        print( "  %-38s %8d%s" % ( "Worst case, %d nesting level(s)" % nesting, total, check( "stack", "total", total ) ) )
+    else:
+        print( "\nNo call graph, stack depths not checked" )
+
+    for error in errors:
+        sys.stderr.write( "footprint: error: %s\n" % error )
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit( main( sys.argv ) )
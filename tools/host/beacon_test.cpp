@@ -0,0 +1,377 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Class B test. A simulated gateway sends the beacons with a
+             clock drift and a downlink in each ping slot of the device.
+             The MAC layer runs unchanged on the simulated radio through
+             beacon acquisition, tracking, beacon-less operation and loss
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "mac_sim.h"
+#include "LoRaMacCrypto.h"
+
+/*!
+ * Gateway time of the first beacon [ms]
+ */
+#define TEST_FIRST_BEACON                           5000
+
+/*!
+ * GPS time of the first beacon [s]
+ */
+#define TEST_FIRST_BEACON_TIME                      1000000000UL
+
+/*!
+ * Gateway clock drift relative to the device clock [ppm]
+ */
+#define TEST_DRIFT                                  40
+
+#define TEST_BEACON_FREQUENCY                       869525000
+#define TEST_BEACON_RSSI                            -97
+#define TEST_BEACON_SNR                             6
+#define TEST_PING_PORT                              10
+
+#define TEST_MAX_INDICATIONS                        256
+
+static uint8_t NwkSKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint32_t DevAddr = 0x26011B4C;
+
+/*!
+ * Beacon periods without beacon: [OutageStart, OutageEnd[
+ */
+static uint32_t OutageStart = 0;
+static uint32_t OutageEnd = 0;
+
+/*!
+ * The gateway sends a downlink in each ping slot when set
+ */
+static bool PingOn = false;
+
+/*!
+ * Number of receive windows opened by the device
+ */
+static uint32_t NbBeaconWindows = 0;
+static uint32_t NbPingWindows = 0;
+
+static MlmeIndication_t Indications[TEST_MAX_INDICATIONS];
+static TimerTime_t IndicationTimes[TEST_MAX_INDICATIONS];
+static uint16_t NbIndications = 0;
+
+/*!
+ * Beacon periods of the downlinks received in the ping slots
+ */
+static uint32_t Pings[TEST_MAX_INDICATIONS];
+static uint16_t NbPings = 0;
+
+static uint32_t Failures = 0;
+
+#define TEST_CHECK( cond )                                                          \
+    do                                                                              \
+    {                                                                               \
+        if( !( cond ) )                                                             \
+        {                                                                           \
+            printf( "FAIL %s:%d %s\n", __FILE__, __LINE__, #cond );                 \
+            Failures++;                                                             \
+        }                                                                           \
+    }while( 0 )
+
+/*!
+ * \brief Converts a gateway time to the device clock
+ */
+static TimerTime_t GatewayTime( uint64_t time )
+{
+    return ( TimerTime_t )( time + ( time * TEST_DRIFT ) / 1000000 );
+}
+
+static TimerTime_t BeaconStart( uint32_t period )
+{
+    return GatewayTime( TEST_FIRST_BEACON + ( uint64_t )period * BEACON_INTERVAL );
+}
+
+static uint32_t BeaconTime( uint32_t period )
+{
+    return TEST_FIRST_BEACON_TIME / 128 * 128 + period * ( BEACON_INTERVAL / 1000 );
+}
+
+/*!
+ * \brief Gets the beacon period of the device time. The period before the
+ *        first beacon is 0
+ */
+static uint32_t BeaconPeriod( TimerTime_t time )
+{
+    uint32_t period = 0;
+
+    while( BeaconStart( period + 1 ) <= time )
+    {
+        period++;
+    }
+    return period;
+}
+
+static uint16_t BeaconCrc( const uint8_t *buffer, uint16_t length )
+{
+    uint16_t crc = 0;
+
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        crc ^= ( uint16_t )buffer[i] << 8;
+        for( uint8_t j = 0; j < 8; j++ )
+        {
+            crc = ( ( crc & 0x8000 ) != 0 ) ? ( ( crc << 1 ) ^ 0x1021 ) : ( crc << 1 );
+        }
+    }
+    return crc;
+}
+
+static void BeaconBuild( uint32_t period, SimRadioFrame_t *frame )
+{
+    uint32_t time = BeaconTime( period );
+    uint8_t index = BEACON_RFU1_SIZE;
+    uint16_t crc = 0;
+
+    memset( frame, 0, sizeof( SimRadioFrame_t ) );
+    frame->Payload[index++] = time & 0xFF;
+    frame->Payload[index++] = ( time >> 8 ) & 0xFF;
+    frame->Payload[index++] = ( time >> 16 ) & 0xFF;
+    frame->Payload[index++] = ( time >> 24 ) & 0xFF;
+    crc = BeaconCrc( frame->Payload, index );
+    frame->Payload[index++] = crc & 0xFF;
+    frame->Payload[index++] = ( crc >> 8 ) & 0xFF;
+    // Gateway specific part: no location
+    index += 7;
+    crc = BeaconCrc( frame->Payload + BEACON_RFU1_SIZE + 6, 7 );
+    frame->Payload[index++] = crc & 0xFF;
+    frame->Payload[index++] = ( crc >> 8 ) & 0xFF;
+    frame->Size = BEACON_SIZE;
+    frame->Start = BeaconStart( period );
+    frame->Rssi = TEST_BEACON_RSSI;
+    frame->Snr = TEST_BEACON_SNR;
+}
+
+static bool OnReceive( const SimRadioSettings_t *settings, TimerTime_t end, SimRadioFrame_t *frame )
+{
+    TimerTime_t now = TimerGetCurrentTime( );
+    uint32_t period = BeaconPeriod( now );
+
+    if( settings->Frequency != TEST_BEACON_FREQUENCY )
+    {
+        return false;
+    }
+
+    if( settings->IqInverted == false )
+    {
+        NbBeaconWindows++;
+        // Next beacon on the air
+        if( BeaconStart( period ) < now )
+        {
+            period++;
+        }
+        while( ( period >= OutageStart ) && ( period < OutageEnd ) )
+        {
+            period++;
+        }
+        BeaconBuild( period, frame );
+        return true;
+    }
+
+    NbPingWindows++;
+    if( PingOn == true )
+    {
+        uint16_t pingOffset = 0;
+        uint8_t payload[4];
+
+        payload[0] = period & 0xFF;
+        payload[1] = ( period >> 8 ) & 0xFF;
+        payload[2] = ( period >> 16 ) & 0xFF;
+        payload[3] = ( period >> 24 ) & 0xFF;
+        LoRaMacBeaconComputePingOffset( BeaconTime( period ), DevAddr, 4096, &pingOffset );
+        memset( frame, 0, sizeof( SimRadioFrame_t ) );
+        frame->Size = MacSimBuildDown( frame->Payload, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, DevAddr, 0, period, NULL, 0,
+                                       TEST_PING_PORT, payload, sizeof( payload ), NwkSKey, AppSKey );
+        frame->Start = GatewayTime( TEST_FIRST_BEACON + ( uint64_t )period * BEACON_INTERVAL + 2120 + pingOffset * 30 );
+        frame->Rssi = TEST_BEACON_RSSI;
+        frame->Snr = TEST_BEACON_SNR;
+        return true;
+    }
+    return false;
+}
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+    TEST_CHECK( mcpsIndication->Status == LORAMAC_EVENT_INFO_STATUS_OK );
+    TEST_CHECK( mcpsIndication->RxSlot == 3 );
+    TEST_CHECK( mcpsIndication->Port == TEST_PING_PORT );
+    TEST_CHECK( mcpsIndication->BufferSize == 4 );
+    if( ( mcpsIndication->BufferSize == 4 ) && ( NbPings < TEST_MAX_INDICATIONS ) )
+    {
+        Pings[NbPings++] = ( uint32_t )mcpsIndication->Buffer[0] | ( ( uint32_t )mcpsIndication->Buffer[1] << 8 ) |
+                           ( ( uint32_t )mcpsIndication->Buffer[2] << 16 ) | ( ( uint32_t )mcpsIndication->Buffer[3] << 24 );
+    }
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+    if( NbIndications < TEST_MAX_INDICATIONS )
+    {
+        IndicationTimes[NbIndications] = TimerGetCurrentTime( );
+        Indications[NbIndications++] = *mlmeIndication;
+    }
+}
+
+/*!
+ * \brief Checks the beacon indications of the periods [first, last]
+ */
+static void CheckIndications( uint16_t start, uint32_t first, uint32_t last, LoRaMacEventInfoStatus_t status )
+{
+    TEST_CHECK( ( uint32_t )( NbIndications - start ) == last - first + 1 );
+    for( uint16_t i = start; i < NbIndications; i++ )
+    {
+        const MlmeIndication_t *ind = &Indications[i];
+        uint32_t period = first + ( i - start );
+
+        TEST_CHECK( ind->MlmeIndication == MLME_BEACON );
+        TEST_CHECK( ind->Status == status );
+        TEST_CHECK( ind->BeaconTime == BeaconTime( period ) );
+        if( status == LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED )
+        {
+            TEST_CHECK( ( ind->Rssi == TEST_BEACON_RSSI ) && ( ind->Snr == TEST_BEACON_SNR ) );
+        }
+        else
+        {
+            TEST_CHECK( ( ind->Rssi == 0 ) && ( ind->Snr == 0 ) );
+        }
+    }
+}
+
+/*!
+ * \brief Checks that a downlink was received in the ping slot of each
+ *        period of [first, last]
+ */
+static void CheckPings( uint16_t start, uint32_t first, uint32_t last )
+{
+    TEST_CHECK( ( uint32_t )( NbPings - start ) == last - first + 1 );
+    for( uint16_t i = start; i < NbPings; i++ )
+    {
+        TEST_CHECK( Pings[i] == first + ( i - start ) );
+    }
+}
+
+/*!
+ * \brief Runs until the end of the beacon reserved time of a period
+ */
+static void RunToPeriod( uint32_t period )
+{
+    MacSimRun( BeaconStart( period ) + 2120 );
+}
+
+int main( void )
+{
+    LoRaMacPrimitives_t primitives;
+    SimRadioHandlers_t handlers;
+    MibRequestConfirm_t mibReq;
+    MlmeReq_t mlmeReq;
+    uint16_t start = 0;
+    uint16_t pingStart = 0;
+    uint32_t windows = 0;
+
+    srand( 1 );
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    handlers.Transmit = NULL;
+    handlers.Receive = OnReceive;
+    handlers.Random = NULL;
+    MacSimInit( &primitives, &handlers );
+    MacSimActivate( DevAddr, NwkSKey, AppSKey );
+
+    // No beacon on the air: the acquisition times out
+    OutageStart = 0;
+    OutageEnd = 3;
+    mlmeReq.Type = MLME_BEACON_ACQUISITION;
+    TEST_CHECK( LoRaMacMlmeRequest( &mlmeReq ) == LORAMAC_STATUS_OK );
+    RunToPeriod( 2 );
+    TEST_CHECK( NbIndications == 1 );
+    TEST_CHECK( Indications[0].Status == LORAMAC_EVENT_INFO_STATUS_BEACON_NOT_FOUND );
+    TEST_CHECK( ( Indications[0].BeaconTime == 0 ) && ( Indications[0].Rssi == 0 ) && ( Indications[0].Snr == 0 ) );
+    printf( "beacon acquisition without beacon: not found after %u ms\n", IndicationTimes[0] );
+
+    // Acquisition of the beacon of period 3, then tracking with a drifting
+    // gateway clock
+    start = NbIndications;
+    TEST_CHECK( LoRaMacMlmeRequest( &mlmeReq ) == LORAMAC_STATUS_OK );
+    RunToPeriod( 3 );
+    CheckIndications( start, 3, 3, LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED );
+
+    mibReq.Type = MIB_DEVICE_CLASS;
+    mibReq.Param.Class = CLASS_B;
+    TEST_CHECK( LoRaMacMibSetRequestConfirm( &mibReq ) == LORAMAC_STATUS_OK );
+    PingOn = true;
+    start = NbIndications;
+    pingStart = NbPings;
+    windows = NbBeaconWindows;
+    RunToPeriod( 23 );
+    CheckIndications( start, 4, 23, LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED );
+    CheckPings( pingStart, 3, 22 );
+    printf( "beacon tracking %d ppm: %u beacons locked, %u ping downlinks received, %u beacon windows\n",
+            TEST_DRIFT, NbIndications - start, NbPings - pingStart, NbBeaconWindows - windows );
+
+    // Beacon-less operation: the estimated beacon time is indicated and the
+    // ping slots go on with widened windows
+    OutageStart = 24;
+    OutageEnd = 34;
+    start = NbIndications;
+    pingStart = NbPings;
+    RunToPeriod( 33 );
+    CheckIndications( start, 24, 33, LORAMAC_EVENT_INFO_STATUS_BEACON_MISSED );
+    CheckPings( pingStart, 23, 32 );
+    start = NbIndications;
+    RunToPeriod( 34 );
+    CheckIndications( start, 34, 34, LORAMAC_EVENT_INFO_STATUS_BEACON_LOCKED );
+    printf( "beacon outage of %u periods: %u ping downlinks received, beacon locked again\n",
+            OutageEnd - OutageStart, NbPings - pingStart );
+
+    // Loss: the device reverts to class A after the beacon-less operation
+    // period and stops opening windows
+    OutageStart = 35;
+    OutageEnd = 200;
+    start = NbIndications;
+    RunToPeriod( 92 );
+    TEST_CHECK( NbIndications - start == 57 );
+    if( NbIndications - start == 57 )
+    {
+        NbIndications--;
+        CheckIndications( start, 35, 90, LORAMAC_EVENT_INFO_STATUS_BEACON_MISSED );
+        NbIndications++;
+        TEST_CHECK( Indications[NbIndications - 1].Status == LORAMAC_EVENT_INFO_STATUS_BEACON_LOST );
+        TEST_CHECK( ( Indications[NbIndications - 1].BeaconTime == 0 ) && ( Indications[NbIndications - 1].Rssi == 0 ) &&
+                    ( Indications[NbIndications - 1].Snr == 0 ) );
+    }
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    TEST_CHECK( mibReq.Param.Class == CLASS_A );
+    windows = NbBeaconWindows + NbPingWindows;
+    RunToPeriod( 100 );
+    TEST_CHECK( NbBeaconWindows + NbPingWindows == windows );
+    printf( "beacon loss: lost after %u missed beacons, class A\n", NbIndications - start - 1 );
+
+    printf( "beacon test: %u failures\n", Failures );
+    return ( Failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Payload codec benchmark. Generated sensor traces are sent
+             through the codec over links losing uplinks and
+             acknowledgements. Reports the encoded bytes against the raw
+             fixed width size of the records, per trace, records per frame
+             and link. Every received frame is decoded and checked
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PayloadCodec.h"
+
+#define BENCH_NB_FRAMES                             10000
+#define BENCH_MAX_RECORDS                           16
+#define BENCH_MAX_SIZE                              51
+
+/*!
+ * Sensor trace: record layout, raw fixed width record size and generator
+ */
+typedef struct sBenchTrace
+{
+    const char *Name;
+    const PayloadCodecField_t *Fields;
+    uint8_t NbFields;
+    /*!
+     * Record size with the fixed width encoding of the application [bytes]
+     */
+    uint8_t RawSize;
+    /*!
+     * Updates the record to the next sample
+     */
+    void ( *Next )( int32_t *record );
+    /*!
+     * First sample
+     */
+    int32_t First[PAYLOAD_CODEC_MAX_FIELDS];
+}BenchTrace_t;
+
+typedef struct sBenchLink
+{
+    /*!
+     * Percentage of uplinks lost
+     */
+    uint8_t UplinkLoss;
+    /*!
+     * Percentage of acknowledgements lost
+     */
+    uint8_t AckLoss;
+    /*!
+     * Percentage of confirmed uplinks
+     */
+    uint8_t Confirmed;
+}BenchLink_t;
+
+/*!
+ * Demo record, app/main.cpp: LED state, downlink counter, RSSI and SNR. Sent
+ * on 6 bytes by BatchPushRecord
+ */
+static const PayloadCodecField_t DemoFields[] =
+{
+    { PAYLOAD_CODEC_BITS, 1 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+};
+
+/*!
+ * Environment sensor: temperature [0.01 C], relative humidity [0.1 %],
+ * pressure [Pa], battery [mV] and a door contact. Fixed width: int16,
+ * uint16, uint32, uint16 and uint8
+ */
+static const PayloadCodecField_t SensorFields[] =
+{
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_BITS, 1 },
+};
+
+/*!
+ * Metering: cumulative index [Wh] and power [W]. Fixed width: uint32 and
+ * uint16
+ */
+static const PayloadCodecField_t MeterFields[] =
+{
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_VARINT, 0 },
+};
+
+static int32_t Walk( int32_t value, int32_t step, int32_t min, int32_t max )
+{
+    value += ( rand( ) % ( 2 * step + 1 ) ) - step;
+    return ( value < min ) ? min : ( ( value > max ) ? max : value );
+}
+
+static void DemoNext( int32_t *record )
+{
+    record[0] = rand( ) & 0x01;
+    record[1] += rand( ) % 3;
+    record[2] = Walk( record[2], 5, -137, -20 );
+    record[3] = Walk( record[3], 2, -20, 15 );
+}
+
+static void SensorNext( int32_t *record )
+{
+    record[0] = Walk( record[0], 8, -4000, 8500 );
+    record[1] = Walk( record[1], 5, 0, 1000 );
+    record[2] = Walk( record[2], 12, 87000, 108000 );
+    record[3] -= ( ( rand( ) % 50 ) == 0 ) ? 1 : 0;
+    record[4] = ( ( rand( ) % 20 ) == 0 ) ? !record[4] : record[4];
+}
+
+static void MeterNext( int32_t *record )
+{
+    record[1] = Walk( record[1], 40, 0, 6000 );
+    record[0] += record[1] / 4;
+}
+
+static const BenchTrace_t Traces[] =
+{
+    { "demo", DemoFields, 4, 6, DemoNext, { 0, 0, -60, 5 } },
+    { "sensor", SensorFields, 5, 11, SensorNext, { 2150, 450, 101325, 3600, 0 } },
+    { "meter", MeterFields, 2, 6, MeterNext, { 1200000, 800 } },
+};
+
+static bool Chance( uint8_t percent )
+{
+    return ( uint32_t )( rand( ) % 100 ) < percent;
+}
+
+/*!
+ * \brief   Sends a trace over a link
+ *
+ * \param   [OUT] rawBytes     Raw size of the records sent
+ * \param   [OUT] encodedBytes Size of the frames sent
+ *
+ * \retval  Number of frames received by the network which failed to decode
+ */
+static uint32_t BenchRun( const BenchTrace_t *trace, const BenchLink_t *link, uint8_t nbRecords,
+                          uint32_t *rawBytes, uint32_t *encodedBytes )
+{
+    PayloadCodec_t codec;
+    PayloadCodecDecoder_t decoder;
+    uint8_t buffer[BENCH_MAX_SIZE];
+    int32_t sent[BENCH_MAX_RECORDS][PAYLOAD_CODEC_MAX_FIELDS];
+    int32_t received[BENCH_MAX_RECORDS * PAYLOAD_CODEC_MAX_FIELDS];
+    int32_t record[PAYLOAD_CODEC_MAX_FIELDS];
+    uint32_t upLinkCounter = 0;
+    uint32_t failures = 0;
+
+    PayloadCodecInit( &codec, trace->Fields, trace->NbFields );
+    PayloadCodecDecoderInit( &decoder, trace->Fields, trace->NbFields );
+    memcpy( record, trace->First, sizeof( record ) );
+    *rawBytes = 0;
+    *encodedBytes = 0;
+
+    for( uint32_t n = 0; n < BENCH_NB_FRAMES; n++ )
+    {
+        uint8_t nbSent = 0;
+        uint8_t size = 0;
+
+        PayloadCodecBeginFrame( &codec, upLinkCounter, buffer, sizeof( buffer ) );
+        for( ; nbSent < nbRecords; nbSent++ )
+        {
+            trace->Next( record );
+            if( PayloadCodecAppend( &codec, record ) == false )
+            {
+                break;
+            }
+            memcpy( sent[nbSent], record, trace->NbFields * sizeof( int32_t ) );
+        }
+        size = PayloadCodecEndFrame( &codec );
+        *rawBytes += nbSent * trace->RawSize;
+        *encodedBytes += size;
+
+        if( Chance( link->UplinkLoss ) == false )
+        {
+            uint8_t nbDecoded = PayloadCodecDecode( &decoder, upLinkCounter, buffer, size, received, BENCH_MAX_RECORDS );
+
+            if( nbDecoded != nbSent )
+            {
+                failures++;
+            }
+            for( uint8_t i = 0; i < nbDecoded; i++ )
+            {
+                if( memcmp( sent[i], received + i * trace->NbFields, trace->NbFields * sizeof( int32_t ) ) != 0 )
+                {
+                    failures++;
+                    break;
+                }
+            }
+            if( Chance( link->Confirmed ) && ( Chance( link->AckLoss ) == false ) )
+            {
+                PayloadCodecConfirm( &codec, upLinkCounter );
+            }
+        }
+        upLinkCounter++;
+    }
+    return failures;
+}
+
+int main( void )
+{
+    const BenchLink_t links[] =
+    {
+        // Loss, ack loss, confirmed
+        {  0,  0, 100 },
+        { 10,  5,  50 },
+        { 30, 20,  20 },
+        { 10, 10,   0 },
+    };
+    const uint8_t nbRecords[] = { 1, 4 };
+    uint32_t failures = 0;
+
+    srand( 1 );
+    printf( "codec bench, %u frames per run, raw: fixed width records, encoded: frames with the codec header\n",
+            BENCH_NB_FRAMES );
+    printf( "  trace  rec/frame loss ack loss confirmed   raw[B]  encoded[B] B/frame saved\n" );
+    for( uint8_t t = 0; t < sizeof( Traces ) / sizeof( Traces[0] ); t++ )
+    {
+        for( uint8_t r = 0; r < sizeof( nbRecords ); r++ )
+        {
+            for( uint8_t l = 0; l < sizeof( links ) / sizeof( links[0] ); l++ )
+            {
+                uint32_t rawBytes = 0;
+                uint32_t encodedBytes = 0;
+
+                failures += BenchRun( &Traces[t], &links[l], nbRecords[r], &rawBytes, &encodedBytes );
+                printf( "  %-6s %9u %3u%% %7u%% %8u%% %8u %11u %7.2f %4.1f%%\n", Traces[t].Name, nbRecords[r],
+                        links[l].UplinkLoss, links[l].AckLoss, links[l].Confirmed, rawBytes, encodedBytes,
+                        ( double )encodedBytes / BENCH_NB_FRAMES, 100.0 * ( 1.0 - ( double )encodedBytes / rawBytes ) );
+            }
+        }
+    }
+    if( failures != 0 )
+    {
+        printf( "%u frames failed to decode\n", failures );
+    }
+    return ( failures == 0 ) ? 0 : 1;
+}
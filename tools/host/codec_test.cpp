@@ -0,0 +1,161 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Payload codec round trip test. The frames of the demo record
+             layout go through a link losing uplinks and acknowledgements.
+             Every frame received by the network must decode to the records
+             the device sent
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PayloadCodec.h"
+
+#define TEST_NB_FIELDS                              4
+#define TEST_MAX_RECORDS                            16
+#define TEST_MAX_SIZE                               51
+#define TEST_NB_FRAMES                              20000
+
+/*!
+ * Demo record layout, see AppRecordFields
+ */
+static const PayloadCodecField_t Fields[TEST_NB_FIELDS] =
+{
+    { PAYLOAD_CODEC_BITS, 1 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+    { PAYLOAD_CODEC_DELTA, 0 },
+};
+
+typedef struct sTestLink
+{
+    /*!
+     * Percentage of uplinks lost
+     */
+    uint8_t UplinkLoss;
+    /*!
+     * Percentage of acknowledgements lost
+     */
+    uint8_t AckLoss;
+    /*!
+     * Percentage of confirmed uplinks
+     */
+    uint8_t Confirmed;
+    /*!
+     * Uplinks sent in a row without any received by the network, every
+     * TEST_NB_FRAMES / 4 frames. Exercises the distance limit
+     */
+    uint16_t Outage;
+}TestLink_t;
+
+static bool Chance( uint8_t percent )
+{
+    return ( uint32_t )( rand( ) % 100 ) < percent;
+}
+
+/*!
+ * \brief   Runs the device and the network over the given link
+ *
+ * \retval  Number of frames received by the network which failed to decode
+ */
+static uint32_t TestLink( const TestLink_t *link, uint32_t *nbDelta, uint32_t *nbReceived )
+{
+    PayloadCodec_t codec;
+    PayloadCodecDecoder_t decoder;
+    uint8_t buffer[TEST_MAX_SIZE];
+    int32_t sent[TEST_MAX_RECORDS][TEST_NB_FIELDS];
+    int32_t received[TEST_MAX_RECORDS][TEST_NB_FIELDS];
+    int32_t record[TEST_NB_FIELDS] = { 0, 0, -60, 5 };
+    uint32_t upLinkCounter = 0;
+    uint32_t failures = 0;
+
+    PayloadCodecInit( &codec, Fields, TEST_NB_FIELDS );
+    PayloadCodecDecoderInit( &decoder, Fields, TEST_NB_FIELDS );
+    *nbDelta = 0;
+    *nbReceived = 0;
+
+    for( uint32_t n = 0; n < TEST_NB_FRAMES; n++ )
+    {
+        uint8_t nbRecords = 1 + rand( ) % 6;
+        uint8_t nbSent = 0;
+        uint8_t size = 0;
+        bool isConfirmed = Chance( link->Confirmed );
+        bool isLost = Chance( link->UplinkLoss ) || ( ( n % ( TEST_NB_FRAMES / 4 ) ) < link->Outage );
+
+        PayloadCodecBeginFrame( &codec, upLinkCounter, buffer, sizeof( buffer ) );
+        for( ; nbSent < nbRecords; nbSent++ )
+        {
+            record[0] = rand( ) & 0x01;
+            record[1] += rand( ) % 3;
+            record[2] += ( rand( ) % 11 ) - 5;
+            record[3] += ( rand( ) % 5 ) - 2;
+            if( PayloadCodecAppend( &codec, record ) == false )
+            {
+                break;
+            }
+            memcpy( sent[nbSent], record, sizeof( record ) );
+        }
+        size = PayloadCodecEndFrame( &codec );
+
+        if( isLost == false )
+        {
+            uint8_t nbDecoded = PayloadCodecDecode( &decoder, upLinkCounter, buffer, size, &received[0][0], TEST_MAX_RECORDS );
+
+            ( *nbReceived )++;
+            if( ( buffer[0] & PAYLOAD_CODEC_HDR_DELTA ) != 0 )
+            {
+                ( *nbDelta )++;
+            }
+            if( ( nbDecoded != nbSent ) || ( memcmp( sent, received, nbSent * sizeof( record ) ) != 0 ) )
+            {
+                failures++;
+            }
+            if( ( isConfirmed == true ) && ( Chance( link->AckLoss ) == false ) )
+            {
+                PayloadCodecConfirm( &codec, upLinkCounter );
+            }
+        }
+        // The MAC uses a new counter for each frame and skips some after a
+        // session restore
+        upLinkCounter += ( Chance( 1 ) == true ) ? 16 : 1;
+    }
+    return failures;
+}
+
+int main( void )
+{
+    const TestLink_t links[] =
+    {
+        // Loss, ack loss, confirmed, outage
+        {  0,  0, 100,   0 },
+        { 20, 10, 100,   0 },
+        { 20, 10,  10,   0 },
+        { 40, 30,  30,   0 },
+        { 10, 10,   0,   0 },
+        { 10,  0,  20, 200 },
+        {  5,  5,   5, 129 },
+    };
+    uint32_t total = 0;
+
+    srand( 1 );
+    for( uint8_t i = 0; i < sizeof( links ) / sizeof( links[0] ); i++ )
+    {
+        uint32_t nbDelta = 0;
+        uint32_t nbReceived = 0;
+        uint32_t failures = TestLink( &links[i], &nbDelta, &nbReceived );
+
+        printf( "codec loss %2u%% ack loss %2u%% confirmed %3u%% outage %3u: %5u received, %5u delta, %u failures\n",
+                links[i].UplinkLoss, links[i].AckLoss, links[i].Confirmed, links[i].Outage, nbReceived, nbDelta, failures );
+        total += failures;
+    }
+    return ( total == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Debug UART stream test. The trace, log and capture frames are
+             drained into one stream, as on the UART. A reader following the
+             tools/debug_frame.py algorithm must recover every frame, and
+             must not accept a frame that was not sent when it starts in the
+             middle of the stream or when bytes are corrupted
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "board.h"
+
+#define TEST_STREAM_SIZE                            65536
+#define TEST_NB_CORRUPTIONS                         500
+
+/*!
+ * Maximum payload size of each frame type, see tools/debug_frame.py
+ */
+static uint16_t TestMaxPayloadSize( uint8_t type )
+{
+    switch( type )
+    {
+        case DEBUG_FRAME_TRACE:
+            return TRACE_PAYLOAD_SIZE;
+        case DEBUG_FRAME_LOG:
+            return LOG_PAYLOAD_SIZE( LOG_MAX_ARGS );
+        case DEBUG_FRAME_CAPTURE:
+            return CAPTURE_PAYLOAD_SIZE( CAPTURE_MAX_DATA_SIZE );
+        default:
+            return 0;
+    }
+}
+
+static uint8_t Stream[TEST_STREAM_SIZE];
+static uint32_t StreamSize = 0;
+
+/*!
+ * Frame start offsets in the stream
+ */
+static bool IsFrameStart[TEST_STREAM_SIZE];
+static uint32_t NbFrames = 0;
+
+static uint8_t DrainBuffer[CAPTURE_FRAME_SIZE( CAPTURE_MAX_DATA_SIZE )];
+
+/*!
+ * \brief Appends drained frames to the stream
+ */
+static void TestAppend( const uint8_t *buffer, uint16_t size )
+{
+    uint16_t i = 0;
+
+    while( ( i < size ) && ( StreamSize + size < TEST_STREAM_SIZE ) )
+    {
+        uint16_t frameSize = DEBUG_FRAME_SIZE( buffer[i + 2] | ( buffer[i + 3] << 8 ) );
+
+        IsFrameStart[StreamSize] = true;
+        NbFrames++;
+        memcpy( Stream + StreamSize, buffer + i, frameSize );
+        StreamSize += frameSize;
+        i += frameSize;
+    }
+}
+
+static void TestDrain( void )
+{
+    uint16_t size;
+
+    size = TraceDrain( DrainBuffer, sizeof( DrainBuffer ) );
+    size += LogDrain( DrainBuffer + size, sizeof( DrainBuffer ) - size );
+    TestAppend( DrainBuffer, size );
+    size = CaptureDrain( DrainBuffer, sizeof( DrainBuffer ) );
+    TestAppend( DrainBuffer, size );
+}
+
+/*!
+ * \brief Reads the frames from an offset of the stream, resynchronizing on
+ *        errors
+ *
+ * \param [IN]  data     Stream
+ * \param [IN]  start    First byte read
+ * \param [IN]  stop     The reading stops at the first frame starting after
+ *                       this offset
+ * \param [OUT] nbFalse  Number of accepted frames that were not sent
+ * \retval nbFrames      Number of accepted frames
+ */
+static uint32_t TestRead( const uint8_t *data, uint32_t start, uint32_t stop, uint32_t *nbFalse )
+{
+    uint32_t i = start;
+    uint32_t nbFrames = 0;
+
+    *nbFalse = 0;
+    while( ( i + DEBUG_FRAME_HEADER_SIZE <= StreamSize ) && ( i <= stop ) )
+    {
+        uint16_t size = data[i + 2] | ( data[i + 3] << 8 );
+        uint32_t end = i + DEBUG_FRAME_HEADER_SIZE + size;
+
+        if( ( data[i] != DEBUG_FRAME_SYNC ) || ( size > TestMaxPayloadSize( data[i + 1] ) ) ||
+            ( end + 2 > StreamSize ) ||
+            ( DebugFrameCrc( 0xFFFF, data + i + 1, DEBUG_FRAME_HEADER_SIZE - 1 + size ) != ( data[end] | ( data[end + 1] << 8 ) ) ) )
+        {
+            i++;
+            continue;
+        }
+        nbFrames++;
+        if( ( IsFrameStart[i] == false ) || ( memcmp( data + i, Stream + i, end + 2 - i ) != 0 ) )
+        {
+            ( *nbFalse )++;
+        }
+        i = end + 2;
+    }
+    return nbFrames;
+}
+
+int main( void )
+{
+    static uint8_t corrupted[TEST_STREAM_SIZE];
+    uint8_t air[CAPTURE_MAX_DATA_SIZE];
+    uint32_t nbFalse = 0;
+    uint32_t totalFalse = 0;
+    uint32_t nbRead = 0;
+    uint32_t failures = 0;
+
+    srand( 1 );
+    // Records of all types, with payloads looking like frames of the other
+    // types
+    while( StreamSize + 2 * CAPTURE_FRAME_SIZE( CAPTURE_MAX_DATA_SIZE ) < TEST_STREAM_SIZE )
+    {
+        uint16_t size = rand( ) % ( CAPTURE_MAX_DATA_SIZE + 1 );
+
+        for( uint16_t i = 0; i < size; i++ )
+        {
+            // Half of the bytes are sync bytes
+            air[i] = ( ( rand( ) & 0x01 ) != 0 ) ? DEBUG_FRAME_SYNC : ( uint8_t )rand( );
+        }
+        TraceWrite( rand( ) & 0x0F, DEBUG_FRAME_SYNC, ( uint16_t )rand( ) );
+        LogPrint( LOG_LEVEL_INFO, "%u %u\n", DEBUG_FRAME_SYNC * 0x01010101UL, rand( ) );
+        CaptureWrite( CAPTURE_AIR_RX, NULL, 0, air, size );
+        TimerAdvance( TimerGetCurrentTime( ) + 1 + rand( ) % 100 );
+        TestDrain( );
+    }
+
+    // From the start, every frame is read
+    nbRead = TestRead( Stream, 0, StreamSize, &nbFalse );
+    if( ( nbRead != NbFrames ) || ( nbFalse != 0 ) )
+    {
+        failures++;
+    }
+    printf( "debug frames: %u frames, %u bytes, %u read from the start\n", NbFrames, StreamSize, nbRead );
+
+    // From every offset, the reader locks on a sent frame before the next
+    // frame start
+    for( uint32_t i = 0; i < StreamSize; i++ )
+    {
+        uint32_t next = i + 1;
+
+        while( ( next < StreamSize ) && ( IsFrameStart[next] == false ) )
+        {
+            next++;
+        }
+        TestRead( Stream, i, next, &nbFalse );
+        totalFalse += nbFalse;
+    }
+    if( totalFalse != 0 )
+    {
+        failures++;
+    }
+    printf( "debug frames: %u start offsets, %u false frames\n", StreamSize, totalFalse );
+
+    // Corrupted bytes: the damaged frames are dropped, no frame is made up
+    memcpy( corrupted, Stream, StreamSize );
+    for( uint32_t i = 0; i < TEST_NB_CORRUPTIONS; i++ )
+    {
+        corrupted[rand( ) % StreamSize] = ( uint8_t )rand( );
+    }
+    nbRead = TestRead( corrupted, 0, StreamSize, &nbFalse );
+    if( nbFalse != 0 )
+    {
+        failures++;
+    }
+    printf( "debug frames: %u corrupted bytes, %u frames read, %u false frames\n", TEST_NB_CORRUPTIONS, nbRead, nbFalse );
+
+    printf( "debug frame test: %u failures\n", failures );
+    return ( failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Downlink payload lifetime test. The MAC layer lends the frame
+             pool block holding the payload for the MCPS indication only.
+             The application keeps a copy, as app/main.cpp does for the
+             serial display, and reads it after the following uplinks, once
+             the block holds a frame sent to another device
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include "mac_sim.h"
+#include "LoRaMacTest.h"
+
+#define TEST_PORT                                   2
+#define TEST_DOWN_SIZE                              20
+#define TEST_NB_UPLINKS                             4
+
+/*!
+ * Size of the application copy, LORAWAN_APP_DATA_MAX_SIZE in app/main.cpp
+ */
+#define TEST_COPY_SIZE                              64
+
+static uint8_t NwkSKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB, 0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+static uint32_t DevAddr = 0x26011B4C;
+
+/*!
+ * The network answers the first uplink. The window of the third one gets a
+ * frame of another device, received in the pool and dropped by the MAC
+ */
+static bool DownPending = false;
+static bool OtherPending = false;
+static uint32_t NbUplinks = 0;
+
+/*!
+ * Indicated payload: the pointer lent by the MAC and the application copy
+ */
+static const uint8_t *IndicatedBuffer = NULL;
+static uint8_t DownlinkData[TEST_COPY_SIZE];
+static uint8_t DownlinkDataSize = 0;
+static uint32_t NbIndications = 0;
+
+static void FillDown( uint8_t *payload )
+{
+    for( uint8_t i = 0; i < TEST_DOWN_SIZE; i++ )
+    {
+        payload[i] = 0xC0 + i;
+    }
+}
+
+static void OnTransmit( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size, uint32_t timeOnAir )
+{
+    DownPending = NbUplinks == 0;
+    OtherPending = NbUplinks == 2;
+    NbUplinks++;
+}
+
+static bool OnReceive( const SimRadioSettings_t *settings, TimerTime_t end, SimRadioFrame_t *frame )
+{
+    uint8_t payload[TEST_DOWN_SIZE];
+
+    if( ( DownPending == false ) && ( OtherPending == false ) )
+    {
+        return false;
+    }
+
+    memset( frame, 0, sizeof( SimRadioFrame_t ) );
+    if( DownPending == true )
+    {
+        FillDown( payload );
+        frame->Size = MacSimBuildDown( frame->Payload, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, DevAddr, 0, 0, NULL, 0,
+                                       TEST_PORT, payload, sizeof( payload ), NwkSKey, AppSKey );
+    }
+    else
+    {
+        memset( payload, 0x33, sizeof( payload ) );
+        frame->Size = MacSimBuildDown( frame->Payload, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, DevAddr + 1, 0, 0, NULL, 0,
+                                       TEST_PORT, payload, sizeof( payload ), NwkSKey, AppSKey );
+    }
+    DownPending = false;
+    OtherPending = false;
+    frame->Start = TimerGetCurrentTime( );
+    frame->Rssi = -60;
+    frame->Snr = 8;
+    return true;
+}
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+    if( ( mcpsIndication->Status != LORAMAC_EVENT_INFO_STATUS_OK ) || ( mcpsIndication->RxData == false ) )
+    {
+        return;
+    }
+    NbIndications++;
+    IndicatedBuffer = mcpsIndication->Buffer;
+    DownlinkDataSize = MIN( mcpsIndication->BufferSize, sizeof( DownlinkData ) );
+    memcpy1( DownlinkData, mcpsIndication->Buffer, DownlinkDataSize );
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+int main( void )
+{
+    LoRaMacPrimitives_t primitives;
+    SimRadioHandlers_t handlers;
+    McpsReq_t mcpsReq;
+    uint8_t payload[32];
+    uint8_t expected[TEST_DOWN_SIZE];
+    uint32_t failures = 0;
+    bool reused = false;
+
+    srand1( 5 );
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    handlers.Transmit = OnTransmit;
+    handlers.Receive = OnReceive;
+    handlers.Random = NULL;
+    MacSimInit( &primitives, &handlers );
+    MacSimActivate( DevAddr, NwkSKey, AppSKey );
+    LoRaMacTestSetDutyCycleOn( false );
+
+    // The uplinks after the downlink are built in the pool blocks
+    memset( payload, 0x5A, sizeof( payload ) );
+    for( uint8_t i = 0; i < TEST_NB_UPLINKS; i++ )
+    {
+        mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = TEST_PORT;
+        mcpsReq.Req.Unconfirmed.fBuffer = payload;
+        mcpsReq.Req.Unconfirmed.fBufferSize = sizeof( payload );
+        mcpsReq.Req.Unconfirmed.Datarate = DR_5;
+        if( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK )
+        {
+            failures++;
+        }
+        MacSimRun( TimerGetCurrentTime( ) + 3000 );
+    }
+
+    FillDown( expected );
+    if( ( NbUplinks != TEST_NB_UPLINKS ) || ( NbIndications != 1 ) || ( DownlinkDataSize != TEST_DOWN_SIZE ) ||
+        ( memcmp( DownlinkData, expected, sizeof( expected ) ) != 0 ) )
+    {
+        failures++;
+    }
+    // The lent block has been reused: reading it now is the use after free
+    // the copy avoids
+    reused = ( IndicatedBuffer != NULL ) && ( memcmp( IndicatedBuffer, expected, sizeof( expected ) ) != 0 );
+    if( reused == false )
+    {
+        failures++;
+    }
+    printf( "downlink test: %u uplinks, %u indications, lent block %s\n", NbUplinks, NbIndications,
+            ( reused == true ) ? "reused" : "not reused" );
+    printf( "downlink test: %u failures\n", failures );
+    return ( failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Simulated flash memory with power loss injection
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "flash_sim.h"
+
+/*!
+ * Memory content and programmed state of each word
+ */
+static uint8_t *Memory = NULL;
+static bool *IsProgrammed = NULL;
+
+/*!
+ * Geometry
+ */
+static uint32_t Size = 0;
+static uint32_t EraseSize = 0;
+static uint8_t ErasedValue = 0;
+
+/*!
+ * Power loss injection. Operations left before the cut and power state
+ */
+static bool IsCutArmed = false;
+static uint32_t NbOperationsLeft = 0;
+static bool IsPowerOff = false;
+
+/*!
+ * Statistics
+ */
+static FlashSimStats_t Stats;
+
+void FlashSimInit( uint32_t size, uint32_t eraseSize, uint8_t erasedValue )
+{
+    free( Memory );
+    free( IsProgrammed );
+    Memory = ( uint8_t* )malloc( size );
+    IsProgrammed = ( bool* )calloc( size / FLASH_SIM_WORD_SIZE, sizeof( bool ) );
+    memset( Memory, erasedValue, size );
+    Size = size;
+    EraseSize = eraseSize;
+    ErasedValue = erasedValue;
+    IsCutArmed = false;
+    IsPowerOff = false;
+    memset( &Stats, 0, sizeof( Stats ) );
+}
+
+void FlashSimCutPower( uint32_t nbOperations )
+{
+    IsCutArmed = true;
+    NbOperationsLeft = nbOperations;
+}
+
+bool FlashSimPowerOn( void )
+{
+    bool wasOff = IsPowerOff;
+
+    IsCutArmed = false;
+    IsPowerOff = false;
+    return wasOff;
+}
+
+/*!
+ * \brief   Accounts an operation
+ *
+ * \retval  [true: the operation completes, false: the power is cut during it]
+ */
+static bool FlashSimOperation( void )
+{
+    if( IsCutArmed == true )
+    {
+        if( NbOperationsLeft == 0 )
+        {
+            IsCutArmed = false;
+            IsPowerOff = true;
+            return false;
+        }
+        NbOperationsLeft--;
+    }
+    return true;
+}
+
+/*!
+ * \brief   Leaves random data in an interrupted area
+ */
+static void FlashSimScramble( uint32_t offset, uint32_t size )
+{
+    for( uint32_t i = 0; i < size; i++ )
+    {
+        if( ( rand( ) & 0x01 ) != 0 )
+        {
+            Memory[offset + i] = rand( ) & 0xFF;
+        }
+    }
+}
+
+bool FlashSimErase( uint32_t offset, uint32_t size )
+{
+    if( ( ( offset % EraseSize ) != 0 ) || ( ( size % EraseSize ) != 0 ) || ( ( offset + size ) > Size ) )
+    {
+        return false;
+    }
+    for( uint32_t unit = offset; unit < ( offset + size ); unit += EraseSize )
+    {
+        if( IsPowerOff == true )
+        {
+            return false;
+        }
+        if( FlashSimOperation( ) == false )
+        {
+            FlashSimScramble( unit, EraseSize );
+            return false;
+        }
+        memset( Memory + unit, ErasedValue, EraseSize );
+        memset( IsProgrammed + ( unit / FLASH_SIM_WORD_SIZE ), 0, EraseSize / FLASH_SIM_WORD_SIZE );
+        Stats.NbErases++;
+    }
+    return true;
+}
+
+bool FlashSimWrite( uint32_t offset, const uint8_t *buffer, uint32_t size )
+{
+    if( ( ( offset % FLASH_SIM_WORD_SIZE ) != 0 ) || ( ( size % FLASH_SIM_WORD_SIZE ) != 0 ) || ( ( offset + size ) > Size ) )
+    {
+        return false;
+    }
+    for( uint32_t i = 0; i < size; i += FLASH_SIM_WORD_SIZE )
+    {
+        uint32_t word = ( offset + i ) / FLASH_SIM_WORD_SIZE;
+
+        if( IsPowerOff == true )
+        {
+            return false;
+        }
+        if( FlashSimOperation( ) == false )
+        {
+            FlashSimScramble( offset + i, FLASH_SIM_WORD_SIZE );
+            return false;
+        }
+        if( IsProgrammed[word] == true )
+        {
+            Stats.NbOverwrites++;
+        }
+        memcpy( Memory + offset + i, buffer + i, FLASH_SIM_WORD_SIZE );
+        IsProgrammed[word] = true;
+        Stats.NbProgrammed += FLASH_SIM_WORD_SIZE;
+    }
+    return true;
+}
+
+bool FlashSimRead( uint32_t offset, uint8_t *buffer, uint32_t size )
+{
+    if( ( IsPowerOff == true ) || ( ( offset + size ) > Size ) )
+    {
+        return false;
+    }
+    memcpy( buffer, Memory + offset, size );
+    return true;
+}
+
+const FlashSimStats_t* FlashSimGetStats( void )
+{
+    return &Stats;
+}
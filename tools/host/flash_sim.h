@@ -0,0 +1,85 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Simulated flash memory with power loss injection
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __FLASH_SIM_H__
+#define __FLASH_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * Programming granularity. A word may only be programmed once between two
+ * erases
+ */
+#define FLASH_SIM_WORD_SIZE                         4
+
+/*!
+ * Simulated flash statistics
+ */
+typedef struct sFlashSimStats
+{
+    /*!
+     * Number of erase units erased
+     */
+    uint32_t NbErases;
+    /*!
+     * Number of bytes programmed
+     */
+    uint32_t NbProgrammed;
+    /*!
+     * Number of words programmed while not erased. Always a caller bug
+     */
+    uint32_t NbOverwrites;
+}FlashSimStats_t;
+
+/*!
+ * \brief   Initializes the simulated flash. The whole memory is erased
+ *
+ * \param   [IN] size        Memory size
+ * \param   [IN] eraseSize   Erase unit size
+ * \param   [IN] erasedValue Value read from erased bytes, 0x00 on the STM32L0
+ */
+void FlashSimInit( uint32_t size, uint32_t eraseSize, uint8_t erasedValue );
+
+/*!
+ * \brief   Cuts the power after a number of flash operations. A word program
+ *          and an erase unit count as one operation each. The interrupted
+ *          operation leaves random data, the following ones fail
+ *
+ * \param   [IN] nbOperations Operations completed before the cut
+ */
+void FlashSimCutPower( uint32_t nbOperations );
+
+/*!
+ * \brief   Restores the power
+ *
+ * \retval  [true: the power had been cut, false: no cut happened]
+ */
+bool FlashSimPowerOn( void );
+
+/*!
+ * \brief   Memory access functions matching the NvmLog and FragRx callbacks
+ *
+ * \retval  [true: success, false: failure]
+ */
+bool FlashSimErase( uint32_t offset, uint32_t size );
+bool FlashSimWrite( uint32_t offset, const uint8_t *buffer, uint32_t size );
+bool FlashSimRead( uint32_t offset, uint8_t *buffer, uint32_t size );
+
+/*!
+ * \brief   Gets the statistics since the initialization
+ */
+const FlashSimStats_t* FlashSimGetStats( void );
+
+#endif // __FLASH_SIM_H__
@@ -0,0 +1,248 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Fragmented uplink goodput benchmark. The fragmentation
+             transmitter runs over an EU868 MAC model whose datarate moves
+             during the transfer and which queues MAC commands. The frames
+             go through a lossy link into the network side reassembler
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "board.h"
+#include "Fragmentation.h"
+#include "frag_reassembler.h"
+
+#define BENCH_MSG_SIZE                              512
+#define BENCH_NB_MESSAGES                           400
+#define BENCH_PORT                                  16
+
+/*!
+ * EU868 maximum applicative payload per datarate, DR_0 to DR_5 allowed
+ */
+static const uint8_t MaxPayload[] = { 51, 51, 51, 115, 242, 242, 242, 242 };
+#define BENCH_MAX_DR                                DR_5
+
+/*!
+ * MHDR, FHDR, FPort and MIC
+ */
+#define BENCH_FRAME_OVERHEAD                        13
+
+/*!
+ * MAC model state
+ */
+static int8_t Datarate;
+static uint8_t FOptsLen;
+static uint8_t Frame[256];
+static uint8_t FrameSize;
+static bool FrameQueued;
+static bool FrameIsFlush;
+static uint32_t NbLengthErrors;
+
+/*!
+ * \brief   LoRa time on air, 125 kHz, coding rate 4/5, explicit header, CRC
+ *
+ * \retval  Time on air [ms]
+ */
+static uint32_t TimeOnAir( int8_t datarate, uint16_t phyPayloadSize )
+{
+    double sf = 12 - datarate;
+    double tSym = pow( 2.0, sf ) / 125.0;
+    double de = ( sf >= 11 ) ? 1 : 0;
+    double nbSymbols = 8 + MAX( ceil( ( 8.0 * phyPayloadSize - 4.0 * sf + 28 + 16 ) / ( 4.0 * ( sf - 2 * de ) ) ) * 5, 0.0 );
+
+    return ( uint32_t )ceil( ( 12.25 + nbSymbols ) * tSym );
+}
+
+LoRaMacStatus_t LoRaMacQueryTxPlan( uint8_t size, LoRaMacTxPlan_t* txPlan )
+{
+    txPlan->FOptsLen = FOptsLen;
+    txPlan->CurrentDatarate = Datarate;
+    for( int8_t dr = LORAMAC_TX_MIN_DATARATE; dr <= LORAMAC_TX_MAX_DATARATE; dr++ )
+    {
+        LoRaMacTxPlanEntry_t *entry = &txPlan->Entries[dr - LORAMAC_TX_MIN_DATARATE];
+
+        memset1( ( uint8_t* )entry, 0, sizeof( LoRaMacTxPlanEntry_t ) );
+        entry->Datarate = dr;
+        entry->Allowed = dr <= BENCH_MAX_DR;
+        entry->PayloadFits = ( size + FOptsLen ) <= MaxPayload[dr];
+        entry->MaxPossiblePayload = ( MaxPayload[dr] > FOptsLen ) ? ( MaxPayload[dr] - FOptsLen ) : 0;
+        entry->TimeOnAir = TimeOnAir( dr, size + FOptsLen + BENCH_FRAME_OVERHEAD );
+    }
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacQueryTxPossible( uint8_t size, LoRaMacTxInfo_t* txInfo )
+{
+    txInfo->CurrentPayloadSize = MaxPayload[Datarate];
+    txInfo->MaxPossiblePayload = ( MaxPayload[Datarate] > FOptsLen ) ? ( MaxPayload[Datarate] - FOptsLen ) : 0;
+    if( size > MaxPayload[Datarate] )
+    {
+        return LORAMAC_STATUS_LENGTH_ERROR;
+    }
+    if( ( size + FOptsLen ) > MaxPayload[Datarate] )
+    {
+        return LORAMAC_STATUS_MAC_CMD_LENGTH_ERROR;
+    }
+    return LORAMAC_STATUS_OK;
+}
+
+LoRaMacStatus_t LoRaMacMcpsRequest( McpsReq_t* mcpsRequest )
+{
+    uint16_t size = mcpsRequest->Req.Unconfirmed.fBufferSize;
+
+    // The MAC uses the ADR datarate, the requested one is ignored
+    if( ( size + FOptsLen ) > MaxPayload[Datarate] )
+    {
+        NbLengthErrors++;
+        return LORAMAC_STATUS_LENGTH_ERROR;
+    }
+    memcpy1( Frame, ( uint8_t* )mcpsRequest->Req.Unconfirmed.fBuffer, size );
+    FrameSize = size;
+    FrameIsFlush = size == 0;
+    FrameQueued = true;
+    return LORAMAC_STATUS_OK;
+}
+
+typedef struct sBenchResult
+{
+    uint32_t NbDelivered;
+    uint32_t NbCorrupted;
+    uint32_t NbFrames;
+    uint32_t NbFlushes;
+    uint32_t NbRecovered;
+    uint32_t TimeOnAir;
+}BenchResult_t;
+
+static void BenchRun( uint8_t loss, uint8_t parityGroupSize, BenchResult_t *result )
+{
+    static FragReassembler_t reassembler;
+    static uint8_t message[BENCH_MSG_SIZE];
+
+    memset1( ( uint8_t* )result, 0, sizeof( BenchResult_t ) );
+    FragReassemblerInit( &reassembler );
+    NbLengthErrors = 0;
+
+    for( uint32_t n = 0; n < BENCH_NB_MESSAGES; n++ )
+    {
+        bool isDelivered = false;
+
+        for( uint16_t i = 0; i < BENCH_MSG_SIZE; i++ )
+        {
+            message[i] = rand( );
+        }
+        Datarate = rand( ) % ( BENCH_MAX_DR + 1 );
+        FOptsLen = 0;
+        if( FragTxStart( message, BENCH_MSG_SIZE, BENCH_PORT, parityGroupSize ) != LORAMAC_STATUS_OK )
+        {
+            printf( "FragTxStart failed\n" );
+            exit( 1 );
+        }
+        while( FragTxGetStatus( ) == FRAG_STATUS_RUNNING )
+        {
+            McpsConfirm_t mcpsConfirm;
+
+            FrameQueued = false;
+            FragTxProcess( );
+            if( FrameQueued == false )
+            {
+                continue;
+            }
+
+            result->NbFrames++;
+            result->TimeOnAir += TimeOnAir( Datarate, FrameSize + FOptsLen + BENCH_FRAME_OVERHEAD );
+            if( FrameIsFlush == true )
+            {
+                result->NbFlushes++;
+            }
+            FOptsLen = 0;
+
+            if( ( FrameIsFlush == false ) && ( ( uint8_t )( rand( ) % 100 ) >= loss ) )
+            {
+                const uint8_t *received = NULL;
+                uint16_t receivedSize = 0;
+
+                if( FragReassemblerPush( &reassembler, Frame, FrameSize, &received, &receivedSize ) == FRAG_STATUS_DONE )
+                {
+                    isDelivered = true;
+                    result->NbRecovered += reassembler.NbRecovered;
+                    if( ( receivedSize != BENCH_MSG_SIZE ) || ( memcmp( received, message, BENCH_MSG_SIZE ) != 0 ) )
+                    {
+                        result->NbCorrupted++;
+                    }
+                }
+            }
+
+            memset1( ( uint8_t* )&mcpsConfirm, 0, sizeof( mcpsConfirm ) );
+            mcpsConfirm.Status = LORAMAC_EVENT_INFO_STATUS_OK;
+            mcpsConfirm.TxTimeOnAir = TimeOnAir( Datarate, FrameSize + BENCH_FRAME_OVERHEAD );
+            FragTxOnMcpsConfirm( &mcpsConfirm );
+
+            // ADR moves the datarate, the network queues MAC answers
+            if( ( rand( ) % 4 ) == 0 )
+            {
+                int8_t step = ( rand( ) % 3 ) - 1;
+
+                Datarate = MAX( MIN( Datarate + step, BENCH_MAX_DR ), DR_0 );
+            }
+            if( ( rand( ) % 8 ) == 0 )
+            {
+                FOptsLen = 1 + rand( ) % 15;
+            }
+        }
+        if( FragTxGetStatus( ) != FRAG_STATUS_DONE )
+        {
+            printf( "transfer aborted, status %u\n", FragTxGetStatus( ) );
+            exit( 1 );
+        }
+        if( isDelivered == true )
+        {
+            result->NbDelivered++;
+        }
+    }
+    if( NbLengthErrors != 0 )
+    {
+        printf( "%u frames rejected by the MAC\n", NbLengthErrors );
+        exit( 1 );
+    }
+}
+
+int main( void )
+{
+    const uint8_t losses[] = { 0, 5, 10, 20, 30 };
+    const uint8_t groups[] = { 0, 8, 4, 2 };
+    uint32_t nbCorrupted = 0;
+
+    srand( 1 );
+    printf( "frag goodput, %u messages of %u bytes, EU868 DR_0 to DR_5 moving during the transfer\n", BENCH_NB_MESSAGES, BENCH_MSG_SIZE );
+    printf( "  loss group delivered frames/msg flushes recovered goodput[B/s of airtime]\n" );
+    for( uint8_t l = 0; l < sizeof( losses ); l++ )
+    {
+        for( uint8_t g = 0; g < sizeof( groups ); g++ )
+        {
+            BenchResult_t result;
+
+            BenchRun( losses[l], groups[g], &result );
+            printf( "  %3u%% %5u %8.1f%% %10.1f %7u %9u %8.1f\n", losses[l], groups[g],
+                    100.0 * result.NbDelivered / BENCH_NB_MESSAGES, ( double )result.NbFrames / BENCH_NB_MESSAGES,
+                    result.NbFlushes, result.NbRecovered,
+                    ( 1000.0 * result.NbDelivered * BENCH_MSG_SIZE ) / result.TimeOnAir );
+            nbCorrupted += result.NbCorrupted;
+        }
+    }
+    if( nbCorrupted != 0 )
+    {
+        printf( "%u corrupted messages\n", nbCorrupted );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Network side reassembly of the fragmented uplink messages, see
+             the fragment format in Fragmentation.h
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "frag_reassembler.h"
+
+/*!
+ * Size of the message size prefix
+ */
+#define FRAG_MSG_SIZE_PREFIX                        2
+
+/*!
+ * \brief   Recovers the single missing data fragment of each group whose
+ *          parity fragment has been received
+ */
+static void FragReassemblerRepair( FragReassembler_t *reassembler )
+{
+    uint8_t nbGroups = ( reassembler->NbFragments + reassembler->ParityGroupSize - 1 ) / reassembler->ParityGroupSize;
+
+    for( uint8_t group = 0; group < nbGroups; group++ )
+    {
+        uint8_t first = group * reassembler->ParityGroupSize;
+        uint8_t last = MIN( first + reassembler->ParityGroupSize, reassembler->NbFragments );
+        uint8_t nbMissing = 0;
+        uint8_t missing = 0;
+        uint8_t *repaired = NULL;
+        const uint8_t *parity = NULL;
+
+        for( uint8_t fragment = first; fragment < last; fragment++ )
+        {
+            if( reassembler->Received[fragment] == false )
+            {
+                missing = fragment;
+                nbMissing++;
+            }
+        }
+        if( ( nbMissing != 1 ) || ( reassembler->Received[reassembler->NbFragments + group] == false ) )
+        {
+            continue;
+        }
+
+        repaired = reassembler->Stream + ( missing * reassembler->FragmentSize );
+        parity = reassembler->Stream + ( ( reassembler->NbFragments + group ) * reassembler->FragmentSize );
+        memcpy1( repaired, parity, reassembler->FragmentSize );
+        for( uint8_t fragment = first; fragment < last; fragment++ )
+        {
+            if( fragment != missing )
+            {
+                const uint8_t *data = reassembler->Stream + ( fragment * reassembler->FragmentSize );
+
+                for( uint8_t i = 0; i < reassembler->FragmentSize; i++ )
+                {
+                    repaired[i] ^= data[i];
+                }
+            }
+        }
+        reassembler->Received[missing] = true;
+        reassembler->NbRecovered++;
+    }
+}
+
+void FragReassemblerInit( FragReassembler_t *reassembler )
+{
+    reassembler->Status = FRAG_STATUS_IDLE;
+    reassembler->NbRecovered = 0;
+}
+
+FragStatus_t FragReassemblerPush( FragReassembler_t *reassembler, const uint8_t *frame, uint8_t size, const uint8_t **message, uint16_t *messageSize )
+{
+    uint8_t index = 0;
+    uint8_t nbFragments = 0;
+    uint8_t parityGroupSize = 0;
+    uint8_t fragmentSize = 0;
+    uint16_t nbParity = 0;
+    uint16_t streamSize = 0;
+
+    if( size <= FRAG_HEADER_SIZE )
+    {
+        return FRAG_STATUS_ERROR;
+    }
+    index = frame[1];
+    nbFragments = frame[2];
+    parityGroupSize = frame[3];
+    fragmentSize = size - FRAG_HEADER_SIZE;
+    if( parityGroupSize != 0 )
+    {
+        nbParity = ( nbFragments + parityGroupSize - 1 ) / parityGroupSize;
+    }
+    if( ( nbFragments == 0 ) || ( ( nbFragments + nbParity ) > FRAG_MAX_NB_FRAGMENTS ) || ( index >= ( nbFragments + nbParity ) ) )
+    {
+        return FRAG_STATUS_ERROR;
+    }
+
+    if( ( reassembler->Status == FRAG_STATUS_DONE ) && ( reassembler->MessageId == frame[0] ) )
+    {
+        return FRAG_STATUS_IDLE;
+    }
+    if( ( reassembler->Status != FRAG_STATUS_RUNNING ) || ( reassembler->MessageId != frame[0] ) )
+    { // New message
+        reassembler->Status = FRAG_STATUS_RUNNING;
+        reassembler->MessageId = frame[0];
+        reassembler->NbFragments = nbFragments;
+        reassembler->ParityGroupSize = parityGroupSize;
+        reassembler->FragmentSize = fragmentSize;
+        reassembler->NbRecovered = 0;
+        memset1( ( uint8_t* )reassembler->Received, 0, sizeof( reassembler->Received ) );
+    }
+    else if( ( reassembler->NbFragments != nbFragments ) || ( reassembler->ParityGroupSize != parityGroupSize ) ||
+             ( reassembler->FragmentSize != fragmentSize ) )
+    {
+        return FRAG_STATUS_ERROR;
+    }
+
+    memcpy1( reassembler->Stream + ( index * fragmentSize ), frame + FRAG_HEADER_SIZE, fragmentSize );
+    reassembler->Received[index] = true;
+    if( parityGroupSize != 0 )
+    {
+        FragReassemblerRepair( reassembler );
+    }
+
+    for( uint8_t fragment = 0; fragment < nbFragments; fragment++ )
+    {
+        if( reassembler->Received[fragment] == false )
+        {
+            return FRAG_STATUS_RUNNING;
+        }
+    }
+
+    // The stream starts with the message size
+    streamSize = nbFragments * fragmentSize;
+    *messageSize = ( reassembler->Stream[0] << 8 ) | reassembler->Stream[1];
+    if( ( *messageSize + FRAG_MSG_SIZE_PREFIX ) > streamSize )
+    {
+        reassembler->Status = FRAG_STATUS_ERROR;
+        return FRAG_STATUS_ERROR;
+    }
+    *message = reassembler->Stream + FRAG_MSG_SIZE_PREFIX;
+    reassembler->Status = FRAG_STATUS_DONE;
+    return FRAG_STATUS_DONE;
+}
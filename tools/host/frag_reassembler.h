@@ -0,0 +1,79 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Network side reassembly of the fragmented uplink messages, see
+             the fragment format in Fragmentation.h
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __FRAG_REASSEMBLER_H__
+#define __FRAG_REASSEMBLER_H__
+
+#include "board.h"
+#include "Fragmentation.h"
+
+/*!
+ * Largest message the reassembler holds, size prefix included
+ */
+#define FRAG_REASSEMBLER_MAX_SIZE                   ( FRAG_MAX_NB_FRAGMENTS * FRAG_MAX_FRAGMENT_SIZE )
+
+/*!
+ * Reassembler context
+ */
+typedef struct sFragReassembler
+{
+    /*!
+     * Message in reassembly. DONE once the message has been delivered, its
+     * late fragments are ignored
+     */
+    FragStatus_t Status;
+    uint8_t MessageId;
+    uint8_t NbFragments;
+    uint8_t ParityGroupSize;
+    uint8_t FragmentSize;
+    /*!
+     * Received data and parity fragments, one flag per fragment index
+     */
+    bool Received[FRAG_MAX_NB_FRAGMENTS];
+    /*!
+     * Data stream followed by the parity fragments
+     */
+    uint8_t Stream[FRAG_REASSEMBLER_MAX_SIZE];
+    /*!
+     * Number of data fragments recovered from the parity
+     */
+    uint8_t NbRecovered;
+}FragReassembler_t;
+
+/*!
+ * \brief   Initializes the reassembler
+ *
+ * \param   [IN] reassembler Reassembler context
+ */
+void FragReassemblerInit( FragReassembler_t *reassembler );
+
+/*!
+ * \brief   Processes a received fragment. A fragment of a new message drops
+ *          the message in reassembly
+ *
+ * \param   [IN]  reassembler Reassembler context
+ * \param   [IN]  frame       Fragment, header included
+ * \param   [IN]  size        Fragment size
+ * \param   [OUT] message     Reassembled message, valid when DONE is returned
+ * \param   [OUT] messageSize Reassembled message size
+ *
+ * \retval  status [FRAG_STATUS_RUNNING: fragments missing,
+ *                  FRAG_STATUS_DONE: message complete,
+ *                  FRAG_STATUS_IDLE: fragment of a delivered message,
+ *                  FRAG_STATUS_ERROR: malformed fragment]
+ */
+FragStatus_t FragReassemblerPush( FragReassembler_t *reassembler, const uint8_t *frame, uint8_t size, const uint8_t **message, uint16_t *messageSize );
+
+#endif // __FRAG_REASSEMBLER_H__
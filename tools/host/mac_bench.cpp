@@ -0,0 +1,450 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: MAC layer host benchmark. The MAC runs unchanged on the
+             simulated radio: each uplink is answered in RX1 by a downlink
+             carrying 15 bytes of MAC commands in FOpts and an application
+             payload. The profiler regions of the MAC are timed with the host
+             monotonic clock. The crypto operations are then swept over the
+             payload sizes and the time on air computed for the LoRa and FSK
+             settings. Built once per band, see the Makefile
+
+             The results are printed as the app/MicroBench.cpp lines,
+             bench,<operation>,<size>,<cycles>,<ns>, the host core clock is
+             1 GHz. The run summary is printed on the error output
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include "mbed.h"
+#include "mac_sim.h"
+#include "LoRaMacTest.h"
+#include "LoRaMacCrypto.h"
+
+#define BENCH_NB_FRAMES                             5000
+#define BENCH_PORT                                  2
+#define BENCH_UP_SIZE                               16
+#define BENCH_DOWN_SIZE                             32
+
+/*!
+ * Largest swept payload, maximum LoRaWAN application payload
+ */
+#define BENCH_MAX_SIZE                              242
+
+/*!
+ * Calls timed per measurement, after one warm up call
+ */
+#define BENCH_ITERATIONS                            16
+
+#if defined( USE_BAND_915 )
+#define BENCH_BAND                                  "US915"
+#define BENCH_DATARATE                              DR_3
+#else
+#define BENCH_BAND                                  "EU868"
+#define BENCH_DATARATE                              DR_5
+#endif
+
+static uint8_t NwkSKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB, 0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+static uint32_t DevAddr = 0x26011B4C;
+
+/*!
+ * Downlink MAC commands, 15 bytes: LinkCheckAns, DevStatusReq,
+ * DutyCycleReq, RXTimingSetupReq, DevStatusReq, LinkCheckAns, DutyCycleReq
+ * and DevStatusReq. None of them changes the channels nor the datarate
+ */
+static const uint8_t DownFOpts[15] =
+{
+    SRV_MAC_LINK_CHECK_ANS, 20, 1,
+    SRV_MAC_DEV_STATUS_REQ,
+    SRV_MAC_DUTY_CYCLE_REQ, 0,
+    SRV_MAC_RX_TIMING_SETUP_REQ, 1,
+    SRV_MAC_DEV_STATUS_REQ,
+    SRV_MAC_LINK_CHECK_ANS, 18, 2,
+    SRV_MAC_DUTY_CYCLE_REQ, 0,
+    SRV_MAC_DEV_STATUS_REQ,
+};
+
+/*!
+ * Profiled MAC regions reported by the benchmark, with the size of the data
+ * they process. The MIC region is reported under its own name, the swept
+ * LoRaMacComputeMic operation being a different measurement
+ */
+static const struct
+{
+    ProfileRegion_t Region;
+    const char *Name;
+    uint8_t Size;
+}BenchRegions[] =
+{
+    { PROFILE_PREPARE_FRAME, "PrepareFrame", BENCH_UP_SIZE },
+    { PROFILE_SET_NEXT_CHANNEL, "SetNextChannel", 0 },
+    { PROFILE_RADIO_RX_DONE, "OnRadioRxDone", BENCH_DOWN_SIZE },
+    { PROFILE_PROCESS_MAC_COMMANDS, "ProcessMacCommands", sizeof( DownFOpts ) },
+    { PROFILE_COMPUTE_MIC, "ComputeMicRegion", BENCH_UP_SIZE },
+};
+
+#define BENCH_NB_REGIONS                            ( sizeof( BenchRegions ) / sizeof( BenchRegions[0] ) )
+
+/*!
+ * Swept operations, named as in app/MicroBench.cpp
+ */
+typedef enum eBenchOp
+{
+    BENCH_COMPUTE_MIC,
+    BENCH_PAYLOAD_ENCRYPT,
+    BENCH_PAYLOAD_DECRYPT,
+    BENCH_JOIN_COMPUTE_MIC,
+    BENCH_TIME_ON_AIR,
+}BenchOp_t;
+
+/*!
+ * Time on air settings: LoRa SF7 and SF12 at 125 kHz, FSK at 50 kbps
+ */
+static const struct
+{
+    const char *Name;
+    RadioModems_t Modem;
+    uint32_t Bandwidth;
+    uint32_t Datarate;
+}BenchTimeOnAir[] =
+{
+    { "TimeOnAirSF7", MODEM_LORA, 0, 7 },
+    { "TimeOnAirSF12", MODEM_LORA, 0, 12 },
+    { "TimeOnAirFSK", MODEM_FSK, 0, 50000 },
+};
+
+#define BENCH_NB_TIME_ON_AIR                        ( sizeof( BenchTimeOnAir ) / sizeof( BenchTimeOnAir[0] ) )
+
+/*!
+ * Sizes of the operations not swept over every size, app/MicroBench.cpp ones
+ */
+static const uint8_t BenchSizes[] = { 1, 16, 32, 64, 128, BENCH_MAX_SIZE };
+
+#define BENCH_NB_SIZES                              ( sizeof( BenchSizes ) / sizeof( BenchSizes[0] ) )
+
+/*!
+ * Crypto context of the swept operations, never precomputed. The frame
+ * counter changes for each call
+ */
+static LoRaMacCryptoCtx_t BenchCryptoCtx;
+static uint32_t BenchCounter = 0;
+static uint8_t BenchInput[BENCH_MAX_SIZE];
+static uint8_t BenchOutput[BENCH_MAX_SIZE];
+
+/*!
+ * Modem of the time on air case being measured
+ */
+static RadioModems_t BenchModem = MODEM_LORA;
+
+/*!
+ * The network answers in the next RX1 window when set
+ */
+static bool DownPending = false;
+static uint32_t DownLinkCounter = 0;
+
+static uint32_t NbUplinks = 0;
+static uint32_t NbUplinksWithFOpts = 0;
+static uint32_t NbConfirms = 0;
+static uint32_t NbDownlinks = 0;
+static uint32_t NbChannels = 0;
+static uint32_t LastFrequency = 0;
+
+static void OnTransmit( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size, uint32_t timeOnAir )
+{
+    NbUplinks++;
+    if( ( payload[5] & 0x0F ) != 0 )
+    {
+        NbUplinksWithFOpts++;
+    }
+    if( settings->Frequency != LastFrequency )
+    {
+        NbChannels++;
+        LastFrequency = settings->Frequency;
+    }
+    DownPending = true;
+}
+
+static bool OnReceive( const SimRadioSettings_t *settings, TimerTime_t end, SimRadioFrame_t *frame )
+{
+    uint8_t payload[BENCH_DOWN_SIZE];
+
+    if( DownPending == false )
+    {
+        return false;
+    }
+    DownPending = false;
+
+    memset( payload, 0xA5, sizeof( payload ) );
+    memset( frame, 0, sizeof( SimRadioFrame_t ) );
+    frame->Size = MacSimBuildDown( frame->Payload, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, DevAddr, 0, DownLinkCounter++,
+                                   DownFOpts, sizeof( DownFOpts ), BENCH_PORT, payload, sizeof( payload ), NwkSKey, AppSKey );
+    frame->Start = TimerGetCurrentTime( );
+    frame->Rssi = -60;
+    frame->Snr = 8;
+    return true;
+}
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+    if( mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK )
+    {
+        NbConfirms++;
+    }
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+    if( ( mcpsIndication->Status == LORAMAC_EVENT_INFO_STATUS_OK ) && ( mcpsIndication->RxData == true ) &&
+        ( mcpsIndication->Port == BENCH_PORT ) && ( mcpsIndication->BufferSize == BENCH_DOWN_SIZE ) &&
+        ( mcpsIndication->Buffer[0] == 0xA5 ) )
+    {
+        NbDownlinks++;
+    }
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+/*!
+ * \brief Checks the MIC and the encryption of a private crypto context, zero
+ *        initialized as on the target, against AES and CMAC used directly
+ *
+ * \retval failures Number of mismatches
+ */
+static uint32_t CheckCryptoCtx( void )
+{
+    static LoRaMacCryptoCtx_t ctx;
+    AES_CMAC_CTX cmac;
+    aes_context aes;
+    uint8_t frame[BENCH_DOWN_SIZE];
+    uint8_t block[16];
+    uint8_t digest[16];
+    uint8_t encrypted[BENCH_DOWN_SIZE];
+    uint32_t mic = 0;
+    uint32_t failures = 0;
+
+    memset( frame, 0x5A, sizeof( frame ) );
+
+    // B0 | frame, B0 = 0x49 | 4 x 0x00 | dir | devAddr | fCnt | 0x00 | size
+    memset( block, 0, sizeof( block ) );
+    block[0] = 0x49;
+    block[5] = DOWN_LINK;
+    memcpy( block + 6, &DevAddr, 4 );
+    block[10] = 7;
+    block[15] = sizeof( frame );
+    AES_CMAC_Init( &cmac );
+    AES_CMAC_SetKey( &cmac, NwkSKey );
+    AES_CMAC_Update( &cmac, block, sizeof( block ) );
+    AES_CMAC_Update( &cmac, frame, sizeof( frame ) );
+    AES_CMAC_Final( digest, &cmac );
+    LoRaMacComputeMicCtx( &ctx, frame, sizeof( frame ), NwkSKey, DevAddr, DOWN_LINK, 7, &mic );
+    if( memcmp( &mic, digest, 4 ) != 0 )
+    {
+        failures++;
+    }
+
+    // Ai = 0x01 | 4 x 0x00 | dir | devAddr | fCnt | 0x00 | i
+    LoRaMacPayloadEncryptCtx( &ctx, frame, sizeof( frame ), AppSKey, DevAddr, DOWN_LINK, 7, encrypted );
+    memset( &aes, 0, sizeof( aes ) );
+    aes_set_key( AppSKey, 16, &aes );
+    block[0] = 0x01;
+    for( uint8_t i = 0; i < sizeof( frame ); i++ )
+    {
+        if( ( i % 16 ) == 0 )
+        {
+            block[15] = ( i / 16 ) + 1;
+            aes_encrypt( block, digest, &aes );
+        }
+        if( ( frame[i] ^ digest[i % 16] ) != encrypted[i] )
+        {
+            failures++;
+            break;
+        }
+    }
+    return failures;
+}
+
+/*!
+ * \brief Calls an operation once
+ *
+ * \param [IN] op   Operation
+ * \param [IN] size Payload size
+ */
+static void BenchRun( BenchOp_t op, uint8_t size )
+{
+    uint32_t mic;
+
+    switch( op )
+    {
+        case BENCH_COMPUTE_MIC:
+            LoRaMacComputeMicCtx( &BenchCryptoCtx, BenchInput, size, AppSKey, DevAddr, UP_LINK, BenchCounter++, &mic );
+            break;
+        case BENCH_PAYLOAD_ENCRYPT:
+            LoRaMacPayloadEncryptCtx( &BenchCryptoCtx, BenchInput, size, AppSKey, DevAddr, UP_LINK, BenchCounter++, BenchOutput );
+            break;
+        case BENCH_PAYLOAD_DECRYPT:
+            LoRaMacPayloadDecryptCtx( &BenchCryptoCtx, BenchInput, size, AppSKey, DevAddr, DOWN_LINK, BenchCounter++, BenchOutput );
+            break;
+        case BENCH_JOIN_COMPUTE_MIC:
+            LoRaMacJoinComputeMicCtx( &BenchCryptoCtx, BenchInput, size, AppSKey, &mic );
+            break;
+        case BENCH_TIME_ON_AIR:
+            Radio.TimeOnAir( BenchModem, size );
+            break;
+        default:
+            break;
+    }
+}
+
+/*!
+ * \brief Times an operation and prints the result line
+ *
+ * \param [IN] op   Operation
+ * \param [IN] name Operation name
+ * \param [IN] size Payload size
+ */
+static void BenchMeasure( BenchOp_t op, const char *name, uint8_t size )
+{
+    uint32_t start;
+    uint32_t cycles;
+
+    BenchRun( op, size );
+    start = ProfileGetCycles( );
+    for( uint8_t i = 0; i < BENCH_ITERATIONS; i++ )
+    {
+        BenchRun( op, size );
+    }
+    cycles = ProfileGetElapsed( start ) / BENCH_ITERATIONS;
+    printf( "bench,%s,%u,%u,%u\n", name, size, cycles, ( uint32_t )( ( ( uint64_t )cycles * 1000000000 ) / SystemCoreClock ) );
+}
+
+int main( void )
+{
+    LoRaMacPrimitives_t primitives;
+    SimRadioHandlers_t handlers;
+    MibRequestConfirm_t mibReq;
+    McpsReq_t mcpsReq;
+    uint8_t payload[BENCH_UP_SIZE];
+    uint32_t failures = 0;
+    uint32_t cycles;
+    const ProfileStats_t *stats;
+
+    failures += CheckCryptoCtx( );
+    srand1( 1 );
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    handlers.Transmit = OnTransmit;
+    handlers.Receive = OnReceive;
+    handlers.Random = NULL;
+    MacSimInit( &primitives, &handlers );
+    MacSimActivate( DevAddr, NwkSKey, AppSKey );
+    LoRaMacTestSetDutyCycleOn( false );
+
+    mibReq.Type = MIB_ADR;
+    mibReq.Param.AdrEnable = false;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+    mibReq.Type = MIB_CHANNELS_DATARATE;
+    mibReq.Param.ChannelsDatarate = BENCH_DATARATE;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    memset( payload, 0x5A, sizeof( payload ) );
+    ProfileInit( );
+    for( uint32_t i = 0; i < BENCH_NB_FRAMES; i++ )
+    {
+        mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = BENCH_PORT;
+        mcpsReq.Req.Unconfirmed.fBuffer = payload;
+        mcpsReq.Req.Unconfirmed.fBufferSize = sizeof( payload );
+        mcpsReq.Req.Unconfirmed.Datarate = BENCH_DATARATE;
+        if( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK )
+        {
+            failures++;
+        }
+        // RX1 opens after one second, the downlink ends the transaction
+        MacSimRun( TimerGetCurrentTime( ) + 3000 );
+    }
+
+    // Every uplink after the first one answers the MAC commands
+    if( ( NbUplinks != BENCH_NB_FRAMES ) || ( NbConfirms != BENCH_NB_FRAMES ) ||
+        ( NbDownlinks != BENCH_NB_FRAMES ) || ( NbUplinksWithFOpts != BENCH_NB_FRAMES - 1 ) )
+    {
+        failures++;
+    }
+    fprintf( stderr, "mac bench %s: %u uplinks, %u with FOpts, %u frequency changes, %u downlinks\n", BENCH_BAND,
+             NbUplinks, NbUplinksWithFOpts, NbChannels, NbDownlinks );
+
+    printf( "bench,operation,size,cycles,ns\n" );
+    stats = ProfileGetStats( );
+    for( uint8_t i = 0; i < BENCH_NB_REGIONS; i++ )
+    {
+        const ProfileStats_t *s = &stats[BenchRegions[i].Region];
+
+        if( s->Count == 0 )
+        {
+            failures++;
+            continue;
+        }
+        // Mean over the MAC run
+        cycles = ( uint32_t )( s->Total / s->Count );
+        printf( "bench,%s,%u,%u,%u\n", BenchRegions[i].Name, BenchRegions[i].Size, cycles,
+                ( uint32_t )( ( ( uint64_t )cycles * 1000000000 ) / SystemCoreClock ) );
+    }
+
+    for( uint8_t i = 0; i < BENCH_MAX_SIZE; i++ )
+    {
+        BenchInput[i] = i;
+    }
+    for( uint16_t size = 1; size <= BENCH_MAX_SIZE; size++ )
+    {
+        BenchMeasure( BENCH_PAYLOAD_ENCRYPT, "LoRaMacPayloadEncrypt", size );
+    }
+    for( uint16_t size = 1; size <= BENCH_MAX_SIZE; size++ )
+    {
+        BenchMeasure( BENCH_PAYLOAD_DECRYPT, "LoRaMacPayloadDecrypt", size );
+    }
+    for( uint8_t i = 0; i < BENCH_NB_SIZES; i++ )
+    {
+        BenchMeasure( BENCH_COMPUTE_MIC, "LoRaMacComputeMic", BenchSizes[i] );
+    }
+    for( uint8_t i = 0; i < BENCH_NB_SIZES; i++ )
+    {
+        BenchMeasure( BENCH_JOIN_COMPUTE_MIC, "LoRaMacJoinComputeMic", BenchSizes[i] );
+    }
+
+    // Settings of the MAC layer uplinks, the modem is not reached
+    for( uint8_t t = 0; t < BENCH_NB_TIME_ON_AIR; t++ )
+    {
+        BenchModem = BenchTimeOnAir[t].Modem;
+        if( BenchTimeOnAir[t].Modem == MODEM_FSK )
+        {
+            Radio.SetTxConfig( MODEM_FSK, 14, 25e3, 0, BenchTimeOnAir[t].Datarate, 0, 5, false, true, 0, 0, false, 3e3 );
+        }
+        else
+        {
+            Radio.SetTxConfig( MODEM_LORA, 14, 0, BenchTimeOnAir[t].Bandwidth, BenchTimeOnAir[t].Datarate, 1, 8, false, true, 0, 0, false, 3e3 );
+        }
+        for( uint8_t i = 0; i < BENCH_NB_SIZES; i++ )
+        {
+            BenchMeasure( BENCH_TIME_ON_AIR, BenchTimeOnAir[t].Name, BenchSizes[i] );
+        }
+    }
+
+    fflush( stdout );
+    fprintf( stderr, "mac bench %s: %u failures\n", BENCH_BAND, failures );
+    return ( failures == 0 ) ? 0 : 1;
+}
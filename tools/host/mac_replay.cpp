@@ -0,0 +1,674 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Replays a capture of the MAC inputs on the MAC layer built for
+             the host
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdlib.h>
+#include "mac_replay.h"
+#include "LoRaMacTest.h"
+
+/*!
+ * Capture record read from the stream
+ */
+typedef struct sMacReplayRecord
+{
+    uint8_t Type;
+    /*!
+     * Capture time [ms]
+     */
+    TimerTime_t Time;
+    const uint8_t *Data;
+    uint16_t Size;
+}MacReplayRecord_t;
+
+/*!
+ * Frame sent by the replayed MAC, waiting for its captured frame
+ */
+typedef struct sMacReplayTxFrame
+{
+    uint32_t Frequency;
+    uint8_t Datarate;
+    uint8_t Bandwidth;
+    uint8_t Payload[255];
+    uint8_t Size;
+}MacReplayTxFrame_t;
+
+#define MAC_REPLAY_MAX_TX_FRAMES                    4
+
+static MacReplayRecord_t Records[MAC_REPLAY_MAX_RECORDS];
+static uint32_t NbRecords = 0;
+
+/*!
+ * The inputs read by the MAC must follow the current event and precede the
+ * next one
+ */
+static uint32_t NextEvent = 0;
+
+/*!
+ * Next record searched for each input type
+ */
+static uint32_t TimeCursor = 0;
+static uint32_t RandomCursor = 0;
+static uint32_t BatteryCursor = 0;
+
+static MacReplayTxFrame_t TxFrames[MAC_REPLAY_MAX_TX_FRAMES];
+static uint8_t NbTxFrames = 0;
+
+/*!
+ * The sent frames are only compared when the air frames are captured
+ */
+static bool IsAirCaptured = false;
+
+static MacReplayStats_t *Stats = NULL;
+
+/*!
+ * Buffers of the API requests parameters passed by pointer. The MAC keeps
+ * the join identifiers pointers
+ */
+static uint8_t DevEui[8];
+static uint8_t AppEui[8];
+static uint8_t AppKey[16];
+static uint8_t Key[16];
+static uint16_t ChannelsMask[6];
+static LoRaMacEnergyTable_t EnergyTable;
+static uint8_t Payload[CAPTURE_MAX_DATA_SIZE];
+
+static uint32_t ReadLe( const uint8_t *data, uint8_t size )
+{
+    uint32_t value = 0;
+
+    while( size-- > 0 )
+    {
+        value = ( value << 8 ) | data[size];
+    }
+    return value;
+}
+
+static bool IsEvent( uint8_t type )
+{
+    switch( type )
+    {
+        case CAPTURE_TIME:
+        case CAPTURE_RANDOM:
+        case CAPTURE_BATTERY_LEVEL:
+        case CAPTURE_AIR_TX:
+        case CAPTURE_AIR_RX:
+        case CAPTURE_RECORD_DROPPED:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/*!
+ * \brief Reads the capture records of the stream. The damaged frames are
+ *        skipped
+ */
+static void MacReplayParse( const uint8_t *stream, uint32_t size )
+{
+    uint32_t i = 0;
+    uint32_t previous = 0;
+    uint64_t time = 0;
+
+    NbRecords = 0;
+    while( ( i + DEBUG_FRAME_HEADER_SIZE <= size ) && ( NbRecords < MAC_REPLAY_MAX_RECORDS ) )
+    {
+        uint8_t type = stream[i + 1];
+        uint16_t length = stream[i + 2] | ( stream[i + 3] << 8 );
+        uint32_t end = i + DEBUG_FRAME_HEADER_SIZE + length;
+        const uint8_t *payload = stream + i + DEBUG_FRAME_HEADER_SIZE;
+        uint32_t us = 0;
+
+        if( ( stream[i] != DEBUG_FRAME_SYNC ) || ( length > CAPTURE_PAYLOAD_SIZE( CAPTURE_MAX_DATA_SIZE ) ) ||
+            ( end + 2 > size ) ||
+            ( DebugFrameCrc( 0xFFFF, stream + i + 1, DEBUG_FRAME_HEADER_SIZE - 1 + length ) != ( stream[end] | ( stream[end + 1] << 8 ) ) ) )
+        {
+            i++;
+            continue;
+        }
+        i = end + 2;
+        if( ( type != DEBUG_FRAME_CAPTURE ) || ( length < CAPTURE_PAYLOAD_SIZE( 0 ) ) )
+        {
+            continue;
+        }
+
+        // The microsecond timestamps wrap around every 71 minutes. The
+        // records may be a few microseconds out of order
+        us = ReadLe( payload + 1, 4 );
+        if( NbRecords == 0 )
+        {
+            time = us;
+        }
+        else
+        {
+            time += ( int32_t )( us - previous );
+        }
+        previous = us;
+
+        Records[NbRecords].Type = payload[0];
+        Records[NbRecords].Time = ( TimerTime_t )( time / 1000 );
+        Records[NbRecords].Data = payload + CAPTURE_PAYLOAD_SIZE( 0 );
+        Records[NbRecords].Size = length - CAPTURE_PAYLOAD_SIZE( 0 );
+        NbRecords++;
+    }
+}
+
+static uint32_t MacReplayNextEvent( uint32_t from )
+{
+    while( ( from < NbRecords ) && ( IsEvent( Records[from].Type ) == false ) )
+    {
+        from++;
+    }
+    return from;
+}
+
+/*!
+ * \brief Gets the next captured input of a type
+ *
+ * \param [IN]    type   Input record type
+ * \param [INOUT] cursor Next record searched
+ *
+ * \retval record Input record, NULL when there is none before the next event
+ */
+static const MacReplayRecord_t* MacReplayPop( uint8_t type, uint32_t *cursor )
+{
+    uint32_t i = *cursor;
+
+    while( ( i < NbRecords ) && ( Records[i].Type != type ) )
+    {
+        i++;
+    }
+    if( i >= NextEvent )
+    {
+        // Read by the MAC, not captured at this point
+        Stats->NbDivergences++;
+        return NULL;
+    }
+    *cursor = i + 1;
+    return &Records[i];
+}
+
+/*!
+ * \brief Counts the inputs of a type which were captured before a record and
+ *        not read by the MAC
+ */
+static void MacReplaySkip( uint8_t type, uint32_t *cursor, uint32_t index )
+{
+    while( *cursor < index )
+    {
+        if( Records[*cursor].Type == type )
+        {
+            Stats->NbDivergences++;
+        }
+        ( *cursor )++;
+    }
+}
+
+static TimerTime_t MacReplayGetTime( void )
+{
+    const MacReplayRecord_t *record = MacReplayPop( CAPTURE_TIME, &TimeCursor );
+
+    return ( record != NULL ) ? ReadLe( record->Data, 4 ) : TimerGetSimulatedTime( );
+}
+
+static uint32_t MacReplayRandom( void )
+{
+    const MacReplayRecord_t *record = MacReplayPop( CAPTURE_RANDOM, &RandomCursor );
+
+    return ( record != NULL ) ? ReadLe( record->Data, MIN( record->Size, 4 ) ) : ( uint32_t )rand( );
+}
+
+static uint8_t MacReplayGetBatteryLevel( void )
+{
+    const MacReplayRecord_t *record = MacReplayPop( CAPTURE_BATTERY_LEVEL, &BatteryCursor );
+
+    return ( record != NULL ) ? record->Data[0] : BoardGetBatteryLevel( );
+}
+
+static void MacReplayTransmit( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size, uint32_t timeOnAir )
+{
+    MacReplayTxFrame_t *frame = NULL;
+
+    if( IsAirCaptured == false )
+    {
+        return;
+    }
+    if( NbTxFrames >= MAC_REPLAY_MAX_TX_FRAMES )
+    {
+        // Sent frames not captured
+        Stats->NbDivergences++;
+        return;
+    }
+    frame = &TxFrames[NbTxFrames++];
+    frame->Frequency = settings->Frequency;
+    frame->Datarate = settings->Datarate;
+    frame->Bandwidth = settings->Bandwidth;
+    memcpy( frame->Payload, payload, size );
+    frame->Size = size;
+}
+
+/*!
+ * \brief Compares the first frame sent by the replayed MAC with a captured
+ *        CAPTURE_AIR_TX record
+ */
+static void MacReplayCheckTx( const MacReplayRecord_t *record )
+{
+    const MacReplayTxFrame_t *frame = &TxFrames[0];
+
+    if( NbTxFrames == 0 )
+    {
+        Stats->NbDivergences++;
+        return;
+    }
+    Stats->NbTxFrames++;
+    if( ( record->Size < 9 ) || ( ReadLe( record->Data, 4 ) != frame->Frequency ) ||
+        ( record->Data[4] != frame->Datarate ) || ( record->Data[5] != frame->Bandwidth ) ||
+        ( ( uint16_t )( record->Size - 9 ) != frame->Size ) || ( memcmp( record->Data + 9, frame->Payload, frame->Size ) != 0 ) )
+    {
+        Stats->NbDivergences++;
+    }
+    NbTxFrames--;
+    memmove( TxFrames, TxFrames + 1, NbTxFrames * sizeof( MacReplayTxFrame_t ) );
+}
+
+static void MacReplayMcps( const MacReplayRecord_t *record )
+{
+    McpsReq_t mcpsReq;
+    uint16_t size = 0;
+
+    if( record->Size < 4 )
+    {
+        return;
+    }
+    size = record->Size - 4;
+    memcpy( Payload, record->Data + 4, size );
+
+    memset( &mcpsReq, 0, sizeof( mcpsReq ) );
+    mcpsReq.Type = ( Mcps_t )record->Data[0];
+    switch( mcpsReq.Type )
+    {
+        case MCPS_UNCONFIRMED:
+            mcpsReq.Req.Unconfirmed.fPort = record->Data[1];
+            mcpsReq.Req.Unconfirmed.Datarate = record->Data[2];
+            mcpsReq.Req.Unconfirmed.fBuffer = ( size > 0 ) ? Payload : NULL;
+            mcpsReq.Req.Unconfirmed.fBufferSize = size;
+            break;
+        case MCPS_CONFIRMED:
+            mcpsReq.Req.Confirmed.fPort = record->Data[1];
+            mcpsReq.Req.Confirmed.Datarate = record->Data[2];
+            mcpsReq.Req.Confirmed.NbTrials = record->Data[3];
+            mcpsReq.Req.Confirmed.fBuffer = ( size > 0 ) ? Payload : NULL;
+            mcpsReq.Req.Confirmed.fBufferSize = size;
+            break;
+        case MCPS_PROPRIETARY:
+            mcpsReq.Req.Proprietary.Datarate = record->Data[2];
+            mcpsReq.Req.Proprietary.fBuffer = ( size > 0 ) ? Payload : NULL;
+            mcpsReq.Req.Proprietary.fBufferSize = size;
+            break;
+        default:
+            break;
+    }
+    LoRaMacMcpsRequest( &mcpsReq );
+}
+
+static void MacReplayMlme( const MacReplayRecord_t *record )
+{
+    MlmeReq_t mlmeReq;
+    const uint8_t *data = record->Data;
+
+    if( record->Size < 1 )
+    {
+        return;
+    }
+    memset( &mlmeReq, 0, sizeof( mlmeReq ) );
+    mlmeReq.Type = ( Mlme_t )data[0];
+    switch( mlmeReq.Type )
+    {
+        case MLME_JOIN:
+            if( record->Size >= 34 )
+            {
+                memcpy( DevEui, data + 1, 8 );
+                memcpy( AppEui, data + 9, 8 );
+                memcpy( AppKey, data + 17, 16 );
+                mlmeReq.Req.Join.DevEui = DevEui;
+                mlmeReq.Req.Join.AppEui = AppEui;
+                mlmeReq.Req.Join.AppKey = AppKey;
+                mlmeReq.Req.Join.NbTrials = data[33];
+            }
+            break;
+        case MLME_TXCW:
+        case MLME_TXCW_1:
+            if( record->Size >= 3 )
+            {
+                mlmeReq.Req.TxCw.Timeout = ReadLe( data + 1, 2 );
+            }
+            if( record->Size >= 8 )
+            {
+                mlmeReq.Req.TxCw.Frequency = ReadLe( data + 3, 4 );
+                mlmeReq.Req.TxCw.Power = data[7];
+            }
+            break;
+        case MLME_PING_SLOT_INFO:
+            if( record->Size >= 2 )
+            {
+                mlmeReq.Req.PingSlotInfo.Periodicity = data[1];
+            }
+            break;
+        default:
+            break;
+    }
+    LoRaMacMlmeRequest( &mlmeReq );
+}
+
+static void MacReplayMibSet( const MacReplayRecord_t *record )
+{
+    MibRequestConfirm_t mibReq;
+    const uint8_t *data = record->Data + 1;
+    uint16_t size = 0;
+
+    if( record->Size < 1 )
+    {
+        return;
+    }
+    size = record->Size - 1;
+    memset( &mibReq, 0, sizeof( mibReq ) );
+    mibReq.Type = ( Mib_t )record->Data[0];
+    switch( mibReq.Type )
+    {
+        case MIB_DEVICE_CLASS:
+            mibReq.Param.Class = ( DeviceClass_t )( ( size > 0 ) ? data[0] : 0 );
+            break;
+        case MIB_REGION:
+            mibReq.Param.Region = ( LoRaMacRegion_t )( ( size > 0 ) ? data[0] : 0 );
+            break;
+        case MIB_NWK_SKEY:
+        case MIB_APP_SKEY:
+            if( size >= sizeof( Key ) )
+            {
+                memcpy( Key, data, sizeof( Key ) );
+                mibReq.Param.NwkSKey = ( mibReq.Type == MIB_NWK_SKEY ) ? Key : NULL;
+                mibReq.Param.AppSKey = ( mibReq.Type == MIB_APP_SKEY ) ? Key : mibReq.Param.NwkSKey;
+            }
+            break;
+        case MIB_RX2_CHANNEL:
+        case MIB_RX2_DEFAULT_CHANNEL:
+            if( size >= 5 )
+            {
+                mibReq.Param.Rx2Channel.Frequency = ReadLe( data, 4 );
+                mibReq.Param.Rx2Channel.Datarate = data[4];
+            }
+            break;
+        case MIB_CHANNELS_MASK:
+        case MIB_CHANNELS_DEFAULT_MASK:
+            if( size > 0 )
+            {
+                memset( ChannelsMask, 0, sizeof( ChannelsMask ) );
+                memcpy( ChannelsMask, data, MIN( size, sizeof( ChannelsMask ) ) );
+                mibReq.Param.ChannelsMask = ChannelsMask;
+            }
+            break;
+        case MIB_ENERGY_TABLE:
+            if( size >= sizeof( EnergyTable ) )
+            {
+                memcpy( &EnergyTable, data, sizeof( EnergyTable ) );
+                mibReq.Param.EnergyTable = &EnergyTable;
+            }
+            break;
+        default:
+            // Scalar parameters, captured as their union member
+            memcpy( &mibReq.Param, data, MIN( size, sizeof( uint32_t ) ) );
+            break;
+    }
+    LoRaMacMibSetRequestConfirm( &mibReq );
+}
+
+static void MacReplaySessionRestore( const MacReplayRecord_t *record )
+{
+    LoRaMacSession_t session;
+    MibRequestConfirm_t mibReq;
+
+    memset( &session, 0, sizeof( session ) );
+    if( record->Size < sizeof( session ) )
+    {
+        // The fixed channels of the band are not captured
+        mibReq.Type = MIB_CHANNELS;
+        LoRaMacMibGetRequestConfirm( &mibReq );
+        memcpy( session.Channels, mibReq.Param.ChannelList, sizeof( session.Channels ) );
+    }
+    memcpy( &session, record->Data, MIN( record->Size, sizeof( session ) ) );
+    LoRaMacSessionRestore( &session );
+}
+
+static void MacReplayTest( const MacReplayRecord_t *record )
+{
+    uint16_t value = 0;
+
+    if( record->Size < 3 )
+    {
+        return;
+    }
+    value = ReadLe( record->Data + 1, 2 );
+    switch( record->Data[0] )
+    {
+        case CAPTURE_TEST_RX_WINDOWS_ON:
+            LoRaMacTestRxWindowsOn( value != 0 );
+            break;
+        case CAPTURE_TEST_SET_MIC:
+            LoRaMacTestSetMic( value );
+            break;
+        case CAPTURE_TEST_SET_DUTY_CYCLE_ON:
+            LoRaMacTestSetDutyCycleOn( value != 0 );
+            break;
+        case CAPTURE_TEST_SET_CHANNEL:
+            LoRaMacTestSetChannel( value );
+            break;
+        default:
+            break;
+    }
+}
+
+/*!
+ * \brief Raises a captured event again
+ */
+static void MacReplayEvent( const MacReplayRecord_t *record )
+{
+    switch( record->Type )
+    {
+        case CAPTURE_RADIO_TX_DONE:
+            Radio.ReplayTxDone( );
+            break;
+        case CAPTURE_RADIO_TX_TIMEOUT:
+            Radio.ReplayTxTimeout( );
+            break;
+        case CAPTURE_RADIO_RX_DONE:
+            if( record->Size >= 3 )
+            {
+                Radio.ReplayRxDone( record->Data + 3, record->Size - 3, ( int16_t )ReadLe( record->Data, 2 ), ( int8_t )record->Data[2] );
+            }
+            break;
+        case CAPTURE_RADIO_RX_ERROR:
+            Radio.ReplayRxError( );
+            break;
+        case CAPTURE_RADIO_RX_TIMEOUT:
+            Radio.ReplayRxTimeout( );
+            break;
+        case CAPTURE_RADIO_VALID_HEADER:
+            Radio.ReplayValidHeader( );
+            break;
+        case CAPTURE_TIMER_FIRE:
+            if( ( record->Size < 4 ) || ( TimerFire( ReadLe( record->Data, 4 ), MAC_REPLAY_TIMER_TOLERANCE ) == false ) )
+            {
+                Stats->NbAppTimers++;
+            }
+            break;
+        case CAPTURE_MCPS_REQUEST:
+            MacReplayMcps( record );
+            break;
+        case CAPTURE_MLME_REQUEST:
+            MacReplayMlme( record );
+            break;
+        case CAPTURE_MIB_SET:
+            MacReplayMibSet( record );
+            break;
+        case CAPTURE_SESSION_RESTORE:
+            MacReplaySessionRestore( record );
+            break;
+        case CAPTURE_CHANNEL_ADD:
+            if( record->Size >= 6 )
+            {
+                ChannelParams_t params;
+
+                memset( &params, 0, sizeof( params ) );
+                params.Frequency = ReadLe( record->Data + 1, 4 );
+                params.DrRange.Value = ( int8_t )record->Data[5];
+                LoRaMacChannelAdd( record->Data[0], params );
+            }
+            break;
+        case CAPTURE_CHANNEL_REMOVE:
+            if( record->Size >= 1 )
+            {
+                LoRaMacChannelRemove( record->Data[0] );
+            }
+            break;
+        case CAPTURE_MULTICAST_LINK:
+            if( record->Size >= 36 )
+            {
+                MulticastParams_t channel;
+
+                memset( &channel, 0, sizeof( channel ) );
+                channel.Address = ReadLe( record->Data, 4 );
+                memcpy( channel.NwkSKey, record->Data + 4, 16 );
+                memcpy( channel.AppSKey, record->Data + 20, 16 );
+                LoRaMacMulticastChannelLink( &channel );
+            }
+            break;
+        case CAPTURE_MULTICAST_UNLINK:
+            if( record->Size >= 4 )
+            {
+                LoRaMacMulticastChannelUnlink( ReadLe( record->Data, 4 ) );
+            }
+            break;
+        case CAPTURE_TEST_REQUEST:
+            MacReplayTest( record );
+            break;
+        default:
+            // Unknown record, from a newer firmware
+            Stats->NbDivergences++;
+            break;
+    }
+}
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+bool MacReplayRun( const uint8_t *stream, uint32_t size, MacReplayStats_t *stats )
+{
+    static LoRaMacPrimitives_t primitives;
+    static LoRaMacCallback_t callbacks;
+    static SimRadioHandlers_t handlers;
+    bool status = true;
+
+    memset( stats, 0, sizeof( MacReplayStats_t ) );
+    Stats = stats;
+    MacReplayParse( stream, size );
+    stats->NbRecords = NbRecords;
+    if( NbRecords == 0 )
+    {
+        return false;
+    }
+    IsAirCaptured = false;
+    for( uint32_t i = 0; i < NbRecords; i++ )
+    {
+        if( Records[i].Type == CAPTURE_AIR_TX )
+        {
+            IsAirCaptured = true;
+        }
+    }
+
+    TimeCursor = 0;
+    RandomCursor = 0;
+    BatteryCursor = 0;
+    NbTxFrames = 0;
+    NextEvent = MacReplayNextEvent( 0 );
+
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    callbacks.GetBatteryLevel = MacReplayGetBatteryLevel;
+    handlers.Transmit = MacReplayTransmit;
+    handlers.Receive = NULL;
+    handlers.Random = MacReplayRandom;
+
+    // The initialization reads the inputs captured before the first event
+    TimerTimeCounterInit( );
+    TimerSetSimulatedTime( Records[0].Time );
+    TimerSetTimeSource( MacReplayGetTime );
+    Radio.SetHandlers( &handlers );
+    Radio.SetReplay( true );
+    LoRaMacInitialization( &primitives, &callbacks );
+
+    for( uint32_t i = 0; i < NbRecords; i++ )
+    {
+        const MacReplayRecord_t *record = &Records[i];
+
+        if( record->Type == CAPTURE_RECORD_DROPPED )
+        {
+            stats->NbDropped = ReadLe( record->Data, MIN( record->Size, 2 ) );
+            status = false;
+            break;
+        }
+        if( record->Type == CAPTURE_AIR_TX )
+        {
+            MacReplayCheckTx( record );
+        }
+        if( IsEvent( record->Type ) == false )
+        {
+            continue;
+        }
+
+        MacReplaySkip( CAPTURE_TIME, &TimeCursor, i );
+        MacReplaySkip( CAPTURE_RANDOM, &RandomCursor, i );
+        MacReplaySkip( CAPTURE_BATTERY_LEVEL, &BatteryCursor, i );
+        NextEvent = MacReplayNextEvent( i + 1 );
+        TimerSetSimulatedTime( record->Time );
+        MacReplayEvent( record );
+        stats->NbEvents++;
+    }
+
+    if( status == true )
+    {
+        MacReplaySkip( CAPTURE_TIME, &TimeCursor, NbRecords );
+        MacReplaySkip( CAPTURE_RANDOM, &RandomCursor, NbRecords );
+        MacReplaySkip( CAPTURE_BATTERY_LEVEL, &BatteryCursor, NbRecords );
+        // Sent frames not captured
+        stats->NbDivergences += NbTxFrames;
+    }
+
+    Radio.SetReplay( false );
+    TimerSetTimeSource( NULL );
+    return status;
+}
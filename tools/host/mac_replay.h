@@ -0,0 +1,87 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Replays a capture of the MAC inputs on the MAC layer built for
+             the host. The captured radio events, timer expiries and API
+             requests are raised again, the MAC reads the captured time,
+             random numbers and battery levels. The replay diverges when the
+             MAC does not consume the captured inputs between the same events
+             or does not send the captured frames
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __MAC_REPLAY_H__
+#define __MAC_REPLAY_H__
+
+#include "board.h"
+#include "LoRaMac.h"
+
+/*!
+ * Maximum number of records of a capture
+ */
+#define MAC_REPLAY_MAX_RECORDS                      32768
+
+/*!
+ * Maximum difference between a captured timer expiry and the expiry of the
+ * replayed MAC timer, when the timer callback addresses differ [ms]
+ */
+#define MAC_REPLAY_TIMER_TOLERANCE                  2
+
+/*!
+ * Replay results
+ */
+typedef struct sMacReplayStats
+{
+    /*!
+     * Capture records read from the stream
+     */
+    uint32_t NbRecords;
+    /*!
+     * Radio events, timer expiries and API requests raised again
+     */
+    uint32_t NbEvents;
+    /*!
+     * Captured timer expiries matching no MAC timer: application timers
+     */
+    uint32_t NbAppTimers;
+    /*!
+     * Sent frames compared with the captured ones
+     */
+    uint32_t NbTxFrames;
+    /*!
+     * Records lost by the capture. The replay stops at the first loss
+     */
+    uint32_t NbDropped;
+    /*!
+     * Inputs not consumed, or consumed by the wrong event, and sent frames
+     * differing from the captured ones
+     */
+    uint32_t NbDivergences;
+}MacReplayStats_t;
+
+/*!
+ * \brief Replays a capture on the MAC layer. The MAC layer must not have been
+ *        initialized: a process replays a single capture
+ *
+ * \remark The capture must start at the MAC initialization and be made on a
+ *         build of the same band. A MAC function interrupted by a MAC
+ *         interrupt on the target is not replayed in the same order: its
+ *         inputs are then reported as divergences
+ *
+ * \param [IN]  stream Debug frames stream, as read on the debug UART. The
+ *                     trace and log frames are skipped
+ * \param [IN]  size   Stream size
+ * \param [OUT] stats  Replay results
+ *
+ * \retval status [true: capture replayed, false: no record or records lost]
+ */
+bool MacReplayRun( const uint8_t *stream, uint32_t size, MacReplayStats_t *stats );
+
+#endif // __MAC_REPLAY_H__
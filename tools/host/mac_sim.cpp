@@ -0,0 +1,89 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Runs the MAC layer on the simulated radio and time
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mac_sim.h"
+#include "LoRaMacCrypto.h"
+
+static LoRaMacCallback_t MacSimCallbacks;
+
+void MacSimInit( LoRaMacPrimitives_t *primitives, const SimRadioHandlers_t *handlers )
+{
+    TimerTimeCounterInit( );
+    Radio.SetHandlers( handlers );
+    MacSimCallbacks.GetBatteryLevel = BoardGetBatteryLevel;
+    LoRaMacInitialization( primitives, &MacSimCallbacks );
+}
+
+void MacSimActivate( uint32_t devAddr, uint8_t *nwkSKey, uint8_t *appSKey )
+{
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_NET_ID;
+    mibReq.Param.NetID = 0;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_DEV_ADDR;
+    mibReq.Param.DevAddr = devAddr;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_NWK_SKEY;
+    mibReq.Param.NwkSKey = nwkSKey;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_APP_SKEY;
+    mibReq.Param.AppSKey = appSKey;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    mibReq.Type = MIB_NETWORK_JOINED;
+    mibReq.Param.IsNetworkJoined = true;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+}
+
+void MacSimRun( TimerTime_t time )
+{
+    TimerAdvance( time );
+}
+
+uint8_t MacSimBuildDown( uint8_t *buffer, LoRaMacFrameType_t mType, uint32_t devAddr, uint8_t fCtrl, uint32_t fCnt,
+                         const uint8_t *fOpts, uint8_t fOptsLen, uint8_t port, const uint8_t *payload, uint8_t size,
+                         const uint8_t *nwkSKey, const uint8_t *appSKey )
+{
+    uint8_t length = 0;
+    uint32_t mic = 0;
+
+    buffer[length++] = ( uint8_t )( mType << 5 );
+    buffer[length++] = devAddr & 0xFF;
+    buffer[length++] = ( devAddr >> 8 ) & 0xFF;
+    buffer[length++] = ( devAddr >> 16 ) & 0xFF;
+    buffer[length++] = ( devAddr >> 24 ) & 0xFF;
+    buffer[length++] = ( fCtrl & 0xF0 ) | ( fOptsLen & 0x0F );
+    buffer[length++] = fCnt & 0xFF;
+    buffer[length++] = ( fCnt >> 8 ) & 0xFF;
+    memcpy1( buffer + length, fOpts, fOptsLen );
+    length += fOptsLen;
+
+    if( port != 0xFF )
+    {
+        buffer[length++] = port;
+        LoRaMacPayloadEncrypt( payload, size, ( port == 0 ) ? nwkSKey : appSKey, devAddr, DOWN_LINK, fCnt, buffer + length );
+        length += size;
+    }
+
+    LoRaMacComputeMic( buffer, length, nwkSKey, devAddr, DOWN_LINK, fCnt, &mic );
+    buffer[length++] = mic & 0xFF;
+    buffer[length++] = ( mic >> 8 ) & 0xFF;
+    buffer[length++] = ( mic >> 16 ) & 0xFF;
+    buffer[length++] = ( mic >> 24 ) & 0xFF;
+    return length;
+}
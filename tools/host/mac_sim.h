@@ -0,0 +1,69 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Runs the MAC layer on the simulated radio and time. Builds the
+             network frames with the MAC crypto functions
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __MAC_SIM_H__
+#define __MAC_SIM_H__
+
+#include "board.h"
+#include "LoRaMac.h"
+
+/*!
+ * \brief Resets the simulated time and initializes the MAC layer on the
+ *        simulated radio
+ *
+ * \param [IN] primitives MAC primitives of the test
+ * \param [IN] handlers   Radio frame handlers of the test
+ */
+void MacSimInit( LoRaMacPrimitives_t *primitives, const SimRadioHandlers_t *handlers );
+
+/*!
+ * \brief Activates the device by personalization
+ *
+ * \param [IN] devAddr Device address
+ * \param [IN] nwkSKey Network session key
+ * \param [IN] appSKey Application session key
+ */
+void MacSimActivate( uint32_t devAddr, uint8_t *nwkSKey, uint8_t *appSKey );
+
+/*!
+ * \brief Runs the MAC layer until the given simulated time
+ *
+ * \param [IN] time Simulated time [ms]
+ */
+void MacSimRun( TimerTime_t time );
+
+/*!
+ * \brief Builds a data frame sent by the network
+ *
+ * \param [OUT] buffer   Frame
+ * \param [IN]  mType    FRAME_TYPE_DATA_UNCONFIRMED_DOWN or
+ *                       FRAME_TYPE_DATA_CONFIRMED_DOWN
+ * \param [IN]  devAddr  Device address
+ * \param [IN]  fCtrl    Frame control byte, FOptsLen excluded
+ * \param [IN]  fCnt     Downlink counter
+ * \param [IN]  fOpts    MAC commands sent in FOpts
+ * \param [IN]  fOptsLen Size of the MAC commands in FOpts
+ * \param [IN]  port     Frame port. 0xFF: no port nor payload
+ * \param [IN]  payload  Frame payload, encrypted with nwkSKey on port 0
+ * \param [IN]  size     Frame payload size
+ * \param [IN]  nwkSKey  Network session key
+ * \param [IN]  appSKey  Application session key
+ * \retval size          Frame size
+ */
+uint8_t MacSimBuildDown( uint8_t *buffer, LoRaMacFrameType_t mType, uint32_t devAddr, uint8_t fCtrl, uint32_t fCnt,
+                         const uint8_t *fOpts, uint8_t fOptsLen, uint8_t port, const uint8_t *payload, uint8_t size,
+                         const uint8_t *nwkSKey, const uint8_t *appSKey );
+
+#endif // __MAC_SIM_H__
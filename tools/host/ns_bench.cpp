@@ -0,0 +1,186 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: End to end MAC throughput benchmark against the network server
+             stand-in on the simulated radio link. The device joins, then
+             sends confirmed uplinks acknowledged in RX1, every tenth one
+             answering scripted MAC commands. Reports the transactions run
+             per host second and the simulated transaction latency. EU868
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <time.h>
+#include "mac_sim.h"
+#include "ns_sim.h"
+#include "LoRaMacTest.h"
+
+#define BENCH_NB_TRANSACTIONS                       20000
+#define BENCH_COMMANDS_PERIOD                       10
+#define BENCH_PORT                                  2
+
+static uint8_t DevEui[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02 };
+static uint8_t AppEui[8] = { 0x70, 0xB3, 0xD5, 0x7E, 0xF0, 0x00, 0x00, 0x01 };
+static uint8_t AppKey[16] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB, 0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+
+static const NsSimParams_t NsParams =
+{
+    DevEui, AppEui, AppKey,
+    0x000013,                                       // NetID
+    0x26016789,                                     // DevAddr
+    0,                                              // Rx1DrOffset
+    DR_0,                                           // Rx2Datarate
+    1,                                              // RxDelay
+    869525000,                                      // Rx2Frequency
+    { 867100000, 867300000, 867500000, 867700000, 867900000 },
+};
+
+/*!
+ * Scripted MAC commands: LinkADRReq keeping DR_5 on the 8 channels,
+ * DutyCycleReq without limit and DevStatusReq
+ */
+static const uint8_t BenchCommands[] =
+{
+    SRV_MAC_LINK_ADR_REQ, ( DR_5 << 4 ) | 1, 0xFF, 0x00, 0x01,
+    SRV_MAC_DUTY_CYCLE_REQ, 0,
+    SRV_MAC_DEV_STATUS_REQ,
+};
+
+static bool MacDone = false;
+static bool MacStatusOk = false;
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+    MacStatusOk = ( mcpsConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK ) && ( mcpsConfirm->AckReceived == true );
+    MacDone = true;
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+    MacStatusOk = mlmeConfirm->Status == LORAMAC_EVENT_INFO_STATUS_OK;
+    MacDone = true;
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+/*!
+ * \brief Runs the MAC layer until the confirmation, by timer expiries
+ *
+ * \retval status [true: confirmed]
+ */
+static bool RunUntilConfirm( void )
+{
+    TimerTime_t expiry = 0;
+
+    while( ( MacDone == false ) && ( TimerGetNextExpiry( &expiry ) == true ) )
+    {
+        TimerAdvance( expiry );
+    }
+    return MacDone;
+}
+
+static double HostTime( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main( void )
+{
+    LoRaMacPrimitives_t primitives;
+    SimRadioHandlers_t handlers;
+    MibRequestConfirm_t mibReq;
+    MlmeReq_t mlmeReq;
+    McpsReq_t mcpsReq;
+    uint8_t payload[16];
+    const NsSimStats_t *stats = NULL;
+    uint32_t failures = 0;
+    uint32_t latency = 0;
+    uint32_t maxLatency = 0;
+    uint64_t totalLatency = 0;
+    double start = 0;
+    double elapsed = 0;
+
+    srand1( 4 );
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    NsSimInit( &NsParams, &handlers );
+    MacSimInit( &primitives, &handlers );
+    LoRaMacTestSetDutyCycleOn( false );
+    stats = NsSimGetStats( );
+
+    mlmeReq.Type = MLME_JOIN;
+    mlmeReq.Req.Join.DevEui = DevEui;
+    mlmeReq.Req.Join.AppEui = AppEui;
+    mlmeReq.Req.Join.AppKey = AppKey;
+    mlmeReq.Req.Join.NbTrials = 1;
+    MacDone = false;
+    if( ( LoRaMacMlmeRequest( &mlmeReq ) != LORAMAC_STATUS_OK ) || ( RunUntilConfirm( ) == false ) || ( MacStatusOk == false ) )
+    {
+        printf( "ns bench: join failed\n" );
+        return 1;
+    }
+    mibReq.Type = MIB_CHANNELS_DATARATE;
+    mibReq.Param.ChannelsDatarate = DR_5;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    memset( payload, 0x5A, sizeof( payload ) );
+    start = HostTime( );
+    // The acknowledgement in RX1 ends the transaction, RX2 is not opened
+    for( uint32_t i = 0; i < BENCH_NB_TRANSACTIONS; i++ )
+    {
+        TimerTime_t requestTime = TimerGetCurrentTime( );
+
+        if( ( i % BENCH_COMMANDS_PERIOD ) == 0 )
+        {
+            NsSimQueueCommand( BenchCommands, sizeof( BenchCommands ) );
+        }
+        mcpsReq.Type = MCPS_CONFIRMED;
+        mcpsReq.Req.Confirmed.fPort = BENCH_PORT;
+        mcpsReq.Req.Confirmed.fBuffer = payload;
+        mcpsReq.Req.Confirmed.fBufferSize = sizeof( payload );
+        mcpsReq.Req.Confirmed.NbTrials = 1;
+        mcpsReq.Req.Confirmed.Datarate = DR_5;
+        MacDone = false;
+        if( ( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK ) || ( RunUntilConfirm( ) == false ) || ( MacStatusOk == false ) )
+        {
+            failures++;
+        }
+        latency = TimerGetCurrentTime( ) - requestTime;
+        totalLatency += latency;
+        maxLatency = ( latency > maxLatency ) ? latency : maxLatency;
+        payload[0]++;
+    }
+    elapsed = HostTime( ) - start;
+
+    // Every uplink after a command downlink answers the three commands
+    if( ( stats->NbAcks != BENCH_NB_TRANSACTIONS ) || ( stats->NbRejected != 0 ) || ( stats->NbMissedWindows != 0 ) ||
+        ( stats->NbCommands[MOTE_MAC_DEV_STATUS_ANS] != BENCH_NB_TRANSACTIONS / BENCH_COMMANDS_PERIOD ) ||
+        ( stats->CommandStatus[MOTE_MAC_LINK_ADR_ANS] != 0x07 ) )
+    {
+        failures++;
+    }
+    printf( "ns bench: %u transactions in %.2f s, %.0f transactions/s\n", BENCH_NB_TRANSACTIONS, elapsed,
+            BENCH_NB_TRANSACTIONS / elapsed );
+    printf( "ns bench: simulated latency mean %u ms, max %u ms, %u uplinks, %u downlinks\n",
+            ( uint32_t )( totalLatency / BENCH_NB_TRANSACTIONS ), maxLatency, stats->NbUplinks, stats->NbDownlinks );
+    printf( "ns bench: %u failures\n", failures );
+    return ( failures == 0 ) ? 0 : 1;
+}
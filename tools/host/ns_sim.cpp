@@ -0,0 +1,449 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Network server stand-in on the simulated radio link. The join
+             accept is encrypted with the AES decryption, the host build
+             compiles it with AES_DEC_PREKEYED
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "ns_sim.h"
+#include "mac_sim.h"
+#include "LoRaMacCrypto.h"
+
+#if defined( USE_BAND_470 ) || defined( USE_BAND_915 ) || defined( USE_BAND_915_HYBRID )
+    #error "The network server stand-in answers RX1 on the uplink channel, EU433, CN780 and EU868 only"
+#endif
+
+#if !defined( AES_DEC_PREKEYED )
+    #error "The join accept encryption needs AES_DEC_PREKEYED"
+#endif
+
+/*!
+ * Join request size, MIC included
+ */
+#define NS_SIM_JOIN_REQUEST_SIZE                    23
+
+/*!
+ * Data frame header size: MHDR, DevAddr, FCtrl and FCnt
+ */
+#define NS_SIM_FRAME_HEADER_SIZE                    8
+
+/*!
+ * LinkCheckAns sent to the LinkCheckReq: demodulation margin [dB] and
+ * number of gateways
+ */
+#define NS_SIM_LINK_CHECK_MARGIN                    20
+#define NS_SIM_LINK_CHECK_GATEWAYS                  1
+
+/*!
+ * Downlink signal quality
+ */
+#define NS_SIM_DOWN_RSSI                            -60
+#define NS_SIM_DOWN_SNR                             8
+
+static const NsSimParams_t *NsSimParams;
+static NsSimStats_t NsSimStats;
+
+/*!
+ * Crypto context of the network server, the MAC layer keeps its own
+ */
+static LoRaMacCryptoCtx_t NsSimCryptoCtx;
+
+/*!
+ * Session state, set by the last join accept
+ */
+static bool NsSimIsJoined = false;
+static uint8_t NsSimNwkSKey[16];
+static uint8_t NsSimAppSKey[16];
+static uint32_t NsSimAppNonce = 0;
+static bool NsSimHasUplink = false;
+static uint32_t NsSimDownLinkCounter = 0;
+static uint32_t NsSimRx2Frequency = 0;
+
+/*!
+ * RX2 frequency of the RXParamSetupReq waiting for its answer. 0: none
+ */
+static uint32_t NsSimPendingRx2Frequency = 0;
+
+/*!
+ * Queued MAC commands and application payload
+ */
+static uint8_t NsSimCommands[NS_SIM_MAX_COMMANDS_SIZE];
+static uint8_t NsSimCommandsSize = 0;
+static uint8_t NsSimData[NS_SIM_MAX_DATA_SIZE];
+static uint8_t NsSimDataSize = 0;
+static uint8_t NsSimDataPort = 0;
+
+/*!
+ * Downlink of the last uplink, sent in the window NsSimDownWindow
+ */
+static uint8_t NsSimWindow = 1;
+static uint8_t NsSimWindowCounter = 0;
+static uint8_t NsSimDownWindow = 0;
+static uint32_t NsSimDownFrequency = 0;
+static uint8_t NsSimDown[255];
+static uint8_t NsSimDownSize = 0;
+
+/*!
+ * \brief Compares an EUI sent least significant byte first with an EUI of
+ *        the parameters
+ */
+static bool NsSimEuiEqual( const uint8_t *frame, const uint8_t *eui )
+{
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        if( frame[i] != eui[7 - i] )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Schedules the downlink in the window selected by NsSimSetWindow
+ */
+static void NsSimScheduleDown( uint32_t uplinkFrequency, uint8_t size )
+{
+    NsSimDownSize = size;
+    NsSimDownWindow = NsSimWindow;
+    NsSimDownFrequency = ( NsSimWindow == 1 ) ? uplinkFrequency : NsSimRx2Frequency;
+}
+
+static void NsSimJoinRequest( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size )
+{
+    aes_context aes;
+    uint16_t devNonce = 0;
+    uint8_t length = 0;
+    uint32_t mic = 0;
+    bool cfList = false;
+
+    if( ( size != NS_SIM_JOIN_REQUEST_SIZE ) || ( NsSimEuiEqual( payload + 1, NsSimParams->AppEui ) == false ) ||
+        ( NsSimEuiEqual( payload + 9, NsSimParams->DevEui ) == false ) )
+    {
+        NsSimStats.NbRejected++;
+        return;
+    }
+    LoRaMacJoinComputeMicCtx( &NsSimCryptoCtx, payload, size - 4, NsSimParams->AppKey, &mic );
+    if( memcmp( &mic, payload + size - 4, 4 ) != 0 )
+    {
+        NsSimStats.NbRejected++;
+        return;
+    }
+    NsSimStats.NbJoinRequests++;
+    devNonce = payload[17] | ( payload[18] << 8 );
+
+    // MHDR | AppNonce | NetID | DevAddr | DLSettings | RxDelay | CFList | MIC
+    NsSimAppNonce++;
+    NsSimDown[length++] = FRAME_TYPE_JOIN_ACCEPT << 5;
+    NsSimDown[length++] = NsSimAppNonce & 0xFF;
+    NsSimDown[length++] = ( NsSimAppNonce >> 8 ) & 0xFF;
+    NsSimDown[length++] = ( NsSimAppNonce >> 16 ) & 0xFF;
+    NsSimDown[length++] = NsSimParams->NetID & 0xFF;
+    NsSimDown[length++] = ( NsSimParams->NetID >> 8 ) & 0xFF;
+    NsSimDown[length++] = ( NsSimParams->NetID >> 16 ) & 0xFF;
+    NsSimDown[length++] = NsSimParams->DevAddr & 0xFF;
+    NsSimDown[length++] = ( NsSimParams->DevAddr >> 8 ) & 0xFF;
+    NsSimDown[length++] = ( NsSimParams->DevAddr >> 16 ) & 0xFF;
+    NsSimDown[length++] = ( NsSimParams->DevAddr >> 24 ) & 0xFF;
+    NsSimDown[length++] = ( ( NsSimParams->Rx1DrOffset & 0x07 ) << 4 ) | ( NsSimParams->Rx2Datarate & 0x0F );
+    NsSimDown[length++] = NsSimParams->RxDelay & 0x0F;
+    for( uint8_t i = 0; i < 5; i++ )
+    {
+        cfList |= NsSimParams->CFList[i] != 0;
+    }
+    if( cfList == true )
+    {
+        for( uint8_t i = 0; i < 5; i++ )
+        {
+            uint32_t frequency = NsSimParams->CFList[i] / 100;
+
+            NsSimDown[length++] = frequency & 0xFF;
+            NsSimDown[length++] = ( frequency >> 8 ) & 0xFF;
+            NsSimDown[length++] = ( frequency >> 16 ) & 0xFF;
+        }
+        NsSimDown[length++] = 0;
+    }
+    LoRaMacJoinComputeMicCtx( &NsSimCryptoCtx, NsSimDown, length, NsSimParams->AppKey, &mic );
+    NsSimDown[length++] = mic & 0xFF;
+    NsSimDown[length++] = ( mic >> 8 ) & 0xFF;
+    NsSimDown[length++] = ( mic >> 16 ) & 0xFF;
+    NsSimDown[length++] = ( mic >> 24 ) & 0xFF;
+
+    // Same derivation as the device, from the AppNonce and NetID in clear
+    LoRaMacJoinComputeSKeys( NsSimParams->AppKey, NsSimDown + 1, devNonce, NsSimNwkSKey, NsSimAppSKey );
+
+    // The device decrypts the join accept with the AES encryption
+    memset( &aes, 0, sizeof( aes ) );
+    aes_set_key( NsSimParams->AppKey, 16, &aes );
+    for( uint8_t i = 1; i < length; i += 16 )
+    {
+        aes_decrypt( NsSimDown + i, NsSimDown + i, &aes );
+    }
+
+    NsSimIsJoined = true;
+    NsSimHasUplink = false;
+    NsSimDownLinkCounter = 0;
+    NsSimRx2Frequency = NsSimParams->Rx2Frequency;
+    NsSimPendingRx2Frequency = 0;
+    NsSimStats.NbJoinAccepts++;
+    NsSimScheduleDown( settings->Frequency, length );
+}
+
+/*!
+ * \brief Processes the MAC commands sent by the device
+ *
+ * \retval answer [true: a command asks for a downlink]
+ */
+static bool NsSimProcessCommands( const uint8_t *commands, uint8_t size )
+{
+    bool answer = false;
+    uint8_t i = 0;
+
+    while( i < size )
+    {
+        uint8_t id = commands[i++];
+        uint8_t length = 0;
+
+        switch( id )
+        {
+            case MOTE_MAC_LINK_CHECK_REQ:
+            case MOTE_MAC_DUTY_CYCLE_ANS:
+            case MOTE_MAC_RX_TIMING_SETUP_ANS:
+                length = 0;
+                break;
+            case MOTE_MAC_LINK_ADR_ANS:
+            case MOTE_MAC_RX_PARAM_SETUP_ANS:
+            case MOTE_MAC_NEW_CHANNEL_ANS:
+            case MOTE_MAC_PING_SLOT_INFO_REQ:
+                length = 1;
+                break;
+            case MOTE_MAC_DEV_STATUS_ANS:
+                length = 2;
+                break;
+            default:
+                // Unknown command, the rest of the field can not be parsed
+                return answer;
+        }
+        if( i + length > size )
+        {
+            return answer;
+        }
+        if( id <= MOTE_MAC_RX_TIMING_SETUP_ANS )
+        {
+            NsSimStats.NbCommands[id]++;
+            if( length > 0 )
+            {
+                NsSimStats.CommandStatus[id] = commands[i];
+            }
+        }
+        if( id == MOTE_MAC_LINK_CHECK_REQ )
+        {
+            uint8_t linkCheckAns[] = { SRV_MAC_LINK_CHECK_ANS, NS_SIM_LINK_CHECK_MARGIN, NS_SIM_LINK_CHECK_GATEWAYS };
+
+            answer |= NsSimQueueCommand( linkCheckAns, sizeof( linkCheckAns ) );
+        }
+        if( ( id == MOTE_MAC_RX_PARAM_SETUP_ANS ) && ( NsSimPendingRx2Frequency != 0 ) )
+        {
+            // The device takes the new RX2 channel when all the bits are set
+            if( ( commands[i] & 0x07 ) == 0x07 )
+            {
+                NsSimRx2Frequency = NsSimPendingRx2Frequency;
+            }
+            NsSimPendingRx2Frequency = 0;
+        }
+        i += length;
+    }
+    return answer;
+}
+
+static void NsSimDataUplink( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size )
+{
+    uint8_t commands[255];
+    uint8_t commandsSize = 0;
+    uint32_t devAddr = 0;
+    uint32_t upLinkCounter = 0;
+    uint32_t mic = 0;
+    uint8_t fOptsLen = 0;
+    uint8_t length = 0;
+    bool confirmed = ( payload[0] >> 5 ) == FRAME_TYPE_DATA_CONFIRMED_UP;
+    bool retransmission = false;
+    bool answer = false;
+
+    if( ( NsSimIsJoined == false ) || ( size < NS_SIM_FRAME_HEADER_SIZE + LORAMAC_MFR_LEN ) )
+    {
+        NsSimStats.NbRejected++;
+        return;
+    }
+    devAddr = payload[1] | ( payload[2] << 8 ) | ( payload[3] << 16 ) | ( ( uint32_t )payload[4] << 24 );
+    fOptsLen = payload[5] & 0x0F;
+    if( ( devAddr != NsSimParams->DevAddr ) || ( NS_SIM_FRAME_HEADER_SIZE + fOptsLen + LORAMAC_MFR_LEN > size ) )
+    {
+        NsSimStats.NbRejected++;
+        return;
+    }
+
+    // 32 bits counter from the 16 bits sent, the counter does not go back
+    upLinkCounter = ( NsSimStats.UpLinkCounter & 0xFFFF0000 ) | payload[6] | ( payload[7] << 8 );
+    if( ( NsSimHasUplink == true ) && ( upLinkCounter < NsSimStats.UpLinkCounter ) )
+    {
+        upLinkCounter += 0x10000;
+    }
+    LoRaMacComputeMicCtx( &NsSimCryptoCtx, payload, size - LORAMAC_MFR_LEN, NsSimNwkSKey, devAddr, UP_LINK, upLinkCounter, &mic );
+    if( memcmp( &mic, payload + size - LORAMAC_MFR_LEN, LORAMAC_MFR_LEN ) != 0 )
+    {
+        NsSimStats.NbRejected++;
+        return;
+    }
+    retransmission = ( NsSimHasUplink == true ) && ( upLinkCounter == NsSimStats.UpLinkCounter );
+    NsSimHasUplink = true;
+    NsSimStats.UpLinkCounter = upLinkCounter;
+    NsSimStats.NbUplinks++;
+
+    // MAC commands in FOpts or in a port 0 payload. A retransmission carries
+    // the commands already processed
+    if( retransmission == true )
+    {
+        NsSimStats.NbRetransmissions++;
+    }
+    else
+    {
+        memcpy1( commands, payload + NS_SIM_FRAME_HEADER_SIZE, fOptsLen );
+        commandsSize = fOptsLen;
+        length = NS_SIM_FRAME_HEADER_SIZE + fOptsLen;
+        if( ( size > length + LORAMAC_MFR_LEN + 1 ) && ( payload[length] == 0 ) )
+        {
+            LoRaMacPayloadDecryptCtx( &NsSimCryptoCtx, payload + length + 1, size - length - 1 - LORAMAC_MFR_LEN, NsSimNwkSKey,
+                                      devAddr, UP_LINK, upLinkCounter, commands + commandsSize );
+            commandsSize += size - length - 1 - LORAMAC_MFR_LEN;
+        }
+        answer = NsSimProcessCommands( commands, commandsSize );
+    }
+
+    if( ( confirmed == false ) && ( answer == false ) && ( NsSimCommandsSize == 0 ) && ( NsSimDataSize == 0 ) )
+    {
+        return;
+    }
+    if( confirmed == true )
+    {
+        NsSimStats.NbAcks++;
+    }
+    length = MacSimBuildDown( NsSimDown, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, devAddr, ( confirmed == true ) ? 0x20 : 0x00,
+                              NsSimDownLinkCounter++, NsSimCommands, NsSimCommandsSize,
+                              ( NsSimDataSize > 0 ) ? NsSimDataPort : 0xFF, NsSimData, NsSimDataSize, NsSimNwkSKey, NsSimAppSKey );
+    NsSimCommandsSize = 0;
+    NsSimDataSize = 0;
+    NsSimScheduleDown( settings->Frequency, length );
+}
+
+static void NsSimTransmit( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size, uint32_t timeOnAir )
+{
+    NsSimWindowCounter = 0;
+    NsSimDownSize = 0;
+    if( size == 0 )
+    {
+        return;
+    }
+    switch( payload[0] >> 5 )
+    {
+        case FRAME_TYPE_JOIN_REQ:
+            NsSimJoinRequest( settings, payload, size );
+            break;
+        case FRAME_TYPE_DATA_UNCONFIRMED_UP:
+        case FRAME_TYPE_DATA_CONFIRMED_UP:
+            NsSimDataUplink( settings, payload, size );
+            break;
+        default:
+            NsSimStats.NbRejected++;
+            break;
+    }
+}
+
+static bool NsSimReceive( const SimRadioSettings_t *settings, TimerTime_t end, SimRadioFrame_t *frame )
+{
+    NsSimWindowCounter++;
+    if( ( NsSimDownSize == 0 ) || ( NsSimWindowCounter != NsSimDownWindow ) )
+    {
+        return false;
+    }
+    if( settings->Frequency != NsSimDownFrequency )
+    {
+        NsSimStats.NbMissedWindows++;
+        NsSimDownSize = 0;
+        return false;
+    }
+    memset( frame, 0, sizeof( SimRadioFrame_t ) );
+    memcpy1( frame->Payload, NsSimDown, NsSimDownSize );
+    frame->Size = NsSimDownSize;
+    frame->Start = TimerGetCurrentTime( );
+    frame->Rssi = NS_SIM_DOWN_RSSI;
+    frame->Snr = NS_SIM_DOWN_SNR;
+    NsSimDownSize = 0;
+    NsSimStats.NbDownlinks++;
+    return true;
+}
+
+void NsSimInit( const NsSimParams_t *params, SimRadioHandlers_t *handlers )
+{
+    NsSimParams = params;
+    memset( &NsSimStats, 0, sizeof( NsSimStats ) );
+    memset( &NsSimCryptoCtx, 0, sizeof( NsSimCryptoCtx ) );
+    NsSimIsJoined = false;
+    NsSimHasUplink = false;
+    NsSimRx2Frequency = params->Rx2Frequency;
+    NsSimPendingRx2Frequency = 0;
+    NsSimCommandsSize = 0;
+    NsSimDataSize = 0;
+    NsSimWindow = 1;
+    NsSimDownSize = 0;
+
+    handlers->Transmit = NsSimTransmit;
+    handlers->Receive = NsSimReceive;
+    handlers->Random = NULL;
+}
+
+void NsSimSetWindow( uint8_t window )
+{
+    NsSimWindow = window;
+}
+
+bool NsSimQueueCommand( const uint8_t *command, uint8_t size )
+{
+    if( ( size == 0 ) || ( NsSimCommandsSize + size > NS_SIM_MAX_COMMANDS_SIZE ) )
+    {
+        return false;
+    }
+    // RXParamSetupReq: DLSettings, then the frequency in 100 Hz steps
+    if( ( command[0] == SRV_MAC_RX_PARAM_SETUP_REQ ) && ( size >= 5 ) )
+    {
+        NsSimPendingRx2Frequency = ( command[2] | ( command[3] << 8 ) | ( command[4] << 16 ) ) * 100;
+    }
+    memcpy1( NsSimCommands + NsSimCommandsSize, command, size );
+    NsSimCommandsSize += size;
+    return true;
+}
+
+bool NsSimQueueData( uint8_t port, const uint8_t *payload, uint8_t size )
+{
+    if( ( NsSimDataSize > 0 ) || ( size == 0 ) || ( size > NS_SIM_MAX_DATA_SIZE ) || ( port == 0 ) || ( port > 223 ) )
+    {
+        return false;
+    }
+    memcpy1( NsSimData, payload, size );
+    NsSimDataSize = size;
+    NsSimDataPort = port;
+    return true;
+}
+
+const NsSimStats_t* NsSimGetStats( void )
+{
+    return &NsSimStats;
+}
@@ -0,0 +1,152 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Network server stand-in on the simulated radio link. Answers
+             the join requests with a join accept carrying a CFList, checks
+             the uplinks, acknowledges the confirmed ones in RX1 or RX2 and
+             sends the scripted MAC commands and application payloads with
+             the next downlink. The keys and frames are computed with the MAC
+             crypto functions. Single device, Class A
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __NS_SIM_H__
+#define __NS_SIM_H__
+
+#include "board.h"
+#include "LoRaMac.h"
+
+/*!
+ * Maximum size of the MAC commands sent in a downlink, FOpts field
+ */
+#define NS_SIM_MAX_COMMANDS_SIZE                    15
+
+/*!
+ * Maximum size of the application payload sent in a downlink
+ */
+#define NS_SIM_MAX_DATA_SIZE                        51
+
+/*!
+ * Network server parameters
+ */
+typedef struct sNsSimParams
+{
+    /*!
+     * Device accepted by the network. The EUIs are in the Commissioning.h
+     * order, most significant byte first
+     */
+    const uint8_t *DevEui;
+    const uint8_t *AppEui;
+    const uint8_t *AppKey;
+    /*!
+     * Network identifier and device address sent in the join accept
+     */
+    uint32_t NetID;
+    uint32_t DevAddr;
+    /*!
+     * Join accept DLSettings and RxDelay [s]
+     */
+    uint8_t Rx1DrOffset;
+    uint8_t Rx2Datarate;
+    uint8_t RxDelay;
+    /*!
+     * RX2 frequency [Hz]
+     */
+    uint32_t Rx2Frequency;
+    /*!
+     * Join accept CFList, channels 3 to 7 [Hz]. All 0: no CFList. Ignored on
+     * the bands with fixed channels
+     */
+    uint32_t CFList[5];
+}NsSimParams_t;
+
+/*!
+ * Network server counters
+ */
+typedef struct sNsSimStats
+{
+    uint32_t NbJoinRequests;
+    uint32_t NbJoinAccepts;
+    /*!
+     * Data uplinks with a valid MIC, retransmissions included
+     */
+    uint32_t NbUplinks;
+    /*!
+     * Data uplinks repeating the last frame counter
+     */
+    uint32_t NbRetransmissions;
+    /*!
+     * Frames of an unknown device or with a wrong MIC
+     */
+    uint32_t NbRejected;
+    uint32_t NbAcks;
+    uint32_t NbDownlinks;
+    /*!
+     * Downlinks not sent because the device window was not on the expected
+     * frequency
+     */
+    uint32_t NbMissedWindows;
+    /*!
+     * MAC commands received, indexed by command identifier, and the status
+     * byte of the last answer carrying one
+     */
+    uint32_t NbCommands[MOTE_MAC_RX_TIMING_SETUP_ANS + 1];
+    uint8_t CommandStatus[MOTE_MAC_RX_TIMING_SETUP_ANS + 1];
+    /*!
+     * Uplink counter of the last data uplink
+     */
+    uint32_t UpLinkCounter;
+}NsSimStats_t;
+
+/*!
+ * \brief Initializes the network server and its radio frame handlers. The
+ *        handlers are then given to MacSimInit
+ *
+ * \param [IN]  params   Network parameters, kept by reference
+ * \param [OUT] handlers Radio frame handlers
+ */
+void NsSimInit( const NsSimParams_t *params, SimRadioHandlers_t *handlers );
+
+/*!
+ * \brief Selects the window of the downlinks
+ *
+ * \param [IN] window 1: RX1, 2: RX2
+ */
+void NsSimSetWindow( uint8_t window );
+
+/*!
+ * \brief Queues a MAC command for the next downlink. The queued commands are
+ *        sent once, in order
+ *
+ * \param [IN] command Command identifier and payload
+ * \param [IN] size    Command size
+ *
+ * \retval status [true: queued, false: FOpts field full]
+ */
+bool NsSimQueueCommand( const uint8_t *command, uint8_t size );
+
+/*!
+ * \brief Queues an application payload for the next downlink
+ *
+ * \param [IN] port    Frame port, 1 to 223
+ * \param [IN] payload Application payload
+ * \param [IN] size    Payload size
+ *
+ * \retval status [true: queued, false: a payload is already queued or too
+ *                 large]
+ */
+bool NsSimQueueData( uint8_t port, const uint8_t *payload, uint8_t size );
+
+/*!
+ * \brief Returns the network server counters
+ */
+const NsSimStats_t* NsSimGetStats( void );
+
+#endif // __NS_SIM_H__
@@ -0,0 +1,288 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: End to end test of the MAC layer against the network server
+             stand-in on the simulated radio link: OTAA join with a CFList,
+             confirmed uplinks acknowledged in RX1 and RX2, scripted
+             LinkADRReq, NewChannelReq, RXParamSetupReq, DutyCycleReq and
+             DevStatusReq, application downlink and link check. EU868
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include "mac_sim.h"
+#include "ns_sim.h"
+#include "LoRaMacTest.h"
+
+#define TEST_PORT                                   2
+#define TEST_DOWN_PORT                              7
+
+/*!
+ * Maximum simulated duration of a transaction [ms]
+ */
+#define TEST_TRANSACTION_TIMEOUT                    30000
+
+static uint8_t DevEui[8] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static uint8_t AppEui[8] = { 0x70, 0xB3, 0xD5, 0x7E, 0xF0, 0x00, 0x00, 0x01 };
+static uint8_t AppKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+
+static const NsSimParams_t NsParams =
+{
+    DevEui, AppEui, AppKey,
+    0x000013,                                       // NetID
+    0x26012345,                                     // DevAddr
+    0,                                              // Rx1DrOffset
+    DR_3,                                           // Rx2Datarate
+    1,                                              // RxDelay
+    869525000,                                      // Rx2Frequency
+    { 867100000, 867300000, 867500000, 867700000, 867900000 },
+};
+
+static uint32_t Failures = 0;
+
+static bool McpsDone = false;
+static McpsConfirm_t LastMcpsConfirm;
+static bool MlmeDone = false;
+static MlmeConfirm_t LastMlmeConfirm;
+static uint32_t NbDownData = 0;
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+    LastMcpsConfirm = *mcpsConfirm;
+    McpsDone = true;
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+    if( ( mcpsIndication->Status == LORAMAC_EVENT_INFO_STATUS_OK ) && ( mcpsIndication->RxData == true ) &&
+        ( mcpsIndication->Port == TEST_DOWN_PORT ) && ( mcpsIndication->BufferSize == 4 ) &&
+        ( memcmp( mcpsIndication->Buffer, "ping", 4 ) == 0 ) )
+    {
+        NbDownData++;
+    }
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+    LastMlmeConfirm = *mlmeConfirm;
+    MlmeDone = true;
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+static void Check( bool condition, const char *name )
+{
+    if( condition == false )
+    {
+        printf( "ns test: %s failed\n", name );
+        Failures++;
+    }
+}
+
+/*!
+ * \brief Runs the MAC layer until the flag is set
+ *
+ * \retval status [true: flag set, false: timeout]
+ */
+static bool RunUntil( bool *flag )
+{
+    TimerTime_t end = TimerGetCurrentTime( ) + TEST_TRANSACTION_TIMEOUT;
+
+    while( ( *flag == false ) && ( ( int32_t )( end - TimerGetCurrentTime( ) ) > 0 ) )
+    {
+        MacSimRun( TimerGetCurrentTime( ) + 100 );
+    }
+    return *flag;
+}
+
+/*!
+ * \brief Sends an uplink and runs the MAC layer until its confirmation
+ *
+ * \retval status [true: confirmed, acknowledged when confirmed]
+ */
+static bool Uplink( bool confirmed )
+{
+    McpsReq_t mcpsReq;
+    uint8_t payload[4] = { 0x01, 0x02, 0x03, 0x04 };
+    MibRequestConfirm_t mibReq;
+
+    mibReq.Type = MIB_CHANNELS_DATARATE;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    if( confirmed == true )
+    {
+        mcpsReq.Type = MCPS_CONFIRMED;
+        mcpsReq.Req.Confirmed.fPort = TEST_PORT;
+        mcpsReq.Req.Confirmed.fBuffer = payload;
+        mcpsReq.Req.Confirmed.fBufferSize = sizeof( payload );
+        mcpsReq.Req.Confirmed.NbTrials = 1;
+        mcpsReq.Req.Confirmed.Datarate = mibReq.Param.ChannelsDatarate;
+    }
+    else
+    {
+        mcpsReq.Type = MCPS_UNCONFIRMED;
+        mcpsReq.Req.Unconfirmed.fPort = TEST_PORT;
+        mcpsReq.Req.Unconfirmed.fBuffer = payload;
+        mcpsReq.Req.Unconfirmed.fBufferSize = sizeof( payload );
+        mcpsReq.Req.Unconfirmed.Datarate = mibReq.Param.ChannelsDatarate;
+    }
+    McpsDone = false;
+    if( ( LoRaMacMcpsRequest( &mcpsReq ) != LORAMAC_STATUS_OK ) || ( RunUntil( &McpsDone ) == false ) )
+    {
+        return false;
+    }
+    // Lets the last receive window close
+    MacSimRun( TimerGetCurrentTime( ) + 3000 );
+    return ( LastMcpsConfirm.Status == LORAMAC_EVENT_INFO_STATUS_OK ) &&
+           ( ( confirmed == false ) || ( LastMcpsConfirm.AckReceived == true ) );
+}
+
+/*!
+ * \brief Sends a scripted MAC command with an uplink, then its answer with a
+ *        second uplink
+ */
+static bool Command( const uint8_t *command, uint8_t size )
+{
+    return ( NsSimQueueCommand( command, size ) == true ) && ( Uplink( false ) == true ) && ( Uplink( false ) == true );
+}
+
+int main( void )
+{
+    LoRaMacPrimitives_t primitives;
+    SimRadioHandlers_t handlers;
+    MibRequestConfirm_t mibReq;
+    MlmeReq_t mlmeReq;
+    LoRaMacSession_t session;
+    const NsSimStats_t *stats = NULL;
+    uint32_t nbAcks = 0;
+
+    srand1( 3 );
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    NsSimInit( &NsParams, &handlers );
+    MacSimInit( &primitives, &handlers );
+    LoRaMacTestSetDutyCycleOn( false );
+    stats = NsSimGetStats( );
+
+    // OTAA join, the join accept carries the CFList and the RX2 datarate
+    mlmeReq.Type = MLME_JOIN;
+    mlmeReq.Req.Join.DevEui = DevEui;
+    mlmeReq.Req.Join.AppEui = AppEui;
+    mlmeReq.Req.Join.AppKey = AppKey;
+    mlmeReq.Req.Join.NbTrials = 1;
+    MlmeDone = false;
+    Check( LoRaMacMlmeRequest( &mlmeReq ) == LORAMAC_STATUS_OK, "join request" );
+    Check( ( RunUntil( &MlmeDone ) == true ) && ( LastMlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_OK ), "join" );
+    Check( ( stats->NbJoinRequests == 1 ) && ( stats->NbJoinAccepts == 1 ), "join accept" );
+    mibReq.Type = MIB_CHANNELS;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    for( uint8_t i = 0; i < 5; i++ )
+    {
+        Check( mibReq.Param.ChannelList[3 + i].Frequency == NsParams.CFList[i], "CFList" );
+    }
+    mibReq.Type = MIB_RX2_CHANNEL;
+    LoRaMacMibGetRequestConfirm( &mibReq );
+    Check( mibReq.Param.Rx2Channel.Datarate == DR_3, "DLSettings" );
+
+    mibReq.Type = MIB_ADR;
+    mibReq.Param.AdrEnable = true;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+    mibReq.Type = MIB_CHANNELS_DATARATE;
+    mibReq.Param.ChannelsDatarate = DR_5;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+
+    // Confirmed uplinks acknowledged in RX1 then in RX2. The uplink MIC
+    // proves the session keys derived on both sides match
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        NsSimSetWindow( ( i < 4 ) ? 1 : 2 );
+        nbAcks += ( Uplink( true ) == true ) ? 1 : 0;
+    }
+    NsSimSetWindow( 1 );
+    Check( ( nbAcks == 8 ) && ( stats->NbAcks == 8 ), "acknowledgements" );
+
+    // LinkADRReq: DR_4, TX power 2, channels 0 to 7, 1 transmission
+    {
+        const uint8_t command[] = { SRV_MAC_LINK_ADR_REQ, ( DR_4 << 4 ) | 2, 0xFF, 0x00, 0x01 };
+
+        Check( Command( command, sizeof( command ) ) == true, "LinkADRReq uplinks" );
+        Check( ( stats->NbCommands[MOTE_MAC_LINK_ADR_ANS] == 1 ) && ( stats->CommandStatus[MOTE_MAC_LINK_ADR_ANS] == 0x07 ),
+               "LinkADRAns" );
+        mibReq.Type = MIB_CHANNELS_DATARATE;
+        LoRaMacMibGetRequestConfirm( &mibReq );
+        Check( mibReq.Param.ChannelsDatarate == DR_4, "LinkADRReq datarate" );
+    }
+
+    // NewChannelReq: channel 8 at 868.8 MHz, DR_0 to DR_5
+    {
+        const uint8_t command[] = { SRV_MAC_NEW_CHANNEL_REQ, 8, 8688000 & 0xFF, ( 8688000 >> 8 ) & 0xFF,
+                                    ( 8688000 >> 16 ) & 0xFF, ( DR_5 << 4 ) | DR_0 };
+
+        Check( Command( command, sizeof( command ) ) == true, "NewChannelReq uplinks" );
+        Check( ( stats->NbCommands[MOTE_MAC_NEW_CHANNEL_ANS] == 1 ) && ( stats->CommandStatus[MOTE_MAC_NEW_CHANNEL_ANS] == 0x03 ),
+               "NewChannelAns" );
+        mibReq.Type = MIB_CHANNELS;
+        LoRaMacMibGetRequestConfirm( &mibReq );
+        Check( mibReq.Param.ChannelList[8].Frequency == 868800000, "NewChannelReq channel" );
+    }
+
+    // RXParamSetupReq: RX1 offset 1, RX2 at 869.1 MHz DR_2. The network
+    // answers the next confirmed uplink on the new RX2 channel
+    {
+        const uint8_t command[] = { SRV_MAC_RX_PARAM_SETUP_REQ, ( 1 << 4 ) | DR_2, 8691000 & 0xFF, ( 8691000 >> 8 ) & 0xFF,
+                                    ( 8691000 >> 16 ) & 0xFF };
+
+        Check( Command( command, sizeof( command ) ) == true, "RXParamSetupReq uplinks" );
+        Check( ( stats->NbCommands[MOTE_MAC_RX_PARAM_SETUP_ANS] == 1 ) &&
+               ( stats->CommandStatus[MOTE_MAC_RX_PARAM_SETUP_ANS] == 0x07 ), "RXParamSetupAns" );
+        NsSimSetWindow( 2 );
+        Check( Uplink( true ) == true, "RX2 acknowledgement on the new channel" );
+        NsSimSetWindow( 1 );
+    }
+
+    // DutyCycleReq: aggregated duty cycle 1 / 4
+    {
+        const uint8_t command[] = { SRV_MAC_DUTY_CYCLE_REQ, 2 };
+
+        Check( Command( command, sizeof( command ) ) == true, "DutyCycleReq uplinks" );
+        Check( stats->NbCommands[MOTE_MAC_DUTY_CYCLE_ANS] == 1, "DutyCycleAns" );
+        LoRaMacSessionGet( &session );
+        Check( session.MaxDCycle == 2, "DutyCycleReq duty cycle" );
+    }
+
+    // DevStatusReq
+    {
+        const uint8_t command[] = { SRV_MAC_DEV_STATUS_REQ };
+
+        Check( Command( command, sizeof( command ) ) == true, "DevStatusReq uplinks" );
+        Check( stats->NbCommands[MOTE_MAC_DEV_STATUS_ANS] == 1, "DevStatusAns" );
+    }
+
+    // Application downlink, decrypted with the AppSKey derived by the device
+    Check( NsSimQueueData( TEST_DOWN_PORT, ( const uint8_t* )"ping", 4 ) == true, "data queue" );
+    Check( ( Uplink( false ) == true ) && ( NbDownData == 1 ), "data downlink" );
+
+    // Link check, answered in the downlink of the request uplink
+    mlmeReq.Type = MLME_LINK_CHECK;
+    Check( LoRaMacMlmeRequest( &mlmeReq ) == LORAMAC_STATUS_OK, "link check request" );
+    MlmeDone = false;
+    Check( Uplink( false ) == true, "link check uplink" );
+    Check( ( MlmeDone == true ) && ( LastMlmeConfirm.MlmeRequest == MLME_LINK_CHECK ) &&
+           ( LastMlmeConfirm.Status == LORAMAC_EVENT_INFO_STATUS_OK ) && ( LastMlmeConfirm.NbGateways == 1 ) &&
+           ( LastMlmeConfirm.DemodMargin == 20 ), "LinkCheckAns" );
+
+    Check( ( stats->NbRejected == 0 ) && ( stats->NbMissedWindows == 0 ) && ( stats->NbRetransmissions == 0 ), "network counters" );
+    printf( "ns test: %u uplinks, %u downlinks, uplink counter %u\n", stats->NbUplinks, stats->NbDownlinks, stats->UpLinkCounter );
+    printf( "ns test: %u failures\n", Failures );
+    return ( Failures == 0 ) ? 0 : 1;
+}
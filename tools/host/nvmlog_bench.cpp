@@ -0,0 +1,89 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Session log wear benchmark. Counts the counter updates stored
+             per page erase with the demo log geometry, against storing the
+             whole session in a page erased on every update
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include "board.h"
+#include "LoRaMac.h"
+#include "NvmLog.h"
+#include "flash_sim.h"
+
+/*!
+ * Demo log geometry, see APP_NVM_PAGE_SIZE and APP_NVM_NB_PAGES
+ */
+#define BENCH_PAGE_SIZE                             2048
+#define BENCH_NB_PAGES                              4
+#define BENCH_ERASE_SIZE                            128
+
+/*!
+ * Number of uplinks of the benchmark
+ */
+#define BENCH_NB_UPDATES                            100000
+
+/*!
+ * Program/erase cycles of the STM32L0 flash
+ */
+#define BENCH_ENDURANCE                             10000
+
+typedef struct sBenchImage
+{
+    LoRaMacSession_t Session;
+    uint16_t DevNonce;
+    uint8_t IsJoined;
+}BenchImage_t;
+
+static NvmLogCallbacks_t Callbacks = { FlashSimErase, FlashSimWrite, FlashSimRead };
+
+int main( void )
+{
+    BenchImage_t image;
+    BenchImage_t recovered;
+    const FlashSimStats_t *stats = NULL;
+    double pageErases = 0;
+    double updatesPerErase = 0;
+
+    FlashSimInit( BENCH_PAGE_SIZE * BENCH_NB_PAGES, BENCH_ERASE_SIZE, 0x00 );
+    NvmLogInit( &Callbacks, BENCH_PAGE_SIZE, BENCH_NB_PAGES, ( uint8_t* )&recovered, sizeof( recovered ) );
+
+    memset( &image, 0, sizeof( image ) );
+    image.IsJoined = 1;
+    for( uint32_t n = 0; n < BENCH_NB_UPDATES; n++ )
+    {
+        // One uplink: new counter and time off of the band used, a downlink
+        // every 4 uplinks
+        image.Session.UpLinkCounter = n;
+        image.Session.DownLinkCounter = n / 4;
+        image.Session.AggregatedTimeOff = 0;
+        image.Session.BandsTimeOff[n % LORA_MAX_NB_BANDS] = 99000 + ( n % 7 );
+        if( NvmLogUpdate( ( uint8_t* )&image ) == false )
+        {
+            printf( "update %u failed\n", n );
+            return 1;
+        }
+    }
+
+    stats = FlashSimGetStats( );
+    pageErases = ( double )stats->NbErases * BENCH_ERASE_SIZE / BENCH_PAGE_SIZE;
+    updatesPerErase = BENCH_NB_UPDATES / pageErases;
+
+    printf( "nvmlog bench: %u byte data block, %u pages of %u bytes\n", ( uint32_t )sizeof( image ), BENCH_NB_PAGES, BENCH_PAGE_SIZE );
+    printf( "  updates                 %u\n", BENCH_NB_UPDATES );
+    printf( "  page erases             %.0f\n", pageErases );
+    printf( "  updates per page erase  %.1f ( whole block rewrite: 1.0 )\n", updatesPerErase );
+    printf( "  bytes programmed/update %.1f ( whole block rewrite: %u )\n", ( double )stats->NbProgrammed / BENCH_NB_UPDATES, ( uint32_t )sizeof( image ) );
+    printf( "  updates to wear out     %.0f ( whole block rewrite on %u pages: %u )\n",
+            updatesPerErase * BENCH_NB_PAGES * BENCH_ENDURANCE, BENCH_NB_PAGES, BENCH_NB_PAGES * BENCH_ENDURANCE );
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Session log power loss test. The power is cut after each flash
+             operation of an update sequence in turn. After the restart the
+             recovered data block must be the last stored one or the one
+             being stored, and the log must accept new updates
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "board.h"
+#include "LoRaMac.h"
+#include "NvmLog.h"
+#include "flash_sim.h"
+
+/*!
+ * Small pages so that the sequence crosses several page switches
+ */
+#define TEST_PAGE_SIZE                              512
+#define TEST_NB_PAGES                               3
+#define TEST_ERASE_SIZE                             128
+
+/*!
+ * Number of updates of the sequence
+ */
+#define TEST_NB_UPDATES                             40
+
+/*!
+ * Stored data block, the application image layout
+ */
+typedef struct sTestImage
+{
+    LoRaMacSession_t Session;
+    uint16_t DevNonce;
+    uint8_t IsJoined;
+}TestImage_t;
+
+static NvmLogCallbacks_t Callbacks = { FlashSimErase, FlashSimWrite, FlashSimRead };
+
+/*!
+ * \brief   Builds version n of the data block. The counters change on every
+ *          version, the other fields now and then
+ */
+static void TestImageBuild( TestImage_t *image, uint32_t n )
+{
+    memset( image, 0, sizeof( TestImage_t ) );
+    image->Session.UpLinkCounter = n;
+    image->Session.DownLinkCounter = n / 3;
+    image->Session.AggregatedTimeOff = ( n * 37 ) % 1000;
+    image->Session.BandsTimeOff[n % LORA_MAX_NB_BANDS] = 1000 + n;
+    image->Session.DevAddr = 0x26011234;
+    image->Session.Params.ChannelsDatarate = ( n / 10 ) % 6;
+    memset( image->Session.NwkSKey, ( n / 16 ) & 0xFF, sizeof( image->Session.NwkSKey ) );
+    image->DevNonce = 100 + ( n / 25 );
+    image->IsJoined = 1;
+}
+
+/*!
+ * \brief   Runs the sequence with a power cut after nbOperations operations
+ *
+ * \retval  [0: pass, 1: fail, 2: no cut, the sequence completed]
+ */
+static int TestCut( uint32_t nbOperations, uint8_t erasedValue )
+{
+    TestImage_t image;
+    TestImage_t recovered;
+    TestImage_t expected;
+    uint32_t stored = 0;
+    uint32_t n = 0;
+
+    FlashSimInit( TEST_PAGE_SIZE * TEST_NB_PAGES, TEST_ERASE_SIZE, erasedValue );
+    if( NvmLogInit( &Callbacks, TEST_PAGE_SIZE, TEST_NB_PAGES, ( uint8_t* )&recovered, sizeof( recovered ) ) == true )
+    {
+        printf( "  erased log reported as valid\n" );
+        return 1;
+    }
+
+    FlashSimCutPower( nbOperations );
+    for( n = 1; n <= TEST_NB_UPDATES; n++ )
+    {
+        TestImageBuild( &image, n );
+        if( NvmLogUpdate( ( uint8_t* )&image ) == false )
+        {
+            break;
+        }
+        stored = n;
+    }
+    if( FlashSimPowerOn( ) == false )
+    {
+        return 2;
+    }
+
+    // Restart
+    if( NvmLogInit( &Callbacks, TEST_PAGE_SIZE, TEST_NB_PAGES, ( uint8_t* )&recovered, sizeof( recovered ) ) == false )
+    {
+        if( stored != 0 )
+        {
+            printf( "  cut %u: version %u lost\n", nbOperations, stored );
+            return 1;
+        }
+    }
+    else
+    {
+        bool isStored = false;
+        bool isPending = false;
+
+        if( stored != 0 )
+        {
+            TestImageBuild( &expected, stored );
+            isStored = memcmp( &recovered, &expected, sizeof( expected ) ) == 0;
+        }
+        TestImageBuild( &expected, stored + 1 );
+        isPending = memcmp( &recovered, &expected, sizeof( expected ) ) == 0;
+        if( ( isStored == false ) && ( isPending == false ) )
+        {
+            printf( "  cut %u: recovered block is neither version %u nor %u\n", nbOperations, stored, stored + 1 );
+            return 1;
+        }
+    }
+
+    // The log keeps working after the restart
+    for( n = 100; n < 100 + TEST_NB_UPDATES; n++ )
+    {
+        TestImageBuild( &image, n );
+        if( NvmLogUpdate( ( uint8_t* )&image ) == false )
+        {
+            printf( "  cut %u: update %u failed after the restart\n", nbOperations, n );
+            return 1;
+        }
+    }
+    if( ( NvmLogInit( &Callbacks, TEST_PAGE_SIZE, TEST_NB_PAGES, ( uint8_t* )&recovered, sizeof( recovered ) ) == false ) ||
+        ( memcmp( &recovered, &image, sizeof( image ) ) != 0 ) )
+    {
+        printf( "  cut %u: last update lost after the restart\n", nbOperations );
+        return 1;
+    }
+    if( FlashSimGetStats( )->NbOverwrites != 0 )
+    {
+        printf( "  cut %u: programmed words written again\n", nbOperations );
+        return 1;
+    }
+    return 0;
+}
+
+int main( void )
+{
+    const uint8_t erasedValues[] = { 0x00, 0xFF };
+    int failures = 0;
+
+    for( uint8_t e = 0; e < sizeof( erasedValues ); e++ )
+    {
+        uint32_t nbCuts = 0;
+
+        srand( 1 );
+        for( uint32_t cut = 0; ; cut++ )
+        {
+            int result = TestCut( cut, erasedValues[e] );
+
+            if( result == 2 )
+            {
+                break;
+            }
+            failures += result;
+            nbCuts++;
+        }
+        printf( "nvmlog power loss, erased 0x%02X: %u cut points, %d failures\n", erasedValues[e], nbCuts, failures );
+    }
+    return ( failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Replays a capture recorded on the debug UART on the MAC layer
+             built for the host
+
+             build/replay <file>
+
+             The file holds the raw bytes read on the UART. The capture must
+             come from a firmware of the band of the build, EU868 unless the
+             program is built with another USE_BAND_xxx
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "mac_replay.h"
+
+#define REPLAY_MAX_STREAM_SIZE                      ( 4 * 1024 * 1024 )
+
+int main( int argc, char *argv[] )
+{
+    static uint8_t stream[REPLAY_MAX_STREAM_SIZE];
+    MacReplayStats_t stats;
+    FILE *file = NULL;
+    uint32_t size = 0;
+    bool status = false;
+
+    if( argc != 2 )
+    {
+        fprintf( stderr, "usage: %s <capture file>\n", argv[0] );
+        return 2;
+    }
+    file = fopen( argv[1], "rb" );
+    if( file == NULL )
+    {
+        perror( argv[1] );
+        return 2;
+    }
+    size = fread( stream, 1, sizeof( stream ), file );
+    fclose( file );
+
+    status = MacReplayRun( stream, size, &stats );
+    printf( "replay: %u records, %u events, %u application timers, %u frames compared\n",
+            stats.NbRecords, stats.NbEvents, stats.NbAppTimers, stats.NbTxFrames );
+    if( status == false )
+    {
+        printf( "replay: capture unusable, %u records, %u dropped\n", stats.NbRecords, stats.NbDropped );
+        return 2;
+    }
+    printf( "replay: %u divergences\n", stats.NbDivergences );
+    return ( stats.NbDivergences == 0 ) ? 0 : 1;
+}
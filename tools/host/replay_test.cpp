@@ -0,0 +1,356 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Capture replay test. A first process captures the MAC layer
+             running on the simulated radio: API requests with parameters
+             passed by pointer, a session restore, uplinks with the duty
+             cycle, downlinks in both windows, MAC commands and
+             retransmissions. A second process replays the capture and must
+             send the same frames. A third one replays the capture with a
+             damaged downlink and must diverge. The MAC layer is a singleton,
+             each process runs it once
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "mac_sim.h"
+#include "mac_replay.h"
+#include "LoRaMacTest.h"
+
+#define TEST_NB_UPLINKS                             24
+#define TEST_PORT                                   3
+#define TEST_MAX_STREAM_SIZE                        ( 1024 * 1024 )
+
+static uint8_t NwkSKey[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+static uint8_t AppSKey[16] = { 0x3C, 0x4F, 0xCF, 0x09, 0x88, 0x15, 0xF7, 0xAB, 0xA6, 0xD2, 0xAE, 0x28, 0x16, 0x15, 0x7E, 0x2B };
+static uint32_t DevAddr = 0x26011B4C;
+
+/*!
+ * Downlink MAC commands: DevStatusReq, LinkCheckAns and NewChannelReq of
+ * channel 4 at 867.3 MHz, DR_0 to DR_5
+ */
+static const uint8_t DownFOpts[] =
+{
+    SRV_MAC_DEV_STATUS_REQ,
+    SRV_MAC_LINK_CHECK_ANS, 15, 1,
+    SRV_MAC_NEW_CHANNEL_REQ, 4, 8673000 & 0xFF, ( 8673000 >> 8 ) & 0xFF, ( 8673000 >> 16 ) & 0xFF, ( DR_5 << 4 ) | DR_0,
+};
+
+static uint8_t Stream[TEST_MAX_STREAM_SIZE];
+static uint32_t StreamSize = 0;
+
+static FILE *CaptureFile = NULL;
+static uint8_t DrainBuffer[CAPTURE_FRAME_SIZE( CAPTURE_MAX_DATA_SIZE )];
+
+/*!
+ * Window of the downlink of the current uplink: 0: none, 1: RX1, 2: RX2
+ */
+static uint8_t DownWindow = 0;
+static uint8_t DownWindowCounter = 0;
+static uint32_t DownLinkCounter = 0;
+static bool DownAck = false;
+static uint32_t NbUplinks = 0;
+
+static void OnTransmit( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size, uint32_t timeOnAir )
+{
+    NbUplinks++;
+    DownWindowCounter = 0;
+    DownAck = ( payload[0] >> 5 ) == FRAME_TYPE_DATA_CONFIRMED_UP;
+}
+
+static bool OnReceive( const SimRadioSettings_t *settings, TimerTime_t end, SimRadioFrame_t *frame )
+{
+    uint8_t payload[8];
+
+    DownWindowCounter++;
+    if( ( DownWindow == 0 ) || ( DownWindowCounter != DownWindow ) )
+    {
+        return false;
+    }
+
+    memset( payload, 0x3C, sizeof( payload ) );
+    memset( frame, 0, sizeof( SimRadioFrame_t ) );
+    if( DownWindow == 1 )
+    {
+        frame->Size = MacSimBuildDown( frame->Payload, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, DevAddr, DownAck ? 0x20 : 0x00,
+                                       DownLinkCounter++, DownFOpts, sizeof( DownFOpts ), 0xFF, NULL, 0, NwkSKey, AppSKey );
+    }
+    else
+    {
+        frame->Size = MacSimBuildDown( frame->Payload, FRAME_TYPE_DATA_UNCONFIRMED_DOWN, DevAddr, DownAck ? 0x20 : 0x00,
+                                       DownLinkCounter++, NULL, 0, TEST_PORT, payload, sizeof( payload ), NwkSKey, AppSKey );
+    }
+    frame->Start = TimerGetCurrentTime( );
+    frame->Rssi = -80;
+    frame->Snr = 5;
+    return true;
+}
+
+static void OnMcpsConfirm( McpsConfirm_t *mcpsConfirm )
+{
+}
+
+static void OnMcpsIndication( McpsIndication_t *mcpsIndication )
+{
+}
+
+static void OnMlmeConfirm( MlmeConfirm_t *mlmeConfirm )
+{
+}
+
+static void OnMlmeIndication( MlmeIndication_t *mlmeIndication )
+{
+}
+
+/*!
+ * \brief Writes the captured records to the capture file, as the application
+ *        drains them to the debug UART
+ */
+static void CaptureFileDrain( void )
+{
+    uint16_t size = 0;
+
+    while( ( size = CaptureDrain( DrainBuffer, sizeof( DrainBuffer ) ) ) > 0 )
+    {
+        fwrite( DrainBuffer, 1, size, CaptureFile );
+    }
+}
+
+/*!
+ * \brief Runs the MAC layer until the given time, draining the capture after
+ *        each timer expiry
+ */
+static void CaptureRun( TimerTime_t time )
+{
+    TimerTime_t expiry = 0;
+
+    CaptureFileDrain( );
+    while( ( TimerGetNextExpiry( &expiry ) == true ) && ( ( int32_t )( expiry - time ) <= 0 ) )
+    {
+        TimerAdvance( expiry );
+        CaptureFileDrain( );
+    }
+    TimerAdvance( time );
+    CaptureFileDrain( );
+}
+
+/*!
+ * \brief Runs the captured scenario
+ */
+static void CaptureScenario( void )
+{
+    LoRaMacPrimitives_t primitives;
+    SimRadioHandlers_t handlers;
+    MibRequestConfirm_t mibReq;
+    MlmeReq_t mlmeReq;
+    McpsReq_t mcpsReq;
+    LoRaMacSession_t session;
+    MulticastParams_t multicast;
+    ChannelParams_t channel = { 867100000, { ( DR_5 << 4 ) | DR_0 }, 0 };
+    uint16_t channelsMask[1] = { 0x0007 };
+    uint8_t payload[12];
+
+    srand1( 7 );
+    primitives.MacMcpsConfirm = OnMcpsConfirm;
+    primitives.MacMcpsIndication = OnMcpsIndication;
+    primitives.MacMlmeConfirm = OnMlmeConfirm;
+    primitives.MacMlmeIndication = OnMlmeIndication;
+    handlers.Transmit = OnTransmit;
+    handlers.Receive = OnReceive;
+    handlers.Random = NULL;
+    MacSimInit( &primitives, &handlers );
+    MacSimActivate( DevAddr, NwkSKey, AppSKey );
+    CaptureRun( 100 );
+
+    // Parameters passed by pointer, changed after the requests
+    mibReq.Type = MIB_CHANNELS_MASK;
+    mibReq.Param.ChannelsMask = channelsMask;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+    channelsMask[0] = 0;
+    LoRaMacChannelAdd( 3, channel );
+    mibReq.Type = MIB_RX2_CHANNEL;
+    mibReq.Param.Rx2Channel.Frequency = 869525000;
+    mibReq.Param.Rx2Channel.Datarate = DR_3;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+    mibReq.Type = MIB_ADR;
+    mibReq.Param.AdrEnable = false;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+    mibReq.Type = MIB_CHANNELS_DATARATE;
+    mibReq.Param.ChannelsDatarate = DR_5;
+    LoRaMacMibSetRequestConfirm( &mibReq );
+    multicast.Address = 0x01020304;
+    memcpy( multicast.NwkSKey, AppSKey, 16 );
+    memcpy( multicast.AppSKey, NwkSKey, 16 );
+    LoRaMacMulticastChannelLink( &multicast );
+    memset( &multicast, 0, sizeof( multicast ) );
+    LoRaMacTestSetDutyCycleOn( true );
+    CaptureRun( 200 );
+
+    memset( payload, 0x5A, sizeof( payload ) );
+    for( uint8_t i = 0; i < TEST_NB_UPLINKS; i++ )
+    {
+        // No downlink, a downlink with MAC commands in RX1, or a payload
+        // in RX2. The confirmed uplinks without downlink are retransmitted
+        DownWindow = i % 3;
+        if( i == 6 )
+        {
+            LoRaMacSessionGet( &session );
+            LoRaMacSessionRestore( &session );
+        }
+        if( i == 9 )
+        {
+            mlmeReq.Type = MLME_LINK_CHECK;
+            LoRaMacMlmeRequest( &mlmeReq );
+        }
+        if( i == 12 )
+        {
+            LoRaMacMulticastChannelUnlink( 0x01020304 );
+        }
+        if( ( i % 4 ) == 3 )
+        {
+            mcpsReq.Type = MCPS_CONFIRMED;
+            mcpsReq.Req.Confirmed.fPort = TEST_PORT;
+            mcpsReq.Req.Confirmed.fBuffer = payload;
+            mcpsReq.Req.Confirmed.fBufferSize = sizeof( payload );
+            mcpsReq.Req.Confirmed.NbTrials = 2;
+            mcpsReq.Req.Confirmed.Datarate = DR_5;
+        }
+        else
+        {
+            mcpsReq.Type = MCPS_UNCONFIRMED;
+            mcpsReq.Req.Unconfirmed.fPort = TEST_PORT;
+            mcpsReq.Req.Unconfirmed.fBuffer = payload;
+            mcpsReq.Req.Unconfirmed.fBufferSize = sizeof( payload );
+            mcpsReq.Req.Unconfirmed.Datarate = DR_5;
+        }
+        LoRaMacMcpsRequest( &mcpsReq );
+        payload[0]++;
+        CaptureRun( TimerGetCurrentTime( ) + 12000 );
+    }
+}
+
+/*!
+ * \brief Runs a function in a child process
+ *
+ * \retval status Exit status of the child, -1 when it did not exit
+ */
+static int RunChild( int ( *function )( void ) )
+{
+    int status = 0;
+    pid_t pid = 0;
+
+    fflush( stdout );
+    pid = fork( );
+    if( pid == 0 )
+    {
+        status = function( );
+        fflush( stdout );
+        _exit( status );
+    }
+    if( ( pid < 0 ) || ( waitpid( pid, &status, 0 ) != pid ) || ( WIFEXITED( status ) == 0 ) )
+    {
+        return -1;
+    }
+    return WEXITSTATUS( status );
+}
+
+static int CaptureChild( void )
+{
+    CaptureScenario( );
+    fflush( CaptureFile );
+    printf( "replay test: %u uplinks captured\n", NbUplinks );
+    return 0;
+}
+
+/*!
+ * \retval status [0: replayed without divergence, 1: replayed with
+ *                 divergences, 2: capture unusable]
+ */
+static int ReplayChild( void )
+{
+    MacReplayStats_t stats;
+
+    if( MacReplayRun( Stream, StreamSize, &stats ) == false )
+    {
+        printf( "replay test: capture unusable, %u records, %u dropped\n", stats.NbRecords, stats.NbDropped );
+        return 2;
+    }
+    printf( "replay test: %u records, %u events, %u frames compared, %u divergences\n",
+            stats.NbRecords, stats.NbEvents, stats.NbTxFrames, stats.NbDivergences );
+    if( stats.NbTxFrames == 0 )
+    {
+        return 2;
+    }
+    return ( stats.NbDivergences == 0 ) ? 0 : 1;
+}
+
+/*!
+ * \brief Changes the device address of the first captured downlink
+ *
+ * \retval status [true: downlink found]
+ */
+static bool DamageDownlink( void )
+{
+    uint32_t i = 0;
+
+    while( i + DEBUG_FRAME_HEADER_SIZE <= StreamSize )
+    {
+        uint16_t length = Stream[i + 2] | ( Stream[i + 3] << 8 );
+        uint8_t *payload = Stream + i + DEBUG_FRAME_HEADER_SIZE;
+        uint16_t crc = 0;
+
+        // Record type, timestamp, RSSI, SNR, MHDR then the device address
+        if( ( Stream[i + 1] == DEBUG_FRAME_CAPTURE ) && ( payload[0] == CAPTURE_RADIO_RX_DONE ) &&
+            ( length > CAPTURE_PAYLOAD_SIZE( 3 + 5 ) ) )
+        {
+            payload[CAPTURE_PAYLOAD_SIZE( 3 + 1 )] ^= 0x01;
+            crc = DebugFrameCrc( 0xFFFF, Stream + i + 1, DEBUG_FRAME_HEADER_SIZE - 1 + length );
+            payload[length] = crc & 0xFF;
+            payload[length + 1] = ( crc >> 8 ) & 0xFF;
+            return true;
+        }
+        i += DEBUG_FRAME_SIZE( length );
+    }
+    return false;
+}
+
+int main( void )
+{
+    uint32_t failures = 0;
+
+    CaptureFile = tmpfile( );
+    if( ( CaptureFile == NULL ) || ( RunChild( CaptureChild ) != 0 ) )
+    {
+        printf( "replay test: capture failed\n" );
+        return 1;
+    }
+    rewind( CaptureFile );
+    StreamSize = fread( Stream, 1, sizeof( Stream ), CaptureFile );
+    fclose( CaptureFile );
+    printf( "replay test: %u bytes captured\n", StreamSize );
+
+    // Same inputs: same frames
+    if( RunChild( ReplayChild ) != 0 )
+    {
+        failures++;
+    }
+
+    // The damaged downlink is dropped: its MAC commands are not answered
+    if( ( DamageDownlink( ) == false ) || ( RunChild( ReplayChild ) != 1 ) )
+    {
+        failures++;
+    }
+
+    printf( "replay test: %u failures\n", failures );
+    return ( failures == 0 ) ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Host build replacement of the target board functions
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "mbed.h"
+#include "board.h"
+
+uint32_t HostPrimask = 0;
+
+uint32_t SystemCoreClock = 1000000000;
+HostDwt_t HostDwt;
+HostCoreDebug_t HostCoreDebug;
+
+void BoardDisableIrq( void )
+{
+}
+
+void BoardEnableIrq( void )
+{
+}
+
+uint8_t BoardGetBatteryLevel( void )
+{
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Host build replacement of the target board definitions
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "timer.h"
+#include "utilities.h"
+#include "trace.h"
+#include "log.h"
+#include "profile.h"
+#include "capture.h"
+#include "framepool.h"
+#include "radio.h"
+
+#if !defined( USE_BAND_433 ) && !defined( USE_BAND_470 ) && !defined( USE_BAND_780 ) && \
+    !defined( USE_BAND_868 ) && !defined( USE_BAND_915 ) && !defined( USE_BAND_915_HYBRID )
+#define USE_BAND_868
+#endif
+
+/*!
+ * Simulated radio used by the MAC
+ */
+extern SimRadio Radio;
+
+/*!
+ * \brief Disable interrupts. Nothing to do, the host build is single threaded
+ */
+void BoardDisableIrq( void );
+
+/*!
+ * \brief Enable interrupts
+ */
+void BoardEnableIrq( void );
+
+/*!
+ * \brief Measure the Battery level
+ *
+ * \retval value  battery level ( 0: external power source )
+ */
+uint8_t BoardGetBatteryLevel( void );
+
+#endif // __BOARD_H__
@@ -0,0 +1,115 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2015 Semtech
+
+Description: Host build replacement of the mbed core functions used by the
+             system modules
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __MBED_H__
+#define __MBED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "timer.h"
+
+/*!
+ * The host build is single threaded. The interrupt mask is only recorded so
+ * that the code checking it behaves as in thread mode
+ */
+extern uint32_t HostPrimask;
+
+static inline uint32_t __get_PRIMASK( void )
+{
+    return HostPrimask;
+}
+
+static inline void __set_PRIMASK( uint32_t primask )
+{
+    HostPrimask = primask;
+}
+
+static inline void __disable_irq( void )
+{
+    HostPrimask = 1;
+}
+
+static inline void __enable_irq( void )
+{
+    HostPrimask = 0;
+}
+
+static inline uint32_t __get_IPSR( void )
+{
+    return 0;
+}
+
+static inline void __DMB( void )
+{
+    __sync_synchronize( );
+}
+
+/*!
+ * \brief Reads the microsecond ticker. Runs on the simulated time
+ *
+ * \retval time Current time [us]
+ */
+static inline uint32_t us_ticker_read( void )
+{
+    return TimerGetSimulatedTime( ) * 1000;
+}
+
+/*!
+ * Profiler cycle counter. The host counts the nanoseconds of the monotonic
+ * clock, the core clock is then 1 GHz
+ */
+#define __CORTEX_M                                  3
+
+extern uint32_t SystemCoreClock;
+
+struct HostCycleCounter
+{
+    operator uint32_t( ) const
+    {
+        struct timespec now;
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        return ( uint32_t )( ( uint64_t )now.tv_sec * 1000000000 + now.tv_nsec );
+    }
+
+    HostCycleCounter& operator=( uint32_t value )
+    {
+        return *this;
+    }
+};
+
+typedef struct
+{
+    HostCycleCounter CYCCNT;
+    uint32_t CTRL;
+}HostDwt_t;
+
+typedef struct
+{
+    uint32_t DEMCR;
+}HostCoreDebug_t;
+
+extern HostDwt_t HostDwt;
+extern HostCoreDebug_t HostCoreDebug;
+
+#define DWT                                         ( &HostDwt )
+#define CoreDebug                                   ( &HostCoreDebug )
+#define DWT_CTRL_CYCCNTENA_Msk                      0x00000001
+#define CoreDebug_DEMCR_TRCENA_Msk                  0x01000000
+
+#endif // __MBED_H__
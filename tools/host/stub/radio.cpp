@@ -0,0 +1,419 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C) 2014 Semtech
+
+Description: Host build radio. Simulates the SX1276 driver on the simulated
+             time. The frames are captured as by the driver
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainers: Miguel Luis, Gregory Cristian and Nicolas Huguenin
+*/
+#include <stdlib.h>
+#include <math.h>
+#include "board.h"
+
+/*!
+ * Sync word size of the FSK frames sent by the MAC [bytes]
+ */
+#define SIM_RADIO_FSK_SYNCWORD_SIZE                 3
+
+SimRadio Radio;
+
+static void OnSimRadioTimerEvent( void )
+{
+    Radio.OnTimeout( );
+}
+
+/*!
+ * \brief Records a LoRa frame sent or received on air, as the SX1276 driver
+ */
+#if( CAPTURE_AIR_ON )
+static void SimRadioCaptureAir( uint8_t type, const SimRadioSettings_t *settings, int16_t rssi, int8_t snr,
+                                const uint8_t *payload, uint8_t size )
+{
+    uint8_t header[9];
+
+    if( settings->Modem != MODEM_LORA )
+    {
+        return;
+    }
+    header[0] = settings->Frequency & 0xFF;
+    header[1] = ( settings->Frequency >> 8 ) & 0xFF;
+    header[2] = ( settings->Frequency >> 16 ) & 0xFF;
+    header[3] = ( settings->Frequency >> 24 ) & 0xFF;
+    header[4] = settings->Datarate;
+    header[5] = settings->Bandwidth;
+    header[6] = rssi & 0xFF;
+    header[7] = ( rssi >> 8 ) & 0xFF;
+    header[8] = snr;
+    CAPTURE_AIR( type, header, sizeof( header ), payload, size );
+}
+#else
+#define SimRadioCaptureAir( type, settings, rssi, snr, payload, size )
+#endif
+
+SimRadio::SimRadio( void )
+{
+    Events = NULL;
+    Handlers = NULL;
+    memset( &Settings, 0, sizeof( Settings ) );
+    State = RF_IDLE;
+    IsSleeping = true;
+    StateStart = 0;
+    memset( &Times, 0, sizeof( Times ) );
+    FramePending = false;
+    IsReplay = false;
+    TimerInit( &Timer, OnSimRadioTimerEvent );
+    Timer.IsCaptured = false;
+}
+
+void SimRadio::SetHandlers( const SimRadioHandlers_t *handlers )
+{
+    Handlers = handlers;
+}
+
+void SimRadio::Init( RadioEvents_t *events )
+{
+    Events = events;
+    TimerInit( &Timer, OnSimRadioTimerEvent );
+    Timer.IsCaptured = false;
+    StateStart = TimerGetSimulatedTime( );
+    memset( &Times, 0, sizeof( Times ) );
+    SetState( RF_IDLE, true );
+}
+
+RadioState SimRadio::GetStatus( void )
+{
+    return State;
+}
+
+void SimRadio::SetModem( RadioModems_t modem )
+{
+    Settings.Modem = modem;
+}
+
+void SimRadio::SetChannel( uint32_t freq )
+{
+    Settings.Frequency = freq;
+}
+
+bool SimRadio::IsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh )
+{
+    return true;
+}
+
+uint32_t SimRadio::Random( void )
+{
+    if( ( Handlers != NULL ) && ( Handlers->Random != NULL ) )
+    {
+        return Handlers->Random( );
+    }
+    return ( ( uint32_t )rand( ) << 16 ) ^ ( uint32_t )rand( );
+}
+
+void SimRadio::SetRxConfig( RadioModems_t modem, uint32_t bandwidth,
+                            uint32_t datarate, uint8_t coderate,
+                            uint32_t bandwidthAfc, uint16_t preambleLen,
+                            uint16_t symbTimeout, bool fixLen,
+                            uint8_t payloadLen,
+                            bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                            bool iqInverted, bool rxContinuous )
+{
+    Settings.Modem = modem;
+    Settings.Bandwidth = bandwidth;
+    Settings.Datarate = datarate;
+    Settings.Coderate = coderate;
+    Settings.PreambleLen = preambleLen;
+    Settings.FixLen = fixLen;
+    Settings.CrcOn = crcOn;
+    Settings.IqInverted = iqInverted;
+    Settings.SymbTimeout = symbTimeout;
+    Settings.RxContinuous = rxContinuous;
+}
+
+void SimRadio::SetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
+                            uint32_t bandwidth, uint32_t datarate,
+                            uint8_t coderate, uint16_t preambleLen,
+                            bool fixLen, bool crcOn, bool freqHopOn,
+                            uint8_t hopPeriod, bool iqInverted, uint32_t timeout )
+{
+    Settings.Modem = modem;
+    Settings.Power = power;
+    Settings.Bandwidth = bandwidth;
+    Settings.Datarate = datarate;
+    Settings.Coderate = coderate;
+    Settings.PreambleLen = preambleLen;
+    Settings.FixLen = fixLen;
+    Settings.CrcOn = crcOn;
+    Settings.IqInverted = iqInverted;
+}
+
+bool SimRadio::CheckRfFrequency( uint32_t frequency )
+{
+    return true;
+}
+
+uint32_t SimRadio::TimeOnAir( RadioModems_t modem, uint8_t pktLen )
+{
+    if( modem == MODEM_FSK )
+    {
+        return ( uint32_t )rint( ( 8 * ( Settings.PreambleLen + SIM_RADIO_FSK_SYNCWORD_SIZE +
+                                         ( Settings.FixLen ? 0.0 : 1.0 ) + pktLen +
+                                         ( Settings.CrcOn ? 2.0 : 0.0 ) ) /
+                                   Settings.Datarate ) * 1e3 );
+    }
+
+    // Same computation as the SX1276 driver
+    double bw = 125e3 * ( 1 << Settings.Bandwidth );
+    bool lowDatarateOptimize = ( ( Settings.Bandwidth == 0 ) && ( ( Settings.Datarate == 11 ) || ( Settings.Datarate == 12 ) ) ) ||
+                               ( ( Settings.Bandwidth == 1 ) && ( Settings.Datarate == 12 ) );
+    double ts = ( 1 << Settings.Datarate ) / bw;
+    double tPreamble = ( Settings.PreambleLen + 4.25 ) * ts;
+    double tmp = ceil( ( 8 * pktLen - 4 * ( int32_t )Settings.Datarate +
+                         28 + 16 * Settings.CrcOn -
+                         ( Settings.FixLen ? 20 : 0 ) ) /
+                         ( double )( 4 * ( Settings.Datarate - ( lowDatarateOptimize ? 2 : 0 ) ) ) ) *
+                         ( Settings.Coderate + 4 );
+    double nPayload = 8 + ( ( tmp > 0 ) ? tmp : 0 );
+
+    return ( uint32_t )floor( ( tPreamble + nPayload * ts ) * 1e3 + 0.999 );
+}
+
+void SimRadio::Send( uint8_t *buffer, uint8_t size )
+{
+    uint32_t timeOnAir = TimeOnAir( Settings.Modem, size );
+
+    TimerStop( &Timer );
+    FramePending = false;
+    SetState( RF_TX_RUNNING, false );
+    SimRadioCaptureAir( CAPTURE_AIR_TX, &Settings, 0, 0, buffer, size );
+    if( ( Handlers != NULL ) && ( Handlers->Transmit != NULL ) )
+    {
+        Handlers->Transmit( &Settings, buffer, size, timeOnAir );
+    }
+    if( IsReplay == false )
+    {
+        TimerSetValue( &Timer, timeOnAir );
+        TimerStart( &Timer );
+    }
+}
+
+void SimRadio::Sleep( void )
+{
+    TimerStop( &Timer );
+    FramePending = false;
+    SetState( RF_IDLE, true );
+}
+
+void SimRadio::Standby( void )
+{
+    TimerStop( &Timer );
+    FramePending = false;
+    SetState( RF_IDLE, false );
+}
+
+void SimRadio::Rx( uint32_t timeout )
+{
+    TimerTime_t now = TimerGetSimulatedTime( );
+    TimerTime_t end = 0;
+
+    TimerStop( &Timer );
+    FramePending = false;
+    SetState( RF_RX_RUNNING, false );
+    if( IsReplay == true )
+    {
+        return;
+    }
+
+    if( Settings.RxContinuous == false )
+    {
+        uint32_t window = timeout;
+
+        if( Settings.Modem == MODEM_LORA )
+        {
+            // The preamble must be detected within the symbol timeout
+            uint32_t symbTime = ( uint32_t )ceil( ( double )( Settings.SymbTimeout << Settings.Datarate ) / ( 125 << Settings.Bandwidth ) );
+
+            if( ( window == 0 ) || ( symbTime < window ) )
+            {
+                window = symbTime;
+            }
+        }
+        end = now + ( ( window > 0 ) ? window : 1 );
+    }
+
+    if( ( Handlers != NULL ) && ( Handlers->Receive != NULL ) &&
+        ( Handlers->Receive( &Settings, end, &Frame ) == true ) &&
+        ( Frame.Start >= now ) && ( ( end == 0 ) || ( Frame.Start <= end ) ) )
+    {
+        FramePending = true;
+        TimerSetValue( &Timer, Frame.Start + TimeOnAir( Settings.Modem, Frame.Size ) - now );
+        TimerStart( &Timer );
+    }
+    else if( end != 0 )
+    {
+        TimerSetValue( &Timer, end - now );
+        TimerStart( &Timer );
+    }
+}
+
+void SimRadio::SetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time )
+{
+    Settings.Frequency = freq;
+    Settings.Power = power;
+    SetState( RF_TX_RUNNING, false );
+    if( IsReplay == false )
+    {
+        TimerSetValue( &Timer, ( uint32_t )time * 1000 );
+        TimerStart( &Timer );
+    }
+}
+
+void SimRadio::SetMaxPayloadLength( RadioModems_t modem, uint8_t max )
+{
+}
+
+void SimRadio::SetPublicNetwork( bool enable )
+{
+}
+
+void SimRadio::GetOpModeTimes( RadioOpModeTimes_t *times )
+{
+    SetState( State, IsSleeping );
+    *times = Times;
+}
+
+void SimRadio::OnTimeout( void )
+{
+    if( State == RF_TX_RUNNING )
+    {
+        SetState( RF_IDLE, false );
+        if( ( Events != NULL ) && ( Events->TxDone != NULL ) )
+        {
+            Events->TxDone( );
+        }
+    }
+    else if( State == RF_RX_RUNNING )
+    {
+        if( Settings.RxContinuous == false )
+        {
+            SetState( RF_IDLE, false );
+        }
+        if( FramePending == true )
+        {
+            FramePending = false;
+            SimRadioCaptureAir( CAPTURE_AIR_RX, &Settings, Frame.Rssi, Frame.Snr, Frame.Payload, Frame.Size );
+            if( ( Events != NULL ) && ( Events->RxDone != NULL ) )
+            {
+                Events->RxDone( Frame.Payload, Frame.Size, Frame.Rssi, Frame.Snr );
+            }
+        }
+        else if( ( Events != NULL ) && ( Events->RxTimeout != NULL ) )
+        {
+            Events->RxTimeout( );
+        }
+    }
+}
+
+void SimRadio::SetReplay( bool enable )
+{
+    IsReplay = enable;
+}
+
+void SimRadio::ReplayTxDone( void )
+{
+    SetState( RF_IDLE, false );
+    if( ( Events != NULL ) && ( Events->TxDone != NULL ) )
+    {
+        Events->TxDone( );
+    }
+}
+
+void SimRadio::ReplayTxTimeout( void )
+{
+    SetState( RF_IDLE, false );
+    if( ( Events != NULL ) && ( Events->TxTimeout != NULL ) )
+    {
+        Events->TxTimeout( );
+    }
+}
+
+void SimRadio::ReplayRxDone( const uint8_t *payload, uint8_t size, int16_t rssi, int8_t snr )
+{
+    if( Settings.RxContinuous == false )
+    {
+        SetState( RF_IDLE, false );
+    }
+    // The MAC decrypts the frame in place
+    memcpy( Frame.Payload, payload, size );
+    Frame.Size = size;
+    Frame.Rssi = rssi;
+    Frame.Snr = snr;
+    if( ( Events != NULL ) && ( Events->RxDone != NULL ) )
+    {
+        Events->RxDone( Frame.Payload, Frame.Size, Frame.Rssi, Frame.Snr );
+    }
+}
+
+void SimRadio::ReplayRxTimeout( void )
+{
+    if( Settings.RxContinuous == false )
+    {
+        SetState( RF_IDLE, false );
+    }
+    if( ( Events != NULL ) && ( Events->RxTimeout != NULL ) )
+    {
+        Events->RxTimeout( );
+    }
+}
+
+void SimRadio::ReplayRxError( void )
+{
+    if( Settings.RxContinuous == false )
+    {
+        SetState( RF_IDLE, false );
+    }
+    if( ( Events != NULL ) && ( Events->RxError != NULL ) )
+    {
+        Events->RxError( );
+    }
+}
+
+void SimRadio::ReplayValidHeader( void )
+{
+    if( ( Events != NULL ) && ( Events->ValidHeader != NULL ) )
+    {
+        Events->ValidHeader( );
+    }
+}
+
+void SimRadio::SetState( RadioState state, bool sleep )
+{
+    TimerTime_t now = TimerGetSimulatedTime( );
+    uint32_t elapsed = ( now - StateStart ) * 1000;
+
+    if( State == RF_TX_RUNNING )
+    {
+        Times.Tx += elapsed;
+    }
+    else if( State == RF_RX_RUNNING )
+    {
+        Times.Rx += elapsed;
+    }
+    else if( IsSleeping == true )
+    {
+        Times.Sleep += elapsed;
+    }
+    else
+    {
+        Times.Standby += elapsed;
+    }
+    StateStart = now;
+    State = state;
+    IsSleeping = sleep;
+}
@@ -0,0 +1,221 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C) 2014 Semtech
+
+Description: Host build radio. Simulates the SX1276 driver on the simulated
+             time: transmissions end after their time on air and the receive
+             windows get the frames the test puts on the air. In replay mode
+             the radio events are the captured ones
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainers: Miguel Luis, Gregory Cristian and Nicolas Huguenin
+*/
+#ifndef __RADIO_H__
+#define __RADIO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+#include "../../../radio/SX1276Lib/enums/enums.h"
+
+/*!
+ * Radio wakeup time from sleep [ms]
+ */
+#define RADIO_WAKEUP_TIME                           1
+
+/*!
+ * @brief Radio driver callback functions
+ */
+typedef struct
+{
+    void    ( *TxDone )( void );
+    void    ( *TxTimeout )( void );
+    void    ( *RxDone )( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr );
+    void    ( *RxTimeout )( void );
+    void    ( *RxError )( void );
+    void ( *FhssChangeChannel )( uint8_t currentChannel );
+    void ( *CadDone ) ( bool channelActivityDetected );
+    void ( *ValidHeader ) ( void );
+}RadioEvents_t;
+
+/*!
+ * @brief Time spent by the radio in each operating mode since its creation [us]
+ */
+typedef struct
+{
+    uint32_t Sleep;
+    uint32_t Standby;
+    uint32_t Tx;
+    uint32_t Rx;
+}RadioOpModeTimes_t;
+
+/*!
+ * @brief Modulation parameters of the last SetTxConfig or SetRxConfig call
+ */
+typedef struct
+{
+    RadioModems_t Modem;
+    uint32_t Frequency;
+    /*!
+     * LoRa: 0: 125 kHz, 1: 250 kHz, 2: 500 kHz. FSK: bandwidth [Hz]
+     */
+    uint32_t Bandwidth;
+    /*!
+     * LoRa: spreading factor. FSK: bitrate [bps]
+     */
+    uint32_t Datarate;
+    uint8_t Coderate;
+    uint16_t PreambleLen;
+    bool FixLen;
+    bool CrcOn;
+    bool IqInverted;
+    int8_t Power;
+    /*!
+     * Reception timeout [symbols]
+     */
+    uint16_t SymbTimeout;
+    bool RxContinuous;
+}SimRadioSettings_t;
+
+/*!
+ * @brief Frame put on the air by the test
+ */
+typedef struct
+{
+    /*!
+     * Simulated time of the preamble start [ms]
+     */
+    TimerTime_t Start;
+    uint8_t Payload[255];
+    uint8_t Size;
+    int16_t Rssi;
+    int8_t Snr;
+}SimRadioFrame_t;
+
+/*!
+ * @brief Frame handlers of the test, all optional
+ */
+typedef struct
+{
+    /*!
+     * @brief Called when the radio starts a transmission
+     *
+     * @param [IN] settings Transmission parameters
+     * @param [IN] payload  Frame
+     * @param [IN] size     Frame size
+     * @param [IN] timeOnAir Frame time on air [ms]
+     */
+    void ( *Transmit )( const SimRadioSettings_t *settings, const uint8_t *payload, uint8_t size, uint32_t timeOnAir );
+    /*!
+     * @brief Called when the radio opens a receive window. The frame is
+     *        received when its preamble starts while the window is open
+     *
+     * @param [IN]  settings Reception parameters
+     * @param [IN]  end      Simulated time at which the window closes when
+     *                       no preamble is detected [ms]. 0 for continuous
+     *                       reception
+     * @param [OUT] frame    Next frame on the air for this window
+     * @retval found         [true: frame is filled, false: nothing on the air]
+     */
+    bool ( *Receive )( const SimRadioSettings_t *settings, TimerTime_t end, SimRadioFrame_t *frame );
+    /*!
+     * @brief Called for each random number read by the MAC. NULL: the C
+     *        library generator is used
+     *
+     * @retval value Random number
+     */
+    uint32_t ( *Random )( void );
+}SimRadioHandlers_t;
+
+/*!
+ * Simulated radio. Same functions as the SX1276 driver used by the MAC
+ */
+class SimRadio
+{
+public:
+    SimRadio( void );
+
+    /*!
+     * @brief Sets the test frame handlers
+     */
+    void SetHandlers( const SimRadioHandlers_t *handlers );
+
+    void Init( RadioEvents_t *events );
+    RadioState GetStatus( void );
+    void SetModem( RadioModems_t modem );
+    void SetChannel( uint32_t freq );
+    bool IsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh );
+    uint32_t Random( void );
+    void SetRxConfig( RadioModems_t modem, uint32_t bandwidth,
+                      uint32_t datarate, uint8_t coderate,
+                      uint32_t bandwidthAfc, uint16_t preambleLen,
+                      uint16_t symbTimeout, bool fixLen,
+                      uint8_t payloadLen,
+                      bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                      bool iqInverted, bool rxContinuous );
+    void SetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
+                      uint32_t bandwidth, uint32_t datarate,
+                      uint8_t coderate, uint16_t preambleLen,
+                      bool fixLen, bool crcOn, bool freqHopOn,
+                      uint8_t hopPeriod, bool iqInverted, uint32_t timeout );
+    bool CheckRfFrequency( uint32_t frequency );
+    uint32_t TimeOnAir( RadioModems_t modem, uint8_t pktLen );
+    void Send( uint8_t *buffer, uint8_t size );
+    void Sleep( void );
+    void Standby( void );
+    void Rx( uint32_t timeout );
+    void SetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time );
+    void SetMaxPayloadLength( RadioModems_t modem, uint8_t max );
+    void SetPublicNetwork( bool enable );
+    void GetOpModeTimes( RadioOpModeTimes_t *times );
+
+    /*!
+     * @brief Ends the current operation. Called by the radio timer
+     */
+    void OnTimeout( void );
+
+    /*!
+     * @brief Enters or leaves the replay mode. In replay mode the radio does
+     *        not end its operations by itself nor asks the test for frames,
+     *        the Replay functions raise the captured events
+     *
+     * @param [IN] enable Replay mode
+     */
+    void SetReplay( bool enable );
+
+    /*!
+     * @brief Raises a captured radio event
+     */
+    void ReplayTxDone( void );
+    void ReplayTxTimeout( void );
+    void ReplayRxDone( const uint8_t *payload, uint8_t size, int16_t rssi, int8_t snr );
+    void ReplayRxTimeout( void );
+    void ReplayRxError( void );
+    void ReplayValidHeader( void );
+
+private:
+    /*!
+     * @brief Accounts the time spent in the current state and enters the
+     *        new one
+     */
+    void SetState( RadioState state, bool sleep );
+
+    RadioEvents_t *Events;
+    const SimRadioHandlers_t *Handlers;
+    SimRadioSettings_t Settings;
+    RadioState State;
+    bool IsSleeping;
+    TimerEvent_t Timer;
+    TimerTime_t StateStart;
+    RadioOpModeTimes_t Times;
+    bool FramePending;
+    SimRadioFrame_t Frame;
+    bool IsReplay;
+};
+
+#endif // __RADIO_H__
@@ -0,0 +1,210 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2013 Semtech
+
+Description: Host build timer objects running on a simulated time. The
+             expiries are captured as by the system timers
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#include "board.h"
+
+/*!
+ * Maximum number of timer objects started at least once
+ */
+#define TIMER_MAX_NB_OBJECTS                        32
+
+/*!
+ * Simulated time [ms]
+ */
+static TimerTime_t CurrentTime = 0;
+
+/*!
+ * Source of TimerGetCurrentTime. NULL: simulated time
+ */
+static TimerTime_t ( *TimeSource )( void ) = NULL;
+
+/*!
+ * Timer objects started at least once since the last TimerTimeCounterInit
+ */
+static TimerEvent_t *Timers[TIMER_MAX_NB_OBJECTS];
+static uint8_t NbTimers = 0;
+
+void TimerTimeCounterInit( void )
+{
+    CurrentTime = 0;
+    for( uint8_t i = 0; i < NbTimers; i++ )
+    {
+        Timers[i]->IsRunning = false;
+    }
+    NbTimers = 0;
+}
+
+void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) )
+{
+    obj->value = 0;
+    obj->Callback = callback;
+    obj->Expiry = 0;
+    obj->IsRunning = false;
+    obj->IsCaptured = true;
+}
+
+void TimerStart( TimerEvent_t *obj )
+{
+    uint8_t i = 0;
+
+    while( ( i < NbTimers ) && ( Timers[i] != obj ) )
+    {
+        i++;
+    }
+    if( ( i == NbTimers ) && ( NbTimers < TIMER_MAX_NB_OBJECTS ) )
+    {
+        Timers[NbTimers++] = obj;
+    }
+    obj->Expiry = CurrentTime + obj->value;
+    obj->IsRunning = true;
+}
+
+void TimerStop( TimerEvent_t *obj )
+{
+    obj->IsRunning = false;
+}
+
+void TimerReset( TimerEvent_t *obj )
+{
+    TimerStop( obj );
+    TimerStart( obj );
+}
+
+void TimerSetValue( TimerEvent_t *obj, uint32_t value )
+{
+    obj->value = value;
+}
+
+TimerTime_t TimerGetCurrentTime( void )
+{
+    return ( TimeSource != NULL ) ? TimeSource( ) : CurrentTime;
+}
+
+TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime )
+{
+    return ( TimerTime_t )( TimerGetCurrentTime( ) - savedTime );
+}
+
+TimerTime_t TimerGetFutureTime( TimerTime_t eventInFuture )
+{
+    return ( TimerTime_t )( TimerGetCurrentTime( ) + eventInFuture );
+}
+
+TimerTime_t TimerGetSimulatedTime( void )
+{
+    return CurrentTime;
+}
+
+void TimerSetSimulatedTime( TimerTime_t time )
+{
+    CurrentTime = time;
+}
+
+void TimerSetTimeSource( TimerTime_t ( *source )( void ) )
+{
+    TimeSource = source;
+}
+
+/*!
+ * \brief Stops the timer and calls its callback, as the system timer
+ *        interrupt handler
+ */
+static void TimerIrqHandler( TimerEvent_t *obj )
+{
+#if( CAPTURE_MAC_ON )
+    uint32_t callback = ( uint32_t )( uintptr_t )obj->Callback;
+#endif
+
+    obj->IsRunning = false;
+    if( obj->IsCaptured == true )
+    {
+        CAPTURE( CAPTURE_TIMER_FIRE, &callback, sizeof( callback ), NULL, 0 );
+    }
+    obj->Callback( );
+}
+
+/*!
+ * \brief Gets the running timer expiring first
+ */
+static TimerEvent_t* TimerGetNext( void )
+{
+    TimerEvent_t *next = NULL;
+
+    for( uint8_t i = 0; i < NbTimers; i++ )
+    {
+        if( ( Timers[i]->IsRunning == true ) &&
+            ( ( next == NULL ) || ( ( int32_t )( Timers[i]->Expiry - next->Expiry ) < 0 ) ) )
+        {
+            next = Timers[i];
+        }
+    }
+    return next;
+}
+
+bool TimerGetNextExpiry( TimerTime_t *expiry )
+{
+    TimerEvent_t *next = TimerGetNext( );
+
+    if( next == NULL )
+    {
+        return false;
+    }
+    *expiry = next->Expiry;
+    return true;
+}
+
+void TimerAdvance( TimerTime_t time )
+{
+    TimerEvent_t *next = TimerGetNext( );
+
+    // A callback may start timers expiring before time
+    while( ( next != NULL ) && ( ( int32_t )( next->Expiry - time ) <= 0 ) )
+    {
+        if( ( int32_t )( next->Expiry - CurrentTime ) > 0 )
+        {
+            CurrentTime = next->Expiry;
+        }
+        TimerIrqHandler( next );
+        next = TimerGetNext( );
+    }
+    if( ( int32_t )( time - CurrentTime ) > 0 )
+    {
+        CurrentTime = time;
+    }
+}
+
+bool TimerFire( uint32_t callback, uint32_t tolerance )
+{
+    TimerEvent_t *next = NULL;
+
+    for( uint8_t i = 0; i < NbTimers; i++ )
+    {
+        if( ( Timers[i]->IsRunning == true ) && ( ( uint32_t )( uintptr_t )Timers[i]->Callback == callback ) )
+        {
+            next = Timers[i];
+            break;
+        }
+    }
+    if( next == NULL )
+    {
+        next = TimerGetNext( );
+        if( ( next == NULL ) || ( ( int32_t )( next->Expiry - CurrentTime ) > ( int32_t )tolerance ) )
+        {
+            return false;
+        }
+    }
+    TimerIrqHandler( next );
+    return true;
+}
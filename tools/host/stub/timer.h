@@ -0,0 +1,163 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+    (C)2013 Semtech
+
+Description: Host build timer objects running on a simulated time
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+
+Maintainer: Miguel Luis and Gregory Cristian
+*/
+#ifndef __TIMER_H__
+#define __TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*!
+ * \brief Timer time variable definition
+ */
+#ifndef TimerTime_t
+typedef uint32_t TimerTime_t;
+#endif
+
+/*!
+ * \brief Timer object description
+ */
+typedef struct TimerEvent_s
+{
+    uint32_t value;
+    void ( *Callback )( void );
+    TimerTime_t Expiry;
+    bool IsRunning;
+    /*!
+     * The expiry is captured, as the system timers. Cleared by the simulated
+     * radio, whose driver timeouts are not system timers on the target
+     */
+    bool IsCaptured;
+}TimerEvent_t;
+
+/*!
+ * \brief Resets the simulated time to 0 and forgets all the running timers
+ */
+void TimerTimeCounterInit( void );
+
+/*!
+ * \brief Initializes the timer object
+ *
+ * \param [IN] obj          Structure containing the timer object parameters
+ * \param [IN] callback     Function callback called at the end of the timeout
+ */
+void TimerInit( TimerEvent_t *obj, void ( *callback )( void ) );
+
+/*!
+ * \brief Starts the timer object. It expires value ms after the current
+ *        simulated time
+ *
+ * \param [IN] obj Structure containing the timer object parameters
+ */
+void TimerStart( TimerEvent_t *obj );
+
+/*!
+ * \brief Stops the timer object
+ *
+ * \param [IN] obj Structure containing the timer object parameters
+ */
+void TimerStop( TimerEvent_t *obj );
+
+/*!
+ * \brief Restarts the timer object
+ *
+ * \param [IN] obj Structure containing the timer object parameters
+ */
+void TimerReset( TimerEvent_t *obj );
+
+/*!
+ * \brief Set timer new timeout value
+ *
+ * \param [IN] obj   Structure containing the timer object parameters
+ * \param [IN] value New timer timeout value [ms]
+ */
+void TimerSetValue( TimerEvent_t *obj, uint32_t value );
+
+/*!
+ * \brief Read the current time: the simulated time, or the time given by the
+ *        time source when one is set
+ *
+ * \retval time Current time [ms]
+ */
+TimerTime_t TimerGetCurrentTime( void );
+
+/*!
+ * \brief Return the Time elapsed since a fix moment in Time
+ *
+ * \param [IN] savedTime fix moment in Time
+ * \retval time          returns elapsed time
+ */
+TimerTime_t TimerGetElapsedTime( TimerTime_t savedTime );
+
+/*!
+ * \brief Return the Time elapsed since a fix moment in Time
+ *
+ * \param [IN] eventInFuture fix moment in the future
+ * \retval time              returns difference between now and future event
+ */
+TimerTime_t TimerGetFutureTime( TimerTime_t eventInFuture );
+
+/*!
+ * \brief Gets the expiry of the next running timer
+ *
+ * \param [OUT] expiry Simulated time of the next expiry [ms]
+ *
+ * \retval status [true: a timer is running, false: no timer is running]
+ */
+bool TimerGetNextExpiry( TimerTime_t *expiry );
+
+/*!
+ * \brief Advances the simulated time. The timers expiring on the way are
+ *        fired in expiry order, the time being set to their expiry first
+ *
+ * \param [IN] time New simulated time [ms]. Ignored when in the past
+ */
+void TimerAdvance( TimerTime_t time );
+
+/*!
+ * \brief Read the simulated time, whatever the time source
+ *
+ * \retval time Simulated time [ms]
+ */
+TimerTime_t TimerGetSimulatedTime( void );
+
+/*!
+ * \brief Sets the simulated time without firing the timers. Used by the
+ *        capture replay, which fires the timers as captured
+ *
+ * \param [IN] time New simulated time [ms]
+ */
+void TimerSetSimulatedTime( TimerTime_t time );
+
+/*!
+ * \brief Sets the source of TimerGetCurrentTime and TimerGetElapsedTime
+ *
+ * \param [IN] source Time source. NULL: simulated time
+ */
+void TimerSetTimeSource( TimerTime_t ( *source )( void ) );
+
+/*!
+ * \brief Fires a running timer at the current simulated time
+ *
+ * \param [IN] callback  Captured callback address. The timer of this callback
+ *                       is fired when running
+ * \param [IN] tolerance Otherwise, the running timer expiring first is fired
+ *                       when it expires at most tolerance ms after the
+ *                       current time [ms]
+ *
+ * \retval status [true: a timer is fired, false: no timer matches]
+ */
+bool TimerFire( uint32_t callback, uint32_t tolerance );
+
+#endif // __TIMER_H__
@@ -0,0 +1,270 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: Host control client. Drives the node MCPS, MLME and MIB services
+#              through the binary protocol implemented by app/HostCtrl.cpp
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+#
+# Usage: hostctrl.py <serial device> [join <DevEui> <AppEui> <AppKey>] [send <port> <hex data>]
+#                                    [get <mib>] [set <mib> <value>]
+
+import struct
+import sys
+import threading
+
+DELIMITER = 0x00
+
+# Mirrors HostCtrlMessage_t in app/HostCtrl.h
+MCPS_REQ = 0x01
+MLME_REQ = 0x02
+MIB_GET = 0x03
+MIB_SET = 0x04
+STATUS = 0x80
+MCPS_CONFIRM = 0x81
+MCPS_INDICATION = 0x82
+MLME_CONFIRM = 0x83
+MLME_INDICATION = 0x84
+
+# Mirrors Mcps_t, Mlme_t, Mib_t and LoRaMacStatus_t in LoRaMac.h
+MCPS_UNCONFIRMED, MCPS_CONFIRMED, MCPS_MULTICAST, MCPS_PROPRIETARY = range( 4 )
+MLME_JOIN, MLME_LINK_CHECK, MLME_TXCW, MLME_TXCW_1, MLME_BEACON_ACQUISITION, MLME_PING_SLOT_INFO, MLME_BEACON = range( 7 )
+MIBS = [
+    "DEVICE_CLASS", "NETWORK_JOINED", "ADR", "NET_ID", "DEV_ADDR", "NWK_SKEY", "APP_SKEY",
+    "PUBLIC_NETWORK", "REPEATER_SUPPORT", "CHANNELS", "RX2_CHANNEL", "RX2_DEFAULT_CHANNEL",
+    "CHANNELS_MASK", "CHANNELS_DEFAULT_MASK", "CHANNELS_NB_REP", "MAX_RX_WINDOW_DURATION",
+    "RECEIVE_DELAY_1", "RECEIVE_DELAY_2", "JOIN_ACCEPT_DELAY_1", "JOIN_ACCEPT_DELAY_2",
+    "CHANNELS_DEFAULT_DATARATE", "CHANNELS_DATARATE", "CHANNELS_TX_POWER",
+    "CHANNELS_DEFAULT_TX_POWER", "UPLINK_COUNTER", "DOWNLINK_COUNTER", "MULTICAST_CHANNEL",
+    "SYSTEM_MAX_RX_ERROR", "MIN_RX_SYMBOLS", "ENERGY", "ENERGY_TABLE", "PROFILE", "REGION",
+    "LINK_ADR", "DEV_NONCE",
+]
+STATUSES = [
+    "OK", "BUSY", "SERVICE_UNKNOWN", "PARAMETER_INVALID", "FREQUENCY_INVALID",
+    "DATARATE_INVALID", "FREQ_AND_DR_INVALID", "NO_NETWORK_JOINED", "LENGTH_ERROR",
+    "MAC_CMD_LENGTH_ERROR", "DEVICE_OFF",
+]
+
+
+def crc16( data ):
+    crc = 0
+    for b in data:
+        crc ^= b << 8
+        for i in range( 8 ):
+            crc = ( ( crc << 1 ) ^ 0x1021 ) if ( crc & 0x8000 ) else ( crc << 1 )
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode( data ):
+    out = bytearray( [0] )
+    code_index = 0
+    code = 1
+    for b in data:
+        if b == 0:
+            out[code_index] = code
+            code_index = len( out )
+            out.append( 0 )
+            code = 1
+        else:
+            out.append( b )
+            code += 1
+            if code == 0xFF:
+                out[code_index] = code
+                code_index = len( out )
+                out.append( 0 )
+                code = 1
+    out[code_index] = code
+    return bytes( out )
+
+
+def cobs_decode( data ):
+    out = bytearray( )
+    i = 0
+    while i < len( data ):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len( data ):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len( data ):
+            out.append( 0 )
+    return bytes( out )
+
+
+def frame( message ):
+    """Frames a message: delimiter, COBS( message, CRC ), delimiter"""
+    return bytes( [DELIMITER] ) + cobs_encode( message + struct.pack( "<H", crc16( message ) ) ) + bytes( [DELIMITER] )
+
+
+def unframe( data ):
+    """Returns the message of a frame content, None when it is invalid"""
+    message = cobs_decode( data )
+    if message is None or len( message ) < 4 or crc16( message[:-2] ) != struct.unpack( "<H", message[-2:] )[0]:
+        return None
+    return message[:-2]
+
+
+def decode( message ):
+    """Decodes a device message into a dictionary"""
+    kind, seq, body = message[0], message[1], message[2:]
+    if kind == STATUS:
+        return { "type": "status", "seq": seq, "status": STATUSES[body[0]] if body[0] < len( STATUSES ) else body[0], "value": body[1:] }
+    if kind == MCPS_CONFIRM:
+        fields = struct.unpack_from( "<BBBbBBIII", body )
+        return dict( zip( ( "mcps", "event_status", "datarate", "tx_power", "ack_received", "nb_retries",
+                            "time_on_air", "uplink_counter", "frequency" ), fields ), type="mcps_confirm", seq=seq )
+    if kind == MCPS_INDICATION:
+        fields = struct.unpack_from( "<BBBBBBBBhBI", body )
+        result = dict( zip( ( "mcps", "event_status", "multicast", "port", "datarate", "frame_pending",
+                              "ack_received", "rx_slot", "rssi", "snr", "downlink_counter" ), fields ) )
+        result.update( type="mcps_indication", seq=seq, data=body[struct.calcsize( "<BBBBBBBBhBI" ):] )
+        return result
+    if kind == MLME_CONFIRM:
+        fields = struct.unpack_from( "<BBIBBB", body )
+        return dict( zip( ( "mlme", "event_status", "time_on_air", "demod_margin", "nb_gateways", "nb_retries" ), fields ),
+                     type="mlme_confirm", seq=seq )
+    if kind == MLME_INDICATION:
+        fields = struct.unpack_from( "<BBIhB", body )
+        return dict( zip( ( "mlme", "event_status", "beacon_time", "rssi", "snr" ), fields ), type="mlme_indication", seq=seq )
+    return { "type": "unknown", "seq": seq, "raw": message }
+
+
+class HostCtrl( object ):
+    """Host control client. The requests may be pipelined: each request method
+    returns a sequence number immediately, wait( ) collects the responses"""
+
+    def __init__( self, port, baudrate=115200, on_indication=None ):
+        import serial
+        self.serial = serial.Serial( port, baudrate, timeout=0.1 )
+        self.on_indication = on_indication
+        self.seq = 0
+        self.responses = {}
+        self.condition = threading.Condition( )
+        self.running = True
+        self.reader = threading.Thread( target=self._read )
+        self.reader.daemon = True
+        self.reader.start( )
+
+    def close( self ):
+        self.running = False
+        self.reader.join( )
+        self.serial.close( )
+
+    def _read( self ):
+        buffer = bytearray( )
+        in_frame = False
+        while self.running:
+            for b in self.serial.read( 256 ):
+                if b != DELIMITER:
+                    if in_frame:
+                        buffer.append( b )
+                    # Chars outside of a frame belong to the console
+                    continue
+                if not in_frame or not buffer:
+                    in_frame = True
+                    continue
+                message = unframe( bytes( buffer ) )
+                buffer = bytearray( )
+                in_frame = False
+                if message is not None:
+                    self._dispatch( decode( message ) )
+
+    def _dispatch( self, event ):
+        if event["type"] in ( "mcps_indication", "mlme_indication" ):
+            if self.on_indication is not None:
+                self.on_indication( event )
+            return
+        with self.condition:
+            self.responses.setdefault( event["seq"], [] ).append( event )
+            self.condition.notify_all( )
+
+    def _request( self, kind, body ):
+        with self.condition:
+            seq = self.seq
+            self.seq = ( self.seq + 1 ) & 0xFF
+            self.responses.pop( seq, None )
+        self.serial.write( frame( bytes( [kind, seq] ) + body ) )
+        return seq
+
+    def wait( self, seq, kind="status", timeout=10.0 ):
+        """Waits for the response of the given type to a request"""
+        with self.condition:
+            while True:
+                for event in self.responses.get( seq, [] ):
+                    if event["type"] == kind:
+                        self.responses[seq].remove( event )
+                        return event
+                if not self.condition.wait( timeout ):
+                    raise IOError( "No %s for request %d" % ( kind, seq ) )
+
+    def mcps_request( self, port, data, confirmed=False, datarate=0, nb_trials=8 ):
+        mcps = MCPS_CONFIRMED if confirmed else MCPS_UNCONFIRMED
+        return self._request( MCPS_REQ, bytes( [mcps, port, datarate, nb_trials] ) + bytes( data ) )
+
+    def join( self, dev_eui, app_eui, app_key, nb_trials=1 ):
+        return self._request( MLME_REQ, bytes( [MLME_JOIN] ) + bytes( dev_eui ) + bytes( app_eui ) + bytes( app_key ) + bytes( [nb_trials] ) )
+
+    def link_check( self ):
+        return self._request( MLME_REQ, bytes( [MLME_LINK_CHECK] ) )
+
+    def mib_get( self, mib ):
+        return self._request( MIB_GET, bytes( [MIBS.index( mib )] ) )
+
+    def mib_set( self, mib, value ):
+        if isinstance( value, int ):
+            value = struct.pack( "<I", value & 0xFFFFFFFF )
+        return self._request( MIB_SET, bytes( [MIBS.index( mib )] ) + bytes( value ) )
+
+
+def main( argv ):
+    if len( argv ) < 2:
+        sys.stderr.write( "Usage: %s <serial device> [join <DevEui> <AppEui> <AppKey>] [send <port> <hex data>] "
+                          "[get <mib>] [set <mib> <value>]\n" % argv[0] )
+        return 1
+
+    def on_indication( event ):
+        print( "indication %s" % event )
+
+    host = HostCtrl( argv[1], on_indication=on_indication )
+    args = argv[2:]
+    try:
+        while args:
+            command = args.pop( 0 )
+            if command == "join":
+                seq = host.join( bytes.fromhex( args.pop( 0 ) ), bytes.fromhex( args.pop( 0 ) ), bytes.fromhex( args.pop( 0 ) ) )
+                print( host.wait( seq ) )
+                print( host.wait( seq, "mlme_confirm", 60.0 ) )
+            elif command == "send":
+                seq = host.mcps_request( int( args.pop( 0 ) ), bytes.fromhex( args.pop( 0 ) ) )
+                print( host.wait( seq ) )
+                print( host.wait( seq, "mcps_confirm", 60.0 ) )
+            elif command == "get":
+                mib = args.pop( 0 )
+                response = host.wait( host.mib_get( mib ) )
+                value = response["value"]
+                print( "%s %s %s" % ( mib, response["status"], struct.unpack( "<I", value )[0] if len( value ) == 4 else value.hex( ) ) )
+            elif command == "set":
+                mib = args.pop( 0 )
+                value = args.pop( 0 )
+                value = int( value, 0 ) if len( value ) <= 10 else bytes.fromhex( value )
+                print( "%s %s" % ( mib, host.wait( host.mib_set( mib, value ) )["status"] ) )
+            else:
+                sys.stderr.write( "Unknown command %s\n" % command )
+                return 1
+    finally:
+        host.close( )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit( main( sys.argv ) )
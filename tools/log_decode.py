@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: Tokenized log decoder. Expands the messages drained by
+#              system/log.cpp with the format strings of the application ELF
+#              file. The event trace frames sharing the stream are skipped
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+#
+# Usage: log_decode.py [-m] <ELF file> <capture file | serial device> [baudrate]
+#
+#   -m  Prints the messages only, without timestamp and level. Used to extract
+#       the comma separated results of app/MicroBench.cpp
+
+import re
+import struct
+import sys
+
+import debug_frame
+
+MAX_ARGS = 4
+
+# Mirrors the LOG_LEVEL_* values of system/log.h
+LEVELS = [ "LOST", "ERROR", "WARNING", "INFO", "DEBUG" ]
+
+CONVERSION = re.compile( r"%([-+ #0]*[0-9]*(?:\.[0-9]+)?)(?:hh|h|ll|l|j|z|t)?([diouxXcsp%])" )
+
+SHT_PROGBITS = 1
+SHF_ALLOC = 0x2
+
+
+class Image( object ):
+    """Allocated sections of an ELF file, used to read the format strings"""
+
+    def __init__( self, path ):
+        data = open( path, "rb" ).read( )
+        if data[:4] != b"\x7fELF":
+            raise ValueError( "%s is not an ELF file" % path )
+        is64 = data[4] == 2
+        endian = "<" if data[5] == 1 else ">"
+        if is64:
+            shoff, = struct.unpack_from( endian + "Q", data, 0x28 )
+            shentsize, shnum = struct.unpack_from( endian + "HH", data, 0x3A )
+            header = endian + "IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from( endian + "I", data, 0x20 )
+            shentsize, shnum = struct.unpack_from( endian + "HH", data, 0x2E )
+            header = endian + "IIIIIIIIII"
+
+        self.sections = []
+        for i in range( shnum ):
+            name, kind, flags, addr, offset, size = struct.unpack_from( header, data, shoff + i * shentsize )[:6]
+            if kind == SHT_PROGBITS and ( flags & SHF_ALLOC ) and size > 0:
+                self.sections.append( ( addr, data[offset:offset + size] ) )
+
+    def string( self, address ):
+        """Returns the NUL terminated string at the address, None if the address
+        is not in the image"""
+        for start, content in self.sections:
+            if start <= address < start + len( content ):
+                end = content.find( b"\0", address - start )
+                if end < 0:
+                    end = len( content )
+                return content[address - start:end].decode( "latin-1" )
+        return None
+
+
+def read_frames( stream ):
+    """Yields ( level, time, format, args ) tuples. Resynchronizes on errors"""
+    for payload in debug_frame.read_frames( stream, debug_frame.LOG ):
+        nb_args = payload[0] & 0x0F
+        level = payload[0] >> 4
+        if nb_args > MAX_ARGS or level >= len( LEVELS ) or len( payload ) != 9 + 4 * nb_args:
+            continue
+        time, address = struct.unpack_from( "<II", payload, 1 )
+        args = struct.unpack_from( "<%dI" % nb_args, payload, 9 )
+        yield level, time, address, args
+
+
+def expand( image, address, args ):
+    """Formats a message like printf, the arguments being 32 bits words"""
+    format = image.string( address )
+    if format is None:
+        return "<unknown format 0x%08X> %s" % ( address, " ".join( "0x%08X" % arg for arg in args ) )
+
+    values = list( args )
+    result = []
+    position = 0
+    for match in CONVERSION.finditer( format ):
+        result.append( format[position:match.start( )] )
+        position = match.end( )
+        flags, conversion = match.groups( )
+        if conversion == "%":
+            result.append( "%" )
+            continue
+        if not values:
+            result.append( "<missing>" )
+            continue
+        value = values.pop( 0 )
+        if conversion in "di":
+            result.append( ( "%" + flags + "d" ) % ( value - ( 1 << 32 ) if value & 0x80000000 else value ) )
+        elif conversion in "ouxX":
+            result.append( ( "%" + flags + ( "d" if conversion == "u" else conversion ) ) % value )
+        elif conversion == "c":
+            result.append( chr( value & 0xFF ) )
+        elif conversion == "p":
+            result.append( "0x%08X" % value )
+        else:
+            string = image.string( value )
+            result.append( ( "%" + flags + "s" ) % ( string if string is not None else "<0x%08X>" % value ) )
+    result.append( format[position:] )
+    return "".join( result ).rstrip( "\r\n" )
+
+
+def main( argv ):
+    messages_only = "-m" in argv
+    argv = [ arg for arg in argv if arg != "-m" ]
+    if len( argv ) < 3:
+        sys.stderr.write( "Usage: %s [-m] <ELF file> <capture file | serial device> [baudrate]\n" % argv[0] )
+        return 1
+
+    image = Image( argv[1] )
+    if len( argv ) > 3:
+        import serial
+        stream = serial.Serial( argv[2], int( argv[3] ), timeout=None )
+    else:
+        stream = open( argv[2], "rb" )
+
+    last = None
+    elapsed = 0
+    try:
+        for level, time, address, args in read_frames( stream ):
+            if last is not None:
+                # The microsecond timestamp wraps around every 71 minutes
+                delta = ( time - last ) & 0xFFFFFFFF
+                if delta >= 0x80000000:
+                    delta -= 0x100000000
+                elapsed += delta
+            last = time
+
+            if address == 0:
+                message = "%d messages lost" % args[0]
+            else:
+                message = expand( image, address, args )
+            if messages_only:
+                print( message )
+            else:
+                print( "%12.6f  %-7s  %s" % ( elapsed / 1e6, LEVELS[level], message ) )
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit( main( sys.argv ) )
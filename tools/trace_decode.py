@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+#
+#  / _____)             _              | |
+# ( (____  _____ ____ _| |_ _____  ____| |__
+#  \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+#  _____) ) ____| | | || |_| ____( (___| | | |
+# (______/|_____)_|_|_| \__)_____)\____)_| |_|
+#     (C)2015 Semtech
+#
+# Description: Event trace decoder. Renders the records drained by
+#              system/trace.cpp as a timeline followed by latency statistics
+#
+# License: Revised BSD License, see LICENSE.TXT file include in the project
+#
+# Maintainer: Miguel Luis and Gregory Cristian
+#
+# Usage: trace_decode.py <capture file | serial device> [baudrate]
+
+import struct
+import sys
+
+import debug_frame
+
+# Mirrors TraceEvent_t in system/trace.h
+EVENTS = [
+    "NONE",
+    "DROPPED",
+    "RADIO_TX_DONE",
+    "RADIO_TX_TIMEOUT",
+    "RADIO_RX_DONE",
+    "RADIO_RX_ERROR",
+    "RADIO_RX_TIMEOUT",
+    "RADIO_VALID_HEADER",
+    "MAC_TX",
+    "MAC_RX_WINDOW",
+    "MAC_RX_FRAME",
+    "MAC_RX_ABORT",
+    "MAC_MIC_FAIL",
+    "MAC_COMMAND",
+    "MAC_ACK_TIMEOUT",
+    "TIMER_FIRE",
+]
+
+# Latencies measured between a start event and the first following end event
+LATENCIES = [
+    ( "Tx time on air", "MAC_TX", ( "RADIO_TX_DONE", "RADIO_TX_TIMEOUT" ) ),
+    ( "Tx done to Rx window", "RADIO_TX_DONE", ( "MAC_RX_WINDOW", ) ),
+    ( "Rx window to header", "MAC_RX_WINDOW", ( "RADIO_VALID_HEADER", "RADIO_RX_TIMEOUT", "RADIO_RX_ERROR" ) ),
+    ( "Header to Rx done", "RADIO_VALID_HEADER", ( "RADIO_RX_DONE", "RADIO_RX_ERROR" ) ),
+]
+
+
+def read_frames( stream ):
+    """Yields ( time, event, arg8, arg16 ) tuples. Resynchronizes on errors"""
+    for payload in debug_frame.read_frames( stream, debug_frame.TRACE ):
+        if len( payload ) == 8:
+            yield struct.unpack( "<IBBH", payload )
+
+
+def describe( name, arg8, arg16 ):
+    if name == "DROPPED":
+        return "%d records lost" % arg16
+    if name == "RADIO_RX_DONE":
+        return "size %d, rssi %d" % ( arg8, struct.unpack( "<h", struct.pack( "<H", arg16 ) )[0] )
+    if name in ( "RADIO_RX_ERROR", "RADIO_RX_TIMEOUT" ):
+        return "slot %d" % arg8
+    if name == "MAC_TX":
+        return "DR%d, %.1f MHz" % ( arg8, arg16 / 10.0 )
+    if name == "MAC_RX_WINDOW":
+        return "DR%d, %d symbols" % ( arg8, arg16 )
+    if name in ( "MAC_RX_FRAME", "MAC_MIC_FAIL" ):
+        return "mhdr 0x%02X, fcnt %d" % ( arg8, arg16 )
+    if name == "MAC_RX_ABORT":
+        return "status %d" % arg8
+    if name == "MAC_COMMAND":
+        return "cid 0x%02X" % arg8
+    if name == "MAC_ACK_TIMEOUT":
+        return "trial %d" % arg8
+    if name == "TIMER_FIRE":
+        return "callback 0x%04X" % arg16
+    return ""
+
+
+def main( argv ):
+    if len( argv ) < 2:
+        sys.stderr.write( "Usage: %s <capture file | serial device> [baudrate]\n" % argv[0] )
+        return 1
+
+    if len( argv ) > 2:
+        import serial
+        stream = serial.Serial( argv[1], int( argv[2] ), timeout=None )
+    else:
+        stream = open( argv[1], "rb" )
+
+    last = None
+    elapsed = 0
+    pending = {}
+    samples = dict( ( latency[0], [] ) for latency in LATENCIES )
+
+    try:
+        for time, event, arg8, arg16 in read_frames( stream ):
+            delta = 0
+            if last is not None:
+                # The microsecond timestamp wraps around every 71 minutes. A
+                # record reserved by an interrupted writer may be slightly
+                # older than the previous one
+                delta = ( time - last ) & 0xFFFFFFFF
+                if delta >= 0x80000000:
+                    delta -= 0x100000000
+                elapsed += delta
+            last = time
+
+            name = EVENTS[event] if event < len( EVENTS ) else "EVENT_%d" % event
+            print( "%12.6f %+10d  %-20s %s" % ( elapsed / 1e6, delta, name, describe( name, arg8, arg16 ) ) )
+
+            for label, start, ends in LATENCIES:
+                if name in ends and label in pending:
+                    samples[label].append( elapsed - pending.pop( label ) )
+                if name == start:
+                    pending[label] = elapsed
+    except KeyboardInterrupt:
+        pass
+
+    print( "" )
+    print( "%-24s %6s %10s %10s %10s" % ( "Latency [us]", "count", "min", "mean", "max" ) )
+    for label, start, ends in LATENCIES:
+        values = samples[label]
+        if values:
+            print( "%-24s %6d %10d %10d %10d" % ( label, len( values ), min( values ), sum( values ) // len( values ), max( values ) ) )
+        else:
+            print( "%-24s %6d %10s %10s %10s" % ( label, 0, "-", "-", "-" ) )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit( main( sys.argv ) )